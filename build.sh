@@ -1,2 +1,4 @@
 make asm
-make sim
\ No newline at end of file
+make sim
+make opt
+make ld
\ No newline at end of file
@@ -5,23 +5,24 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+#include "common/object.h"
 #include "hashmap.h"
-
-/// @brief A struct representing the file header for a tinker program
-typedef struct TinkerFileHeader {
-	uint64_t fileType; // Currently, 0
-	uint64_t codeBegin; // Address into which the code is to be loaded in memory
-	uint64_t codeSize; // Size of the code segment
-	uint64_t dataBegin; // Address into which the data is to be loaded in memory
-	uint64_t dataSize; // Size of the data segment (could be 0)
-} TinkerFileHeader;
+#include "buffer.h"
+#include "source.h"
+#include "cache.h"
+#include "reserve.h"
 
 /**
- * @brief Creates a pointer to a new tinker file header
- * 
- * @return The pointer to the new tinker file header
+ * @brief Structure representing how hw7-asm assembles a file.
  */
-TinkerFileHeader* create_tinker_file_header();
+typedef struct AssemblerOptions {
+	int numThreads; /**< number of threads to assemble with (1 for sequential) */
+	bool incremental; /**< whether to reuse and refresh the line cache next to the output file */
+	bool optimize; /**< whether to run the peephole pass first */
+	bool relocatable; /**< whether to emit a relocatable object for hw7-ld */
+	bool debug; /**< whether to append a debug table of labels and source lines */
+	bool compress; /**< whether to compress the data segment */
+} AssemblerOptions;
 
 /**
  * @brief Generates the object file from the input file
@@ -32,35 +33,140 @@ TinkerFileHeader* create_tinker_file_header();
 void generate_object_file(const char* inputFile, const char* outputFile);
 
 /**
- * @brief Checks and opens the input and output files
+ * @brief Generates the object file from the input file using multiple threads
+ * 
+ * The output is byte-identical to generate_object_file.
+ * 
+ * @param inputFile path to the input file
+ * @param outputFile path to the output file
+ * @param numThreads number of threads to assemble with (1 for sequential)
+ */
+void generate_object_file_parallel(const char* inputFile, const char* outputFile, int numThreads);
+
+/**
+ * @brief Assembles one input file into an output file, reporting errors instead of exiting
+ * 
+ * In incremental mode the per-line encodings cached by the previous run are reused.
+ * The cache lives in a sidecar file next to the output file (the output path
+ * followed by ".cache") and is rewritten after every successful assembly.
+ * Every mode produces the same output for the same (optimized) program.
  * 
  * @param inputFile path to the input file
  * @param outputFile path to the output file
+ * @param ihm pointer to the instruction hash map (only read, so it may be shared)
+ * @param options pointer to the assembler options
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_file(const char* inputFile, const char* outputFile, HashMap* ihm, const AssemblerOptions* options);
+
+/**
+ * @brief Assembles a tinker program held in memory into an in-memory object image
+ * 
+ * Nothing is read from or written to disk, and errors are reported instead of exiting.
+ * 
+ * @param text the source program
+ * @param size the size of the source program in bytes
+ * @param out pointer to the object buffer receiving the image
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_source(const char* text, uint64_t size, ObjectBuffer* out);
+
+/**
+ * @brief Assembles a tinker program held in memory into an in-memory relocatable object image
+ * 
+ * The image is the one hw7-asm -c writes, for hw7-ld to link.
+ * 
+ * @param text the source program
+ * @param size the size of the source program in bytes
+ * @param out pointer to the object buffer receiving the image
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_relocatable_source(const char* text, uint64_t size, ObjectBuffer* out);
+
+/**
+ * @brief Assembles a tinker program held in memory as hw7-asm would with the given options
+ * 
+ * Only the relocatable and debug options apply; the program is assembled sequentially.
+ * 
+ * @param text the source program
+ * @param size the size of the source program in bytes
+ * @param out pointer to the object buffer receiving the image
+ * @param options pointer to the assembler options
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_source_with_options(const char* text, uint64_t size, ObjectBuffer* out, const AssemblerOptions* options);
+
+/**
+ * @brief Assembles an in-memory source into a complete object image
+ * 
+ * @param source pointer to the source program, with expressions folded and virtual registers allocated
+ * @param out pointer to the object buffer receiving the image
+ * @param ihm pointer to the instruction hash map
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_program(Source* source, ObjectBuffer* out, HashMap* ihm);
+
+/**
+ * @brief Assembles an in-memory source, copying unchanged lines from a line cache
+ * 
+ * Lines whose text and referenced label addresses match a cached entry are
+ * copied instead of parsed, and every line is recorded into the cache.
+ * 
+ * @param source pointer to the source program, with expressions folded and virtual registers allocated
+ * @param out pointer to the object buffer receiving the image
+ * @param ihm pointer to the instruction hash map
+ * @param cache pointer to the line cache, or NULL to encode every line
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_program_cached(Source* source, ObjectBuffer* out, HashMap* ihm, LineCache* cache);
+
+/**
+ * @brief Checks and opens the input file
+ * 
+ * @param inputFile path to the input file
  * @param in pointer to the input file pointer
- * @param out pointer to the output file pointer
+ * @return 0 if successful, non-zero otherwise
+ */
+int check_input_file(const char* inputFile, FILE** in);
+
+/**
+ * @brief Writes a complete object image to the output file in a single write
+ * 
+ * @param outputFile path to the output file
+ * @param out pointer to the object buffer holding the image
+ * @return 0 if successful, non-zero otherwise
  */
-void check_files(const char* inputFile, const char* outputFile, FILE** in, FILE** out);
+int write_object_file(const char* outputFile, ObjectBuffer* out);
 
 /**
- * @brief Populates the label hash map from the input file
+ * @brief Populates the label hash map from the source
+ * 
+ * Layout passes are repeated until no line moves, since the size of an ld or
+ * brr of a label depends on where the label is placed.
  * 
- * @param in pointer to the input file
+ * @param source pointer to the source program
  * @param lhm pointer to the label hash map
  * @param tfh pointer to the tinker file header
+ * @param reserved pointer to the reserved data layout
+ * @param cache pointer to the line cache, or NULL
  * @return 0 if successful, non-zero otherwise
  */
-int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh);
+int populate_labels(Source* source, HashMap* lhm, TinkerFileHeader* tfh, const ReservedLayout* reserved, LineCache* cache);
 
 /**
- * @brief Resolves the program and writes the object file
+ * @brief Resolves the program into the object image, writing the header last
+ * 
+ * Reserved data only appears in the range table behind the header.
  * 
- * @param in pointer to the input file
- * @param out pointer to the output file
+ * @param source pointer to the source program
+ * @param out pointer to the object buffer
  * @param lhm pointer to the label hash map
  * @param ihm pointer to the instruction hash map
  * @param tfh pointer to the tinker file header
+ * @param reserved pointer to the reserved data layout
+ * @param cache pointer to the line cache, or NULL
  * @return 0 if successful, non-zero otherwise
  */
-int resolve_program(FILE* in, FILE* out, HashMap* lhm, HashMap* ihm, TinkerFileHeader* tfh);
+int resolve_program(Source* source, ObjectBuffer* out, HashMap* lhm, HashMap* ihm, TinkerFileHeader* tfh, const ReservedLayout* reserved, LineCache* cache);
 
 #endif
\ No newline at end of file
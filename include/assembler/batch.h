@@ -0,0 +1,69 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "hashmap.h"
+#include "assembler.h"
+
+/**
+ * @brief Structure representing one input/output pair in a batch.
+ */
+typedef struct BatchJob {
+	char* inputFile; /**< path to the input file, or NULL if the entry was malformed */
+	char* outputFile; /**< path to the output file, or NULL if the entry was malformed */
+	int status; /**< 0 if the file assembled successfully */
+} BatchJob;
+
+/**
+ * @brief Structure representing a batch of files assembled by a thread pool.
+ */
+typedef struct Batch {
+	BatchJob* jobs; /**< jobs in the order they were listed */
+	uint64_t count; /**< number of jobs */
+	uint64_t next; /**< index of the next job to hand out */
+	pthread_mutex_t lock; /**< protects next */
+	HashMap* ihm; /**< instruction hash map shared by every worker */
+	AssemblerOptions options; /**< options every file is assembled with */
+} Batch;
+
+/**
+ * @brief Reads a batch from a list with one "inputFile outputFile" pair per line.
+ * 
+ * Empty lines and lines starting with ';' are ignored. A malformed line is
+ * reported and kept as a job that has already failed.
+ * 
+ * @param list pointer to the list file
+ * @return Pointer to the newly created batch
+ */
+Batch* read_batch(FILE* list);
+
+/**
+ * @brief Assembles every job of the batch on a pool of threads.
+ * 
+ * Each failing file is reported on stderr and does not stop the rest of the batch.
+ * 
+ * @param batch pointer to the batch
+ * @param numThreads number of worker threads
+ * @return the number of files that failed to assemble
+ */
+uint64_t run_batch(Batch* batch, int numThreads);
+
+/**
+ * @brief Takes jobs from the batch until none are left (thread entry point).
+ * 
+ * @param ptr pointer to the batch
+ * @return NULL
+ */
+void* batch_worker(void* ptr);
+
+/**
+ * @brief Destroys the batch and frees memory.
+ * 
+ * @param batch pointer to the batch
+ */
+void destroy_batch(Batch* batch);
+
+#endif
\ No newline at end of file
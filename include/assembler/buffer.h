@@ -0,0 +1,65 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdint.h>
+
+/**
+ * @brief Structure representing a growable in-memory object image.
+ */
+typedef struct ObjectBuffer {
+	uint8_t* data; /**< bytes of the object image */
+	uint64_t size; /**< number of bytes written (highest offset written) */
+	uint64_t capacity; /**< number of bytes allocated */
+	uint64_t position; /**< offset at which the next sequential write happens */
+} ObjectBuffer;
+
+/**
+ * @brief Creates a new empty object buffer.
+ *
+ * @return Pointer to the newly created object buffer.
+ */
+ObjectBuffer* create_object_buffer();
+
+/**
+ * @brief Ensures the buffer can hold at least the given number of bytes.
+ *
+ * @param buffer pointer to the object buffer
+ * @param capacity the minimum capacity in bytes
+ */
+void buffer_reserve(ObjectBuffer* buffer, uint64_t capacity);
+
+/**
+ * @brief Writes bytes at the current position and advances the position.
+ *
+ * @param buffer pointer to the object buffer
+ * @param src pointer to the bytes to write
+ * @param size number of bytes to write
+ */
+void buffer_write(ObjectBuffer* buffer, const void* src, uint64_t size);
+
+/**
+ * @brief Writes bytes at a fixed offset without moving the position.
+ *
+ * @param buffer pointer to the object buffer
+ * @param offset offset into the buffer to write at
+ * @param src pointer to the bytes to write
+ * @param size number of bytes to write
+ */
+void buffer_write_at(ObjectBuffer* buffer, uint64_t offset, const void* src, uint64_t size);
+
+/**
+ * @brief Writes a single encoded instruction at the current position.
+ *
+ * @param buffer pointer to the object buffer
+ * @param instr the encoded instruction
+ */
+void buffer_write_instruction(ObjectBuffer* buffer, uint32_t instr);
+
+/**
+ * @brief Destroys the object buffer and frees memory.
+ *
+ * @param buffer pointer to the object buffer
+ */
+void destroy_object_buffer(ObjectBuffer* buffer);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,128 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hashmap.h"
+#include "buffer.h"
+
+/**
+ * @brief Structure representing the cached encoding of one tabbed line.
+ */
+typedef struct CacheEntry {
+	uint64_t hash; /**< hash of the line's text */
+	uint64_t dependency; /**< hash of the addresses of the labels the line references */
+	char section; /**< 'C' for an instruction line, 'D' for a data line */
+	uint32_t size; /**< number of encoded bytes */
+	uint64_t offset; /**< offset of the encoded bytes in the cache's byte pool */
+} CacheEntry;
+
+/**
+ * @brief Structure representing the per-line encoding cache kept next to an object file.
+ *
+ * Entries loaded from the sidecar file are looked up by line hash, while entries
+ * recorded during the current assembly become the next sidecar file.
+ */
+typedef struct LineCache {
+	CacheEntry* entries; /**< entries loaded from the sidecar file, sorted by hash */
+	uint64_t count; /**< number of loaded entries */
+	uint8_t* bytes; /**< encoded bytes of the loaded entries */
+
+	CacheEntry* recorded; /**< entries recorded during the current assembly */
+	uint64_t recordedCount; /**< number of recorded entries */
+	uint64_t recordedCapacity; /**< number of recorded entries allocated */
+	ObjectBuffer* recordedBytes; /**< encoded bytes of the recorded entries */
+
+	uint64_t hits; /**< number of lines copied from the cache */
+	uint64_t misses; /**< number of lines that had to be encoded */
+} LineCache;
+
+/**
+ * @brief Creates an empty line cache.
+ *
+ * @return Pointer to the newly created line cache.
+ */
+LineCache* create_line_cache();
+
+/**
+ * @brief Reads a line cache from a sidecar file.
+ *
+ * A missing, stale, or malformed sidecar file yields an empty cache, so the
+ * assembly simply falls back to encoding every line.
+ *
+ * @param path path to the sidecar file
+ * @return Pointer to the newly created line cache.
+ */
+LineCache* read_line_cache(const char* path);
+
+/**
+ * @brief Writes the entries recorded during the current assembly to a sidecar file.
+ *
+ * @param path path to the sidecar file
+ * @param cache pointer to the line cache
+ * @return 0 if successful, non-zero otherwise
+ */
+int write_line_cache(const char* path, LineCache* cache);
+
+/**
+ * @brief Hashes the text of a line.
+ *
+ * @param line the line
+ * @return The hash of the line.
+ */
+uint64_t hash_line(const char* line);
+
+/**
+ * @brief Hashes the addresses of every label a line references.
+ *
+ * Labels that are not defined hash differently from every address, so a line
+ * referencing a missing label never matches a cached encoding. Relative branches
+ * also hash their own address.
+ *
+ * @param lhm pointer to the label hash map
+ * @param address the address of the line
+ * @param line the line
+ * @return The hash of the referenced label addresses.
+ */
+uint64_t line_dependency(HashMap* lhm, uint64_t address, const char* line);
+
+/**
+ * @brief Finds a loaded entry whose text and label dependencies both match.
+ *
+ * @param cache pointer to the line cache
+ * @param hash hash of the line's text
+ * @param dependency hash of the line's referenced label addresses
+ * @return Pointer to the entry, or NULL if there is none.
+ */
+CacheEntry* line_cache_match(LineCache* cache, uint64_t hash, uint64_t dependency);
+
+/**
+ * @brief Returns the encoded bytes of a loaded entry.
+ *
+ * @param cache pointer to the line cache
+ * @param entry pointer to the entry
+ * @return Pointer to the entry's encoded bytes.
+ */
+const uint8_t* line_cache_bytes(LineCache* cache, CacheEntry* entry);
+
+/**
+ * @brief Records the encoding of a line for the next sidecar file.
+ *
+ * @param cache pointer to the line cache
+ * @param hash hash of the line's text
+ * @param dependency hash of the line's referenced label addresses
+ * @param section 'C' for an instruction line, 'D' for a data line
+ * @param bytes the encoded bytes
+ * @param size number of encoded bytes
+ */
+void line_cache_record(LineCache* cache, uint64_t hash, uint64_t dependency, char section, const uint8_t* bytes, uint32_t size);
+
+/**
+ * @brief Destroys the line cache and frees memory.
+ *
+ * @param cache pointer to the line cache
+ */
+void destroy_line_cache(LineCache* cache);
+
+#endif
\ No newline at end of file
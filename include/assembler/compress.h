@@ -0,0 +1,19 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include "buffer.h"
+
+/**
+ * @brief Compresses the data segment of an object image in place.
+ *
+ * The data segment is replaced by its compressed size and stream (see
+ * common/compress.h) and FILE_FLAG_COMPRESSED is set. Any tables after the
+ * data segment are kept. Images whose data would not get smaller, and images
+ * that are already compressed, are left unchanged.
+ *
+ * @param out pointer to the object buffer holding the whole image
+ * @return 0 if successful, -1 if the image is malformed
+ */
+int compress_object(ObjectBuffer* out);
+
+#endif
\ No newline at end of file
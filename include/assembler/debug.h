@@ -0,0 +1,22 @@
+#ifndef DEBUG_H
+#define DEBUG_H
+
+#include "buffer.h"
+#include "source.h"
+
+/**
+ * @brief Appends a debug table to an assembled object image.
+ *
+ * The table maps the address of every label to its name and the address of
+ * every instruction line to its line number in the source, so the simulator
+ * can name the code it reports on. Lines are counted in the source as
+ * assembled, which is the input file unless -O removed lines or virtual
+ * registers were spilled.
+ *
+ * @param source pointer to the source program the image was assembled from
+ * @param out pointer to the object buffer holding the image, which must end with its data segment
+ * @return 0 if successful, -1 otherwise
+ */
+int append_debug_table(Source* source, ObjectBuffer* out);
+
+#endif
\ No newline at end of file
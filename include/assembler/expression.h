@@ -0,0 +1,49 @@
+#ifndef EXPRESSION_H
+#define EXPRESSION_H
+
+#include <stdint.h>
+
+#include "hashmap.h"
+#include "source.h"
+
+/**
+ * @brief Structure representing the value of a constant expression.
+ */
+typedef struct Expression {
+	int64_t value; /**< the value, or the offset from the label if there is one */
+	char label[256]; /**< label the value is relative to, or empty if the value is constant */
+} Expression;
+
+/**
+ * @brief Evaluates a constant expression.
+ *
+ * Expressions combine decimal numbers, .equ symbols, and parentheses with
+ * +, -, *, and / in 64-bit signed arithmetic. A single :label may be added to
+ * or subtracted from a constant; since label names may contain operators, the
+ * operators around a label must be separated from it by spaces.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text the expression
+ * @param result set to the value of the expression
+ * @return 0 if successful, -1 if the expression is malformed or not constant
+ */
+int evaluate_expression(HashMap* symbols, const char* text, Expression* result);
+
+/**
+ * @brief Folds .equ symbols and constant expressions out of a source program.
+ *
+ * .equ NAME, EXPR lines define symbols usable anywhere in the program and are
+ * dropped. Operands that are not plain numbers, registers, or labels are
+ * evaluated: constant ones become decimal numbers, and ones relative to a label
+ * become :label+offset, which the encoder resolves once labels are placed.
+ * Data words and .space, .zero, and .align operands may be expressions too.
+ * Registers are left as written. Any other operand must evaluate: undefined
+ * symbols, division by zero, malformed expressions, and labels where only a
+ * constant fits are reported with their line number.
+ *
+ * @param source pointer to the source program
+ * @return Pointer to the newly created source, or NULL if a .equ or an operand is invalid.
+ */
+Source* expand_source(Source* source);
+
+#endif
\ No newline at end of file
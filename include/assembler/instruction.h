@@ -2,8 +2,14 @@
 #define INSTRUCTION_H
 
 #include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 #include "hashmap.h"
+#include "buffer.h"
+
+#define LD_MAX_SIZE 12
+#define BRR_LONG_SIZE 28
 
 /**
  * @brief Instruction formats enum.
@@ -16,6 +22,7 @@ typedef enum {
 	FORMAT_RRRL,
 	FORMAT_BRR,
 	FORMAT_MOV,
+	FORMAT_VECTOR,
 	FORMAT_NONE
 } InstrFormat;
 
@@ -53,104 +60,130 @@ void print_instruction(void* ptr);
 void destroy_instruction(void* ptr);
 
 /**
- * @brief Processes an instruction line.
+ * @brief Processes an instruction line into its encoded instructions.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param lhm the label hashmap
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
+ * @param address the address the line is placed at
  * @return 0 on success, non-zero on failure
  */
-int process_instruction(FILE* out, HashMap* lhm, HashMap* ihm, char* line);
+int process_instruction_line(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line, uint64_t address);
 
 /**
  * @brief Processes an RRR format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_RRR_instr(FILE* out, HashMap* ihm, char* line);
+int process_RRR_instr(ObjectBuffer* out, HashMap* ihm, char* line);
 
 /**
  * @brief Processes an RR format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_RR_instr(FILE* out, HashMap* ihm, char* line);
+int process_RR_instr(ObjectBuffer* out, HashMap* ihm, char* line);
 
 /**
  * @brief Processes an R format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_R_instr(FILE* out, HashMap* ihm, char* line);
+int process_R_instr(ObjectBuffer* out, HashMap* ihm, char* line);
 
 /**
  * @brief Processes an RL format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param lhm the label hashmap
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_RL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line);
+int process_RL_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line);
 
 /**
  * @brief Processes an RRRL format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param lhm the label hashmap
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_RRRL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line);
+int process_RRRL_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line);
 
 /**
  * @brief Processes a BRR format instruction.
  * 
- * @param out the output file
+ * A branch to a label becomes a single brrL when the label is within its 12-bit
+ * signed range, and otherwise a BRR_LONG_SIZE sequence that loads the target into
+ * the word below the stack pointer and returns to it, leaving every register intact.
+ * 
+ * @param out the output object buffer
  * @param lhm the label hashmap
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
+ * @param address the address the line is placed at
  * @return 0 on success, non-zero on failure
  */
-int process_BRR_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line);
+int process_BRR_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line, uint64_t address);
+
+/**
+ * @brief Checks whether a line is a brr to a label, whose encoding depends on its own address.
+ * 
+ * @param line the line to check
+ * @return true if the line branches relative to a label, false otherwise
+ */
+bool is_relative_branch(const char* line);
 
 /**
  * @brief Processes a MOV format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param lhm the label hashmap
  * @param ihm the instruction hashmap
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line);
+int process_MOV_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line);
+
+/**
+ * @brief Processes a vector instruction.
+ * 
+ * Vector registers are written x0 to x15, memory operands (rX), and the
+ * operation goes in the literal field of opcode 0x1f.
+ * 
+ * @param out the output object buffer
+ * @param line the instruction line to process
+ * @return 0 on success, non-zero on failure
+ */
+int process_VECTOR_instr(ObjectBuffer* out, char* line);
 
 /**
  * @brief Processes a NONE format instruction.
  * 
- * @param out the output file
+ * @param out the output object buffer
  * @param line the instruction line to process
  * @return 0 on success, non-zero on failure
  */
-int process_NONE_instr(FILE* out, char* line);
+int process_NONE_instr(ObjectBuffer* out, char* line);
 
 /**
  * @brief Processes a directive line.
  * 
  * @param line the directive line to process
- * @return the directive character
+ * @return 'C' for .code, 'D' for .data, 'R' for a valid .space, .zero, or .align, and 'N' otherwise
  */
 char process_directive(char* line);
 
@@ -166,13 +199,44 @@ char process_directive(char* line);
  */
 uint32_t encode_instruction(uint8_t opcode, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
 
+/**
+ * @brief Emits the shortest xor/addi/shftli sequence that loads a constant into a register.
+ * 
+ * When sizing by width, every 12-bit window below the highest one is kept, so the
+ * length depends only on the bit width of the value and never shrinks as it grows.
+ * 
+ * @param out pointer to the object buffer, or NULL to only count the instructions
+ * @param rd the destination register
+ * @param value the constant to load
+ * @param byWidth whether the length may depend only on the value's bit width
+ * @return the number of instructions in the sequence
+ */
+uint8_t materialize_constant(ObjectBuffer* out, uint8_t rd, uint64_t value, bool byWidth);
+
+/**
+ * @brief Emits the smallest encoding of ld: a short xor/addi/shftli sequence, or the
+ * wide immediate instruction (opcode 0x1e) followed by the value in two code words.
+ * 
+ * @param out pointer to the object buffer, or NULL to only measure the encoding
+ * @param rd the destination register
+ * @param value the constant to load
+ * @param byWidth whether the length may depend only on the value's bit width
+ * @return the size of the encoding in bytes
+ */
+uint8_t load_constant(ObjectBuffer* out, uint8_t rd, uint64_t value, bool byWidth);
+
 /**
  * @brief Change in the current address from a line of code.
  * 
+ * An ld or brr of a label is sized from the label's address in lhm, or at its
+ * longest if the label has not been placed yet.
+ * 
+ * @param lhm pointer to the label hash map from the previous layout pass, or NULL
+ * @param address the address of the line in the previous layout pass
  * @param line the line to process
  * @return the change in address
  */
-int8_t change_in_address(char* line);
+int8_t change_in_address(HashMap* lhm, uint64_t address, char* line);
 
 /**
  * @brief Creates a hashmap for instructions.
@@ -0,0 +1,98 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hashmap.h"
+#include "buffer.h"
+#include "source.h"
+#include "reserve.h"
+
+/**
+ * @brief Structure representing a label found while scanning a chunk.
+ */
+typedef struct ChunkLabel {
+	char* name; /**< name of the label */
+	char section; /**< 'I' for the inherited directive, 'C', 'D', or 'P' if still pending */
+	uint64_t offset; /**< offset of the label within its section of the chunk */
+} ChunkLabel;
+
+/**
+ * @brief Structure representing a line-aligned slice of the source assembled by one thread.
+ */
+typedef struct Chunk {
+	Source* source; /**< source program the chunk belongs to */
+	HashMap* lhm; /**< label hash map used when encoding */
+	HashMap* sizing; /**< labels from the previous layout pass used to size label operands, or NULL */
+	const uint64_t* previous; /**< line addresses from the previous layout pass, or NULL */
+	uint64_t* addresses; /**< line sizes, then line addresses, of the current layout pass */
+	HashMap* ihm; /**< instruction hash map used when encoding */
+	const ReservedLayout* reserved; /**< bytes reserved by each line */
+	uint64_t firstLine; /**< index of the first line in the chunk */
+	uint64_t endLine; /**< index one past the last line in the chunk */
+	int status; /**< 0 if the chunk was processed successfully */
+	const char* error; /**< error message from scanning, printed in chunk order */
+
+	char lastDirective; /**< last directive seen in the chunk, 'I' if none */
+	bool hasCodeDirective; /**< whether the chunk contains a .code directive */
+	bool labelSized; /**< whether any line's size depends on a label address */
+	uint64_t inheritedSize; /**< bytes emitted before the chunk's first directive */
+	uint64_t codeSize; /**< bytes of code emitted after the chunk's own directives */
+	uint64_t dataSize; /**< bytes of data emitted after the chunk's own directives */
+	bool hasInstruction; /**< whether the chunk contains any tabbed line, .space, or .zero */
+	char firstSection; /**< section of the chunk's first such line */
+	uint64_t firstOffset; /**< offset of the chunk's first such line within its section */
+	uint64_t tabLines; /**< number of tabbed lines in the chunk */
+	ChunkLabel* labels; /**< labels defined in the chunk, in source order */
+	uint64_t labelCount; /**< number of labels defined in the chunk */
+
+	char startDirective; /**< directive in effect at the start of the chunk */
+	uint64_t codeAddress; /**< address of the chunk's first code byte */
+	uint64_t dataAddress; /**< address of the chunk's first data byte */
+	uint64_t firstLineNumber; /**< tabbed line number used in error messages */
+	ObjectBuffer* out; /**< object image shared by every chunk */
+	uint64_t codeOffset; /**< offset in the image of the chunk's code */
+	uint64_t dataOffset; /**< offset in the image of the chunk's data */
+} Chunk;
+
+/**
+ * @brief Assembles a source into an object image using multiple threads.
+ * 
+ * Chunks are sized and their labels collected in parallel, chunk base addresses
+ * are resolved with a prefix sum, and chunks are then encoded in parallel into
+ * disjoint regions of the image. The result is byte-identical to assemble_program.
+ * 
+ * @param source pointer to the source program, with expressions folded and virtual registers allocated
+ * @param out pointer to the object buffer receiving the image
+ * @param ihm pointer to the instruction hash map
+ * @param numThreads number of threads to use
+ * @return 0 if successful, non-zero otherwise
+ */
+int assemble_program_parallel(Source* source, ObjectBuffer* out, HashMap* ihm, int numThreads);
+
+/**
+ * @brief Computes the sizes and local labels of a chunk (thread entry point).
+ * 
+ * @param ptr pointer to the chunk
+ * @return NULL
+ */
+void* scan_chunk(void* ptr);
+
+/**
+ * @brief Turns the line sizes recorded by scan_chunk into line addresses (thread entry point).
+ * 
+ * @param ptr pointer to the chunk
+ * @return NULL
+ */
+void* place_chunk(void* ptr);
+
+/**
+ * @brief Encodes a chunk into its region of the object image (thread entry point).
+ * 
+ * @param ptr pointer to the chunk
+ * @return NULL
+ */
+void* encode_chunk(void* ptr);
+
+#endif
\ No newline at end of file
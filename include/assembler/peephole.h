@@ -0,0 +1,24 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stdint.h>
+
+#include "source.h"
+
+/**
+ * @brief Runs the peephole pass over a source program.
+ *
+ * The pass works on instruction lines before layout, so every label and branch
+ * target is computed from the optimized program. Within runs of code that no
+ * label or branch splits, it removes mov rX, rX, folds adjacent addi/subi on the
+ * same register, drops an ld of a constant the register already holds, and turns
+ * a push directly followed by a pop into a single mov. Lines a brr with a
+ * literal offset may jump over or land on are left as written.
+ *
+ * @param source pointer to the source program
+ * @param removed set to the number of instructions removed
+ * @return Pointer to the newly created optimized source.
+ */
+Source* optimize_source(Source* source, uint64_t* removed);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdint.h>
+
+#include "source.h"
+
+#define SPILL_LABEL ":__spill"
+#define SPILL_SCRATCH 3
+
+/**
+ * @brief Allocates the virtual registers of a source program onto physical registers.
+ *
+ * Code may name virtual registers v0, v1, ... anywhere it names a register.
+ * Liveness is computed over the code's control flow, where a br, brnz, brgt, or
+ * call branches to every label its register is loaded with by ld and any other
+ * indirect branch may reach any instruction. Linear scan then assigns each
+ * virtual register one of r0 to r30 that the program never names itself.
+ * When they do not all fit, SPILL_SCRATCH free registers are kept back for
+ * spill code and the virtual registers that live longest are kept in a zeroed
+ * .data area at SPILL_LABEL, loaded before each use and stored after each write.
+ * brr with a literal offset is not adjusted for the spill code.
+ *
+ * @param source pointer to the source program
+ * @param spilled set to the number of virtual registers spilled to memory
+ * @return Pointer to the newly created source, or NULL if the registers cannot be allocated.
+ */
+Source* allocate_registers(Source* source, uint64_t* spilled);
+
+#endif
\ No newline at end of file
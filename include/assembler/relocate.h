@@ -0,0 +1,43 @@
+#ifndef RELOCATE_H
+#define RELOCATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "buffer.h"
+#include "hashmap.h"
+#include "source.h"
+
+#define RELOCATION_LABEL ":__reloc_"
+
+/**
+ * @brief Removes the .global directives from a source program.
+ *
+ * .global :label exports a label to the other objects of a link when the
+ * program is assembled with -c; otherwise it has no effect.
+ *
+ * @param source pointer to the source program
+ * @param globals pointer to the hash map receiving every exported label
+ * @return Pointer to the newly created source, or NULL if a .global is malformed.
+ */
+Source* extract_globals(Source* source, HashMap* globals);
+
+/**
+ * @brief Assembles a source program into a relocatable object image.
+ *
+ * Every ld of a label, and every brr to a label that takes the long form,
+ * holds the label's address in an 8-byte payload; each payload is listed as a
+ * relocation so the linker can rewrite it once the object is placed. Labels
+ * the program loads but does not define become undefined symbols that another
+ * object must export; brr cannot reach them.
+ *
+ * @param source pointer to the source program, with expressions folded and virtual registers allocated
+ * @param out pointer to the object buffer receiving the image
+ * @param ihm pointer to the instruction hash map
+ * @param globals pointer to the hash map of exported labels
+ * @param debug whether to place a debug table before the link table
+ * @return 0 if successful, -1 otherwise
+ */
+int assemble_relocatable(Source* source, ObjectBuffer* out, HashMap* ihm, HashMap* globals, bool debug);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef RESERVE_H
+#define RESERVE_H
+
+#include <stdint.h>
+
+#include "common/object.h"
+#include "buffer.h"
+#include "source.h"
+
+/**
+ * @brief Structure representing the reserved data of a source program.
+ *
+ * .space N and .zero N reserve N zero bytes of the data segment, and .align N
+ * reserves the padding up to the next multiple of N. Reserved bytes take no
+ * room in the object file; they are listed in a range table behind the header.
+ */
+typedef struct ReservedLayout {
+	uint64_t* sizes; /**< bytes reserved by each line, 0 for every other line */
+	ReservedRange* ranges; /**< merged reserved ranges, in address order */
+	uint64_t count; /**< number of reserved ranges */
+	uint64_t capacity; /**< capacity of the range array */
+	uint64_t total; /**< total number of reserved bytes */
+} ReservedLayout;
+
+/**
+ * @brief Computes the bytes a reservation directive reserves at an address.
+ *
+ * @param line the directive line
+ * @param address the data address the directive is placed at
+ * @param size set to the number of reserved bytes
+ * @return 0 if the line is a valid .space, .zero, or .align directive, -1 otherwise
+ */
+int reservation_size(const char* line, uint64_t address, uint64_t* size);
+
+/**
+ * @brief Lays out every reservation directive of a source program.
+ *
+ * Data addresses do not depend on the code, so a single pass places every
+ * reservation before labels are laid out.
+ *
+ * @param source pointer to the source program
+ * @param layout set to the newly created layout
+ * @return 0 if successful, non-zero otherwise
+ */
+int layout_reserved(Source* source, ReservedLayout** layout);
+
+/**
+ * @brief Gets the size of the range table written behind the file header.
+ *
+ * @param layout pointer to the layout
+ * @return the size of the table in bytes, 0 if nothing is reserved
+ */
+uint64_t reserved_table_size(const ReservedLayout* layout);
+
+/**
+ * @brief Gets the number of reserved bytes below an address.
+ *
+ * @param layout pointer to the layout
+ * @param address the address
+ * @return the number of reserved bytes below the address
+ */
+uint64_t reserved_below(const ReservedLayout* layout, uint64_t address);
+
+/**
+ * @brief Writes the range table behind the file header and flags the header.
+ *
+ * @param out pointer to the object buffer holding the image
+ * @param layout pointer to the layout
+ * @param tfh pointer to the tinker file header
+ */
+void write_reserved_table(ObjectBuffer* out, const ReservedLayout* layout, TinkerFileHeader* tfh);
+
+/**
+ * @brief Destroys the layout and frees memory.
+ *
+ * @param layout pointer to the layout
+ */
+void destroy_reserved_layout(ReservedLayout* layout);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/**
+ * @brief Structure representing a tinker source program held in memory.
+ */
+typedef struct Source {
+	char* text; /**< contents of the source program */
+	uint64_t size; /**< size of the contents in bytes */
+	uint64_t* lineStarts; /**< offset of the first character of each line */
+	uint64_t count; /**< number of lines */
+} Source;
+
+/**
+ * @brief Creates a source from a block of text, splitting it into lines.
+ * 
+ * @param text the source text (copied)
+ * @param size the size of the source text in bytes
+ * @return Pointer to the newly created source.
+ */
+Source* create_source(const char* text, uint64_t size);
+
+/**
+ * @brief Reads the whole input file into a source.
+ * 
+ * @param in pointer to the input file
+ * @return Pointer to the newly created source, or NULL if reading fails.
+ */
+Source* read_source(FILE* in);
+
+/**
+ * @brief Copies a line (including its newline) into a caller buffer, like fgets.
+ * 
+ * @param source pointer to the source
+ * @param index index of the line to copy
+ * @param line buffer receiving the null-terminated line
+ * @param size size of the buffer
+ */
+void source_get_line(Source* source, uint64_t index, char* line, uint64_t size);
+
+/**
+ * @brief Destroys the source and frees memory.
+ * 
+ * @param source pointer to the source
+ */
+void destroy_source(Source* source);
+
+#endif
\ No newline at end of file
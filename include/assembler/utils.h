@@ -1,9 +1,10 @@
-#ifndef UTILS_H
-#define UTILS_H
+#ifndef ASSEMBLER_UTILS_H
+#define ASSEMBLER_UTILS_H
 
 #include <stdbool.h>
 
 #include "hashmap.h"
+#include "common/utils.h"
 
 /**
  * @brief Checks if the line contains data.
@@ -29,12 +30,17 @@ bool is_empty(const char* line);
 void trim(char* str);
 
 /**
- * @brief Checks if the string is an unsigned 64-bit integer.
+ * @brief Splits an instruction line into its mnemonic and trimmed operands.
  * 
- * @param str the string to check
- * @return True if the string is an unsigned 64-bit integer, false otherwise
+ * Safe to call from several threads at once.
+ * 
+ * @param line the instruction line
+ * @param mnemonic buffer receiving the mnemonic
+ * @param operands buffers receiving the operands
+ * @param maxOperands number of operand buffers
+ * @return the number of operands, or -1 if the line has no mnemonic or too many operands
  */
-bool is_uint64(const char* str);
+int split_instruction(const char* line, char mnemonic[10], char operands[][256], int maxOperands);
 
 /**
  * @brief Checks if the register is valid.
@@ -44,6 +50,25 @@ bool is_uint64(const char* str);
  */
 bool is_valid_register(const char* reg);
 
+/**
+ * @brief Resolves a label operand, which may carry a constant offset as :label+N or :label-N.
+ * 
+ * @param lhm the label hashmap
+ * @param operand the label operand
+ * @param address set to the address of the label plus its offset
+ * @return True if the label is defined, false otherwise
+ */
+bool resolve_label(HashMap* lhm, const char* operand, uint64_t* address);
+
+/**
+ * @brief Gets the value of a literal that is_valid_literal accepted.
+ * 
+ * @param lhm the label hashmap
+ * @param L the literal
+ * @return the value of the literal
+ */
+uint64_t literal_value(HashMap* lhm, const char* L);
+
 /**
  * @brief Checks if the literal is valid.
  * 
@@ -0,0 +1,73 @@
+#ifndef COMMON_COMPRESS_H
+#define COMMON_COMPRESS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Structure representing a read position in the data segment of an object image.
+ *
+ * A compressed data segment is a stream of varints, one per 8-byte word. A
+ * non-zero varint is the zigzag-encoded difference from the previous word
+ * (which starts at 0). A zero varint is followed by a count of words that
+ * repeat the previous word, so zero-filled tables take a few bytes.
+ */
+typedef struct DataDecoder {
+	const uint8_t* stream; /**< stored bytes of the data segment */
+	uint64_t size; /**< number of stored bytes */
+	uint64_t position; /**< offset of the next stored byte to read */
+	uint64_t previous; /**< last word decoded */
+	uint64_t repeat; /**< number of words still to repeat the previous word */
+	bool compressed; /**< whether the stored bytes are compressed */
+} DataDecoder;
+
+/**
+ * @brief Returns the most bytes encode_data can write for a data segment.
+ *
+ * @param size size of the data segment in bytes
+ * @return the number of bytes the output of encode_data must hold
+ */
+uint64_t encoded_data_bound(uint64_t size);
+
+/**
+ * @brief Compresses a data segment.
+ *
+ * @param data the data segment, whose size is a multiple of 8
+ * @param size size of the data segment in bytes
+ * @param out receives the compressed stream; must hold encoded_data_bound(size) bytes
+ * @return the number of bytes written
+ */
+uint64_t encode_data(const uint8_t* data, uint64_t size, uint8_t* out);
+
+/**
+ * @brief Starts reading the data segment of an object image from its first byte.
+ *
+ * @param decoder pointer to the decoder to start
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @return 0 if successful, -1 if the image is malformed
+ */
+int open_data_segment(DataDecoder* decoder, const uint8_t* image, uint64_t size);
+
+/**
+ * @brief Reads the next bytes of a data segment.
+ *
+ * Compressed segments are decoded a word at a time, so the size must be a
+ * multiple of 8 for them.
+ *
+ * @param decoder pointer to the decoder
+ * @param out receives the bytes
+ * @param size number of bytes to read
+ * @return 0 if successful, -1 if the stored bytes run out or are malformed
+ */
+int decode_data(DataDecoder* decoder, uint8_t* out, uint64_t size);
+
+/**
+ * @brief Checks that a data segment was read exactly to its end.
+ *
+ * @param decoder pointer to the decoder
+ * @return true if no stored bytes or repeated words are left, false otherwise
+ */
+bool data_segment_finished(const DataDecoder* decoder);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef COMMON_DEBUG_H
+#define COMMON_DEBUG_H
+
+#include <stdint.h>
+
+#include "common/object.h"
+
+/**
+ * @brief Structure representing the debug table of a loaded object.
+ */
+typedef struct DebugInfo {
+	DebugSymbol* symbols; /**< labels, in address order */
+	uint64_t symbolCount; /**< number of labels */
+	DebugLine* lines; /**< source lines of the code, in address order */
+	uint64_t lineCount; /**< number of source lines */
+	char* strings; /**< the string table of label names */
+} DebugInfo;
+
+/**
+ * @brief Reads the debug table of an object image.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @return Pointer to the newly created debug info, or NULL if the image has no valid debug table.
+ */
+DebugInfo* read_debug_info(const uint8_t* image, uint64_t size);
+
+/**
+ * @brief Describes an address by the nearest label at or before it and the source line it was assembled from.
+ * 
+ * @param debug pointer to the debug info
+ * @param address the address to describe
+ * @param description buffer receiving the description, such as ":loop+8 (line 12)"
+ * @param size size of the buffer in bytes
+ * @return 0 if the address was described, -1 if no label or line precedes it
+ */
+int describe_address(const DebugInfo* debug, uint64_t address, char* description, uint64_t size);
+
+/**
+ * @brief Frees the debug info.
+ * 
+ * @param debug pointer to the debug info, or NULL
+ */
+void destroy_debug_info(DebugInfo* debug);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef COMMON_FILE_H
+#define COMMON_FILE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Structure representing the read-only contents of a file.
+ */
+typedef struct MappedFile {
+	const uint8_t* data; /**< contents of the file */
+	uint64_t size; /**< size of the file in bytes */
+	bool mapped; /**< whether the contents are mapped rather than read */
+} MappedFile;
+
+/**
+ * @brief Maps a whole file into memory for reading.
+ * 
+ * Regular files are mapped privately, so their pages are read on demand by
+ * the kernel instead of being copied into a buffer first. Files that cannot be
+ * mapped, such as pipes, are read into a buffer instead.
+ * 
+ * @param path path to the file
+ * @return Pointer to the newly created mapped file, or NULL if the file cannot be opened or read.
+ */
+MappedFile* map_file(const char* path);
+
+/**
+ * @brief Unmaps a file and frees it.
+ * 
+ * @param file pointer to the mapped file, or NULL
+ */
+void unmap_file(MappedFile* file);
+
+#endif
\ No newline at end of file
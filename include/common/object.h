@@ -0,0 +1,145 @@
+#ifndef OBJECT_H
+#define OBJECT_H
+
+#include <stdint.h>
+
+#define FILE_TYPE 0
+#define FILE_FLAG_RESERVED 0x1
+#define FILE_FLAG_RELOCATABLE 0x2
+#define FILE_FLAG_DEBUG 0x4
+#define FILE_FLAG_COMPRESSED 0x8
+#define FILE_FLAGS (FILE_FLAG_RESERVED | FILE_FLAG_RELOCATABLE | FILE_FLAG_DEBUG | FILE_FLAG_COMPRESSED)
+#define INIT_CODE_ADDR 0x2000
+#define INIT_DATA_ADDR 0x10000
+#define SECTION_UNDEFINED 0
+#define SECTION_CODE 1
+#define SECTION_DATA 2
+
+/// @brief A struct representing the file header for a tinker program
+typedef struct TinkerFileHeader {
+	uint64_t fileType; // Currently, 0
+	uint64_t codeBegin; // Address into which the code is to be loaded in memory
+	uint64_t codeSize; // Size of the code segment
+	uint64_t dataBegin; // Address into which the data is to be loaded in memory
+	uint64_t dataSize; // Size of the data segment (could be 0)
+} TinkerFileHeader;
+
+/// @brief A struct representing a zero-initialized range of the data segment that takes no file bytes
+typedef struct ReservedRange {
+	uint64_t address; // Address of the first reserved byte
+	uint64_t size; // Number of reserved bytes
+} ReservedRange;
+
+/// @brief A struct representing the debug table that follows the data segment of an object assembled with -g
+typedef struct DebugTable {
+	uint64_t symbolCount; // Number of debug symbols, which follow the table
+	uint64_t lineCount; // Number of debug lines, which follow the symbols
+	uint64_t stringSize; // Size of the string table of label names, which follows the lines
+} DebugTable;
+
+/// @brief A struct representing a label and the address it names
+typedef struct DebugSymbol {
+	uint64_t address; // Address of the label
+	uint64_t name; // Offset of the label's name in the string table
+} DebugSymbol;
+
+/// @brief A struct representing the source line an instruction was assembled from
+typedef struct DebugLine {
+	uint64_t address; // Address of the first instruction of the line
+	uint64_t line; // Line number in the assembled source, starting at 1
+} DebugLine;
+
+/// @brief A struct representing the link table that follows the data segment of a relocatable object
+typedef struct LinkTable {
+	uint64_t symbolCount; // Number of symbols, which follow the table
+	uint64_t relocationCount; // Number of relocations, which follow the symbols
+	uint64_t stringSize; // Size of the string table of symbol names, which follows the relocations
+} LinkTable;
+
+/// @brief A struct representing a symbol of a relocatable object
+typedef struct ObjectSymbol {
+	uint64_t name; // Offset of the symbol's name in the string table
+	uint64_t section; // SECTION_CODE or SECTION_DATA if defined by this object, SECTION_UNDEFINED otherwise
+	uint64_t value; // Address of the symbol as assembled, if defined by this object
+	uint64_t global; // 1 if other objects may refer to the symbol, 0 otherwise
+} ObjectSymbol;
+
+/// @brief A struct representing an 8-byte address in the code segment that the linker rewrites
+typedef struct Relocation {
+	uint64_t offset; // Offset of the address in the code segment
+	uint64_t symbol; // Index of the symbol the address refers to
+	int64_t addend; // Constant added to the symbol's address
+} Relocation;
+
+/**
+ * @brief Creates a pointer to a new tinker file header
+ * 
+ * @return The pointer to the new tinker file header
+ */
+TinkerFileHeader* create_tinker_file_header();
+
+/**
+ * @brief Finds where the code segment starts in an object file image.
+ * 
+ * When the FILE_FLAG_RESERVED bit of the file type is set, the header is followed
+ * by a count of reserved ranges and then the ranges themselves, in address order.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @param reservedCount set to the number of reserved ranges
+ * @return the offset of the code segment, or 0 if the header or range table is malformed
+ */
+uint64_t object_code_offset(const uint8_t* image, uint64_t size, uint64_t* reservedCount);
+
+/**
+ * @brief Reads one reserved range from an object file image.
+ * 
+ * @param image the object file image, starting with its header
+ * @param index index of the range
+ * @return the reserved range
+ */
+ReservedRange object_reserved_range(const uint8_t* image, uint64_t index);
+
+/**
+ * @brief Finds where the stored bytes of the data segment start in an object image.
+ * 
+ * When the FILE_FLAG_COMPRESSED bit of the file type is set, the code segment is
+ * followed by the number of bytes the compressed data segment takes and then the
+ * compressed bytes; the header's dataSize stays the size once decompressed.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @param storedSize set to the number of bytes the data segment takes in the image
+ * @return the offset of the data segment, or 0 if the image is malformed
+ */
+uint64_t object_data_offset(const uint8_t* image, uint64_t size, uint64_t* storedSize);
+
+/**
+ * @brief Finds the debug table of an object image.
+ * 
+ * When the FILE_FLAG_DEBUG bit of the file type is set, the data segment is
+ * followed by a DebugTable, its symbols and lines in address order, and its
+ * string table.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @param table set to the debug table
+ * @return the offset of the first debug symbol, or 0 if the image has no debug table or is malformed
+ */
+uint64_t object_debug_offset(const uint8_t* image, uint64_t size, DebugTable* table);
+
+/**
+ * @brief Finds the link table of a relocatable object image.
+ * 
+ * When the FILE_FLAG_RELOCATABLE bit of the file type is set, the data segment
+ * and any debug table are followed by a LinkTable, its symbols, its relocations,
+ * and its string table.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @param table set to the link table
+ * @return the offset of the first symbol, or 0 if the image is not relocatable or is malformed
+ */
+uint64_t object_link_offset(const uint8_t* image, uint64_t size, LinkTable* table);
+
+#endif
\ No newline at end of file
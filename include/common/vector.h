@@ -0,0 +1,22 @@
+#ifndef COMMON_VECTOR_H
+#define COMMON_VECTOR_H
+
+#define VECTOR_OPCODE 0x1f
+#define VECTOR_LANES 4
+#define NUM_VREGS 16
+
+/// @brief Operations of the vector instruction, held in its literal field
+typedef enum {
+	VECTOR_LOAD,      // vld xD, (rS): load the 4 words at rS
+	VECTOR_STORE,     // vst (rD), xS: store the 4 words of xS at rD
+	VECTOR_ADD,       // vadd xD, xS, xT: lane-wise integer add
+	VECTOR_MUL,       // vmul xD, xS, xT: lane-wise integer multiply, low 64 bits
+	VECTOR_ADDF,      // vaddf xD, xS, xT: lane-wise double add
+	VECTOR_MULF,      // vmulf xD, xS, xT: lane-wise double multiply
+	VECTOR_SUM,       // vsum rD, xS: integer sum of the lanes
+	VECTOR_SUMF,      // vsumf rD, xS: double sum of the lanes, added pairwise as (x0 + x1) + (x2 + x3)
+	VECTOR_BROADCAST, // vbcast xD, rS: copy rS into every lane
+	NUM_VECTOR_OPS
+} VectorOp;
+
+#endif
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <stdint.h>
+
+#include "assembler/buffer.h"
+
+/**
+ * @brief Links relocatable object images into one executable object image.
+ *
+ * The code segments are placed one after another from INIT_CODE_ADDR in the
+ * order given, so the first object's code runs first. The data segments follow
+ * from INIT_DATA_ADDR, each starting on an 8-byte boundary; reserved ranges
+ * move with their data and the padding between segments is reserved too.
+ * Every relocation is then rewritten with the placed address of its symbol,
+ * taken from the object itself or from the one object that exports it.
+ *
+ * @param images the relocatable object images, made by hw7-asm -c
+ * @param sizes size of each image in bytes
+ * @param names name of each image, for error messages
+ * @param count number of images
+ * @param out pointer to the object buffer receiving the linked image
+ * @return 0 if successful, -1 if an image is malformed or a symbol is undefined or defined twice
+ */
+int link_images(const uint8_t* const* images, const uint64_t* sizes, const char* const* names, uint64_t count, ObjectBuffer* out);
+
+/**
+ * @brief Links relocatable object files into one executable object file.
+ *
+ * @param inputFiles paths to the relocatable object files
+ * @param count number of object files
+ * @param outputFile path to the output object file
+ * @return 0 if successful, -1 otherwise
+ */
+int link_object_files(const char* const* inputFiles, uint64_t count, const char* outputFile);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,182 @@
+#ifndef CFG_H
+#define CFG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "common/object.h"
+
+#define VALUE_UNDEF 0
+#define VALUE_CONST 1
+#define VALUE_VARIES 2
+
+#define UNIT_DERIVED -1
+#define UNIT_MIXED -2
+
+/**
+ * @brief Structure representing what constant propagation knows about a register.
+ */
+typedef struct RegValue {
+	uint8_t kind; /**< VALUE_UNDEF, VALUE_CONST, or VALUE_VARIES */
+	uint64_t value; /**< the register's value, if constant */
+	int64_t unit; /**< index of the constant op the value was loaded by, UNIT_DERIVED, or UNIT_MIXED */
+} RegValue;
+
+/**
+ * @brief Structure representing one op of the lifted code segment.
+ *
+ * An op is a single instruction, except that an ldw with its payload, or an
+ * xor rd, rd, rd followed by addi/shftli on rd, is one constant op, and the
+ * sequence hw7-asm emits for a brr out of brrL's range is one jump op:
+ *
+ *     mov (r31)(-16), r0
+ *     ldw r0, target
+ *     mov (r31)(-8), r0
+ *     mov r0, (r31)(-16)
+ *     return
+ */
+typedef struct Op {
+	uint64_t address; /**< address of the op in the original code */
+	uint64_t offset; /**< offset of the op's bytes in the code segment */
+	uint32_t size; /**< size of the op in bytes */
+	uint32_t instructions; /**< number of instructions in the op, not counting an ldw payload */
+	uint32_t word; /**< encoding of the op's first instruction */
+	uint8_t opcode; /**< opcode of the op's first instruction */
+	uint8_t rd; /**< destination register */
+	uint8_t rs; /**< source register */
+	uint8_t rt; /**< target register */
+	uint16_t imm; /**< raw 12-bit literal */
+	bool constant; /**< whether the op loads value into rd */
+	uint64_t value; /**< the constant loaded by a constant op */
+	bool leader; /**< whether the op starts a block */
+
+	bool takes; /**< whether the op can branch to target */
+	bool falls; /**< whether execution can continue with the next op */
+	uint64_t target; /**< address the op branches to, if it takes */
+	bool jump; /**< whether the op is a long brr sequence, which always branches to target */
+
+	bool removed; /**< whether the op is dropped from the output */
+	bool replaced; /**< whether the op is rewritten as replacement */
+	uint32_t replacement; /**< the instruction written instead of the op */
+	bool relocate; /**< whether the constant is a code address to rewrite */
+	uint64_t newAddress; /**< address of the op in the rewritten code */
+} Op;
+
+/**
+ * @brief Structure representing a lifted object file and its control-flow graph.
+ */
+typedef struct Program {
+	TinkerFileHeader header; /**< header of the object file */
+	const uint8_t* table; /**< reserved range table between the header and the code */
+	uint64_t tableSize; /**< size of the range table in bytes */
+	const uint8_t* code; /**< the code segment */
+	uint8_t* data; /**< the data segment, decoded into its own buffer */
+
+	Op* ops; /**< ops of the code segment, in address order */
+	uint64_t count; /**< number of ops */
+
+	uint64_t* blocks; /**< index of the first op of each block */
+	uint64_t blockCount; /**< number of blocks */
+	uint64_t* blockOf; /**< index of the block holding each op */
+	bool* reached; /**< whether each block is reachable */
+	RegValue (*in)[32]; /**< register values on entry to each block */
+} Program;
+
+/**
+ * @brief Decodes the code segment of an object file image into ops.
+ *
+ * The image is not copied, so it must outlive the program.
+ *
+ * @param image the object file image
+ * @param size size of the image in bytes
+ * @return Pointer to the newly created program, or NULL if the image is malformed.
+ */
+Program* decode_program(const uint8_t* image, uint64_t size);
+
+/**
+ * @brief Builds the control-flow graph and propagates constants through it.
+ *
+ * Every br, brnz, brgt, and call that can run must branch through a register
+ * holding a constant code address, which becomes a block leader; the analysis
+ * repeats until no new leader is found. Branches whose condition is constant
+ * only keep the edge they take.
+ *
+ * @param program pointer to the program
+ * @return 0 if every indirect target was proven, -1 otherwise
+ */
+int analyze_program(Program* program);
+
+/**
+ * @brief Applies an op's effect to the known register values.
+ *
+ * @param program pointer to the program
+ * @param index index of the op
+ * @param regs the register values, updated in place
+ */
+void apply_op(Program* program, uint64_t index, RegValue regs[32]);
+
+/**
+ * @brief Finds the op starting at an address.
+ *
+ * @param program pointer to the program
+ * @param address the address
+ * @return the index of the op, or -1 if no op starts there
+ */
+int64_t find_op(Program* program, uint64_t address);
+
+/**
+ * @brief Checks whether a privileged operation leaves every register unchanged.
+ *
+ * Halt, the mode switches, output, the memory copy and fill host calls, and
+ * free write no register. Input, memory compare, allocation, and the hart
+ * and atomic calls write rd; anything else may write any register.
+ *
+ * @param imm the priv literal
+ * @return true if the operation writes no register, false otherwise
+ */
+bool priv_keeps_registers(uint64_t imm);
+
+/**
+ * @brief Checks whether a privileged operation writes rd and no other register.
+ *
+ * @param imm the priv literal
+ * @return true for input, memory compare, allocation, and the hart and atomic calls, false otherwise
+ */
+bool priv_writes_destination(uint64_t imm);
+
+/**
+ * @brief Returns the register holding the target of a branch, call, or spawn.
+ *
+ * A spawn (priv 11) starts its hart at the address in rs; every other op
+ * that takes a register target holds it in rd.
+ *
+ * @param op pointer to the op
+ * @return the register number
+ */
+uint8_t branch_register(const Op* op);
+
+/**
+ * @brief Checks whether a vector operation writes a general purpose register.
+ *
+ * @param imm the vector literal
+ * @return true for the sums, which write rd, false otherwise
+ */
+bool vector_writes_register(uint64_t imm);
+
+/**
+ * @brief Checks whether a value lies in the code segment, end included.
+ *
+ * @param program pointer to the program
+ * @param value the value
+ * @return true if the value could be a code address, false otherwise
+ */
+bool is_code_address(Program* program, uint64_t value);
+
+/**
+ * @brief Destroys the program and frees memory.
+ *
+ * @param program pointer to the program
+ */
+void destroy_program(Program* program);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdint.h>
+
+#include "assembler/buffer.h"
+
+/**
+ * @brief Structure representing the instruction counts before and after optimization.
+ */
+typedef struct OptimizerStats {
+	uint64_t before; /**< instructions in the original code segment */
+	uint64_t after; /**< instructions in the rewritten code segment */
+} OptimizerStats;
+
+/**
+ * @brief Optimizes the code segment of an object file image.
+ *
+ * The code is lifted into a control-flow graph, then unreachable code, branches
+ * with constant conditions, reloads of constants and memory a register already
+ * holds, and instructions whose results are never used are removed. brrL
+ * offsets and the code addresses loaded for br, brnz, brgt, and call are
+ * recomputed for the new layout. Code with a branch target or code address the
+ * analysis cannot prove is refused.
+ *
+ * @param image the object file image
+ * @param size size of the image in bytes
+ * @param out pointer to the object buffer receiving the optimized image
+ * @param stats set to the instruction counts
+ * @return 0 if successful, -1 if the image is malformed or refused
+ */
+int optimize_image(const uint8_t* image, uint64_t size, ObjectBuffer* out, OptimizerStats* stats);
+
+/**
+ * @brief Optimizes an object file into another object file.
+ *
+ * @param inputFile path to the input object file
+ * @param outputFile path to the output object file
+ * @param stats set to the instruction counts
+ * @return 0 if successful, -1 otherwise
+ */
+int optimize_object_file(const char* inputFile, const char* outputFile, OptimizerStats* stats);
+
+#endif
\ No newline at end of file
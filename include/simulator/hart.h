@@ -0,0 +1,78 @@
+#ifndef SIMULATOR_HART_H
+#define SIMULATOR_HART_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "simulator/simulator.h"
+
+#define MAX_HARTS 64
+
+/**
+ * @brief Structure representing the harts a program has spawned, each on its own host thread.
+ *
+ * Hart ids run from 1 to MAX_HARTS - 1; the main hart has none. A slot is
+ * taken from spawn until the hart is joined, after which its id is reused.
+ */
+struct HartGroup {
+	pthread_mutex_t lock; /**< protects the slots and the heap of the main hart */
+	Processor* harts[MAX_HARTS]; /**< hart in each slot, or NULL if the slot is free */
+	pthread_t threads[MAX_HARTS]; /**< thread running each hart */
+	bool joining[MAX_HARTS]; /**< whether a hart is already waiting for the one in each slot */
+};
+
+/**
+ * @brief Starts a new hart on its own host thread.
+ *
+ * The new hart shares the memory and devices of the spawner and starts with
+ * a copy of its registers, except that r31 holds the given stack pointer and
+ * rd holds 0.
+ *
+ * @param processor pointer to the spawning hart
+ * @param rd register that receives the id in the spawner
+ * @param pc address of the first instruction of the new hart
+ * @param stack stack pointer of the new hart
+ * @return id of the new hart, or 0 if every slot is taken or no thread can be started
+ */
+uint64_t spawn_hart(Processor* processor, uint8_t rd, uint64_t pc, uint64_t stack);
+
+/**
+ * @brief Waits for a spawned hart to stop and frees its slot.
+ *
+ * @param processor pointer to the waiting hart
+ * @param id id of the hart to wait for
+ * @param result set to 0 if the hart halted, 1 if it stopped on an error
+ * @return 0 if successful, -1 if the id names no hart, the caller, or a hart another hart is waiting for
+ */
+int join_hart(Processor* processor, uint64_t id, uint64_t* result);
+
+/**
+ * @brief Waits for every hart that has not been joined, including harts they spawn meanwhile.
+ *
+ * @param harts pointer to the group, or NULL
+ * @return 0 if each of them halted, -1 if any stopped on an error
+ */
+int finish_harts(HartGroup* harts);
+
+/**
+ * @brief Locks the heap shared by every hart, if any hart has been spawned.
+ *
+ * @param harts pointer to the group, or NULL
+ */
+void lock_harts(HartGroup* harts);
+
+/**
+ * @brief Unlocks the heap locked by lock_harts.
+ *
+ * @param harts pointer to the group, or NULL
+ */
+void unlock_harts(HartGroup* harts);
+
+/**
+ * @brief Waits for every remaining hart and frees the group.
+ *
+ * @param harts pointer to the group, or NULL
+ */
+void destroy_harts(HartGroup* harts);
+
+#endif
\ No newline at end of file
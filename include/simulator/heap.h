@@ -0,0 +1,61 @@
+#ifndef SIMULATOR_HEAP_H
+#define SIMULATOR_HEAP_H
+
+#include <stdint.h>
+
+#define HEAP_ALIGNMENT 16
+#define HEAP_CLASSES 32
+#define STACK_RESERVE (64 * 1024)
+
+/**
+ * @brief Structure representing the guest heap behind the allocation host calls.
+ *
+ * Blocks are powers of two from HEAP_ALIGNMENT bytes up, one free list per
+ * size class. Fresh blocks are cut from the top of the heap; when the top is
+ * used up, a free block of a larger class is split. Every piece of metadata
+ * lives on the host, so guest stores cannot corrupt the allocator.
+ */
+typedef struct Heap {
+	uint64_t begin; /**< first address of the heap */
+	uint64_t end; /**< first address past the heap */
+	uint64_t top; /**< first address never handed out */
+	uint8_t* classes; /**< size class plus one of the allocated block starting at each slot, 0 if none */
+	uint32_t* links; /**< slot plus one of the next free block of the same class */
+	uint32_t freeLists[HEAP_CLASSES]; /**< slot plus one of the first free block of each class, 0 if none */
+} Heap;
+
+/**
+ * @brief Creates an empty heap over a range of guest memory.
+ *
+ * @param begin first address of the heap, a multiple of HEAP_ALIGNMENT
+ * @param end first address past the heap
+ * @return Pointer to the newly created heap
+ */
+Heap* create_heap(uint64_t begin, uint64_t end);
+
+/**
+ * @brief Allocates a block of guest memory.
+ *
+ * @param heap pointer to the heap
+ * @param size number of bytes needed
+ * @return the address of the block, aligned to HEAP_ALIGNMENT, or 0 if the heap cannot hold it
+ */
+uint64_t heap_allocate(Heap* heap, uint64_t size);
+
+/**
+ * @brief Frees a block of guest memory.
+ *
+ * @param heap pointer to the heap
+ * @param address address of the block
+ * @return 0 if successful, -1 if no allocated block starts at the address
+ */
+int heap_free(Heap* heap, uint64_t address);
+
+/**
+ * @brief Destroys a heap and frees its metadata.
+ *
+ * @param heap pointer to the heap, or NULL
+ */
+void destroy_heap(Heap* heap);
+
+#endif
\ No newline at end of file
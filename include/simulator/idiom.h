@@ -0,0 +1,127 @@
+#ifndef SIMULATOR_IDIOM_H
+#define SIMULATOR_IDIOM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DOT_LOOP_WORDS 8
+#define DOT_LOOP_MAX_WORDS 32
+
+/**
+ * @brief Structure representing a dot-product loop found in the loaded code.
+ *
+ * A pointer loop is eight instructions long and branches back to its first:
+ *
+ *     mov rA, (rP)(offsetA)
+ *     mov rB, (rQ)(offsetB)
+ *     mul rM, rA, rB         (or mulf)
+ *     add rS, rS, rM         (or addf)
+ *     three updates in any order: rP and rQ step by a literal (addi)
+ *     or by a register the loop leaves alone (add), and rK by addi
+ *     brgt rL, rN, rK
+ *
+ * An indexed loop tests its condition at the top and computes both
+ * addresses from rK on every trip, as matrix_multiplication.tk does:
+ *
+ *     brgt rL, rN, rK        (rL holds the address of the first index instruction)
+ *     any one instruction, which runs once the test fails
+ *     index arithmetic: clr, add, sub, mul, addi, subi, shftli, or mov
+ *     between registers, leaving rP and rQ affine in rK
+ *     mov rA, (rP)(offsetA)
+ *     mov rB, (rQ)(offsetB)
+ *     mul rM, rA, rB         (or mulf)
+ *     add rS, rS, rM         (or addf)
+ *     addi rK, step
+ *     br rH                  (rH holds the address of the brgt)
+ *
+ * The index arithmetic writes each of its registers before reading it.
+ * In both forms rA, rB, rM, rS, rK, and the registers the loop steps or
+ * computes are distinct, and the loop writes no other register.
+ */
+typedef struct DotLoop {
+	uint64_t head; /**< address of the first instruction */
+	uint32_t words[DOT_LOOP_MAX_WORDS]; /**< the instructions, checked again before every native run */
+	uint8_t length; /**< number of instructions */
+	bool indexed; /**< whether the loop tests at the top and computes its addresses from rK */
+	bool floating; /**< whether the loop uses mulf and addf */
+	uint8_t a, b, product, sum; /**< the loaded values, their product, and the accumulator */
+	uint8_t pointers[2]; /**< rP and rQ */
+	int16_t offsets[2]; /**< load offsets from rP and rQ */
+	int16_t strideRegisters[2]; /**< register each pointer steps by, or -1 for a literal step */
+	uint64_t strides[2]; /**< literal step of each pointer */
+	uint8_t counter, limit, target; /**< rK, rN, and rL */
+	uint8_t back; /**< rH of an indexed loop */
+	uint32_t indices; /**< mask of the registers the index arithmetic writes */
+	uint64_t step; /**< literal step of the counter */
+} DotLoop;
+
+/**
+ * @brief Structure representing a multiply whose product is only added to an accumulator.
+ *
+ *     mul rX, rA, rB         (or mulf)
+ *     add rY, rY, rX         (or addf)
+ *
+ * rX and rY are distinct, and rX is written again before any instruction
+ * reads it or control leaves the straight-line code after the pair.
+ */
+typedef struct FusedPair {
+	uint64_t head; /**< address of the multiply */
+	uint32_t words[2]; /**< the instructions, checked again before every fused run */
+	bool floating; /**< whether the pair is mulf and addf */
+	uint8_t product, a, b, sum; /**< rX, rA, rB, and rY */
+} FusedPair;
+
+/**
+ * @brief Structure representing the instruction sequences of the loaded code that run natively.
+ */
+typedef struct IdiomTable {
+	uint64_t codeBegin; /**< first address of the code segment */
+	uint64_t codeWords; /**< number of instruction words in the code segment */
+	int16_t* heads; /**< at each code word, index plus one of the loop starting there, minus index plus one of the pair, or 0 */
+	DotLoop* loops; /**< the loops */
+	uint64_t count; /**< number of loops */
+	FusedPair* pairs; /**< the fused multiply-add pairs */
+	uint64_t pairCount; /**< number of pairs */
+} IdiomTable;
+
+/**
+ * @brief Finds every dot-product loop and fused multiply-add pair in a loaded code segment.
+ *
+ * @param memory memory of the processor
+ * @param codeBegin first address of the code segment
+ * @param codeSize size of the code segment in bytes
+ * @return Pointer to the table, or NULL if the code holds neither
+ */
+IdiomTable* find_idioms(const uint8_t* memory, uint64_t codeBegin, uint64_t codeSize);
+
+/**
+ * @brief Runs the loop or pair starting at the program counter natively, if there is one.
+ *
+ * The loop only runs natively when its instructions are unchanged, it will
+ * branch back to itself, its trip count is known, and every load lies in
+ * memory. It then leaves every register as interpreting it would, with the
+ * program counter on its final brgt. An indexed loop only runs when its body
+ * runs at least once, and ends on the brgt at its head once the test fails.
+ *
+ * A pair runs as one operation when its instructions are unchanged, leaving
+ * the program counter on its add. A double pair rounds once, as a fused
+ * multiply-add, unless strict IEEE rounding is asked for; the product in rX
+ * is always the rounded one that mulf would leave.
+ *
+ * @param idioms pointer to the table
+ * @param registers general purpose registers of the processor
+ * @param memory memory of the processor
+ * @param pc the program counter, moved to the last instruction of the sequence if it ran
+ * @param strict whether double pairs must round the product before adding it
+ * @return true if the sequence ran natively, false if it must be interpreted
+ */
+bool run_idiom(const IdiomTable* idioms, uint64_t* registers, const uint8_t* memory, uint64_t* pc, bool strict);
+
+/**
+ * @brief Destroys an idiom table and frees its memory.
+ *
+ * @param idioms pointer to the table, or NULL
+ */
+void destroy_idioms(IdiomTable* idioms);
+
+#endif
\ No newline at end of file
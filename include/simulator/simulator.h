@@ -1,25 +1,29 @@
 #ifndef SIMULATOR_H
 #define SIMULATOR_H
 
+#include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "common/object.h"
+#include "common/debug.h"
+#include "common/file.h"
+#include "common/vector.h"
+#include "simulator/heap.h"
+#include "simulator/idiom.h"
 
 #define NUM_REGS 32
 #define MEM_SIZE 512 * 1024
-#define NUM_INSTR 30
-
-typedef struct TinkerFileHeader {
-	uint64_t fileType; // Currently, 0
-	uint64_t codeBegin; // Address into which the code is to be loaded in memory
-	uint64_t codeSize; // Size of the code segment
-	uint64_t dataBegin; // Address into which the data is to be loaded in memory
-	uint64_t dataSize; // Size of the data segment (could be 0)
-} TinkerFileHeader;
-
-TinkerFileHeader* create_tinker_file_header();
+#define NUM_INSTR 32
+#define INPUT_ADDR 0x1000000
+#define INPUT_SIZE_ADDR (INPUT_ADDR - 8)
 
 /// @brief Structure representing a processor.
 typedef struct Processor Processor;
 
+/// @brief Structure representing the harts spawned by a program.
+typedef struct HartGroup HartGroup;
+
 /**
  * @brief Function pointer type for instructions.
  * 
@@ -41,11 +45,28 @@ typedef enum {
 struct Processor {
 	uint64_t pc;                     /**< Program counter */
 	uint64_t registers[NUM_REGS];    /**< General purpose registers */
-	uint8_t memory[MEM_SIZE];        /**< Memory */
+	uint64_t vectors[NUM_VREGS][VECTOR_LANES]; /**< Vector registers */
+	uint8_t* memory;                 /**< Memory of MEM_SIZE bytes, shared by every hart */
 	Instruction instructions[NUM_INSTR]; /**< Instruction set */
 	OpMode mode;                     /**< Current operation mode */
+	DebugInfo* debug;                /**< Debug table of the loaded object, or NULL */
+	MappedFile* input;               /**< Input file mapped at INPUT_ADDR, or NULL */
+	FILE* output;                    /**< Stream written by the binary output port */
+	uint64_t heapBegin;              /**< First address after the loaded data, where the heap starts */
+	Heap* heap;                      /**< Heap of the allocation host calls, created on first use */
+	IdiomTable* idioms;              /**< Sequences of the loaded code that run natively, or NULL if none */
+	bool strictIEEE;                 /**< Whether fused mulf/addf pairs round like separate instructions */
+	Processor* root;                 /**< Main hart, which owns the memory, devices, and heap; itself for the main hart */
+	HartGroup* harts;                /**< Harts spawned by the program, created on the first spawn; main hart only */
 };
 
+/// @brief Structure representing the devices and floating-point mode hw7-sim runs a program with.
+typedef struct SimulatorOptions {
+	const char* inputFile;           /**< File to map at INPUT_ADDR, or NULL */
+	const char* outputFile;          /**< File the binary output port writes, or NULL for stdout */
+	bool strictIEEE;                 /**< Whether fused mulf/addf pairs must round like separate instructions */
+} SimulatorOptions;
+
 /**
  * @brief Creates a new processor.
  * 
@@ -57,17 +78,76 @@ Processor* create_processor();
  * @brief Simulates a program from a file.
  * 
  * @param filename path to the program file
+ * @param options pointer to the devices to attach
+ */
+void simulate_program(const char* filename, const SimulatorOptions* options);
+
+/**
+ * @brief Assembles a tinker source file in memory and simulates it.
+ * 
+ * @param filename path to the source file
+ * @param options pointer to the devices to attach
+ */
+void simulate_source(const char* filename, const SimulatorOptions* options);
+
+/**
+ * @brief Maps a binary input file read-only into the address space of the processor.
+ * 
+ * The bytes of the file appear at INPUT_ADDR, far above the memory of the
+ * processor, and its size in bytes is the word at INPUT_SIZE_ADDR. Programs
+ * read the region with mov loads; bytes past the end of the file read as
+ * zero up to the next word, and stores to the region fail.
+ * 
+ * @param processor pointer to the processor
+ * @param filename path to the input file
+ * @return 0 if successful, -1 if the file cannot be read
+ */
+int attach_input(Processor* processor, const char* filename);
+
+/**
+ * @brief Sends the binary output port of the processor to a file instead of stdout.
+ * 
+ * @param processor pointer to the processor
+ * @param filename path to the output file, which is truncated
+ * @return 0 if successful, -1 if the file cannot be opened
+ */
+int attach_output(Processor* processor, const char* filename);
+
+/**
+ * @brief Runs the processor until it halts or an error occurs.
+ * 
+ * Harts the program spawns keep running on their own threads; the simulator
+ * waits for them with finish_harts before the program ends.
+ * 
+ * @param processor pointer to the processor
+ * @return 0 if the program halted, non-zero otherwise
  */
-void simulate_program(const char* filename);
+int run_processor(Processor* processor);
 
 /**
  * @brief Loads memory from a file into the processor.
  * 
  * @param filename path to the memory file
  * @param processor pointer to the processor
+ * @return 0 if successful, non-zero otherwise
  */
 int load_memory(const char* filename, Processor* processor);
 
+/**
+ * @brief Loads memory from an object image held in memory into the processor.
+ * 
+ * Reserved ranges of the data segment are zero-filled rather than read from the image.
+ * A debug table, if present, is kept so errors can name the code they occur in, and
+ * dot-product loops and fused multiply-add pairs in the code are found so they
+ * can run natively.
+ * 
+ * @param image pointer to the object image
+ * @param size size of the object image in bytes
+ * @param processor pointer to the processor
+ * @return 0 if successful, non-zero otherwise
+ */
+int load_image(const uint8_t* image, uint64_t size, Processor* processor);
+
 /**
  * @brief Processes a single instruction.
  * 
@@ -155,6 +235,18 @@ int mul(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
  */
 int divi(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
 
+/**
+ * @brief Loads the 64-bit immediate held in the next two code words and skips over them.
+ * 
+ * @param processor pointer to the processor
+ * @param rd destination register
+ * @param rs source register
+ * @param rt source register
+ * @param L 12 bit literal
+ * @return 0 if successful, non-zero otherwise
+ */
+int ldw(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
+
 /**
  * @brief Performs a bitwise AND on two registers and stores the result in a destination register.
  * 
@@ -338,6 +430,22 @@ int brgt(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
 /**
  * @brief Executes a privileged instruction.
  * 
+ * Output (L 4) writes rs to the port in rd: 1 prints it in decimal, 2 appends
+ * its 8 raw bytes to the binary output stream, and 3 prints its low byte as a
+ * character. Bulk output (L 5) writes the rt bytes of memory at address rs to
+ * the port in rd in one call; port 1 prints each word of the range.
+ * The memory host calls work on the rt bytes at rd: copy (L 6) moves the
+ * bytes at rs there, fill (L 7) sets them to the low byte of rs, and compare
+ * (L 8) leaves -1, 0, or 1 in rd. Allocation (L 9) leaves the address of a
+ * block of rs bytes from the heap in rd, or 0 if the heap is full, and free
+ * (L 10) returns the block at rd to the heap.
+ * Spawn (L 11) starts a hart at the address in rs with its stack pointer in
+ * rt and leaves its id in rd, or 0 if none can be started; join (L 12) waits
+ * for hart rs and leaves 0 in rd if it halted, 1 if it stopped on an error.
+ * Fetch-add (L 13) adds rt to the word at rs, and compare-and-swap (L 14)
+ * stores rt there if the word equals rd; both atomically, leaving the old
+ * word in rd.
+ * 
  * @param processor pointer to the processor
  * @param rd destination register
  * @param rs source register
@@ -446,6 +554,9 @@ int divf(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
 /**
  * @brief Destroys a processor and frees its memory.
  * 
+ * Destroying the main hart first waits for every hart it spawned; a spawned
+ * hart frees only its own registers.
+ * 
  * @param processor pointer to the processor
  */
 void destroy_processor(Processor* processor);
@@ -0,0 +1,59 @@
+#ifndef SIMULATOR_VECTOR_H
+#define SIMULATOR_VECTOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "simulator/simulator.h"
+
+/**
+ * @brief Executes a vector instruction, whose operation is in the literal.
+ *
+ * Vector registers hold VECTOR_LANES 64-bit lanes. Loads and stores move the
+ * 32 bytes at the address in a general purpose register, the arithmetic works
+ * lane by lane, and the sums leave their result in a general purpose register.
+ * The double sum adds the lanes in pairs, ((x0 + x1) + (x2 + x3)), on every host.
+ *
+ * @param processor pointer to the processor
+ * @param rd destination register
+ * @param rs source register
+ * @param rt source register
+ * @param L 12 bit literal
+ * @return 0 if successful, non-zero otherwise
+ */
+int vector(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L);
+
+/**
+ * @brief Adds the products of two strided sequences of words to an accumulator.
+ *
+ * Pair i is the word at a + i * strideA and the word at b + i * strideB;
+ * strides wrap like guest addresses, so they may step backwards. Every word
+ * must lie in memory. Doubles are multiplied and added exactly as a mulf and
+ * addf per pair would, in order.
+ *
+ * @param memory memory of the processor
+ * @param a address of the first word of the first sequence
+ * @param strideA distance between words of the first sequence
+ * @param b address of the first word of the second sequence
+ * @param strideB distance between words of the second sequence
+ * @param count number of pairs
+ * @param sum the accumulator, as an integer or the bits of a double
+ * @param floating whether the words are doubles
+ * @return the accumulator after adding every product
+ */
+uint64_t dot_product(const uint8_t* memory, uint64_t a, uint64_t strideA, uint64_t b, uint64_t strideB, uint64_t count, uint64_t sum, bool floating);
+
+/**
+ * @brief Chooses whether vector instructions run on the host's AVX2 units.
+ *
+ * Acceleration is on by default wherever the host supports AVX2; both paths
+ * give bit-identical results. The default is chosen once, by the first
+ * vector instruction of any hart, so a choice made here must come before
+ * the program starts.
+ *
+ * @param enabled whether to use AVX2 when the host supports it
+ * @return true if AVX2 is now in use, false if the portable path is
+ */
+bool use_vector_acceleration(bool enabled);
+
+#endif
\ No newline at end of file
@@ -1,13 +1,114 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "assembler/assembler.h"
+#include "assembler/batch.h"
+#include "assembler/instruction.h"
 
 int main(int argc, char* argv[]){
-	if(argc != 3){
+	int numThreads = 0;
+	const char* batchList = NULL;
+	AssemblerOptions options = {1, false, false, false, false, false};
+	int arg = 1;
+
+	// Parse the optional flags that precede the input and output files
+	while(arg < argc && argv[arg][0] == '-' && argv[arg][1] != '\0'){
+		if(strcmp(argv[arg], "-j") == 0 && arg + 1 < argc){
+			numThreads = atoi(argv[arg + 1]);
+
+			if(numThreads < 1){
+				fprintf(stderr, "Please include a positive number of threads after -j\n");
+				exit(1);
+			}
+
+			arg += 2;
+		}
+		else if(strcmp(argv[arg], "-i") == 0){
+			options.incremental = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "-O") == 0){
+			options.optimize = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "-c") == 0){
+			options.relocatable = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "-g") == 0){
+			options.debug = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "-z") == 0){
+			options.compress = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "--batch") == 0 && arg + 1 < argc){
+			batchList = argv[arg + 1];
+			arg += 2;
+		}
+		else{
+			fprintf(stderr, "Unknown option %s\n", argv[arg]);
+			exit(1);
+		}
+	}
+
+	// The line cache of a single file is filled sequentially
+	if(options.incremental && batchList == NULL && numThreads > 0){
+		fprintf(stderr, "Please use -i without -j\n");
+		exit(1);
+	}
+
+	// Relocatable objects are not kept in the line cache
+	if(options.incremental && options.relocatable){
+		fprintf(stderr, "Please use -c without -i\n");
+		exit(1);
+	}
+
+	// Assemble every input/output pair listed in the batch file ("-" for stdin)
+	if(batchList != NULL){
+		if(argc != arg){
+			fprintf(stderr, "Please include only a batch list with --batch\n");
+			exit(1);
+		}
+
+		FILE* list = strcmp(batchList, "-") == 0 ? stdin : fopen(batchList, "r");
+		if(list == NULL){
+			fprintf(stderr, "Error: could not open the file %s for reading\n", batchList);
+			exit(1);
+		}
+
+		Batch* batch = read_batch(list);
+		if(list != stdin){
+			fclose(list);
+		}
+		batch->options = options;
+
+		// Default to one worker per online processor
+		if(numThreads == 0){
+			long processors = sysconf(_SC_NPROCESSORS_ONLN);
+			numThreads = processors > 0 ? (int) processors : 1;
+		}
+
+		uint64_t failed = run_batch(batch, numThreads);
+		if(failed > 0){
+			fprintf(stderr, "%lu of %lu files failed to assemble\n", failed, batch->count);
+		}
+
+		destroy_batch(batch);
+		return failed > 0 ? 1 : 0;
+	}
+
+	if(argc - arg != 2){
 		fprintf(stderr, "Please include an input file and output file as arguments\n");
 		exit(1);
 	}
 
-	generate_object_file(argv[1], argv[2]);
+	options.numThreads = numThreads > 0 ? numThreads : 1;
+	HashMap* ihm = create_instr_hashmap();
+	int status = assemble_file(argv[arg], argv[arg + 1], ihm, &options);
+	destroy_hashmap(ihm, destroy_instruction);
+	return status != 0 ? 1 : 0;
 }
\ No newline at end of file
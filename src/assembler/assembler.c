@@ -3,90 +3,252 @@
 #include <string.h>
 
 #include "assembler/assembler.h"
+#include "assembler/buffer.h"
+#include "assembler/source.h"
+#include "assembler/parallel.h"
+#include "assembler/cache.h"
+#include "assembler/peephole.h"
 #include "assembler/instruction.h"
 #include "assembler/label.h"
 #include "assembler/stack.h"
+#include "assembler/reserve.h"
+#include "assembler/expression.h"
+#include "assembler/regalloc.h"
+#include "assembler/relocate.h"
+#include "assembler/debug.h"
+#include "assembler/compress.h"
 #include "assembler/utils.h"
 
-#define FILE_TYPE 0
-#define INIT_CODE_ADDR 0x2000
-#define INIT_DATA_ADDR 0x10000
+void generate_object_file(const char* inputFile, const char* outputFile){
+	generate_object_file_parallel(inputFile, outputFile, 1);
+}
 
-TinkerFileHeader* create_tinker_file_header(){
-	TinkerFileHeader* tfh = (TinkerFileHeader*) malloc(sizeof(TinkerFileHeader));
+void generate_object_file_parallel(const char* inputFile, const char* outputFile, int numThreads){
+	AssemblerOptions options = {numThreads, false, false, false, false, false};
+	HashMap* ihm = create_instr_hashmap();
+	int status = assemble_file(inputFile, outputFile, ihm, &options);
+	destroy_hashmap(ihm, destroy_instruction);
 
-	if (tfh == NULL) {
-		// Print error message and exit if memory allocation fails
-		fprintf(stderr, "Failed to allocate memory for TinkerFileHeader\n");
+	if(status != 0){
 		exit(1);
 	}
-	
-	tfh->fileType = FILE_TYPE;
-	tfh->codeBegin = INIT_CODE_ADDR;
-	tfh->dataBegin = INIT_DATA_ADDR;
+}
+
+int assemble_file(const char* inputFile, const char* outputFile, HashMap* ihm, const AssemblerOptions* options){
+	FILE* in = NULL;
+	if(check_input_file(inputFile, &in) != 0){
+		return -1;
+	}
+
+	// Read the whole program once; every pass works on the in-memory lines
+	Source* source = read_source(in);
+	fclose(in);
+	if(source == NULL){
+		fprintf(stderr, "Error: could not read the file %s\n", inputFile);
+		return -1;
+	}
+
+	// Collect the exported labels; only relocatable objects record them
+	HashMap* globals = create_hashmap();
+	Source* extracted = extract_globals(source, globals);
+	destroy_source(source);
+	if(extracted == NULL){
+		destroy_hashmap(globals, destroy_label);
+		return -1;
+	}
+
+	// Fold constant expressions so every later pass sees plain operands
+	Source* expanded = expand_source(extracted);
+	destroy_source(extracted);
+	if(expanded == NULL){
+		destroy_hashmap(globals, destroy_label);
+		return -1;
+	}
+	source = expanded;
+
+	// Give virtual registers physical ones before the peephole pass looks at registers
+	uint64_t spilled;
+	Source* allocated = allocate_registers(source, &spilled);
+	destroy_source(source);
+	if(allocated == NULL){
+		destroy_hashmap(globals, destroy_label);
+		return -1;
+	}
+	source = allocated;
+
+	// Optimize before layout so labels are placed in the optimized program
+	if(options->optimize){
+		uint64_t removed;
+		Source* optimized = optimize_source(source, &removed);
+		destroy_source(source);
+		source = optimized;
+	}
+
+	// The line cache sidecar file sits next to the output file
+	char* cachePath = NULL;
+	LineCache* cache = NULL;
+	if(options->incremental){
+		cachePath = (char*) malloc(strlen(outputFile) + strlen(".cache") + 1);
+		if (cachePath == NULL) {
+			// Print error message and exit if memory allocation fails
+			fprintf(stderr, "Error: failed to allocate memory for cache path\n");
+			exit(1);
+		}
+
+		sprintf(cachePath, "%s.cache", outputFile);
+		cache = read_line_cache(cachePath);
+	}
+
+	ObjectBuffer* out = create_object_buffer();
+	int status = options->relocatable ? assemble_relocatable(source, out, ihm, globals, options->debug)
+		: cache != NULL ? assemble_program_cached(source, out, ihm, cache)
+		: options->numThreads > 1 ? assemble_program_parallel(source, out, ihm, options->numThreads)
+		: assemble_program(source, out, ihm);
 
-	return tfh;
+	// Relocatable objects place their debug table before the link table themselves
+	if(status == 0 && options->debug && !options->relocatable){
+		status = append_debug_table(source, out);
+	}
+	// Compression runs last so it sees the finished data segment of every assembly mode
+	if(status == 0 && options->compress){
+		status = compress_object(out);
+	}
+
+	// Only touch the output file once the whole image assembled successfully
+	if(status == 0){
+		status = write_object_file(outputFile, out);
+	}
+	// Only refresh the cache once the object file itself was written
+	if(status == 0 && cache != NULL){
+		status = write_line_cache(cachePath, cache);
+	}
+
+	free(cachePath);
+	destroy_line_cache(cache);
+	destroy_hashmap(globals, destroy_label);
+	destroy_source(source);
+	destroy_object_buffer(out);
+	return status;
 }
 
-void generate_object_file(const char* inputFile, const char* outputFile){
-	HashMap* lhm = create_hashmap();
+int assemble_source_with_options(const char* text, uint64_t size, ObjectBuffer* out, const AssemblerOptions* options){
 	HashMap* ihm = create_instr_hashmap();
-	TinkerFileHeader* tfh = create_tinker_file_header();
+	HashMap* globals = create_hashmap();
+	Source* source = create_source(text, size);
+	Source* extracted = extract_globals(source, globals);
+	Source* expanded = extracted != NULL ? expand_source(extracted) : NULL;
+	uint64_t spilled;
+	Source* allocated = expanded != NULL ? allocate_registers(expanded, &spilled) : NULL;
+
+	int status = allocated == NULL ? -1
+		: options->relocatable ? assemble_relocatable(allocated, out, ihm, globals, options->debug)
+		: assemble_program(allocated, out, ihm);
+	if(status == 0 && options->debug && !options->relocatable){
+		status = append_debug_table(allocated, out);
+	}
+	if(status == 0 && options->compress){
+		status = compress_object(out);
+	}
+
+	destroy_source(allocated);
+	destroy_source(expanded);
+	destroy_source(extracted);
+	destroy_source(source);
+	destroy_hashmap(globals, destroy_label);
+	destroy_hashmap(ihm, destroy_instruction);
+	return status;
+}
+
+int assemble_source(const char* text, uint64_t size, ObjectBuffer* out){
+	AssemblerOptions options = {1, false, false, false, false, false};
+	return assemble_source_with_options(text, size, out, &options);
+}
 
-	FILE *in = NULL, *out = NULL;
-	check_files(inputFile, outputFile, &in, &out);
+int assemble_relocatable_source(const char* text, uint64_t size, ObjectBuffer* out){
+	AssemblerOptions options = {1, false, false, true, false, false};
+	return assemble_source_with_options(text, size, out, &options);
+}
 
-	// Populate labels from the input file
-	if(populate_labels(in, lhm, tfh) != 0){
+int assemble_program(Source* source, ObjectBuffer* out, HashMap* ihm){
+	return assemble_program_cached(source, out, ihm, NULL);
+}
+
+int assemble_program_cached(Source* source, ObjectBuffer* out, HashMap* ihm, LineCache* cache){
+	HashMap* lhm = create_hashmap();
+	TinkerFileHeader* tfh = create_tinker_file_header();
+	ReservedLayout* reserved = NULL;
+	int status = 0;
+
+	// Place reserved data, then populate labels from the source
+	if(layout_reserved(source, &reserved) != 0 || populate_labels(source, lhm, tfh, reserved, cache) != 0){
 		fprintf(stderr, "Error: failed to populate LabelHashMap\n");
-		destroy_hashmap(lhm, destroy_label);
-		destroy_hashmap(ihm, destroy_instruction);
-		free(tfh);
-		fclose(in);
-		fclose(out);
-		remove(outputFile);
-		exit(1);
+		status = -1;
 	}
-
-	rewind(in);
-	// Resolve the program by writing the object file
-	if(resolve_program(in, out, lhm, ihm, tfh) != 0){
+	// Resolve the program into the in-memory object image
+	else if(resolve_program(source, out, lhm, ihm, tfh, reserved, cache) != 0){
 		fprintf(stderr, "Error: failed to create object file\n");
-		destroy_hashmap(lhm, destroy_label);
-		destroy_hashmap(ihm, destroy_instruction);
-		free(tfh);
-		fclose(in);
-		fclose(out);
-		remove(outputFile);
-		exit(1);
+		status = -1;
 	}
 
 	destroy_hashmap(lhm, destroy_label);
-	destroy_hashmap(ihm, destroy_instruction);
+	destroy_reserved_layout(reserved);
 	free(tfh);
-	fclose(in);
-	fclose(out);
+	return status;
 }
 
-void check_files(const char* inputFile, const char* outputFile, FILE** in, FILE** out){
+int check_input_file(const char* inputFile, FILE** in){
 	*in = fopen(inputFile, "r");
 
 	// Check if the input file was opened successfully
 	if(*in == NULL){
 		fprintf(stderr, "Error: could not open the file %s for reading\n", inputFile);
-		exit(1);
+		return -1;
 	}
 
-	*out = fopen(outputFile, "wb");
+	return 0;
+}
+
+int write_object_file(const char* outputFile, ObjectBuffer* out){
+	FILE* fp = fopen(outputFile, "wb");
 
 	// Check if the output file was opened or created successfully
-	if(*out == NULL){
+	if(fp == NULL){
 		fprintf(stderr, "Error: could not open or create the file %s for writing\n", outputFile);
-		exit(1);
+		return -1;
+	}
+
+	// Emit the complete image with a single write
+	if(fwrite(out->data, 1, out->size, fp) != out->size){
+		fprintf(stderr, "Error: failed to write the file %s\n", outputFile);
+		fclose(fp);
+		remove(outputFile);
+		return -1;
 	}
+
+	if(fclose(fp) != 0){
+		fprintf(stderr, "Error: failed to write the file %s\n", outputFile);
+		remove(outputFile);
+		return -1;
+	}
+
+	return 0;
 }
 
-int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
+/**
+ * @brief Runs one layout pass, placing every line and label given the previous pass's addresses.
+ * 
+ * @param source pointer to the source program
+ * @param sizing pointer to the label hash map from the previous pass, or NULL for the first pass
+ * @param previous line addresses from the previous pass, or NULL for the first pass
+ * @param addresses array receiving the address of every tabbed line
+ * @param lhm pointer to the label hash map to populate
+ * @param tfh pointer to the tinker file header
+ * @param reserved pointer to the reserved data layout
+ * @param cache pointer to the line cache, or NULL
+ * @param labelSized set to whether any line's size depends on a label address
+ * @return 0 if successful, non-zero otherwise
+ */
+static int layout_labels(Source* source, HashMap* sizing, const uint64_t* previous, uint64_t* addresses, HashMap* lhm, TinkerFileHeader* tfh, const ReservedLayout* reserved, LineCache* cache, bool* labelSized){
 	char line[256];
 	uint64_t codeAddress = INIT_CODE_ADDR;
 	uint64_t dataAddress = INIT_DATA_ADDR;
@@ -94,17 +256,32 @@ int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
 
 	Stack* labelStack = create_stack();
 
-	while(fgets(line, sizeof(line), in)){
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
 		// Skip comments and empty lines
 		if(line[0] == ';' || is_empty(line)){
 			continue;
 		}
 		// Process directives
 		else if(line[0] == '.'){
-			if((currentDirective = process_directive(line)) == 'N'){
+			char directive = process_directive(line);
+			if(directive == 'N'){
 				fprintf(stderr, "Error: invalid directive format");
+				destroy_stack(labelStack);
 				return -1;
 			}
+			else if(directive != 'R'){
+				currentDirective = directive;
+			}
+			else{
+				// Labels before .space or .zero name the reserved bytes; .align leaves them for what follows
+				while(strncmp(line, ".align", 6) != 0 && !stack_is_empty(labelStack)){
+					char* label = stack_pop(labelStack);
+					hashmap_insert(lhm, label, create_label(label, dataAddress));
+				}
+				dataAddress += reserved->sizes[i];
+			}
 		}
 		// Process label lines
 		else if(line[0] == ':'){
@@ -113,6 +290,8 @@ int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
 
 			if(!is_valid_label(label)){
 				fprintf(stderr, "Error: invalid label format\n");
+				free(label);
+				destroy_stack(labelStack);
 				return -1;
 			}
 
@@ -133,10 +312,16 @@ int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
 				}
 			}
 
-			// Calculate new address based on directive type
-			int8_t change = change_in_address(line);
+			addresses[i] = currentDirective == 'C' ? codeAddress : currentDirective == 'D' ? dataAddress : 0;
+			uint64_t address = previous != NULL ? previous[i] : 0;
+
+			// Calculate new address based on directive type, reusing the cached size of unchanged lines
+			CacheEntry* entry = cache != NULL ? line_cache_match(cache, hash_line(line), line_dependency(sizing, address, line)) : NULL;
+			int8_t change = entry != NULL ? (int8_t) entry->size : change_in_address(sizing, address, line);
+			*labelSized = *labelSized || strchr(line, ':') != NULL;
 			if(change == -1){
 				fprintf(stderr, "Error: invalid instruction format\n");
+				destroy_stack(labelStack);
 				return -1;
 			}
 
@@ -150,6 +335,7 @@ int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
 		// Handle invalid line format
 		else{
 			fprintf(stderr, "Error: invalid line format\n");
+			destroy_stack(labelStack);
 			return -1;
 		}
 	}
@@ -168,55 +354,156 @@ int populate_labels(FILE* in, HashMap* lhm, TinkerFileHeader* tfh){
 	
 	// Calculate the size of the code and data segments
 	tfh->codeSize = codeAddress - INIT_CODE_ADDR;
-	tfh->dataSize = dataAddress - INIT_DATA_ADDR;
+	tfh->dataSize = dataAddress - INIT_DATA_ADDR - reserved->total;
 	destroy_stack(labelStack);
 	return 0;
 }
 
-int resolve_program(FILE* in, FILE* out, HashMap* lhm, HashMap* ihm, TinkerFileHeader* tfh){
+int populate_labels(Source* source, HashMap* lhm, TinkerFileHeader* tfh, const ReservedLayout* reserved, LineCache* cache){
+	HashMap* sizing = NULL;
+	uint64_t* previous = NULL;
+	uint64_t* addresses = (uint64_t*) calloc(source->count + 1, sizeof(uint64_t));
+	TinkerFileHeader last = *tfh;
+
+	if (addresses == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for line addresses\n");
+		exit(1);
+	}
+
+	// Start with every label operand at its longest, then size each pass from the last pass's
+	// addresses; sizes never grow as the lines between a branch and its label shrink, so the
+	// passes converge once a pass places every line where the previous one did
+	while(true){
+		HashMap* current = create_hashmap();
+		bool labelSized = false;
+
+		if(layout_labels(source, sizing, previous, addresses, current, tfh, reserved, cache, &labelSized) != 0){
+			destroy_hashmap(current, destroy_label);
+			destroy_hashmap(sizing, destroy_label);
+			free(previous);
+			free(addresses);
+			return -1;
+		}
+
+		bool stable = !labelSized || (previous != NULL && tfh->codeSize == last.codeSize && tfh->dataSize == last.dataSize
+			&& memcmp(previous, addresses, sizeof(uint64_t) * source->count) == 0);
+		destroy_hashmap(sizing, destroy_label);
+		sizing = current;
+		last = *tfh;
+
+		if(stable){
+			break;
+		}
+
+		// The addresses of this pass size the next one
+		if(previous == NULL){
+			previous = (uint64_t*) calloc(source->count + 1, sizeof(uint64_t));
+			if (previous == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for line addresses\n");
+				exit(1);
+			}
+		}
+
+		uint64_t* swap = previous;
+		previous = addresses;
+		addresses = swap;
+	}
+
+	// Hand the final labels over to the caller's hash map
+	HashMap swap = *lhm;
+	*lhm = *sizing;
+	*sizing = swap;
+	destroy_hashmap(sizing, destroy_label);
+	free(previous);
+	free(addresses);
+	return 0;
+}
+
+int resolve_program(Source* source, ObjectBuffer* out, HashMap* lhm, HashMap* ihm, TinkerFileHeader* tfh, const ReservedLayout* reserved, LineCache* cache){
 	char currentDirective = 'N';
 	bool hasCodeDirective = false;
 
-	// Create data array to consolidate data separately from code
-	uint64_t* dataBinary = (uint64_t*) malloc(sizeof(uint64_t) * (tfh->dataSize / 8));
-	uint64_t dataCount = 0;
-
-	// Write file header to output file
-	fwrite(tfh, sizeof(TinkerFileHeader), 1, out);
+	// Size the image up front: the header and range table, then code, then data
+	uint64_t codeOffset = sizeof(TinkerFileHeader) + reserved_table_size(reserved);
+	uint64_t dataOffset = codeOffset + tfh->codeSize;
+	buffer_reserve(out, dataOffset + tfh->dataSize);
+	out->position = codeOffset;
 	uint64_t currentLine = 1;
 
 	char line[256];
-	while(fgets(line, sizeof(line), in)){
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
 		// Skip labels, comments, and empty lines
 		if(line[0] == ':' || line[0] == ';' || is_empty(line)){
 			continue;
 		}
 		// Process directive lines
 		else if(line[0] == '.'){
-			currentDirective = process_directive(line);
+			// Reserved bytes take no room in the image
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
 			hasCodeDirective = currentDirective == 'C' ? true : hasCodeDirective;
 		}
 		// Process data and instruction lines
 		else if(line[0] == '\t'){
-			if(is_data(line)){
-				if(currentDirective != 'D'){
-					fprintf(stderr, "Error: data must be under a .data directive\n");
-					return -1;
+			// Look up the line's previous encoding before parsing it
+			uint64_t hash = 0;
+			uint64_t dependency = 0;
+			CacheEntry* entry = NULL;
+			if(cache != NULL){
+				hash = hash_line(line);
+				dependency = line_dependency(lhm, INIT_CODE_ADDR + out->position - codeOffset, line);
+				entry = line_cache_match(cache, hash, dependency);
+			}
+
+			char section = entry != NULL ? entry->section : (is_data(line) ? 'D' : 'C');
+			if(section == 'D' && currentDirective != 'D'){
+				fprintf(stderr, "Error: data must be under a .data directive\n");
+				return -1;
+			}
+			if(section == 'C' && currentDirective != 'C'){
+				fprintf(stderr, "Error: instructions must be under a .code directive\n");
+				return -1;
+			}
+
+			// Copy unchanged lines straight from the cache
+			if(entry != NULL){
+				if(section == 'D'){
+					buffer_write_at(out, dataOffset, line_cache_bytes(cache, entry), entry->size);
+					dataOffset += entry->size;
+				}
+				else{
+					buffer_write(out, line_cache_bytes(cache, entry), entry->size);
 				}
 
+				line_cache_record(cache, hash, dependency, section, line_cache_bytes(cache, entry), entry->size);
+				cache->hits++;
+			}
+			else if(section == 'D'){
 				trim(line);
-				dataBinary[dataCount] = strtoull(line, NULL, 10);
-				dataCount++;
+				uint64_t value = strtoull(line, NULL, 10);
+				// Data is placed directly behind the code segment
+				buffer_write_at(out, dataOffset, &value, sizeof(uint64_t));
+				dataOffset += sizeof(uint64_t);
+
+				if(cache != NULL){
+					line_cache_record(cache, hash, dependency, section, (uint8_t*) &value, sizeof(uint64_t));
+					cache->misses++;
+				}
 			}
 			else{
-				if(currentDirective != 'C'){
-					fprintf(stderr, "Error: instructions must be under a .code directive\n");
+				uint64_t start = out->position;
+				if(process_instruction_line(out, lhm, ihm, line, INIT_CODE_ADDR + out->position - codeOffset) != 0){
+					fprintf(stderr, "Error: failed to process instruction at line %lu\n", currentLine);
 					return -1;
 				}
 
-				if(process_instruction(out, lhm, ihm, line) != 0){
-					fprintf(stderr, "Error: failed to process instruction at line %lu\n", currentLine);
-					return -1;
+				if(cache != NULL){
+					line_cache_record(cache, hash, dependency, section, out->data + start, out->position - start);
+					cache->misses++;
 				}
 			}
 			
@@ -230,8 +517,14 @@ int resolve_program(FILE* in, FILE* out, HashMap* lhm, HashMap* ihm, TinkerFileH
 		return -1;
 	}
 
-	// Write all data last to output file
-	fwrite(dataBinary, sizeof(uint64_t), (tfh->dataSize / 8), out);
-	free(dataBinary);
+	// Ensure the emitted code matches the layout computed by populate_labels
+	if(out->position - codeOffset != tfh->codeSize){
+		fprintf(stderr, "Error: code segment size does not match label layout\n");
+		return -1;
+	}
+
+	// Write the file header last, now that the segment sizes are final
+	write_reserved_table(out, reserved, tfh);
+	buffer_write_at(out, 0, tfh, sizeof(TinkerFileHeader));
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/batch.h"
+#include "assembler/assembler.h"
+#include "assembler/instruction.h"
+#include "assembler/utils.h"
+
+Batch* read_batch(FILE* list){
+	Batch* batch = (Batch*) malloc(sizeof(Batch));
+
+	if (batch == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Batch\n");
+		exit(1);
+	}
+
+	batch->jobs = NULL;
+	batch->count = 0;
+	batch->next = 0;
+	batch->ihm = NULL;
+	batch->options = (AssemblerOptions) {1, false, false, false, false, false};
+	pthread_mutex_init(&batch->lock, NULL);
+
+	uint64_t capacity = 0, lineNumber = 0;
+	char line[1024], inputFile[512], outputFile[512], extra[2];
+	while(fgets(line, sizeof(line), list)){
+		lineNumber++;
+
+		// Skip comments and empty lines
+		if(line[0] == ';' || is_empty(line)){
+			continue;
+		}
+
+		// A malformed entry is kept as a failed job so the rest of the batch still runs
+		bool valid = sscanf(line, " %511s %511s %1s", inputFile, outputFile, extra) == 2;
+		if(!valid){
+			fprintf(stderr, "Error: invalid batch entry at line %lu\n", lineNumber);
+		}
+
+		if(batch->count == capacity){
+			capacity = capacity == 0 ? 64 : capacity * 2;
+			batch->jobs = (BatchJob*) realloc(batch->jobs, sizeof(BatchJob) * capacity);
+
+			if (batch->jobs == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for BatchJob\n");
+				exit(1);
+			}
+		}
+
+		batch->jobs[batch->count].inputFile = valid ? strdup(inputFile) : NULL;
+		batch->jobs[batch->count].outputFile = valid ? strdup(outputFile) : NULL;
+		batch->jobs[batch->count].status = valid ? 0 : -1;
+		batch->count++;
+	}
+
+	return batch;
+}
+
+void* batch_worker(void* ptr){
+	Batch* batch = (Batch*) ptr;
+
+	while(1){
+		// Claim the next unassembled file
+		pthread_mutex_lock(&batch->lock);
+		uint64_t index = batch->next++;
+		pthread_mutex_unlock(&batch->lock);
+
+		if(index >= batch->count){
+			return NULL;
+		}
+
+		BatchJob* job = &batch->jobs[index];
+		if(job->inputFile == NULL){
+			continue;
+		}
+
+		job->status = assemble_file(job->inputFile, job->outputFile, batch->ihm, &batch->options);
+
+		if(job->status != 0){
+			fprintf(stderr, "Error: failed to assemble %s\n", job->inputFile);
+		}
+	}
+}
+
+uint64_t run_batch(Batch* batch, int numThreads){
+	// The instruction table is immutable, so one copy serves every worker
+	batch->ihm = create_instr_hashmap();
+	batch->next = 0;
+
+	if(numThreads > batch->count){
+		numThreads = batch->count > 0 ? (int) batch->count : 1;
+	}
+
+	pthread_t* threads = (pthread_t*) malloc(sizeof(pthread_t) * numThreads);
+	if (threads == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for threads\n");
+		exit(1);
+	}
+
+	int started = 0;
+	for(int t = 0; t < numThreads; t++){
+		if(pthread_create(&threads[started], NULL, batch_worker, batch) == 0){
+			started++;
+		}
+	}
+
+	// Work on this thread too if no worker could be started
+	if(started == 0){
+		batch_worker(batch);
+	}
+
+	for(int t = 0; t < started; t++){
+		pthread_join(threads[t], NULL);
+	}
+	free(threads);
+
+	uint64_t failed = 0;
+	for(uint64_t i = 0; i < batch->count; i++){
+		failed += batch->jobs[i].status != 0 ? 1 : 0;
+	}
+
+	destroy_hashmap(batch->ihm, destroy_instruction);
+	batch->ihm = NULL;
+	batch->options = (AssemblerOptions) {1, false, false, false, false, false};
+	return failed;
+}
+
+void destroy_batch(Batch* batch){
+	if(batch == NULL){
+		return;
+	}
+
+	for(uint64_t i = 0; i < batch->count; i++){
+		free(batch->jobs[i].inputFile);
+		free(batch->jobs[i].outputFile);
+	}
+
+	pthread_mutex_destroy(&batch->lock);
+	free(batch->jobs);
+	free(batch);
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/buffer.h"
+
+#define INITIAL_CAPACITY 4096
+
+ObjectBuffer* create_object_buffer(){
+	ObjectBuffer* buffer = (ObjectBuffer*) malloc(sizeof(ObjectBuffer));
+
+	if (buffer == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for ObjectBuffer\n");
+		exit(1);
+	}
+
+	buffer->data = NULL;
+	buffer->size = 0;
+	buffer->capacity = 0;
+	buffer->position = 0;
+
+	buffer_reserve(buffer, INITIAL_CAPACITY);
+	return buffer;
+}
+
+void buffer_reserve(ObjectBuffer* buffer, uint64_t capacity){
+	if(capacity <= buffer->capacity){
+		return;
+	}
+
+	// Grow geometrically so repeated small writes stay amortized constant time
+	uint64_t newCapacity = buffer->capacity == 0 ? INITIAL_CAPACITY : buffer->capacity;
+	while(newCapacity < capacity){
+		newCapacity *= 2;
+	}
+
+	uint8_t* data = (uint8_t*) realloc(buffer->data, newCapacity);
+	if (data == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for ObjectBuffer data\n");
+		exit(1);
+	}
+
+	// Zero the new region so gaps left by positional writes are deterministic
+	memset(data + buffer->capacity, 0, newCapacity - buffer->capacity);
+	buffer->data = data;
+	buffer->capacity = newCapacity;
+}
+
+void buffer_write(ObjectBuffer* buffer, const void* src, uint64_t size){
+	buffer_write_at(buffer, buffer->position, src, size);
+	buffer->position += size;
+}
+
+void buffer_write_at(ObjectBuffer* buffer, uint64_t offset, const void* src, uint64_t size){
+	buffer_reserve(buffer, offset + size);
+	memcpy(buffer->data + offset, src, size);
+
+	if(offset + size > buffer->size){
+		buffer->size = offset + size;
+	}
+}
+
+void buffer_write_instruction(ObjectBuffer* buffer, uint32_t instr){
+	buffer_write(buffer, &instr, sizeof(uint32_t));
+}
+
+void destroy_object_buffer(ObjectBuffer* buffer){
+	if(buffer == NULL){
+		return;
+	}
+
+	free(buffer->data);
+	free(buffer);
+}
\ No newline at end of file
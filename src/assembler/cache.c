@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "assembler/cache.h"
+#include "assembler/label.h"
+#include "assembler/instruction.h"
+#include "assembler/utils.h"
+
+#define CACHE_MAGIC 0x3148434143544B54ULL /* "TKTCACH1" */
+#define RECORD_SIZE 24
+#define MISSING_LABEL 0x9E3779B97F4A7C15ULL
+
+/**
+ * @brief Mixes a 64-bit value into an FNV-1a hash.
+ *
+ * @param hash the running hash
+ * @param value the value to mix in
+ * @return The updated hash.
+ */
+static uint64_t mix_value(uint64_t hash, uint64_t value){
+	for(int i = 0; i < 8; i++){
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+/**
+ * @brief Orders entries by hash, then by dependency.
+ */
+static int compare_entries(const void* a, const void* b){
+	const CacheEntry* x = (const CacheEntry*) a;
+	const CacheEntry* y = (const CacheEntry*) b;
+
+	if(x->hash != y->hash){
+		return x->hash < y->hash ? -1 : 1;
+	}
+	if(x->dependency != y->dependency){
+		return x->dependency < y->dependency ? -1 : 1;
+	}
+	return 0;
+}
+
+LineCache* create_line_cache(){
+	LineCache* cache = (LineCache*) malloc(sizeof(LineCache));
+
+	if (cache == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for LineCache\n");
+		exit(1);
+	}
+
+	cache->entries = NULL;
+	cache->count = 0;
+	cache->bytes = NULL;
+	cache->recorded = NULL;
+	cache->recordedCount = 0;
+	cache->recordedCapacity = 0;
+	cache->recordedBytes = create_object_buffer();
+	cache->hits = 0;
+	cache->misses = 0;
+	return cache;
+}
+
+LineCache* read_line_cache(const char* path){
+	LineCache* cache = create_line_cache();
+
+	FILE* fp = fopen(path, "rb");
+	if(fp == NULL){
+		return cache;
+	}
+
+	// Read the record table header
+	uint64_t header[3];
+	if(fread(header, sizeof(uint64_t), 3, fp) != 3 || header[0] != CACHE_MAGIC || header[1] > UINT32_MAX){
+		fclose(fp);
+		return cache;
+	}
+
+	uint64_t count = header[1];
+	uint64_t byteCount = header[2];
+	CacheEntry* entries = (CacheEntry*) malloc(sizeof(CacheEntry) * (count > 0 ? count : 1));
+	uint8_t* bytes = (uint8_t*) malloc(byteCount > 0 ? byteCount : 1);
+	if (entries == NULL || bytes == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for LineCache entries\n");
+		exit(1);
+	}
+
+	// Read the records, which must be sorted and describe the byte pool exactly
+	uint64_t offset = 0;
+	bool valid = true;
+	for(uint64_t i = 0; i < count && valid; i++){
+		uint8_t record[RECORD_SIZE];
+		if(fread(record, 1, RECORD_SIZE, fp) != RECORD_SIZE){
+			valid = false;
+			break;
+		}
+
+		memcpy(&entries[i].hash, record, sizeof(uint64_t));
+		memcpy(&entries[i].dependency, record + 8, sizeof(uint64_t));
+		memcpy(&entries[i].size, record + 16, sizeof(uint32_t));
+		entries[i].section = (char) record[20];
+		entries[i].offset = offset;
+		offset += entries[i].size;
+
+		valid = (entries[i].section == 'C' || entries[i].section == 'D')
+			&& offset <= byteCount
+			&& (i == 0 || compare_entries(&entries[i - 1], &entries[i]) <= 0);
+	}
+
+	if(!valid || offset != byteCount || fread(bytes, 1, byteCount, fp) != byteCount){
+		free(entries);
+		free(bytes);
+		fclose(fp);
+		return cache;
+	}
+
+	fclose(fp);
+	cache->entries = entries;
+	cache->count = count;
+	cache->bytes = bytes;
+	return cache;
+}
+
+int write_line_cache(const char* path, LineCache* cache){
+	// Sort the recorded entries and drop duplicates of repeated lines
+	qsort(cache->recorded, cache->recordedCount, sizeof(CacheEntry), compare_entries);
+
+	uint64_t count = 0;
+	uint64_t byteCount = 0;
+	for(uint64_t i = 0; i < cache->recordedCount; i++){
+		if(count > 0 && compare_entries(&cache->recorded[count - 1], &cache->recorded[i]) == 0){
+			continue;
+		}
+
+		cache->recorded[count++] = cache->recorded[i];
+		byteCount += cache->recorded[i].size;
+	}
+	cache->recordedCount = count;
+
+	FILE* fp = fopen(path, "wb");
+	if(fp == NULL){
+		fprintf(stderr, "Error: could not open or create the file %s for writing\n", path);
+		return -1;
+	}
+
+	uint64_t header[3] = {CACHE_MAGIC, count, byteCount};
+	bool written = fwrite(header, sizeof(uint64_t), 3, fp) == 3;
+
+	for(uint64_t i = 0; i < count && written; i++){
+		uint8_t record[RECORD_SIZE] = {0};
+		memcpy(record, &cache->recorded[i].hash, sizeof(uint64_t));
+		memcpy(record + 8, &cache->recorded[i].dependency, sizeof(uint64_t));
+		memcpy(record + 16, &cache->recorded[i].size, sizeof(uint32_t));
+		record[20] = (uint8_t) cache->recorded[i].section;
+		written = fwrite(record, 1, RECORD_SIZE, fp) == RECORD_SIZE;
+	}
+
+	for(uint64_t i = 0; i < count && written; i++){
+		CacheEntry* entry = &cache->recorded[i];
+		written = fwrite(cache->recordedBytes->data + entry->offset, 1, entry->size, fp) == entry->size;
+	}
+
+	// A partial sidecar file would only be rejected later, so remove it now
+	if(fclose(fp) != 0 || !written){
+		fprintf(stderr, "Error: failed to write the file %s\n", path);
+		remove(path);
+		return -1;
+	}
+
+	return 0;
+}
+
+uint64_t hash_line(const char* line){
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for(const char* c = line; *c != '\0'; c++){
+		hash ^= (uint8_t) *c;
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+uint64_t line_dependency(HashMap* lhm, uint64_t address, const char* line){
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	// Relative branches also depend on where they are placed
+	if(is_relative_branch(line)){
+		hash = mix_value(hash, address);
+	}
+	char label[256];
+
+	for(const char* c = strchr(line, ':'); c != NULL; c = strchr(c, ':')){
+		// A label operand runs until the next separator
+		uint64_t length = 0;
+		while(c[length] != '\0' && c[length] != ',' && c[length] != ')' && !isspace((unsigned char) c[length]) && length < sizeof(label) - 1){
+			label[length] = c[length];
+			length++;
+		}
+		label[length] = '\0';
+		c += length;
+
+		uint64_t found;
+		hash = mix_value(hash, resolve_label(lhm, label, &found) ? found : MISSING_LABEL);
+	}
+
+	return hash;
+}
+
+/**
+ * @brief Finds the first loaded entry for a line's text.
+ *
+ * @param cache pointer to the line cache
+ * @param hash hash of the line's text
+ * @return Pointer to the entry, or NULL if there is none.
+ */
+static CacheEntry* line_cache_find(LineCache* cache, uint64_t hash){
+	// Binary search for the first entry with the hash
+	uint64_t low = 0;
+	uint64_t high = cache->count;
+	while(low < high){
+		uint64_t mid = low + (high - low) / 2;
+		if(cache->entries[mid].hash < hash){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+
+	return low < cache->count && cache->entries[low].hash == hash ? &cache->entries[low] : NULL;
+}
+
+CacheEntry* line_cache_match(LineCache* cache, uint64_t hash, uint64_t dependency){
+	CacheEntry* entry = line_cache_find(cache, hash);
+	if(entry == NULL){
+		return NULL;
+	}
+
+	// Entries with equal hashes are adjacent, ordered by dependency
+	CacheEntry* end = cache->entries + cache->count;
+	for(; entry < end && entry->hash == hash; entry++){
+		if(entry->dependency == dependency){
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+const uint8_t* line_cache_bytes(LineCache* cache, CacheEntry* entry){
+	return cache->bytes + entry->offset;
+}
+
+void line_cache_record(LineCache* cache, uint64_t hash, uint64_t dependency, char section, const uint8_t* bytes, uint32_t size){
+	if(cache->recordedCount == cache->recordedCapacity){
+		uint64_t capacity = cache->recordedCapacity == 0 ? 256 : cache->recordedCapacity * 2;
+		CacheEntry* recorded = (CacheEntry*) realloc(cache->recorded, sizeof(CacheEntry) * capacity);
+
+		if (recorded == NULL) {
+			// Print error message and exit if memory allocation fails
+			fprintf(stderr, "Error: failed to allocate memory for LineCache entries\n");
+			exit(1);
+		}
+
+		cache->recorded = recorded;
+		cache->recordedCapacity = capacity;
+	}
+
+	CacheEntry* entry = &cache->recorded[cache->recordedCount++];
+	entry->hash = hash;
+	entry->dependency = dependency;
+	entry->section = section;
+	entry->size = size;
+	entry->offset = cache->recordedBytes->position;
+	buffer_write(cache->recordedBytes, bytes, size);
+}
+
+void destroy_line_cache(LineCache* cache){
+	if(cache == NULL){
+		return;
+	}
+
+	free(cache->entries);
+	free(cache->bytes);
+	free(cache->recorded);
+	destroy_object_buffer(cache->recordedBytes);
+	free(cache);
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/compress.h"
+#include "common/compress.h"
+#include "common/object.h"
+
+int compress_object(ObjectBuffer* out){
+	uint64_t storedSize;
+	uint64_t offset = object_data_offset(out->data, out->size, &storedSize);
+	if(offset == 0){
+		fprintf(stderr, "Error: cannot compress a malformed object image\n");
+		return -1;
+	}
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, out->data, sizeof(TinkerFileHeader));
+	if((tfh.fileType & FILE_FLAG_COMPRESSED) || storedSize % 8 != 0){
+		return 0;
+	}
+
+	uint8_t* encoded = (uint8_t*) malloc(encoded_data_bound(storedSize) + 1);
+	if (encoded == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for the compressed data segment\n");
+		exit(1);
+	}
+
+	// Keep the plain segment unless the stream and its size prefix save space
+	uint64_t encodedSize = encode_data(out->data + offset, storedSize, encoded);
+	if(encodedSize + sizeof(uint64_t) >= storedSize){
+		free(encoded);
+		return 0;
+	}
+
+	// Move the tables behind the data segment up, then fill in the stream
+	uint64_t tail = out->size - offset - storedSize;
+	uint64_t newSize = offset + sizeof(uint64_t) + encodedSize + tail;
+	memmove(out->data + offset + sizeof(uint64_t) + encodedSize, out->data + offset + storedSize, tail);
+	memcpy(out->data + offset, &encodedSize, sizeof(uint64_t));
+	memcpy(out->data + offset + sizeof(uint64_t), encoded, encodedSize);
+	memset(out->data + newSize, 0, out->size - newSize);
+	free(encoded);
+
+	tfh.fileType |= FILE_FLAG_COMPRESSED;
+	memcpy(out->data, &tfh, sizeof(TinkerFileHeader));
+	out->size = newSize;
+	out->position = newSize;
+	return 0;
+}
\ No newline at end of file
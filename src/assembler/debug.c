@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/debug.h"
+#include "assembler/assembler.h"
+#include "assembler/instruction.h"
+#include "assembler/label.h"
+#include "assembler/utils.h"
+#include "common/object.h"
+
+/**
+ * @brief Orders debug symbols by address, then by name offset, which follows the source order.
+ *
+ * @param a pointer to the first debug symbol
+ * @param b pointer to the second debug symbol
+ * @return negative, zero, or positive as the first symbol comes before, with, or after the second
+ */
+static int compare_symbols(const void* a, const void* b){
+	const DebugSymbol* first = (const DebugSymbol*) a;
+	const DebugSymbol* second = (const DebugSymbol*) b;
+
+	if(first->address != second->address){
+		return first->address < second->address ? -1 : 1;
+	}
+	return first->name < second->name ? -1 : first->name > second->name;
+}
+
+int append_debug_table(Source* source, ObjectBuffer* out){
+	HashMap* lhm = create_hashmap();
+	TinkerFileHeader* tfh = create_tinker_file_header();
+	ReservedLayout* reserved = NULL;
+
+	// Lay the program out again to recover the labels the assembler placed
+	if(layout_reserved(source, &reserved) != 0 || populate_labels(source, lhm, tfh, reserved, NULL) != 0){
+		destroy_hashmap(lhm, destroy_label);
+		destroy_reserved_layout(reserved);
+		free(tfh);
+		return -1;
+	}
+
+	DebugSymbol* symbols = (DebugSymbol*) malloc(sizeof(DebugSymbol) * (source->count + 1));
+	DebugLine* lines = (DebugLine*) malloc(sizeof(DebugLine) * (source->count + 1));
+	if (symbols == NULL || lines == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for debug table\n");
+		exit(1);
+	}
+
+	ObjectBuffer* strings = create_object_buffer();
+	DebugTable table = {0, 0, 0};
+	char line[256], currentDirective = 'N';
+	uint64_t address = INIT_CODE_ADDR;
+
+	// Record every label, and walk the code again with the final labels to place each line
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+		}
+		else if(line[0] == ':'){
+			trim(line);
+			Label* label = (Label*) hashmap_get(lhm, line);
+			if(label != NULL){
+				symbols[table.symbolCount++] = (DebugSymbol) {label->address, strings->position};
+				buffer_write(strings, line, strlen(line) + 1);
+			}
+		}
+		else if(line[0] == '\t' && !is_empty(line) && currentDirective == 'C'){
+			if(!is_data(line)){
+				lines[table.lineCount++] = (DebugLine) {address, i + 1};
+			}
+			address += change_in_address(lhm, address, line);
+		}
+	}
+
+	qsort(symbols, table.symbolCount, sizeof(DebugSymbol), compare_symbols);
+	table.stringSize = strings->position;
+
+	// The table follows the data segment and is flagged in the header
+	TinkerFileHeader header;
+	memcpy(&header, out->data, sizeof(TinkerFileHeader));
+	header.fileType |= FILE_FLAG_DEBUG;
+	buffer_write_at(out, 0, &header, sizeof(TinkerFileHeader));
+
+	out->position = out->size;
+	buffer_write(out, &table, sizeof(DebugTable));
+	buffer_write(out, symbols, sizeof(DebugSymbol) * table.symbolCount);
+	buffer_write(out, lines, sizeof(DebugLine) * table.lineCount);
+	buffer_write(out, strings->data, strings->position);
+
+	free(symbols);
+	free(lines);
+	destroy_object_buffer(strings);
+	destroy_hashmap(lhm, destroy_label);
+	destroy_reserved_layout(reserved);
+	free(tfh);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,546 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "assembler/expression.h"
+#include "assembler/buffer.h"
+#include "assembler/label.h"
+#include "assembler/utils.h"
+#include "assembler/instruction.h"
+
+#define MAX_OPERANDS 4
+
+/**
+ * @brief Structure representing a partially evaluated expression.
+ */
+typedef struct Term {
+	uint64_t value; /**< constant part, wrapping like the simulator's registers */
+	int64_t count; /**< how many times the label is added */
+	const char* label; /**< start of the label in the expression text, or NULL */
+	uint64_t length; /**< length of the label */
+} Term;
+
+static int parse_sum(HashMap* symbols, const char** text, Term* term);
+
+/**
+ * @brief Skips whitespace in the expression text.
+ *
+ * @param text pointer to the current position
+ */
+static void skip_spaces(const char** text){
+	while(isspace((unsigned char) **text)){
+		(*text)++;
+	}
+}
+
+/**
+ * @brief Parses a number, symbol, label, or parenthesized expression.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text pointer to the current position
+ * @param term set to the value of the operand
+ * @return 0 if successful, -1 otherwise
+ */
+static int parse_primary(HashMap* symbols, const char** text, Term* term){
+	skip_spaces(text);
+	const char* start = *text;
+	char name[256];
+	memset(term, 0, sizeof(Term));
+
+	if(*start == '('){
+		(*text)++;
+		if(parse_sum(symbols, text, term) != 0){
+			return -1;
+		}
+
+		skip_spaces(text);
+		if(**text != ')'){
+			return -1;
+		}
+		(*text)++;
+		return 0;
+	}
+	// A label runs until the next separator
+	else if(*start == ':'){
+		while(**text != '\0' && **text != ',' && **text != ')' && !isspace((unsigned char) **text)){
+			(*text)++;
+		}
+
+		term->count = 1;
+		term->label = start;
+		term->length = *text - start;
+		return term->length > 1 ? 0 : -1;
+	}
+	else if(isdigit((unsigned char) *start)){
+		while(isdigit((unsigned char) **text)){
+			(*text)++;
+		}
+	}
+	else if(isalpha((unsigned char) *start) || *start == '_'){
+		while(isalnum((unsigned char) **text) || **text == '_'){
+			(*text)++;
+		}
+	}
+	else{
+		return -1;
+	}
+
+	if((uint64_t) (*text - start) >= sizeof(name)){
+		return -1;
+	}
+	memcpy(name, start, *text - start);
+	name[*text - start] = '\0';
+
+	if(isdigit((unsigned char) *start)){
+		if(!is_uint64(name)){
+			return -1;
+		}
+
+		term->value = strtoull(name, NULL, 10);
+		return 0;
+	}
+
+	Label* symbol = (Label*) hashmap_get(symbols, name);
+	if(symbol == NULL){
+		return -1;
+	}
+
+	term->value = symbol->address;
+	return 0;
+}
+
+/**
+ * @brief Parses an operand with any number of leading minus signs.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text pointer to the current position
+ * @param term set to the value of the operand
+ * @return 0 if successful, -1 otherwise
+ */
+static int parse_unary(HashMap* symbols, const char** text, Term* term){
+	skip_spaces(text);
+	if(**text != '-'){
+		return parse_primary(symbols, text, term);
+	}
+
+	(*text)++;
+	if(parse_unary(symbols, text, term) != 0){
+		return -1;
+	}
+
+	term->value = 0 - term->value;
+	term->count = -term->count;
+	return 0;
+}
+
+/**
+ * @brief Parses a chain of multiplications and divisions, which labels may not take part in.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text pointer to the current position
+ * @param term set to the value of the product
+ * @return 0 if successful, -1 otherwise
+ */
+static int parse_product(HashMap* symbols, const char** text, Term* term){
+	if(parse_unary(symbols, text, term) != 0){
+		return -1;
+	}
+
+	while(true){
+		skip_spaces(text);
+		char operator = **text;
+		if(operator != '*' && operator != '/'){
+			return 0;
+		}
+
+		(*text)++;
+		Term right;
+		if(parse_unary(symbols, text, &right) != 0 || term->count != 0 || right.count != 0){
+			return -1;
+		}
+
+		if(operator == '*'){
+			term->value *= right.value;
+		}
+		// Division truncates like C, and must not trap on zero or overflow
+		else{
+			int64_t dividend = (int64_t) term->value, divisor = (int64_t) right.value;
+			if(divisor == 0 || (dividend == INT64_MIN && divisor == -1)){
+				return -1;
+			}
+
+			term->value = (uint64_t) (dividend / divisor);
+		}
+	}
+}
+
+/**
+ * @brief Parses a chain of additions and subtractions.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text pointer to the current position
+ * @param term set to the value of the sum
+ * @return 0 if successful, -1 otherwise
+ */
+static int parse_sum(HashMap* symbols, const char** text, Term* term){
+	if(parse_product(symbols, text, term) != 0){
+		return -1;
+	}
+
+	while(true){
+		skip_spaces(text);
+		char operator = **text;
+		if(operator != '+' && operator != '-'){
+			return 0;
+		}
+
+		(*text)++;
+		Term right;
+		if(parse_product(symbols, text, &right) != 0){
+			return -1;
+		}
+
+		// Only one label may appear, though it may cancel itself out
+		if(term->count != 0 && right.count != 0 && (term->length != right.length || strncmp(term->label, right.label, term->length) != 0)){
+			return -1;
+		}
+		if(term->count == 0){
+			term->label = right.label;
+			term->length = right.length;
+		}
+
+		term->value = operator == '+' ? term->value + right.value : term->value - right.value;
+		term->count = operator == '+' ? term->count + right.count : term->count - right.count;
+	}
+}
+
+int evaluate_expression(HashMap* symbols, const char* text, Expression* result){
+	Term term;
+	if(parse_sum(symbols, &text, &term) != 0){
+		return -1;
+	}
+
+	// The whole text must be used, and a label can only be added once
+	skip_spaces(&text);
+	if(*text != '\0' || term.count < 0 || term.count > 1){
+		return -1;
+	}
+
+	result->value = (int64_t) term.value;
+	result->label[0] = '\0';
+	if(term.count == 1){
+		memcpy(result->label, term.label, term.length);
+		result->label[term.length] = '\0';
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Checks whether an operand is already in a form the encoder reads.
+ *
+ * @param operand the trimmed operand
+ * @return true if the operand is a register, a label, or a signed decimal number
+ */
+static bool is_plain_operand(const char* operand){
+	if(operand[0] == ':'){
+		return strpbrk(operand, " \t") == NULL;
+	}
+	if(operand[0] == 'r' && is_valid_register(operand + 1)){
+		return true;
+	}
+
+	return is_uint64(operand[0] == '-' ? operand + 1 : operand);
+}
+
+/**
+ * @brief Checks whether an operand names a register, virtual register, or vector register.
+ *
+ * @param operand the trimmed operand
+ * @return true for rN, vN, and xN, bare or in parentheses, false otherwise
+ */
+static bool is_register_operand(const char* operand){
+	char name[256], extra[2];
+	if(operand[0] == '(' && sscanf(operand, "( %255[^) ] ) %1s", name, extra) == 1){
+		operand = name;
+	}
+
+	return (operand[0] == 'r' || operand[0] == 'v' || operand[0] == 'x') && is_uint64(operand + 1);
+}
+
+/**
+ * @brief Replaces an expression with the text the encoder reads.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param text the expression, replaced in place
+ * @param size size of the text buffer
+ * @param allowLabel whether the expression may be relative to a label
+ * @return 1 if the text changed, 0 if it is plain, -1 if it does not evaluate or names a label where none is allowed
+ */
+static int fold_expression(HashMap* symbols, char* text, uint64_t size, bool allowLabel){
+	Expression expression;
+	if(is_plain_operand(text)){
+		return 0;
+	}
+	if(evaluate_expression(symbols, text, &expression) != 0 || (expression.label[0] != '\0' && !allowLabel)){
+		return -1;
+	}
+
+	if(expression.label[0] == '\0'){
+		snprintf(text, size, "%ld", expression.value);
+	}
+	else if(expression.value == 0){
+		snprintf(text, size, "%s", expression.label);
+	}
+	else{
+		// Print the offset's magnitude so INT64_MIN cannot overflow
+		uint64_t magnitude = expression.value < 0 ? 0 - (uint64_t) expression.value : (uint64_t) expression.value;
+		snprintf(text, size, "%s%c%lu", expression.label, expression.value < 0 ? '-' : '+', magnitude);
+	}
+
+	return 1;
+}
+
+/**
+ * @brief Folds a data word or the operands of an instruction line.
+ *
+ * @param symbols pointer to the symbol hash map, or NULL if no symbol is defined
+ * @param ihm pointer to the instruction hash map
+ * @param line the tabbed line, rewritten in place if anything changes
+ * @param invalid set to the operand that does not evaluate, if any
+ * @return 1 if the line was rewritten, 0 if it is left as written, -1 if an operand does not evaluate
+ */
+static int expand_tabbed_line(HashMap* symbols, HashMap* ihm, char* line, char invalid[256]){
+	// Without symbols, only lines with operators or parentheses can fold
+	if(symbols == NULL && strpbrk(line, "+-*/()") == NULL){
+		return 0;
+	}
+
+	char* start = line + 1;
+	while(isspace((unsigned char) *start)){
+		start++;
+	}
+	char* end = start;
+	while(*end != '\0' && !isspace((unsigned char) *end)){
+		end++;
+	}
+
+	// Lines that do not start with an instruction are data words, stored as unsigned 64-bit values
+	char mnemonic[10];
+	uint64_t length = end - start;
+	memcpy(mnemonic, start, length < sizeof(mnemonic) ? length : 0);
+	mnemonic[length < sizeof(mnemonic) ? length : 0] = '\0';
+	if(hashmap_get(ihm, mnemonic) == NULL){
+		char word[256];
+		strcpy(word, start);
+		trim(word);
+
+		Expression expression;
+		if(is_plain_operand(word)){
+			return 0;
+		}
+		if(evaluate_expression(symbols, word, &expression) == 0 && expression.label[0] == '\0'){
+			snprintf(line, 256, "\t%lu\n", (uint64_t) expression.value);
+			return 1;
+		}
+
+		// Words without operators may be mistyped instructions, which the encoder names
+		if(strpbrk(word, "+-*/()") != NULL){
+			strcpy(invalid, word);
+			return -1;
+		}
+		return 0;
+	}
+
+	// Split the operands at commas outside parentheses
+	char operands[MAX_OPERANDS][256];
+	int count = 0, depth = 0;
+	length = 0;
+	for(const char* c = end; ; c++){
+		if(*c == '\0' || (*c == ',' && depth == 0)){
+			if(count == MAX_OPERANDS){
+				return 0;
+			}
+
+			operands[count][length] = '\0';
+			trim(operands[count++]);
+			length = 0;
+
+			if(*c == '\0'){
+				break;
+			}
+			continue;
+		}
+
+		depth += *c == '(' ? 1 : *c == ')' ? -1 : 0;
+		operands[count][length++] = *c;
+	}
+
+	bool changed = false;
+	for(int i = 0; i < count && operands[0][0] != '\0'; i++){
+		char* operand = operands[i];
+		int status = 0;
+
+		// Memory operands only fold the offset in (rX)(offset), whose base may be a virtual register
+		char base[256], offset[256], folded[520];
+		if(sscanf(operand, "( %255[^) ] ) ( %255[^\n]", base, offset) == 2 && is_register_operand(base)){
+			if(strlen(offset) > 0 && offset[strlen(offset) - 1] == ')'){
+				offset[strlen(offset) - 1] = '\0';
+				trim(offset);
+
+				status = fold_expression(symbols, offset, sizeof(offset), true);
+				if(status > 0 && snprintf(folded, sizeof(folded), "(%s)(%s)", base, offset) < 256){
+					strcpy(operand, folded);
+					changed = true;
+				}
+			}
+		}
+		else{
+			status = fold_expression(symbols, operand, 256, true);
+			changed = status > 0 || changed;
+
+			// Registers of every kind are left for the encoder and the register allocator
+			if(status < 0 && is_register_operand(operand)){
+				status = 0;
+			}
+		}
+
+		if(status < 0){
+			strcpy(invalid, operand);
+			return -1;
+		}
+	}
+
+	// Leave lines with nothing to fold exactly as written
+	if(!changed || count == 0 || operands[0][0] == '\0'){
+		return 0;
+	}
+
+	int written = snprintf(line, 256, "\t%s", mnemonic);
+	for(int i = 0; i < count && written < 256; i++){
+		written += snprintf(line + written, 256 - written, "%s%s", i == 0 ? " " : ", ", operands[i]);
+	}
+	if(written < 255){
+		strcat(line, "\n");
+	}
+	return 1;
+}
+
+/**
+ * @brief Defines the symbol of a .equ line.
+ *
+ * @param symbols pointer to the symbol hash map
+ * @param ihm pointer to the instruction hash map
+ * @param line the .equ line
+ * @return 0 if successful, -1 otherwise
+ */
+static int define_symbol(HashMap* symbols, HashMap* ihm, const char* line){
+	char name[256], value[256];
+	if(sscanf(line, ".equ %255[^, \t] , %255[^\n]", name, value) != 2){
+		fprintf(stderr, "Error: invalid .equ format\n");
+		return -1;
+	}
+
+	// Symbols are identifiers that cannot be mistaken for registers or instructions
+	bool valid = isalpha((unsigned char) name[0]) || name[0] == '_';
+	for(const char* c = name; *c != '\0'; c++){
+		valid = valid && (isalnum((unsigned char) *c) || *c == '_');
+	}
+	if(!valid || (name[0] == 'r' && is_uint64(name + 1)) || hashmap_get(ihm, name) != NULL){
+		fprintf(stderr, "Error: invalid .equ symbol %s\n", name);
+		return -1;
+	}
+	if(hashmap_get(symbols, name) != NULL){
+		fprintf(stderr, "Error: .equ symbol %s is already defined\n", name);
+		return -1;
+	}
+
+	Expression expression;
+	if(evaluate_expression(symbols, value, &expression) != 0 || expression.label[0] != '\0'){
+		fprintf(stderr, "Error: .equ symbol %s must have a constant value\n", name);
+		return -1;
+	}
+
+	char* key = strdup(name);
+	hashmap_insert(symbols, key, create_label(key, (uint64_t) expression.value));
+	return 0;
+}
+
+Source* expand_source(Source* source){
+	HashMap* symbols = create_hashmap();
+	HashMap* ihm = create_instr_hashmap();
+	char line[256];
+
+	bool defined = false;
+
+	// Define every symbol first so code may use symbols defined further down
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		if(strncmp(line, ".equ", 4) == 0 && isspace((unsigned char) line[4])){
+			if(define_symbol(symbols, ihm, line) != 0){
+				destroy_hashmap(symbols, destroy_label);
+				destroy_hashmap(ihm, destroy_instruction);
+				return NULL;
+			}
+			defined = true;
+		}
+	}
+
+	// Unchanged lines are copied in runs straight from the original text
+	ObjectBuffer* text = create_object_buffer();
+	uint64_t pending = 0;
+	char invalid[256] = "";
+	for(uint64_t i = 0; i < source->count && invalid[0] == '\0'; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		bool changed = false;
+		bool dropped = strncmp(line, ".equ", 4) == 0 && isspace((unsigned char) line[4]);
+		if(dropped){
+			changed = true;
+		}
+		else if(line[0] == '\t'){
+			int status = expand_tabbed_line(defined ? symbols : NULL, ihm, line, invalid);
+			changed = status > 0;
+			if(status < 0){
+				fprintf(stderr, "Error: cannot evaluate %s at line %lu\n", invalid, i + 1);
+			}
+		}
+		else if(line[0] == '.'){
+			// Fold the operand of a reservation, keeping any comment after it
+			char directive[10], operand[256], comment[256] = "";
+			if(sscanf(line, ".%9s %255[^;\n]%255[^\n]", directive, operand, comment) >= 2 && process_directive(line) != 'C' && process_directive(line) != 'D'){
+				trim(operand);
+				char folded[530];
+				int status = fold_expression(symbols, operand, sizeof(operand), false);
+
+				// Only reservations take expressions; other directives are checked where they are read
+				bool reserves = strcmp(directive, "space") == 0 || strcmp(directive, "zero") == 0 || strcmp(directive, "align") == 0;
+				if(status < 0 && reserves){
+					strcpy(invalid, operand);
+					fprintf(stderr, "Error: cannot evaluate %s at line %lu\n", invalid, i + 1);
+				}
+				if(status > 0
+					&& snprintf(folded, sizeof(folded), ".%s %s%s%s\n", directive, operand, comment[0] != '\0' ? " " : "", comment) < 256){
+					strcpy(line, folded);
+					changed = true;
+				}
+			}
+		}
+
+		if(changed){
+			buffer_write(text, source->text + pending, source->lineStarts[i] - pending);
+			// Dropped lines stay blank so later lines keep their numbers
+			buffer_write(text, dropped ? "\n" : line, dropped ? 1 : strlen(line));
+			pending = source->lineStarts[i + 1];
+		}
+	}
+	buffer_write(text, source->text + pending, source->size - pending);
+
+	Source* expanded = invalid[0] == '\0' ? create_source((char*) text->data, text->position) : NULL;
+	destroy_object_buffer(text);
+	destroy_hashmap(symbols, destroy_label);
+	destroy_hashmap(ihm, destroy_instruction);
+	return expanded;
+}
\ No newline at end of file
@@ -4,8 +4,31 @@
 #include <ctype.h>
 
 #include "assembler/instruction.h"
+#include "assembler/buffer.h"
 #include "assembler/label.h"
 #include "assembler/utils.h"
+#include "assembler/reserve.h"
+#include "common/vector.h"
+
+/// @brief A vector mnemonic, the operation it encodes, and its operand kinds: x vector register, r register, m (register)
+typedef struct VectorInstruction {
+	const char* name;
+	VectorOp op;
+	const char* operands;
+} VectorInstruction;
+
+static const VectorInstruction VECTOR_INSTRUCTIONS[] = {
+	{"vld", VECTOR_LOAD, "xm"},
+	{"vst", VECTOR_STORE, "mx"},
+	{"vadd", VECTOR_ADD, "xxx"},
+	{"vmul", VECTOR_MUL, "xxx"},
+	{"vaddf", VECTOR_ADDF, "xxx"},
+	{"vmulf", VECTOR_MULF, "xxx"},
+	{"vsum", VECTOR_SUM, "rx"},
+	{"vsumf", VECTOR_SUMF, "rx"},
+	{"vbcast", VECTOR_BROADCAST, "xr"},
+	{NULL, 0, NULL}
+};
 
 Instruction* create_instruction(char* name, uint8_t opcode, InstrFormat format){
 	Instruction* instruction = (Instruction*) malloc(sizeof(Instruction));
@@ -33,7 +56,7 @@ void destroy_instruction(void* ptr){
 	free(instruction);
 }
 
-int process_instruction(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
+int process_instruction_line(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line, uint64_t address){
 	// Continue if the tabbed line is data
 	if(is_data(line)){
 		return 0;
@@ -65,9 +88,11 @@ int process_instruction(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 		case FORMAT_RRRL:
 			return process_RRRL_instr(out, lhm, ihm, line);
 		case FORMAT_BRR:
-			return process_BRR_instr(out, lhm, ihm, line);
+			return process_BRR_instr(out, lhm, ihm, line, address);
 		case FORMAT_MOV:
 			return process_MOV_instr(out, lhm, ihm, line);
+		case FORMAT_VECTOR:
+			return process_VECTOR_instr(out, line);
 		case FORMAT_NONE:
 			return process_NONE_instr(out, line);
 		default:
@@ -76,7 +101,7 @@ int process_instruction(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 	}
 }
 
-int process_RRR_instr(FILE* out, HashMap* ihm, char* line){
+int process_RRR_instr(ObjectBuffer* out, HashMap* ihm, char* line){
 	char instrType[10], rd[256], rs[256], rt[256], extra[256];
 
 	// Check 3 register instruction format
@@ -91,14 +116,14 @@ int process_RRR_instr(FILE* out, HashMap* ihm, char* line){
 		uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10), t = strtoul(rt, NULL, 10);
 		uint32_t instr = encode_instruction(opcode, d, s, t, 0);
 		
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
 	return -1;
 }
 
-int process_RR_instr(FILE* out, HashMap* ihm, char* line){
+int process_RR_instr(ObjectBuffer* out, HashMap* ihm, char* line){
 	char instrType[10], rd[256], rs[256], extra[256];
 
 	// Check 2 register instruction format
@@ -112,19 +137,19 @@ int process_RR_instr(FILE* out, HashMap* ihm, char* line){
 		if(strcmp(instrType, "in") == 0){
 			uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
 			uint32_t instr = encode_instruction(0xf, d, s, 0, 0x3);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		else if(strcmp(instrType, "out") == 0){
 			uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
 			uint32_t instr = encode_instruction(0xf, d, s, 0, 0x4);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		else{
 			// Encode instruction into 32-bit integer
 			uint8_t opcode = ((Instruction*) hashmap_get(ihm, instrType))->opcode;
 			uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
 			uint32_t instr = encode_instruction(opcode, d, s, 0, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		
 		return 0;
@@ -133,7 +158,7 @@ int process_RR_instr(FILE* out, HashMap* ihm, char* line){
 	return -1;
 };
 
-int process_R_instr(FILE* out, HashMap* ihm, char* line){
+int process_R_instr(ObjectBuffer* out, HashMap* ihm, char* line){
 	char instrType[10], rd[256], extra[256];
 
 	// Check 1 register instruction format
@@ -147,28 +172,28 @@ int process_R_instr(FILE* out, HashMap* ihm, char* line){
 		if(strcmp(instrType, "clr") == 0){
 			uint8_t d = strtoul(rd, NULL, 10);
 			uint32_t instr = encode_instruction(0x2, d, d, d, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		else if(strcmp(instrType, "push") == 0){
 			uint8_t d = strtoul(rd, NULL, 10);
 			uint32_t mov = encode_instruction(0x13, 31, d, 0, -8);
 			uint32_t subi = encode_instruction(0x1b, 31, 0, 0, 8);
-			fwrite(&mov, sizeof(uint32_t), 1, out);
-			fwrite(&subi, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, mov);
+			buffer_write_instruction(out, subi);
 		}
 		else if(strcmp(instrType, "pop") == 0){
 			uint8_t d = strtoul(rd, NULL, 10);
 			uint32_t mov = encode_instruction(0x10, d, 31, 0, 0);
 			uint32_t addi = encode_instruction(0x19, 31, 0, 0, 8);
-			fwrite(&mov, sizeof(uint32_t), 1, out);
-			fwrite(&addi, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, mov);
+			buffer_write_instruction(out, addi);
 		}
 		else{
 			// Encode instruction into 32-bit integer
 			uint8_t opcode = ((Instruction*) hashmap_get(ihm, instrType))->opcode;
 			uint8_t d = strtoul(rd, NULL, 10);
 			uint32_t instr = encode_instruction(opcode, d, 0, 0, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		
 		return 0;
@@ -177,7 +202,7 @@ int process_R_instr(FILE* out, HashMap* ihm, char* line){
 	return -1;
 }
 
-int process_RL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
+int process_RL_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line){
 	char instrType[10], rd[256], L[256], extra[256];
 
 	// Check register and literal instruction format
@@ -194,49 +219,25 @@ int process_RL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 			uint64_t val;
 			// Make sure label is valid
 			if(L[0] == ':'){
-				if(hashmap_get(lhm, L) == NULL){
+				if(!resolve_label(lhm, L, &val)){
 					fprintf(stderr, "Error: invalid ld label\n");
 					return -1;
 				}
-
-				val = ((Label*) hashmap_get(lhm, L))->address;
 			}
 			else{
 				val = strtoull(L, NULL, 10);
 			}
 			
-			uint32_t instr = encode_instruction(0x2, d, d, d, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, (val >> 52));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x7, d, 0, 0, 12);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, ((val >> 40) & 0xFFF));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x7, d, 0, 0, 12);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, ((val >> 28) & 0xFFF));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x7, d, 0, 0, 12);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, ((val >> 16) & 0xFFF));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x7, d, 0, 0, 12);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, ((val >> 4) & 0xFFF));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x7, d, 0, 0, 4);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
-			instr = encode_instruction(0x19, d, 0, 0, (val & 0xF));
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			// Label addresses are sized by width so the layout passes converge
+			load_constant(out, d, val, L[0] == ':');
 		}
 		else{
 			// Encode instruction into 32-bit integer
 			uint8_t opcode = ((Instruction*) hashmap_get(ihm, instrType))->opcode;
 			uint8_t d = strtoul(rd, NULL, 10);
-			int16_t val = strtoul(L, NULL, 10);
+			int16_t val = literal_value(lhm, L);
 			uint32_t instr = encode_instruction(opcode, d, 0, 0, val);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 		}
 		return 0;
 	}
@@ -244,7 +245,7 @@ int process_RL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 	return -1;
 }
 
-int process_RRRL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
+int process_RRRL_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line){
 	char instrType[10], rd[256], rs[256], rt[256], L[256];
 
 	// Check 3 register and literal instruction format
@@ -257,16 +258,16 @@ int process_RRRL_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 		// Encode instruction into 32-bit integer
 		uint8_t opcode = ((Instruction*) hashmap_get(ihm, instrType))->opcode;
 		uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10), t = strtoul(rt, NULL, 10);
-		int16_t val = strtoul(L, NULL, 10);
+		int16_t val = literal_value(lhm, L);
 		uint32_t instr = encode_instruction(opcode, d, s, t, val);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
 	return -1;
 };
 
-int process_BRR_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
+int process_BRR_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line, uint64_t address){
 	char instrType[10], rd[256], L[256], extra[256];
 
 	// Check brr register instruction format
@@ -279,7 +280,7 @@ int process_BRR_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 		// Encode instruction into 32-bit integer
 		uint8_t d = strtoul(rd, NULL, 10);
 		uint32_t instr = encode_instruction(0x9, d, 0, 0, 0);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
@@ -290,22 +291,49 @@ int process_BRR_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 			return -1;
 		}
 
+		// Branch to labels relative to this instruction, taking the long form when out of range
+		if(L[0] == ':'){
+			uint64_t target;
+			resolve_label(lhm, L, &target);
+			int64_t offset = (int64_t) (target - address);
+
+			if(offset >= -2048 && offset <= 2047){
+				buffer_write_instruction(out, encode_instruction(0xa, 0, 0, 0, offset));
+			}
+			else{
+				// Save r0 below the stack, leave the target where return reads it, and restore r0
+				buffer_write_instruction(out, encode_instruction(0x13, 31, 0, 0, -16));
+				buffer_write_instruction(out, encode_instruction(0x1e, 0, 0, 0, 0));
+				buffer_write(out, &target, sizeof(uint64_t));
+				buffer_write_instruction(out, encode_instruction(0x13, 31, 0, 0, -8));
+				buffer_write_instruction(out, encode_instruction(0x10, 0, 31, 0, -16));
+				buffer_write_instruction(out, encode_instruction(0xd, 0, 0, 0, 0));
+			}
+			return 0;
+		}
+
 		// Encode instruction into 32-bit integer
-		int16_t val = strtoul(L, NULL, 10);
+		int16_t val = literal_value(lhm, L);
 		uint32_t instr = encode_instruction(0xa, 0, 0, 0, val);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
 	return -1;
 }
 
-int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
+bool is_relative_branch(const char* line){
+	char instrType[10], L[256];
+
+	// Only brr to a label depends on where the instruction is placed
+	return sscanf(line, "\t %9[^ ,] %255[^ ,\n]", instrType, L) == 2 && strcmp(instrType, "brr") == 0 && L[0] == ':';
+}
+
+int process_MOV_instr(ObjectBuffer* out, HashMap* lhm, HashMap* ihm, char* line){
 	char instrType[10], rd[256], rs[256], L[256], extra[256];
 
 	// Check mov memory to register instruction format
 	if(sscanf(line, "\t %9[^ ,] r%255[^ ,] , ( r%255[^ )] ) ( %255[^ )] )%255[^ \n]", instrType, rd, rs, L, extra)	== 4){
-		printf("here");
 		if(!is_valid_register(rd) || !is_valid_register(rs) || !is_valid_literal(lhm, "movmem", L)){
 			fprintf(stderr, "Error: invalid mov registers %s, %s or literal %s\n", rd, rs, L);
 			return -1;
@@ -313,9 +341,9 @@ int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 
 		// Encode instruction into 32-bit integer
 		uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
-		int16_t val = strtoul(L, NULL, 10);
+		int16_t val = literal_value(lhm, L);
 		uint32_t instr = encode_instruction(0x10, d, s, 0, val);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
@@ -328,9 +356,9 @@ int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 
 		// Encode instruction into 32-bit integer
 		uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
-		int16_t val = strtoul(L, NULL, 10);
+		int16_t val = literal_value(lhm, L);
 		uint32_t instr = encode_instruction(0x13, d, s, 0, val);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
@@ -344,7 +372,7 @@ int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 		// Encode instruction into 32-bit integer
 		uint8_t d = strtoul(rd, NULL, 10), s = strtoul(rs, NULL, 10);
 		uint32_t instr = encode_instruction(0x11, d, s, 0, 0);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
@@ -357,30 +385,96 @@ int process_MOV_instr(FILE* out, HashMap* lhm, HashMap* ihm, char* line){
 
 		// Encode instruction into 32-bit integer
 		uint8_t d = strtoul(rd, NULL, 10);
-		int16_t val = strtoul(L, NULL, 10);
+		int16_t val = literal_value(lhm, L);
 		uint32_t instr = encode_instruction(0x12, d, 0, 0, val);
-		fwrite(&instr, sizeof(uint32_t), 1, out);
+		buffer_write_instruction(out, instr);
 		return 0;
 	}
 
 	return -1;
 }
 
-int process_NONE_instr(FILE* out, char* line){
+/**
+ * @brief Parses one operand of a vector instruction.
+ * 
+ * @param operand the trimmed operand
+ * @param kind 'x' for a vector register, 'r' for a register, or 'm' for a (register) address
+ * @param reg set to the register number
+ * @return true if the operand is of the kind, false otherwise
+ */
+static bool parse_vector_operand(const char* operand, char kind, uint8_t* reg){
+	char number[256], extra[2];
+
+	if(kind == 'm'){
+		if(sscanf(operand, "( r%255[^ )] ) %1s", number, extra) != 1){
+			return false;
+		}
+	}
+	else if(operand[0] != kind || sscanf(operand + 1, "%255s", number) != 1){
+		return false;
+	}
+
+	if(!is_valid_register(number) || (kind == 'x' && strtoul(number, NULL, 10) >= NUM_VREGS)){
+		return false;
+	}
+
+	*reg = strtoul(number, NULL, 10);
+	return true;
+}
+
+int process_VECTOR_instr(ObjectBuffer* out, char* line){
+	char instrType[10], operands[256];
+	if(sscanf(line, "\t %9s %255[^\n]", instrType, operands) != 2){
+		return -1;
+	}
+
+	const VectorInstruction* vector = VECTOR_INSTRUCTIONS;
+	while(vector->name != NULL && strcmp(vector->name, instrType) != 0){
+		vector++;
+	}
+	if(vector->name == NULL){
+		return -1;
+	}
+
+	// Operands fill rd, rs, and rt in order; lines may be encoded on several threads at once
+	uint8_t regs[3] = {0, 0, 0};
+	uint64_t count = strlen(vector->operands);
+	char* save;
+	char* operand = strtok_r(operands, ",", &save);
+	for(uint64_t i = 0; i < count; i++, operand = strtok_r(NULL, ",", &save)){
+		if(operand == NULL){
+			return -1;
+		}
+
+		trim(operand);
+		if(!parse_vector_operand(operand, vector->operands[i], &regs[i])){
+			fprintf(stderr, "Error: invalid %s operand %s\n", instrType, operand);
+			return -1;
+		}
+	}
+	if(operand != NULL){
+		return -1;
+	}
+
+	buffer_write_instruction(out, encode_instruction(VECTOR_OPCODE, regs[0], regs[1], regs[2], vector->op));
+	return 0;
+}
+
+int process_NONE_instr(ObjectBuffer* out, char* line){
 	char instrType[10], extra[10];
 
 	// Check no operand instruction formats
 	if(sscanf(line, "\t %9[^ ,\n]  %9[^ ,\n]", instrType, extra) == 1){
 		if(strcmp(instrType, "return") == 0){
 			uint32_t instr = encode_instruction(0xd, 0, 0, 0, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 			return 0;
 		}
 		
 		// Check if instruction is a macro
 		if(strcmp(instrType, "halt") == 0){
 			uint32_t instr = encode_instruction(0xf, 0, 0, 0, 0);
-			fwrite(&instr, sizeof(uint32_t), 1, out);
+			buffer_write_instruction(out, instr);
 			return 0;
 		}
 	}
@@ -390,6 +484,7 @@ int process_NONE_instr(FILE* out, char* line){
 
 char process_directive(char* line){
 	char directive[10];
+	uint64_t size;
 	
 	// Extract the directive type
 	if(sscanf(line, ".%9s", directive) != 1){
@@ -403,6 +498,10 @@ char process_directive(char* line){
 	else if(strcmp(directive, "data") == 0){
 		return 'D';
 	}
+	// Reservations stay in the current section
+	else if(reservation_size(line, INIT_DATA_ADDR, &size) == 0){
+		return 'R';
+	}
 	else{
 		return 'N';
 	}
@@ -412,7 +511,75 @@ uint32_t encode_instruction(uint8_t opcode, uint8_t rd, uint8_t rs, uint8_t rt,
 	return ((opcode & 0x1F) << 27) | ((rd & 0x1F) << 22) | ((rs & 0x1F) << 17) | ((rt & 0x1F) << 12) | (L & 0xFFF);
 }
 
-int8_t change_in_address(char* line){
+/**
+ * @brief Writes an instruction unless only the length of a sequence is being measured.
+ * 
+ * @param out pointer to the object buffer, or NULL
+ * @param instr the encoded instruction
+ */
+static void emit_instruction(ObjectBuffer* out, uint32_t instr){
+	if(out != NULL){
+		buffer_write_instruction(out, instr);
+	}
+}
+
+uint8_t materialize_constant(ObjectBuffer* out, uint8_t rd, uint64_t value, bool byWidth){
+	// Clear the register, which is all a zero needs
+	emit_instruction(out, encode_instruction(0x2, rd, rd, rd, 0));
+	if(value == 0){
+		return 1;
+	}
+
+	// Add the value in 12-bit windows from the top, starting at the highest set bit
+	uint8_t top = 63 - __builtin_clzll(value);
+	uint8_t bottom = byWidth ? top / 12 * 12 : (top > 11 ? top - 11 : 0);
+	uint64_t rest = value & ((1ULL << bottom) - 1);
+	uint8_t count = 2;
+	emit_instruction(out, encode_instruction(0x19, rd, 0, 0, (value >> bottom) & 0xFFF));
+
+	// Shift past zero runs in one step, unless every window must be kept to fix the length
+	while(byWidth ? bottom > 0 : rest != 0){
+		uint8_t next = bottom - 12;
+		if(!byWidth){
+			top = 63 - __builtin_clzll(rest);
+			next = top > 11 ? top - 11 : 0;
+		}
+
+		emit_instruction(out, encode_instruction(0x7, rd, 0, 0, bottom - next));
+		emit_instruction(out, encode_instruction(0x19, rd, 0, 0, (rest >> next) & 0xFFF));
+		count += 2;
+
+		bottom = next;
+		rest &= (1ULL << bottom) - 1;
+	}
+
+	// Shift the last window into place
+	if(bottom > 0){
+		emit_instruction(out, encode_instruction(0x7, rd, 0, 0, bottom));
+		count++;
+	}
+
+	return count;
+}
+
+uint8_t load_constant(ObjectBuffer* out, uint8_t rd, uint64_t value, bool byWidth){
+	uint8_t count = materialize_constant(NULL, rd, value, byWidth);
+
+	// One or two instructions beat the wide form; from three on it is no larger and runs once
+	if(count <= 2){
+		materialize_constant(out, rd, value, byWidth);
+		return 4 * count;
+	}
+
+	// Otherwise load the value with one wide instruction followed by its payload
+	if(out != NULL){
+		buffer_write_instruction(out, encode_instruction(0x1e, rd, 0, 0, 0));
+		buffer_write(out, &value, sizeof(uint64_t));
+	}
+	return LD_MAX_SIZE;
+}
+
+int8_t change_in_address(HashMap* lhm, uint64_t address, char* line){
 	// Check if the line is data
 	if(is_data(line)){
 		return 8;
@@ -426,11 +593,31 @@ int8_t change_in_address(char* line){
 
 	// Determine the address change based on the instruction type
 	if(strcmp(instructionType, "ld") == 0){
-		return 48;
+		char rd[256], L[256];
+		if(sscanf(line, "\t %9[^ ,] r%255[^, ] , %255[^, \n]", instructionType, rd, L) != 3){
+			return LD_MAX_SIZE;
+		}
+
+		// Unresolved labels get the longest sequence until a layout pass places them
+		if(L[0] == ':'){
+			uint64_t address;
+			return !resolve_label(lhm, L, &address) ? LD_MAX_SIZE : load_constant(NULL, 0, address, true);
+		}
+
+		return load_constant(NULL, 0, strtoull(L, NULL, 10), false);
 	}
 	else if(strcmp(instructionType, "push") == 0 || strcmp(instructionType, "pop") == 0){
 		return 8;
 	}
+	else if(is_relative_branch(line)){
+		char L[256];
+		sscanf(line, "\t %9[^ ,] %255[^ ,\n]", instructionType, L);
+
+		// Branches to labels that are unplaced or out of brrL's range take the long form
+		uint64_t target;
+		int64_t offset = !resolve_label(lhm, L, &target) ? INT64_MAX : (int64_t) (target - address);
+		return offset >= -2048 && offset <= 2047 ? 4 : BRR_LONG_SIZE;
+	}
 	
 	return 4;
 }
@@ -472,5 +659,9 @@ HashMap* create_instr_hashmap(){
 	hashmap_insert(ihm, "pop", create_instruction("pop", 0x20, FORMAT_R));
 	hashmap_insert(ihm, "halt", create_instruction("halt", 0x20, FORMAT_NONE));
 
+	for(const VectorInstruction* vector = VECTOR_INSTRUCTIONS; vector->name != NULL; vector++){
+		hashmap_insert(ihm, (char*) vector->name, create_instruction((char*) vector->name, VECTOR_OPCODE, FORMAT_VECTOR));
+	}
+
 	return ihm;
 }
\ No newline at end of file
@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "assembler/assembler.h"
+#include "assembler/parallel.h"
+#include "assembler/instruction.h"
+#include "assembler/label.h"
+#include "assembler/utils.h"
+
+/**
+ * @brief Appends a label to the chunk's label list.
+ *
+ * @param chunk pointer to the chunk
+ * @param capacity pointer to the current capacity of the label list
+ * @param name the name of the label
+ */
+static void add_chunk_label(Chunk* chunk, uint64_t* capacity, char* name){
+	if(chunk->labelCount == *capacity){
+		*capacity = *capacity == 0 ? 16 : *capacity * 2;
+		chunk->labels = (ChunkLabel*) realloc(chunk->labels, sizeof(ChunkLabel) * (*capacity));
+
+		if (chunk->labels == NULL) {
+			// Print error message and exit if memory allocation fails
+			fprintf(stderr, "Error: failed to allocate memory for ChunkLabel\n");
+			exit(1);
+		}
+	}
+
+	chunk->labels[chunk->labelCount].name = name;
+	chunk->labels[chunk->labelCount].section = 'P';
+	chunk->labels[chunk->labelCount].offset = 0;
+	chunk->labelCount++;
+}
+
+void* scan_chunk(void* ptr){
+	Chunk* chunk = (Chunk*) ptr;
+	char line[256];
+	char section = 'I';
+	uint64_t labelCapacity = 0, pending = 0;
+
+	for(uint64_t i = chunk->firstLine; i < chunk->endLine; i++){
+		source_get_line(chunk->source, i, line, sizeof(line));
+
+		// Skip comments and empty lines
+		if(line[0] == ';' || is_empty(line)){
+			continue;
+		}
+		// Process directives
+		else if(line[0] == '.'){
+			char directive = process_directive(line);
+			if(directive == 'N'){
+				chunk->error = "Error: invalid directive format";
+				chunk->status = -1;
+				return NULL;
+			}
+			else if(directive != 'R'){
+				section = directive;
+				chunk->lastDirective = section;
+				chunk->hasCodeDirective = chunk->hasCodeDirective || section == 'C';
+				continue;
+			}
+
+			// Reservations only appear under .data, possibly inherited from an earlier chunk
+			uint64_t* size = section == 'D' ? &chunk->dataSize : &chunk->inheritedSize;
+
+			// Labels before .space or .zero name the reserved bytes; .align leaves them for what follows
+			if(strncmp(line, ".align", 6) != 0){
+				for(; pending < chunk->labelCount; pending++){
+					chunk->labels[pending].section = section;
+					chunk->labels[pending].offset = *size;
+				}
+
+				if(!chunk->hasInstruction){
+					chunk->hasInstruction = true;
+					chunk->firstSection = section;
+					chunk->firstOffset = *size;
+				}
+			}
+
+			*size += chunk->reserved->sizes[i];
+		}
+		// Process label lines
+		else if(line[0] == ':'){
+			trim(line);
+
+			if(!is_valid_label(line)){
+				chunk->error = "Error: invalid label format\n";
+				chunk->status = -1;
+				return NULL;
+			}
+
+			add_chunk_label(chunk, &labelCapacity, strdup(line));
+		}
+		// Process instruction lines
+		else if(line[0] == '\t'){
+			uint64_t* size = section == 'C' ? &chunk->codeSize
+				: section == 'D' ? &chunk->dataSize : &chunk->inheritedSize;
+
+			// Bind pending labels to this line; inherited ones are placed during the prefix sum
+			for(; pending < chunk->labelCount; pending++){
+				chunk->labels[pending].section = section;
+				chunk->labels[pending].offset = *size;
+			}
+
+			if(!chunk->hasInstruction){
+				chunk->hasInstruction = true;
+				chunk->firstSection = section;
+				chunk->firstOffset = *size;
+			}
+
+			// Calculate new address based on directive type, sized from the previous pass
+			int8_t change = change_in_address(chunk->sizing, chunk->previous != NULL ? chunk->previous[i] : 0, line);
+			chunk->labelSized = chunk->labelSized || strchr(line, ':') != NULL;
+			if(change == -1){
+				chunk->error = "Error: invalid instruction format\n";
+				chunk->status = -1;
+				return NULL;
+			}
+
+			// Keep the size until place_chunk turns it into an address
+			chunk->addresses[i] = change;
+			*size += change;
+			chunk->tabLines++;
+		}
+		// Handle invalid line format
+		else{
+			chunk->error = "Error: invalid line format\n";
+			chunk->status = -1;
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Resolves the address of a section offset within a chunk.
+ *
+ * @param chunk pointer to the chunk
+ * @param section the section the offset belongs to
+ * @param offset the offset within the section
+ * @param address pointer receiving the resolved address
+ * @return 0 if successful, non-zero if the section has no address
+ */
+static int chunk_address(Chunk* chunk, char section, uint64_t offset, uint64_t* address){
+	// Code and data emitted before the chunk's first directive come first in each segment
+	uint64_t inheritedCode = chunk->startDirective == 'C' ? chunk->inheritedSize : 0;
+	uint64_t inheritedData = chunk->startDirective == 'D' ? chunk->inheritedSize : 0;
+
+	if(section == 'I'){
+		section = chunk->startDirective;
+		inheritedCode = inheritedData = 0;
+	}
+
+	if(section == 'C'){
+		*address = chunk->codeAddress + inheritedCode + offset;
+		return 0;
+	}
+	else if(section == 'D'){
+		*address = chunk->dataAddress + inheritedData + offset;
+		return 0;
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Resolves chunk base addresses with a prefix sum and merges chunk labels.
+ *
+ * @param chunks array of scanned chunks
+ * @param numChunks number of chunks
+ * @param lhm pointer to the label hash map to populate
+ * @param tfh pointer to the tinker file header
+ * @param reserved pointer to the reserved data layout
+ * @return 0 if successful, non-zero otherwise
+ */
+static int resolve_chunks(Chunk* chunks, int numChunks, HashMap* lhm, TinkerFileHeader* tfh, const ReservedLayout* reserved){
+	char directive = 'N';
+	uint64_t codeAddress = INIT_CODE_ADDR, dataAddress = INIT_DATA_ADDR, lineNumber = 1;
+	uint64_t offset = sizeof(TinkerFileHeader) + reserved_table_size(reserved);
+
+	// Labels waiting for a tabbed line in a later chunk, in source order
+	ChunkLabel** pending = NULL;
+	uint64_t pendingCount = 0;
+
+	for(int c = 0; c < numChunks; c++){
+		Chunk* chunk = &chunks[c];
+		chunk->startDirective = directive;
+		chunk->codeAddress = codeAddress;
+		chunk->dataAddress = dataAddress;
+		chunk->firstLineNumber = lineNumber;
+
+		// Labels carried over from earlier chunks bind to this chunk's first tabbed line
+		if(chunk->hasInstruction && pendingCount > 0){
+			uint64_t address;
+			if(chunk_address(chunk, chunk->firstSection, chunk->firstOffset, &address) != 0){
+				fprintf(stderr, "Error: label outside of a .code or .data directive\n");
+				free(pending);
+				return -1;
+			}
+
+			for(uint64_t i = 0; i < pendingCount; i++){
+				hashmap_insert(lhm, pending[i]->name, create_label(pending[i]->name, address));
+				pending[i]->name = NULL;
+			}
+			pendingCount = 0;
+		}
+
+		for(uint64_t i = 0; i < chunk->labelCount; i++){
+			ChunkLabel* label = &chunk->labels[i];
+
+			if(label->section == 'P'){
+				pending = (ChunkLabel**) realloc(pending, sizeof(ChunkLabel*) * (pendingCount + 1));
+				if (pending == NULL) {
+					// Print error message and exit if memory allocation fails
+					fprintf(stderr, "Error: failed to allocate memory for pending labels\n");
+					exit(1);
+				}
+
+				pending[pendingCount++] = label;
+				continue;
+			}
+
+			uint64_t address;
+			if(chunk_address(chunk, label->section, label->offset, &address) != 0){
+				fprintf(stderr, "Error: label outside of a .code or .data directive\n");
+				free(pending);
+				return -1;
+			}
+
+			// The label name now belongs to the hash map
+			hashmap_insert(lhm, label->name, create_label(label->name, address));
+			label->name = NULL;
+		}
+
+		// Advance the running addresses past this chunk
+		if(directive == 'C'){
+			codeAddress += chunk->inheritedSize;
+		}
+		else if(directive == 'D'){
+			dataAddress += chunk->inheritedSize;
+		}
+		codeAddress += chunk->codeSize;
+		dataAddress += chunk->dataSize;
+		lineNumber += chunk->tabLines;
+
+		if(chunk->lastDirective != 'I'){
+			directive = chunk->lastDirective;
+		}
+	}
+
+	// Labels at the end of the program bind to the end of the current segment
+	for(uint64_t i = 0; i < pendingCount; i++){
+		if(directive != 'C' && directive != 'D'){
+			fprintf(stderr, "Error: label outside of a .code or .data directive\n");
+			free(pending);
+			return -1;
+		}
+
+		uint64_t address = directive == 'C' ? codeAddress : dataAddress;
+		hashmap_insert(lhm, pending[i]->name, create_label(pending[i]->name, address));
+		pending[i]->name = NULL;
+	}
+	free(pending);
+
+	tfh->codeSize = codeAddress - INIT_CODE_ADDR;
+	tfh->dataSize = dataAddress - INIT_DATA_ADDR - reserved->total;
+
+	// Place each chunk's code and data in its own region of the image, leaving out reserved bytes
+	for(int c = 0; c < numChunks; c++){
+		chunks[c].codeOffset = offset + (chunks[c].codeAddress - INIT_CODE_ADDR);
+		chunks[c].dataOffset = offset + tfh->codeSize + (chunks[c].dataAddress - INIT_DATA_ADDR) - reserved_below(reserved, chunks[c].dataAddress);
+	}
+
+	return 0;
+}
+
+void* place_chunk(void* ptr){
+	Chunk* chunk = (Chunk*) ptr;
+	char line[256];
+	char currentDirective = chunk->startDirective;
+	uint64_t codeAddress = chunk->codeAddress, dataAddress = chunk->dataAddress;
+
+	for(uint64_t i = chunk->firstLine; i < chunk->endLine; i++){
+		source_get_line(chunk->source, i, line, sizeof(line));
+
+		// Skip comments and empty lines
+		if(line[0] == ';' || is_empty(line)){
+			continue;
+		}
+		// Process directives
+		else if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+			dataAddress += directive == 'R' ? chunk->reserved->sizes[i] : 0;
+		}
+		// Replace each tabbed line's size with its address
+		else if(line[0] == '\t'){
+			uint64_t size = chunk->addresses[i];
+			chunk->addresses[i] = currentDirective == 'C' ? codeAddress : currentDirective == 'D' ? dataAddress : 0;
+
+			if(currentDirective == 'C'){
+				codeAddress += size;
+			}
+			else if(currentDirective == 'D'){
+				dataAddress += size;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+void* encode_chunk(void* ptr){
+	Chunk* chunk = (Chunk*) ptr;
+	char line[256];
+	char currentDirective = chunk->startDirective;
+	uint64_t currentLine = chunk->firstLineNumber;
+
+	// Encode into chunk-local buffers sized for the chunk so no thread reallocates the image
+	ObjectBuffer* code = create_object_buffer();
+	buffer_reserve(code, chunk->inheritedSize + chunk->codeSize);
+	uint64_t dataOffset = chunk->dataOffset;
+
+	for(uint64_t i = chunk->firstLine; i < chunk->endLine; i++){
+		source_get_line(chunk->source, i, line, sizeof(line));
+
+		// Skip labels, comments, and empty lines
+		if(line[0] == ':' || line[0] == ';' || is_empty(line)){
+			continue;
+		}
+		// Process directive lines; reserved bytes take no room in the image
+		else if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+		}
+		// Process data and instruction lines
+		else if(line[0] == '\t'){
+			if(is_data(line)){
+				if(currentDirective != 'D'){
+					fprintf(stderr, "Error: data must be under a .data directive\n");
+					chunk->status = -1;
+					break;
+				}
+
+				// Data regions are disjoint per chunk, so write straight into the image
+				trim(line);
+				uint64_t value = strtoull(line, NULL, 10);
+				memcpy(chunk->out->data + dataOffset, &value, sizeof(uint64_t));
+				dataOffset += sizeof(uint64_t);
+			}
+			else{
+				if(currentDirective != 'C'){
+					fprintf(stderr, "Error: instructions must be under a .code directive\n");
+					chunk->status = -1;
+					break;
+				}
+
+				if(process_instruction_line(code, chunk->lhm, chunk->ihm, line, chunk->codeAddress + code->position) != 0){
+					fprintf(stderr, "Error: failed to process instruction at line %lu\n", currentLine);
+					chunk->status = -1;
+					break;
+				}
+			}
+
+			currentLine++;
+		}
+	}
+
+	uint64_t expected = (chunk->startDirective == 'C' ? chunk->inheritedSize : 0) + chunk->codeSize;
+	if(chunk->status == 0 && code->position != expected){
+		fprintf(stderr, "Error: code segment size does not match label layout\n");
+		chunk->status = -1;
+	}
+
+	if(chunk->status == 0){
+		memcpy(chunk->out->data + chunk->codeOffset, code->data, code->position);
+	}
+
+	destroy_object_buffer(code);
+	return NULL;
+}
+
+/**
+ * @brief Clears the results of scanning a chunk so it can be scanned again.
+ *
+ * @param chunk pointer to the chunk
+ */
+static void reset_chunk(Chunk* chunk){
+	// Free label names that never reached the hash map
+	for(uint64_t i = 0; i < chunk->labelCount; i++){
+		free(chunk->labels[i].name);
+	}
+	free(chunk->labels);
+
+	chunk->labels = NULL;
+	chunk->labelCount = 0;
+	chunk->status = 0;
+	chunk->error = NULL;
+	chunk->lastDirective = 'I';
+	chunk->hasCodeDirective = false;
+	chunk->labelSized = false;
+	chunk->inheritedSize = 0;
+	chunk->codeSize = 0;
+	chunk->dataSize = 0;
+	chunk->hasInstruction = false;
+	chunk->firstSection = 0;
+	chunk->firstOffset = 0;
+	chunk->tabLines = 0;
+}
+
+/**
+ * @brief Runs a function over every chunk, one thread per chunk.
+ *
+ * @param chunks array of chunks
+ * @param numChunks number of chunks
+ * @param function the thread entry point
+ * @return 0 if every chunk succeeded, non-zero otherwise
+ */
+static int run_chunks(Chunk* chunks, int numChunks, void* (*function)(void*)){
+	pthread_t* threads = (pthread_t*) malloc(sizeof(pthread_t) * numChunks);
+
+	if (threads == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for threads\n");
+		exit(1);
+	}
+
+	for(int c = 0; c < numChunks; c++){
+		if(pthread_create(&threads[c], NULL, function, &chunks[c]) != 0){
+			// Fall back to running the chunk on this thread
+			function(&chunks[c]);
+			threads[c] = pthread_self();
+		}
+	}
+
+	int status = 0;
+	for(int c = 0; c < numChunks; c++){
+		if(!pthread_equal(threads[c], pthread_self())){
+			pthread_join(threads[c], NULL);
+		}
+
+		status = chunks[c].status != 0 ? -1 : status;
+	}
+
+	free(threads);
+	return status;
+}
+
+int assemble_program_parallel(Source* source, ObjectBuffer* out, HashMap* ihm, int numThreads){
+	HashMap* lhm = create_hashmap();
+	TinkerFileHeader* tfh = create_tinker_file_header();
+
+	// Reservations depend on data alone, so they are placed before the source is split
+	ReservedLayout* reserved = NULL;
+	if(layout_reserved(source, &reserved) != 0){
+		fprintf(stderr, "Error: failed to populate LabelHashMap\n");
+		destroy_hashmap(lhm, destroy_label);
+		free(tfh);
+		return -1;
+	}
+
+	// Split the source into line-aligned chunks, one per thread
+	int numChunks = source->count < (uint64_t) numThreads ? (int) source->count : numThreads;
+	numChunks = numChunks < 1 ? 1 : numChunks;
+	Chunk* chunks = (Chunk*) calloc(numChunks, sizeof(Chunk));
+
+	if (chunks == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Chunk\n");
+		exit(1);
+	}
+
+	for(int c = 0; c < numChunks; c++){
+		chunks[c].source = source;
+		chunks[c].lhm = lhm;
+		chunks[c].ihm = ihm;
+		chunks[c].out = out;
+		chunks[c].reserved = reserved;
+		chunks[c].firstLine = source->count * c / numChunks;
+		chunks[c].endLine = source->count * (c + 1) / numChunks;
+	}
+
+	// Repeat the layout until no line moves, sizing each pass from the last pass's addresses
+	HashMap* sizing = NULL;
+	uint64_t* previous = NULL;
+	uint64_t* addresses = (uint64_t*) calloc(source->count + 1, sizeof(uint64_t));
+	TinkerFileHeader last = *tfh;
+	int status = 0;
+
+	if (addresses == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for line addresses\n");
+		exit(1);
+	}
+
+	while(true){
+		for(int c = 0; c < numChunks; c++){
+			reset_chunk(&chunks[c]);
+			chunks[c].sizing = sizing;
+			chunks[c].previous = previous;
+			chunks[c].addresses = addresses;
+		}
+
+		status = run_chunks(chunks, numChunks, scan_chunk);
+
+		// Report the first scanning error in source order, as the sequential pass would
+		for(int c = 0; c < numChunks && status != 0; c++){
+			if(chunks[c].status != 0){
+				fprintf(stderr, "%s", chunks[c].error);
+				break;
+			}
+		}
+
+		HashMap* current = create_hashmap();
+		if(status == 0){
+			status = resolve_chunks(chunks, numChunks, current, tfh, reserved);
+		}
+
+		bool labelSized = false;
+		for(int c = 0; c < numChunks; c++){
+			labelSized = labelSized || chunks[c].labelSized;
+		}
+
+		bool stable = status != 0 || !labelSized;
+		if(!stable){
+			run_chunks(chunks, numChunks, place_chunk);
+			stable = previous != NULL && tfh->codeSize == last.codeSize && tfh->dataSize == last.dataSize
+				&& memcmp(previous, addresses, sizeof(uint64_t) * source->count) == 0;
+		}
+
+		destroy_hashmap(sizing, destroy_label);
+		sizing = current;
+		last = *tfh;
+
+		if(stable){
+			break;
+		}
+
+		// The addresses of this pass size the next one
+		if(previous == NULL){
+			previous = (uint64_t*) calloc(source->count + 1, sizeof(uint64_t));
+			if (previous == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for line addresses\n");
+				exit(1);
+			}
+		}
+
+		uint64_t* swap = previous;
+		previous = addresses;
+		addresses = swap;
+	}
+
+	free(previous);
+	free(addresses);
+
+	// Encode against the final labels
+	HashMap swap = *lhm;
+	*lhm = *sizing;
+	*sizing = swap;
+	destroy_hashmap(sizing, destroy_label);
+
+	if(status != 0){
+		fprintf(stderr, "Error: failed to populate LabelHashMap\n");
+	}
+	else{
+		// Size the image once so every chunk writes into its own disjoint region
+		uint64_t size = sizeof(TinkerFileHeader) + reserved_table_size(reserved) + tfh->codeSize + tfh->dataSize;
+		buffer_reserve(out, size);
+		out->size = out->position = size;
+
+		bool hasCodeDirective = false;
+		for(int c = 0; c < numChunks; c++){
+			hasCodeDirective = hasCodeDirective || chunks[c].hasCodeDirective;
+		}
+
+		status = run_chunks(chunks, numChunks, encode_chunk);
+
+		// Ensure there is at least one .code directive
+		if(status == 0 && !hasCodeDirective){
+			fprintf(stderr, "Error: the program must have at least one .code directive\n");
+			status = -1;
+		}
+
+		if(status != 0){
+			fprintf(stderr, "Error: failed to create object file\n");
+		}
+		else{
+			// Write the file header last, now that the segment sizes are final
+			write_reserved_table(out, reserved, tfh);
+			buffer_write_at(out, 0, tfh, sizeof(TinkerFileHeader));
+		}
+	}
+
+	for(int c = 0; c < numChunks; c++){
+		reset_chunk(&chunks[c]);
+	}
+
+	free(chunks);
+	destroy_hashmap(lhm, destroy_label);
+	destroy_reserved_layout(reserved);
+	free(tfh);
+	return status;
+}
\ No newline at end of file
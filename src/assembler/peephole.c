@@ -0,0 +1,342 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "assembler/peephole.h"
+#include "assembler/buffer.h"
+#include "assembler/instruction.h"
+#include "assembler/utils.h"
+
+#define MAX_OPERANDS 3
+
+/**
+ * @brief Kinds of instruction the pass can combine with the next one.
+ */
+typedef enum {
+	LAST_NONE,
+	LAST_ADD,
+	LAST_PUSH
+} LastKind;
+
+/**
+ * @brief Structure representing what the pass knows inside the current run of code.
+ */
+typedef struct PeepholeState {
+	char* constants[32]; /**< operand each register was last loaded with by ld, or NULL */
+	LastKind lastKind; /**< kind of the last instruction, if it can still be combined */
+	uint64_t lastIndex; /**< index of the last instruction in the output lines */
+	uint8_t lastRegister; /**< register of the last addi/subi or push */
+	int64_t lastDelta; /**< net amount added by the last addi/subi */
+} PeepholeState;
+
+/**
+ * @brief Parses a register operand.
+ *
+ * @param operand the operand
+ * @return the register number, or -1 if the operand is not a register
+ */
+static int parse_register(const char* operand){
+	if(operand[0] != 'r' || !is_valid_register(operand + 1)){
+		return -1;
+	}
+
+	return (int) strtoul(operand + 1, NULL, 10);
+}
+
+/**
+ * @brief Forgets every loaded constant and ends the current run of code.
+ *
+ * @param state pointer to the pass state
+ */
+static void reset_state(PeepholeState* state){
+	for(int i = 0; i < 32; i++){
+		free(state->constants[i]);
+		state->constants[i] = NULL;
+	}
+
+	state->lastKind = LAST_NONE;
+}
+
+/**
+ * @brief Forgets the constant held by a register.
+ *
+ * @param state pointer to the pass state
+ * @param reg the register, or -1 for none
+ */
+static void forget_register(PeepholeState* state, int reg){
+	if(reg >= 0){
+		free(state->constants[reg]);
+		state->constants[reg] = NULL;
+	}
+}
+
+/**
+ * @brief Checks whether a mnemonic transfers control.
+ *
+ * @param mnemonic the mnemonic
+ * @return true for branches, calls, returns, and halt
+ */
+static bool is_control(const char* mnemonic){
+	static const char* const control[] = {"br", "brr", "brnz", "brgt", "call", "return", "halt", NULL};
+
+	for(int i = 0; control[i] != NULL; i++){
+		if(strcmp(mnemonic, control[i]) == 0){
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * @brief Marks the code lines a brr with a literal offset may jump over or land on.
+ *
+ * Layout has not happened yet, so the target is only bounded: every
+ * instruction takes at least 4 bytes, so an offset of N bytes reaches at most
+ * N / 4 instruction lines away. Removing a line in that range would move the
+ * target, so those lines are left as written and split the runs around them.
+ * An offset that is not a plain number could reach anywhere.
+ *
+ * @param source pointer to the source program
+ * @param pinned set to true for every line that must be kept as written
+ */
+static void mark_relative_targets(Source* source, bool* pinned){
+	uint64_t* code = (uint64_t*) malloc(sizeof(uint64_t) * (source->count + 1));
+
+	if (code == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for relative branch targets\n");
+		exit(1);
+	}
+
+	// Collect the instruction lines of the code segment in order
+	char currentDirective = 'N';
+	char line[256];
+	uint64_t count = 0;
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+		}
+		else if(line[0] == '\t' && !is_empty(line) && currentDirective == 'C'){
+			code[count++] = i;
+		}
+	}
+
+	for(uint64_t c = 0; c < count; c++){
+		char mnemonic[10], operands[MAX_OPERANDS][256];
+		source_get_line(source, code[c], line, sizeof(line));
+		if(split_instruction(line, mnemonic, operands, MAX_OPERANDS) != 1 || strcmp(mnemonic, "brr") != 0
+			|| operands[0][0] == ':' || parse_register(operands[0]) >= 0){
+			continue;
+		}
+
+		char* end;
+		int64_t offset = strtoll(operands[0], &end, 0);
+		uint64_t reach = *end == '\0' ? (offset < 0 ? 0 - (uint64_t) offset : (uint64_t) offset) / 4 : count;
+		uint64_t first = offset < 0 || *end != '\0' ? (reach < c ? c - reach : 0) : c;
+		uint64_t last = offset >= 0 || *end != '\0' ? (reach < count - c ? c + reach : count - 1) : c;
+
+		for(uint64_t k = first; k <= last; k++){
+			pinned[code[k]] = true;
+		}
+	}
+
+	free(code);
+}
+
+/**
+ * @brief Formats an instruction line.
+ *
+ * @param format printf format of the line
+ * @param a first register or value
+ * @param b second register or value
+ * @return the newly allocated line
+ */
+static char* format_line(const char* format, int64_t a, int64_t b){
+	char line[64];
+	snprintf(line, sizeof(line), format, a, b);
+	return strdup(line);
+}
+
+/**
+ * @brief Optimizes one code line, returning whether it is kept as written.
+ *
+ * @param state pointer to the pass state
+ * @param lines the output lines so far
+ * @param count number of output lines so far, the next index
+ * @param line the code line
+ * @param removed pointer to the count of removed instructions
+ * @return true if the line should be emitted unchanged, false if it was absorbed
+ */
+static bool optimize_line(PeepholeState* state, char** lines, uint64_t count, const char* line, uint64_t* removed){
+	char mnemonic[10], operands[MAX_OPERANDS][256];
+	int numOperands = split_instruction(line, mnemonic, operands, MAX_OPERANDS);
+
+	// Leave anything the pass does not understand to the assembler
+	if(numOperands < 0){
+		reset_state(state);
+		return true;
+	}
+
+	int rd = numOperands > 0 ? parse_register(operands[0]) : -1;
+	LastKind lastKind = state->lastKind;
+	state->lastKind = LAST_NONE;
+
+	// mov rX, rX does nothing
+	if(strcmp(mnemonic, "mov") == 0 && numOperands == 2 && rd >= 0 && parse_register(operands[1]) == rd){
+		state->lastKind = lastKind;
+		(*removed)++;
+		return false;
+	}
+
+	// Fold addi/subi into the previous addi/subi on the same register
+	if((strcmp(mnemonic, "addi") == 0 || strcmp(mnemonic, "subi") == 0) && numOperands == 2 && rd >= 0 && is_uint64(operands[1])){
+		int64_t delta = (int64_t) strtoull(operands[1], NULL, 10);
+		delta = mnemonic[0] == 's' ? -delta : delta;
+		forget_register(state, rd);
+
+		if(lastKind == LAST_ADD && state->lastRegister == rd){
+			int64_t net = state->lastDelta + delta;
+
+			if(net >= -4095 && net <= 4095){
+				free(lines[state->lastIndex]);
+				(*removed)++;
+
+				if(net == 0){
+					lines[state->lastIndex] = NULL;
+					(*removed)++;
+					return false;
+				}
+
+				lines[state->lastIndex] = format_line(net > 0 ? "\taddi r%ld, %ld\n" : "\tsubi r%ld, %ld\n", rd, net > 0 ? net : -net);
+				state->lastKind = LAST_ADD;
+				state->lastDelta = net;
+				return false;
+			}
+		}
+
+		state->lastKind = LAST_ADD;
+		state->lastIndex = count;
+		state->lastRegister = rd;
+		state->lastDelta = delta;
+		return true;
+	}
+
+	// Drop a reload of a constant the register already holds
+	if(strcmp(mnemonic, "ld") == 0 && numOperands == 2 && rd >= 0){
+		if(state->constants[rd] != NULL && strcmp(state->constants[rd], operands[1]) == 0){
+			(*removed)++;
+			return false;
+		}
+
+		forget_register(state, rd);
+		state->constants[rd] = strdup(operands[1]);
+		return true;
+	}
+
+	// push rX directly followed by pop rY only copies rX into rY
+	if(strcmp(mnemonic, "push") == 0 && numOperands == 1 && rd >= 0){
+		forget_register(state, 31);
+		state->lastKind = LAST_PUSH;
+		state->lastIndex = count;
+		state->lastRegister = rd;
+		return true;
+	}
+	if(strcmp(mnemonic, "pop") == 0 && numOperands == 1 && rd >= 0){
+		forget_register(state, rd);
+		forget_register(state, 31);
+
+		if(lastKind == LAST_PUSH){
+			free(lines[state->lastIndex]);
+			lines[state->lastIndex] = state->lastRegister == rd ? NULL : format_line("\tmov r%ld, r%ld\n", rd, state->lastRegister);
+			*removed += state->lastRegister == rd ? 2 : 1;
+			return false;
+		}
+
+		return true;
+	}
+
+	// Control transfers end the run, and calls and privileged operations may change any register
+	if(is_control(mnemonic) || strcmp(mnemonic, "priv") == 0){
+		reset_state(state);
+		return true;
+	}
+
+	// Stores write no register; everything else writes its first operand
+	bool writesNone = strcmp(mnemonic, "out") == 0 || (strcmp(mnemonic, "mov") == 0 && operands[0][0] == '(');
+	if(!writesNone){
+		forget_register(state, rd);
+	}
+
+	return true;
+}
+
+Source* optimize_source(Source* source, uint64_t* removed){
+	char** lines = (char**) malloc(sizeof(char*) * (source->count + 1));
+
+	if (lines == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for optimized lines\n");
+		exit(1);
+	}
+
+	bool* pinned = (bool*) calloc(source->count + 1, sizeof(bool));
+
+	if (pinned == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for pinned lines\n");
+		exit(1);
+	}
+	mark_relative_targets(source, pinned);
+
+	PeepholeState state;
+	memset(&state, 0, sizeof(state));
+	char currentDirective = 'N';
+	char line[256];
+	uint64_t count = 0;
+	*removed = 0;
+
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		// Directives and labels start a new run of code; other lines only pass through
+		if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+			reset_state(&state);
+		}
+		else if(line[0] == ':'){
+			reset_state(&state);
+		}
+		else if(line[0] == '\t' && !is_empty(line)){
+			// Lines a literal brr reaches are kept and split the run, so its offset still lands where it did
+			if(currentDirective != 'C' || is_data(line) || pinned[i]){
+				reset_state(&state);
+			}
+			else if(!optimize_line(&state, lines, count, line, removed)){
+				continue;
+			}
+		}
+
+		lines[count++] = strdup(line);
+	}
+	reset_state(&state);
+	free(pinned);
+
+	// Join the surviving lines into the optimized program
+	ObjectBuffer* text = create_object_buffer();
+	for(uint64_t i = 0; i < count; i++){
+		if(lines[i] != NULL){
+			buffer_write(text, lines[i], strlen(lines[i]));
+			free(lines[i]);
+		}
+	}
+	free(lines);
+
+	Source* optimized = create_source((char*) text->data, text->position);
+	destroy_object_buffer(text);
+	return optimized;
+}
\ No newline at end of file
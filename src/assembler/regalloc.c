@@ -0,0 +1,949 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "assembler/regalloc.h"
+#include "assembler/buffer.h"
+#include "assembler/hashmap.h"
+#include "assembler/instruction.h"
+#include "assembler/label.h"
+#include "assembler/utils.h"
+
+#define MAX_OPERANDS 4
+#define MAX_VIRTUAL 65536
+#define NO_REGISTER -1
+
+/**
+ * @brief Ways control can leave an instruction.
+ */
+typedef enum {
+	FLOW_NEXT,
+	FLOW_BRANCH,
+	FLOW_JUMP,
+	FLOW_CALL,
+	FLOW_RETURN,
+	FLOW_HALT
+} FlowKind;
+
+/**
+ * @brief Structure representing one instruction line of the code segment.
+ */
+typedef struct CodeLine {
+	uint64_t line; /**< index of the source line */
+	int64_t regs[MAX_OPERANDS]; /**< register each operand names: 0-31 physical, 32 up virtual, or NO_REGISTER */
+	uint8_t uses; /**< mask of the register operands read */
+	uint8_t defs; /**< mask of the register operands written */
+	FlowKind flow; /**< how control leaves the instruction */
+	int64_t target; /**< index of the instruction a brr to a label branches to, or NO_REGISTER */
+	int64_t via; /**< register an indirect branch goes through, or NO_REGISTER */
+	bool anywhere; /**< whether the branch may reach any instruction */
+	int64_t loads; /**< index of the code label an ld loads, or NO_REGISTER */
+} CodeLine;
+
+/**
+ * @brief Structure representing the code labels a register is loaded with.
+ */
+typedef struct RegTargets {
+	int64_t* indices; /**< indices of the instructions the labels name */
+	uint64_t count; /**< number of indices */
+	uint64_t capacity; /**< capacity of the index array */
+	bool defined; /**< whether anything writes the register */
+	bool unknown; /**< whether the register is written by anything other than an ld of a code label */
+} RegTargets;
+
+/**
+ * @brief Structure representing the span a virtual register is live over.
+ */
+typedef struct Interval {
+	uint64_t reg; /**< the virtual register */
+	uint64_t start; /**< first position the register is live at */
+	uint64_t end; /**< last position the register is live at */
+} Interval;
+
+/**
+ * @brief Structure representing the code of a program under allocation.
+ */
+typedef struct Allocation {
+	CodeLine* code; /**< instruction lines of the code segment, in program order */
+	uint64_t count; /**< number of instruction lines */
+	HashMap* labels; /**< code labels, mapped to the index of the instruction they name */
+	int32_t* dense; /**< dense index of each virtual register number, or -1 */
+	uint64_t virtuals; /**< number of distinct virtual registers */
+	bool named[32]; /**< whether the program names each physical register */
+} Allocation;
+
+/**
+ * @brief Finds the register an operand names, directly or as the base of a memory operand.
+ *
+ * @param operand the operand
+ * @param kind set to 'r' or 'v'
+ * @param number set to the register number
+ * @return true if the operand names a register, false otherwise
+ */
+static bool operand_register(const char* operand, char* kind, uint64_t* number){
+	char name[256];
+	if(operand[0] != '(' || sscanf(operand, "( %255[^) ] )", name) != 1){
+		strcpy(name, operand);
+	}
+
+	if((name[0] != 'r' && name[0] != 'v') || !is_uint64(name + 1)){
+		return false;
+	}
+
+	*kind = name[0];
+	*number = strtoull(name + 1, NULL, 10);
+	return *kind == 'v' || *number <= 31;
+}
+
+/**
+ * @brief Checks whether a source text names any virtual register.
+ *
+ * @param source pointer to the source program
+ * @return true if a v followed by a digit starts an operand anywhere, false otherwise
+ */
+static bool names_virtual_registers(Source* source){
+	const char* end = source->text + source->size;
+
+	for(const char* c = memchr(source->text, 'v', source->size); c != NULL; c = memchr(c + 1, 'v', end - c - 1)){
+		if(c > source->text && strchr(" \t,(", c[-1]) != NULL && c + 1 < end && isdigit((unsigned char) c[1])){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+/**
+ * @brief Records which operands of an instruction are read and written and where it branches.
+ *
+ * @param allocation pointer to the allocation
+ * @param code pointer to the instruction line, with its registers filled in
+ * @param mnemonic the mnemonic
+ * @param operands the operands
+ * @param count the number of operands
+ */
+static void classify_line(Allocation* allocation, CodeLine* code, const char* mnemonic, char operands[MAX_OPERANDS][256], int count){
+	static const char* const arithmetic[] = {"add", "sub", "mul", "div", "and", "or", "xor", "shftr", "shftl", "addf", "subf", "mulf", "divf", NULL};
+	static const char* const immediate[] = {"addi", "subi", "shftri", "shftli", NULL};
+	static const char* const writers[] = {"3", "9", "11", "12", "13", NULL};
+	bool halts = strcmp(mnemonic, "priv") == 0 && count == 4 && strcmp(operands[3], "0") == 0;
+	bool spawns = strcmp(mnemonic, "priv") == 0 && count == 4 && strcmp(operands[3], "11") == 0;
+
+	// Anything not listed, vector instructions included, reads every register it names
+	code->uses = 0xf;
+	code->defs = 0;
+	code->flow = FLOW_NEXT;
+	code->target = NO_REGISTER;
+	code->via = NO_REGISTER;
+	code->anywhere = false;
+	code->loads = NO_REGISTER;
+
+	for(int i = 0; arithmetic[i] != NULL; i++){
+		if(strcmp(mnemonic, arithmetic[i]) == 0){
+			code->uses = 0x6;
+			code->defs = 0x1;
+		}
+	}
+	for(int i = 0; immediate[i] != NULL; i++){
+		if(strcmp(mnemonic, immediate[i]) == 0){
+			code->uses = 0x1;
+			code->defs = 0x1;
+		}
+	}
+
+	if(strcmp(mnemonic, "not") == 0 || strcmp(mnemonic, "in") == 0){
+		code->uses = 0x2;
+		code->defs = 0x1;
+	}
+	else if(strcmp(mnemonic, "ld") == 0 || strcmp(mnemonic, "clr") == 0 || strcmp(mnemonic, "pop") == 0
+		|| strcmp(mnemonic, "vsum") == 0 || strcmp(mnemonic, "vsumf") == 0){
+		code->uses = 0;
+		code->defs = 0x1;
+	}
+	else if(strcmp(mnemonic, "mov") == 0){
+		// Stores read both operands; every other move writes the first
+		code->uses = operands[0][0] == '(' ? 0x3 : 0x2;
+		code->defs = operands[0][0] == '(' ? 0 : 0x1;
+	}
+	else if(strcmp(mnemonic, "priv") == 0){
+		// Input, allocation, spawn, join, and fetch-add only write rd, halt writes nothing, and anything else may read and write rd
+		code->uses = 0x7;
+		for(int i = 0; writers[i] != NULL && count == 4; i++){
+			if(strcmp(operands[3], writers[i]) == 0){
+				code->uses = 0x6;
+			}
+		}
+		code->defs = halts ? 0 : 0x1;
+		// A spawned hart starts at its target while the spawner carries on
+		code->flow = halts ? FLOW_HALT : spawns ? FLOW_BRANCH : FLOW_NEXT;
+	}
+	else if(strcmp(mnemonic, "br") == 0 || strcmp(mnemonic, "brr") == 0){
+		code->flow = FLOW_JUMP;
+	}
+	else if(strcmp(mnemonic, "brnz") == 0 || strcmp(mnemonic, "brgt") == 0){
+		code->flow = FLOW_BRANCH;
+	}
+	else if(strcmp(mnemonic, "call") == 0){
+		code->flow = FLOW_CALL;
+	}
+	else if(strcmp(mnemonic, "return") == 0){
+		code->flow = FLOW_RETURN;
+	}
+	else if(strcmp(mnemonic, "halt") == 0){
+		code->flow = FLOW_HALT;
+	}
+
+	// Only operands that name registers take part
+	uint8_t registers = 0;
+	for(int i = 0; i < count; i++){
+		registers |= code->regs[i] != NO_REGISTER ? 1 << i : 0;
+	}
+	code->uses &= registers;
+	code->defs &= registers;
+
+	// An ld of a code label may feed an indirect branch
+	if(strcmp(mnemonic, "ld") == 0 && count == 2){
+		Label* label = (Label*) hashmap_get(allocation->labels, operands[1]);
+		code->loads = label != NULL ? (int64_t) label->address : NO_REGISTER;
+	}
+
+	if(code->flow != FLOW_JUMP && code->flow != FLOW_BRANCH && code->flow != FLOW_CALL){
+		return;
+	}
+
+	// brr to a label goes straight there; brr to anything else is only known at run time
+	if(strcmp(mnemonic, "brr") == 0){
+		Label* label = count == 1 ? (Label*) hashmap_get(allocation->labels, operands[0]) : NULL;
+		code->target = label != NULL ? (int64_t) label->address : NO_REGISTER;
+		code->anywhere = label == NULL;
+		return;
+	}
+
+	// The other branches go through the register in their first operand, and a spawn through its second
+	code->via = spawns ? code->regs[1] : count > 0 ? code->regs[0] : NO_REGISTER;
+	code->anywhere = code->via == NO_REGISTER;
+}
+
+/**
+ * @brief Maps every label of the code segment to the index of the instruction it names.
+ *
+ * Labels naming data, or data words placed in the code segment, are left out,
+ * so branches to them are treated as reaching any instruction.
+ *
+ * @param allocation pointer to the allocation
+ * @param source pointer to the source program
+ */
+static void collect_labels(Allocation* allocation, Source* source){
+	char line[256];
+	char currentDirective = 'N';
+	char* pending[256];
+	uint64_t pendingCount = 0;
+	uint64_t index = 0;
+
+	for(uint64_t i = 0; i <= source->count; i++){
+		bool end = i == source->count;
+		if(!end){
+			source_get_line(source, i, line, sizeof(line));
+		}
+
+		if(!end && line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+			continue;
+		}
+		else if(!end && line[0] == ':'){
+			trim(line);
+			if(pendingCount < sizeof(pending) / sizeof(pending[0])){
+				pending[pendingCount++] = strdup(line);
+			}
+			continue;
+		}
+		else if(!end && (line[0] != '\t' || is_empty(line))){
+			continue;
+		}
+
+		// Labels at the end of the code segment name the instruction after the last one
+		bool instruction = currentDirective == 'C' && (end || !is_data(line));
+		for(uint64_t j = 0; j < pendingCount; j++){
+			if(instruction && hashmap_get(allocation->labels, pending[j]) == NULL){
+				hashmap_insert(allocation->labels, pending[j], create_label(pending[j], index));
+			}
+			else{
+				free(pending[j]);
+			}
+		}
+		pendingCount = 0;
+
+		index += !end && instruction ? 1 : 0;
+	}
+}
+
+/**
+ * @brief Finds the register an operand names and gives virtual registers their dense index.
+ *
+ * @param allocation pointer to the allocation
+ * @param operand the operand
+ * @param reg set to the register, or NO_REGISTER
+ * @return 0 if successful, -1 if the operand names an invalid virtual register
+ */
+static int lookup_register(Allocation* allocation, const char* operand, int64_t* reg){
+	char kind;
+	uint64_t number;
+	*reg = NO_REGISTER;
+
+	if(!operand_register(operand, &kind, &number)){
+		return 0;
+	}
+	if(kind == 'r'){
+		allocation->named[number] = true;
+		*reg = (int64_t) number;
+		return 0;
+	}
+	if(number >= MAX_VIRTUAL){
+		fprintf(stderr, "Error: invalid virtual register v%lu\n", number);
+		return -1;
+	}
+
+	if(allocation->dense[number] < 0){
+		allocation->dense[number] = (int32_t) allocation->virtuals++;
+	}
+	*reg = 32 + allocation->dense[number];
+	return 0;
+}
+
+/**
+ * @brief Collects and classifies every instruction line of the code segment.
+ *
+ * @param allocation pointer to the allocation
+ * @param source pointer to the source program
+ * @return 0 if successful, -1 otherwise
+ */
+static int collect_code(Allocation* allocation, Source* source){
+	char line[256], mnemonic[10], operands[MAX_OPERANDS][256];
+	char currentDirective = 'N';
+
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+			continue;
+		}
+		else if(line[0] != '\t' || is_empty(line) || currentDirective != 'C' || is_data(line)){
+			continue;
+		}
+
+		CodeLine* code = &allocation->code[allocation->count++];
+		memset(code, 0, sizeof(CodeLine));
+		code->line = i;
+
+		// Lines the pass cannot split are left for the assembler to reject
+		int count = split_instruction(line, mnemonic, operands, MAX_OPERANDS);
+		for(int j = 0; j < MAX_OPERANDS; j++){
+			code->regs[j] = NO_REGISTER;
+			if(j < count && lookup_register(allocation, operands[j], &code->regs[j]) != 0){
+				return -1;
+			}
+		}
+
+		classify_line(allocation, code, mnemonic, operands, count < 0 ? 0 : count);
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Resolves the instructions each indirect branch may reach.
+ *
+ * A register every write of which is an ld of a code label can only hold those
+ * labels; a branch through any other register may reach any instruction.
+ *
+ * @param allocation pointer to the allocation
+ * @return the targets of every register, indexed like CodeLine.regs
+ */
+static RegTargets* resolve_targets(Allocation* allocation){
+	RegTargets* targets = (RegTargets*) calloc(32 + allocation->virtuals, sizeof(RegTargets));
+
+	if (targets == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for RegTargets\n");
+		exit(1);
+	}
+
+	for(uint64_t i = 0; i < allocation->count; i++){
+		CodeLine* code = &allocation->code[i];
+		if((code->defs & 0x1) == 0){
+			continue;
+		}
+
+		RegTargets* target = &targets[code->regs[0]];
+		target->defined = true;
+		if(code->loads == NO_REGISTER){
+			target->unknown = true;
+			continue;
+		}
+
+		if(target->count == target->capacity){
+			target->capacity = target->capacity == 0 ? 4 : target->capacity * 2;
+			target->indices = (int64_t*) realloc(target->indices, sizeof(int64_t) * target->capacity);
+
+			if (target->indices == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for branch targets\n");
+				exit(1);
+			}
+		}
+		target->indices[target->count++] = code->loads;
+	}
+
+	for(uint64_t i = 0; i < allocation->count; i++){
+		CodeLine* code = &allocation->code[i];
+		if(code->via != NO_REGISTER && (!targets[code->via].defined || targets[code->via].unknown)){
+			code->anywhere = true;
+		}
+	}
+
+	return targets;
+}
+
+/**
+ * @brief Adds the virtual registers an instruction reads or writes to a set.
+ *
+ * @param code pointer to the instruction line
+ * @param mask mask of the operands to add
+ * @param set the set, one bit per virtual register
+ */
+static void add_registers(const CodeLine* code, uint8_t mask, uint64_t* set){
+	for(int i = 0; i < MAX_OPERANDS; i++){
+		if((mask & (1 << i)) != 0 && code->regs[i] >= 32){
+			set[(code->regs[i] - 32) / 64] |= 1ULL << ((code->regs[i] - 32) % 64);
+		}
+	}
+}
+
+/**
+ * @brief Computes the virtual registers live into and out of every instruction.
+ *
+ * @param allocation pointer to the allocation
+ * @param targets the targets of every register
+ * @param words number of 64-bit words per set
+ * @param in set to the live-in sets, words per instruction
+ * @param out set to the live-out sets, words per instruction
+ */
+static void compute_liveness(Allocation* allocation, const RegTargets* targets, uint64_t words, uint64_t* in, uint64_t* out){
+	uint64_t* all = (uint64_t*) calloc(words, sizeof(uint64_t));
+	uint64_t* live = (uint64_t*) calloc(words, sizeof(uint64_t));
+	uint64_t* defined = (uint64_t*) calloc(words, sizeof(uint64_t));
+	uint64_t* fresh = (uint64_t*) calloc(words, sizeof(uint64_t));
+	uint64_t registers = 32 + allocation->virtuals;
+	uint64_t* reach = (uint64_t*) calloc(registers * words, sizeof(uint64_t));
+
+	if (all == NULL || live == NULL || defined == NULL || fresh == NULL || reach == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for liveness sets\n");
+		exit(1);
+	}
+
+	// Instructions that follow a call are where returns go back to
+	uint64_t* returns = (uint64_t*) malloc(sizeof(uint64_t) * (allocation->count + 1));
+	uint64_t returnCount = 0;
+	if (returns == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for return points\n");
+		exit(1);
+	}
+	for(uint64_t i = 0; i + 1 < allocation->count; i++){
+		if(allocation->code[i].flow == FLOW_CALL){
+			returns[returnCount++] = i + 1;
+		}
+	}
+
+	bool changed = true;
+	while(changed){
+		changed = false;
+
+		// Any instruction may follow a branch whose target is unknown
+		memset(all, 0, words * sizeof(uint64_t));
+		for(uint64_t i = 0; i < allocation->count; i++){
+			for(uint64_t w = 0; w < words; w++){
+				all[w] |= in[i * words + w];
+			}
+		}
+
+		// A branch through a register may reach any label the register is loaded with
+		memset(reach, 0, registers * words * sizeof(uint64_t));
+		for(uint64_t r = 0; r < registers; r++){
+			for(uint64_t t = 0; t < targets[r].count; t++){
+				for(uint64_t w = 0; w < words && (uint64_t) targets[r].indices[t] < allocation->count; w++){
+					reach[r * words + w] |= in[targets[r].indices[t] * words + w];
+				}
+			}
+		}
+
+		for(uint64_t i = allocation->count; i-- > 0;){
+			const CodeLine* code = &allocation->code[i];
+			memset(live, 0, words * sizeof(uint64_t));
+
+			// Union the live-in sets of every successor
+			for(uint64_t w = 0; w < words; w++){
+				bool falls = code->flow == FLOW_NEXT || code->flow == FLOW_BRANCH || code->flow == FLOW_CALL;
+				live[w] |= falls && i + 1 < allocation->count ? in[(i + 1) * words + w] : 0;
+				live[w] |= code->anywhere ? all[w] : 0;
+				live[w] |= code->target != NO_REGISTER && (uint64_t) code->target < allocation->count ? in[code->target * words + w] : 0;
+			}
+			for(uint64_t w = 0; w < words && code->via != NO_REGISTER && !code->anywhere; w++){
+				live[w] |= reach[code->via * words + w];
+			}
+			// A return goes back to the instruction after any call
+			for(uint64_t r = 0; r < returnCount && code->flow == FLOW_RETURN; r++){
+				for(uint64_t w = 0; w < words; w++){
+					live[w] |= in[returns[r] * words + w];
+				}
+			}
+
+			// in = uses + (out - defs)
+			memset(defined, 0, words * sizeof(uint64_t));
+			memset(fresh, 0, words * sizeof(uint64_t));
+			add_registers(code, code->defs, defined);
+			add_registers(code, code->uses, fresh);
+			for(uint64_t w = 0; w < words; w++){
+				fresh[w] |= live[w] & ~defined[w];
+				changed = changed || fresh[w] != in[i * words + w] || live[w] != out[i * words + w];
+				in[i * words + w] = fresh[w];
+				out[i * words + w] = live[w];
+			}
+		}
+	}
+
+	free(all);
+	free(live);
+	free(defined);
+	free(fresh);
+	free(reach);
+	free(returns);
+}
+
+/**
+ * @brief Widens an interval to cover a position.
+ *
+ * @param interval pointer to the interval
+ * @param position the position
+ */
+static void extend_interval(Interval* interval, uint64_t position){
+	interval->start = position < interval->start ? position : interval->start;
+	interval->end = position > interval->end ? position : interval->end;
+}
+
+/**
+ * @brief Compares two intervals by their start.
+ *
+ * @param a pointer to the first interval
+ * @param b pointer to the second interval
+ * @return negative, zero, or positive as a starts before, with, or after b
+ */
+static int compare_intervals(const void* a, const void* b){
+	const Interval* first = (const Interval*) a;
+	const Interval* second = (const Interval*) b;
+
+	if(first->start != second->start){
+		return first->start < second->start ? -1 : 1;
+	}
+	return first->reg < second->reg ? -1 : first->reg > second->reg ? 1 : 0;
+}
+
+/**
+ * @brief Builds the live interval of every virtual register, sorted by start.
+ *
+ * Instruction i reads at position 2i and writes at 2i + 1, so a register last
+ * read by an instruction may share a physical register with the one it writes.
+ *
+ * @param allocation pointer to the allocation
+ * @param words number of 64-bit words per set
+ * @param in the live-in sets
+ * @param out the live-out sets
+ * @return the newly allocated intervals, one per virtual register
+ */
+static Interval* build_intervals(Allocation* allocation, uint64_t words, const uint64_t* in, const uint64_t* out){
+	Interval* intervals = (Interval*) malloc(sizeof(Interval) * allocation->virtuals);
+
+	if (intervals == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Interval\n");
+		exit(1);
+	}
+
+	for(uint64_t v = 0; v < allocation->virtuals; v++){
+		intervals[v].reg = v;
+		intervals[v].start = UINT64_MAX;
+		intervals[v].end = 0;
+	}
+
+	for(uint64_t i = 0; i < allocation->count; i++){
+		const CodeLine* code = &allocation->code[i];
+
+		for(uint64_t w = 0; w < words; w++){
+			for(uint64_t bits = in[i * words + w]; bits != 0; bits &= bits - 1){
+				extend_interval(&intervals[w * 64 + __builtin_ctzll(bits)], 2 * i);
+			}
+			for(uint64_t bits = out[i * words + w]; bits != 0; bits &= bits - 1){
+				extend_interval(&intervals[w * 64 + __builtin_ctzll(bits)], 2 * i + 1);
+			}
+		}
+		for(int j = 0; j < MAX_OPERANDS; j++){
+			if((code->defs & (1 << j)) != 0 && code->regs[j] >= 32){
+				extend_interval(&intervals[code->regs[j] - 32], 2 * i + 1);
+			}
+		}
+	}
+
+	// Registers only named where the pass cannot tell how they are used still get one
+	for(uint64_t v = 0; v < allocation->virtuals; v++){
+		if(intervals[v].start == UINT64_MAX){
+			intervals[v].start = 0;
+		}
+	}
+
+	qsort(intervals, allocation->virtuals, sizeof(Interval), compare_intervals);
+	return intervals;
+}
+
+/**
+ * @brief Assigns physical registers to the intervals by linear scan.
+ *
+ * When no register is free, whichever of the active intervals and the new one
+ * ends last is spilled.
+ *
+ * @param intervals the intervals, sorted by start
+ * @param count number of intervals
+ * @param pool whether each physical register may be assigned
+ * @param assigned set to the physical register of each virtual register, or NO_REGISTER if spilled
+ * @return the number of spilled virtual registers
+ */
+static uint64_t linear_scan(const Interval* intervals, uint64_t count, const bool pool[32], int64_t* assigned){
+	bool available[32];
+	memcpy(available, pool, sizeof(available));
+	const Interval* active[32];
+	uint64_t activeCount = 0;
+	uint64_t spilled = 0;
+
+	for(uint64_t i = 0; i < count; i++){
+		const Interval* current = &intervals[i];
+
+		// Free the registers of intervals that ended before this one starts
+		uint64_t kept = 0;
+		for(uint64_t a = 0; a < activeCount; a++){
+			if(active[a]->end < current->start){
+				available[assigned[active[a]->reg]] = true;
+			}
+			else{
+				active[kept++] = active[a];
+			}
+		}
+		activeCount = kept;
+
+		int64_t reg = NO_REGISTER;
+		for(int r = 0; r < 32 && reg == NO_REGISTER; r++){
+			reg = available[r] ? r : NO_REGISTER;
+		}
+
+		if(reg != NO_REGISTER){
+			available[reg] = false;
+		}
+		else if(activeCount > 0 && active[activeCount - 1]->end > current->end){
+			// Take the register of the active interval that ends last
+			reg = assigned[active[--activeCount]->reg];
+			assigned[active[activeCount]->reg] = NO_REGISTER;
+			spilled++;
+		}
+		else{
+			assigned[current->reg] = NO_REGISTER;
+			spilled++;
+			continue;
+		}
+
+		// Keep the active intervals sorted by end
+		assigned[current->reg] = reg;
+		uint64_t position = activeCount++;
+		while(position > 0 && active[position - 1]->end > current->end){
+			active[position] = active[position - 1];
+			position--;
+		}
+		active[position] = current;
+	}
+
+	return spilled;
+}
+
+/**
+ * @brief Writes the address of a spill slot as an ld operand.
+ *
+ * @param slot the slot
+ * @param operand buffer receiving the operand
+ * @param size size of the buffer
+ */
+static void spill_operand(int64_t slot, char* operand, uint64_t size){
+	if(slot == 0){
+		snprintf(operand, size, "%s", SPILL_LABEL);
+	}
+	else{
+		snprintf(operand, size, "%s+%lu", SPILL_LABEL, (uint64_t) slot * sizeof(uint64_t));
+	}
+}
+
+/**
+ * @brief Writes an instruction with physical registers in place of virtual ones.
+ *
+ * Spilled registers are loaded into scratch registers before the instruction
+ * and stored back after it.
+ *
+ * @param text the object buffer receiving the lines
+ * @param code pointer to the instruction line
+ * @param mnemonic the mnemonic
+ * @param operands the operands
+ * @param count the number of operands
+ * @param assigned the physical register of each virtual register, or NO_REGISTER if spilled
+ * @param slots the spill slot of each virtual register
+ * @param scratch the scratch registers
+ */
+static void rewrite_line(ObjectBuffer* text, const CodeLine* code, const char* mnemonic, char operands[MAX_OPERANDS][256], int count,
+	const int64_t* assigned, const int64_t* slots, const int scratch[SPILL_SCRATCH]){
+	int64_t spilledRegs[MAX_OPERANDS];
+	int64_t held[MAX_OPERANDS];
+	int spilledCount = 0;
+	char line[600], slot[64];
+
+	// Give each distinct spilled register its own scratch register
+	for(int k = 0; k < count; k++){
+		held[k] = NO_REGISTER;
+		if(code->regs[k] < 32){
+			continue;
+		}
+		else if(assigned[code->regs[k] - 32] != NO_REGISTER){
+			held[k] = assigned[code->regs[k] - 32];
+			continue;
+		}
+
+		int j = 0;
+		while(j < spilledCount && spilledRegs[j] != code->regs[k]){
+			j++;
+		}
+		if(j == spilledCount){
+			spilledRegs[spilledCount++] = code->regs[k];
+		}
+		held[k] = scratch[j < SPILL_SCRATCH ? j : SPILL_SCRATCH - 1];
+	}
+
+	// Load the spilled registers the instruction reads
+	for(int j = 0; j < spilledCount; j++){
+		for(int k = 0; k < count; k++){
+			if(code->regs[k] == spilledRegs[j] && (code->uses & (1 << k)) != 0){
+				spill_operand(slots[spilledRegs[j] - 32], slot, sizeof(slot));
+				snprintf(line, sizeof(line), "\tld r%ld, %s\n\tmov r%ld, (r%ld)(0)\n", held[k], slot, held[k], held[k]);
+				buffer_write(text, line, strlen(line));
+				break;
+			}
+		}
+	}
+
+	int written = snprintf(line, sizeof(line), "\t%s", mnemonic);
+	for(int k = 0; k < count; k++){
+		char operand[300];
+		if(held[k] == NO_REGISTER || code->regs[k] < 32){
+			snprintf(operand, sizeof(operand), "%s", operands[k]);
+		}
+		else if(operands[k][0] == '('){
+			snprintf(operand, sizeof(operand), "(r%ld)%s", held[k], strchr(operands[k], ')') + 1);
+		}
+		else{
+			snprintf(operand, sizeof(operand), "r%ld", held[k]);
+		}
+
+		written += snprintf(line + written, sizeof(line) - written, "%s%s", k == 0 ? " " : ", ", operand);
+	}
+	snprintf(line + written, sizeof(line) - written, "\n");
+	buffer_write(text, line, strlen(line));
+
+	// Store the spilled registers the instruction writes, addressing the slot through another scratch register
+	for(int j = 0; j < spilledCount; j++){
+		for(int k = 0; k < count; k++){
+			if(code->regs[k] == spilledRegs[j] && (code->defs & (1 << k)) != 0){
+				int address = scratch[held[k] == scratch[0] ? 1 : 0];
+				spill_operand(slots[spilledRegs[j] - 32], slot, sizeof(slot));
+				snprintf(line, sizeof(line), "\tld r%d, %s\n\tmov (r%d)(0), r%ld\n", address, slot, address, held[k]);
+				buffer_write(text, line, strlen(line));
+				break;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Rewrites every line naming a virtual register and appends the spill area.
+ *
+ * @param source pointer to the source program
+ * @param allocation pointer to the allocation
+ * @param assigned the physical register of each virtual register, or NO_REGISTER if spilled
+ * @param scratch the scratch registers
+ * @param spilled the number of spilled virtual registers
+ * @return Pointer to the newly created source.
+ */
+static Source* rewrite_source(Source* source, Allocation* allocation, const int64_t* assigned, const int scratch[SPILL_SCRATCH], uint64_t spilled){
+	int64_t* slots = (int64_t*) malloc(sizeof(int64_t) * allocation->virtuals);
+
+	if (slots == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for spill slots\n");
+		exit(1);
+	}
+
+	int64_t next = 0;
+	for(uint64_t v = 0; v < allocation->virtuals; v++){
+		slots[v] = assigned[v] == NO_REGISTER ? next++ : NO_REGISTER;
+	}
+
+	// Lines without virtual registers are copied in runs straight from the original text
+	ObjectBuffer* text = create_object_buffer();
+	char line[256], mnemonic[10], operands[MAX_OPERANDS][256];
+	uint64_t pending = 0;
+	for(uint64_t i = 0; i < allocation->count; i++){
+		const CodeLine* code = &allocation->code[i];
+		bool named = false;
+		for(int k = 0; k < MAX_OPERANDS; k++){
+			named = named || code->regs[k] >= 32;
+		}
+		if(!named){
+			continue;
+		}
+
+		source_get_line(source, code->line, line, sizeof(line));
+		int count = split_instruction(line, mnemonic, operands, MAX_OPERANDS);
+		buffer_write(text, source->text + pending, source->lineStarts[code->line] - pending);
+		pending = source->lineStarts[code->line + 1];
+
+		rewrite_line(text, code, mnemonic, operands, count, assigned, slots, scratch);
+	}
+	buffer_write(text, source->text + pending, source->size - pending);
+
+	// Spilled registers live in a zeroed area at the end of the data segment
+	if(spilled > 0){
+		char area[128];
+		snprintf(area, sizeof(area), "%s.data\n%s\n.zero %lu\n", source->size > 0 && source->text[source->size - 1] != '\n' ? "\n" : "",
+			SPILL_LABEL, spilled * sizeof(uint64_t));
+		buffer_write(text, area, strlen(area));
+	}
+
+	Source* allocated = create_source((char*) text->data, text->position);
+	destroy_object_buffer(text);
+	free(slots);
+	return allocated;
+}
+
+/**
+ * @brief Frees the memory held by an allocation.
+ *
+ * @param allocation pointer to the allocation
+ */
+static void destroy_allocation(Allocation* allocation){
+	free(allocation->code);
+	free(allocation->dense);
+	destroy_hashmap(allocation->labels, destroy_label);
+}
+
+Source* allocate_registers(Source* source, uint64_t* spilled){
+	*spilled = 0;
+
+	// Programs without virtual registers pass through unchanged
+	if(!names_virtual_registers(source)){
+		return create_source(source->text, source->size);
+	}
+
+	Allocation allocation;
+	memset(&allocation, 0, sizeof(allocation));
+	allocation.code = (CodeLine*) malloc(sizeof(CodeLine) * (source->count + 1));
+	allocation.dense = (int32_t*) malloc(sizeof(int32_t) * MAX_VIRTUAL);
+	allocation.labels = create_hashmap();
+
+	if (allocation.code == NULL || allocation.dense == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Allocation\n");
+		exit(1);
+	}
+	memset(allocation.dense, 0xff, sizeof(int32_t) * MAX_VIRTUAL);
+
+	collect_labels(&allocation, source);
+	if(collect_code(&allocation, source) != 0){
+		destroy_allocation(&allocation);
+		return NULL;
+	}
+	if(allocation.virtuals == 0){
+		destroy_allocation(&allocation);
+		return create_source(source->text, source->size);
+	}
+
+	RegTargets* targets = resolve_targets(&allocation);
+	uint64_t words = (allocation.virtuals + 63) / 64;
+	uint64_t* in = (uint64_t*) calloc(allocation.count * words, sizeof(uint64_t));
+	uint64_t* out = (uint64_t*) calloc(allocation.count * words, sizeof(uint64_t));
+
+	if (in == NULL || out == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for liveness sets\n");
+		exit(1);
+	}
+
+	compute_liveness(&allocation, targets, words, in, out);
+	Interval* intervals = build_intervals(&allocation, words, in, out);
+
+	// Only registers the program never names are free; r31 is the stack pointer
+	bool pool[32];
+	for(int r = 0; r < 32; r++){
+		pool[r] = r < 31 && !allocation.named[r];
+	}
+
+	int64_t* assigned = (int64_t*) malloc(sizeof(int64_t) * allocation.virtuals);
+	if (assigned == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for assigned registers\n");
+		exit(1);
+	}
+
+	int scratch[SPILL_SCRATCH];
+	bool fits = true;
+	uint64_t spills = linear_scan(intervals, allocation.virtuals, pool, assigned);
+	if(spills > 0){
+		// Keep the highest free registers back for the spill code and allocate again
+		int kept = 0;
+		for(int r = 30; r >= 0 && kept < SPILL_SCRATCH; r--){
+			if(pool[r]){
+				pool[r] = false;
+				scratch[kept++] = r;
+			}
+		}
+
+		fits = kept == SPILL_SCRATCH;
+		if(fits){
+			spills = linear_scan(intervals, allocation.virtuals, pool, assigned);
+		}
+		else{
+			fprintf(stderr, "Error: not enough free registers for virtual registers\n");
+		}
+	}
+
+	Source* allocated = fits ? rewrite_source(source, &allocation, assigned, scratch, spills) : NULL;
+	*spilled = fits ? spills : 0;
+
+	for(uint64_t r = 0; r < 32 + allocation.virtuals; r++){
+		free(targets[r].indices);
+	}
+	free(targets);
+	free(in);
+	free(out);
+	free(intervals);
+	free(assigned);
+	destroy_allocation(&allocation);
+	return allocated;
+}
\ No newline at end of file
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+
+#include "assembler/relocate.h"
+#include "assembler/assembler.h"
+#include "assembler/instruction.h"
+#include "assembler/label.h"
+#include "assembler/reserve.h"
+#include "assembler/debug.h"
+#include "assembler/utils.h"
+#include "common/object.h"
+#include "common/utils.h"
+
+/**
+ * @brief Structure representing a label reference the linker must rewrite.
+ */
+typedef struct Reference {
+	char symbol[256]; /**< label the reference names, without its offset */
+	int64_t addend; /**< offset added to the label's address */
+	bool external; /**< whether another object defines the label */
+} Reference;
+
+/**
+ * @brief Structure representing the symbols and relocations of an object under construction.
+ */
+typedef struct SymbolTable {
+	ObjectSymbol* symbols; /**< the symbols */
+	uint64_t count; /**< number of symbols */
+	HashMap* indices; /**< index of each symbol, by name */
+	ObjectBuffer* strings; /**< the string table of symbol names */
+	Relocation* relocations; /**< the relocations */
+	uint64_t relocationCount; /**< number of relocations */
+} SymbolTable;
+
+Source* extract_globals(Source* source, HashMap* globals){
+	// Programs without .global pass through unchanged
+	if(strstr(source->text, ".global") == NULL){
+		return create_source(source->text, source->size);
+	}
+
+	ObjectBuffer* text = create_object_buffer();
+	char line[256];
+	uint64_t pending = 0;
+
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+		if(strncmp(line, ".global", 7) != 0 || !isspace((unsigned char) line[7])){
+			continue;
+		}
+
+		// Only a comment may follow the label
+		char label[256], extra = ';';
+		int fields = sscanf(line, ".global %255s %c", label, &extra);
+		if(fields < 1 || extra != ';' || label[0] != ':'){
+			fprintf(stderr, "Error: invalid .global format\n");
+			destroy_object_buffer(text);
+			return NULL;
+		}
+
+		if(hashmap_get(globals, label) == NULL){
+			char* name = strdup(label);
+			hashmap_insert(globals, name, create_label(name, 0));
+		}
+
+		// Leave the line blank so later lines keep their numbers
+		buffer_write(text, source->text + pending, source->lineStarts[i] - pending);
+		buffer_write(text, "\n", 1);
+		pending = source->lineStarts[i + 1];
+	}
+	buffer_write(text, source->text + pending, source->size - pending);
+
+	Source* extracted = create_source((char*) text->data, text->position);
+	destroy_object_buffer(text);
+	return extracted;
+}
+
+/**
+ * @brief Splits a label operand into the label and the offset added to it.
+ *
+ * @param defined pointer to the hash map of labels the program defines
+ * @param operand the label operand, as :label, :label+N, or :label-N
+ * @param reference set to the label, its offset, and whether another object defines it
+ */
+static void split_reference(HashMap* defined, const char* operand, Reference* reference){
+	strcpy(reference->symbol, operand);
+	reference->addend = 0;
+	reference->external = hashmap_get(defined, reference->symbol) == NULL;
+	if(!reference->external){
+		return;
+	}
+
+	// Split the offset after the last + or -, as the encoder does
+	const char* split = operand + strlen(operand);
+	while(split > operand && *split != '+' && *split != '-'){
+		split--;
+	}
+	if(split == operand || !is_uint64(split + 1)){
+		return;
+	}
+
+	uint64_t offset = strtoull(split + 1, NULL, 10);
+	reference->symbol[split - operand] = '\0';
+	reference->addend = *split == '+' ? (int64_t) offset : -(int64_t) offset;
+	reference->external = hashmap_get(defined, reference->symbol) == NULL;
+}
+
+/**
+ * @brief Marks every label reference with a label of its own and loads external labels as placeholders.
+ *
+ * The marker labels give the address of each reference once the program is
+ * laid out. Loads of external labels take a placeholder that is wide enough
+ * for the ld to take the wide form, whose payload the linker rewrites.
+ *
+ * @param source pointer to the source program
+ * @param defined pointer to the hash map of labels the program defines
+ * @param references set to the newly allocated references, in program order
+ * @param count set to the number of references
+ * @return Pointer to the newly created source, or NULL if a brr names an external label.
+ */
+static Source* mark_references(Source* source, HashMap* defined, Reference** references, uint64_t* count){
+	ObjectBuffer* text = create_object_buffer();
+	Reference* found = (Reference*) malloc(sizeof(Reference) * (source->count + 1));
+
+	if (found == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Reference\n");
+		exit(1);
+	}
+
+	char line[256], currentDirective = 'N';
+	uint64_t pending = 0;
+	*count = 0;
+
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		if(line[0] == '.'){
+			char directive = process_directive(line);
+			currentDirective = directive == 'R' ? currentDirective : directive;
+		}
+		else if(line[0] == '\t' && currentDirective == 'C' && !is_empty(line) && !is_data(line)){
+			char instrType[10], rd[256], L[256], extra[256];
+			bool load = sscanf(line, "\t %9[^ ,] r%255[^, ] , %255[^, \n] , %255[^ ,\n]", instrType, rd, L, extra) == 3
+				&& strcmp(instrType, "ld") == 0 && L[0] == ':';
+			bool branch = !load && sscanf(line, "\t %9[^ ,] %255[^ ,\n] , %255[^ ,\n]", instrType, L, extra) == 2
+				&& strcmp(instrType, "brr") == 0 && L[0] == ':';
+
+			if(load || branch){
+				Reference* reference = &found[*count];
+				split_reference(defined, L, reference);
+
+				if(branch && reference->external){
+					fprintf(stderr, "Error: brr cannot reach %s in another object; use ld and br\n", reference->symbol);
+					destroy_object_buffer(text);
+					free(found);
+					return NULL;
+				}
+
+				buffer_write(text, source->text + pending, source->lineStarts[i] - pending);
+				pending = source->lineStarts[i];
+
+				char marked[600];
+				snprintf(marked, sizeof(marked), "%s%lu\n", RELOCATION_LABEL, *count);
+				buffer_write(text, marked, strlen(marked));
+				if(reference->external){
+					snprintf(marked, sizeof(marked), "\tld r%s, %ld\n", rd, INT64_MAX);
+					buffer_write(text, marked, strlen(marked));
+					pending = source->lineStarts[i + 1];
+				}
+				(*count)++;
+			}
+		}
+	}
+	buffer_write(text, source->text + pending, source->size - pending);
+
+	*references = found;
+	Source* marked = create_source((char*) text->data, text->position);
+	destroy_object_buffer(text);
+	return marked;
+}
+
+/**
+ * @brief Adds a symbol unless one of the same name was already added.
+ *
+ * @param table pointer to the symbol table
+ * @param name the symbol's name
+ * @param section the symbol's section
+ * @param value the symbol's address
+ * @param global whether other objects may refer to the symbol
+ * @return the index of the symbol
+ */
+static uint64_t add_symbol(SymbolTable* table, const char* name, uint64_t section, uint64_t value, bool global){
+	Label* existing = (Label*) hashmap_get(table->indices, (char*) name);
+	if(existing != NULL){
+		return existing->address;
+	}
+
+	ObjectSymbol* symbol = &table->symbols[table->count];
+	symbol->name = table->strings->position;
+	symbol->section = section;
+	symbol->value = value;
+	symbol->global = global ? 1 : 0;
+	buffer_write(table->strings, name, strlen(name) + 1);
+
+	char* key = strdup(name);
+	hashmap_insert(table->indices, key, create_label(key, table->count));
+	return table->count++;
+}
+
+/**
+ * @brief Builds the symbols and relocations of an assembled program.
+ *
+ * @param table pointer to the symbol table
+ * @param source pointer to the marked source program
+ * @param lhm pointer to the label hash map of the assembled program
+ * @param globals pointer to the hash map of exported labels
+ * @param image the assembled object image
+ * @param references the references, in program order
+ * @param count number of references
+ * @return 0 if successful, -1 otherwise
+ */
+static int build_symbols(SymbolTable* table, Source* source, HashMap* lhm, HashMap* globals, ObjectBuffer* image, const Reference* references, uint64_t count){
+	char line[256];
+
+	// Exported labels come first, in the order they are defined
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+		if(line[0] != ':'){
+			continue;
+		}
+
+		trim(line);
+		Label* label = (Label*) hashmap_get(lhm, line);
+		if(hashmap_get(globals, line) != NULL && label != NULL){
+			add_symbol(table, line, label->address >= INIT_DATA_ADDR ? SECTION_DATA : SECTION_CODE, label->address, true);
+		}
+	}
+
+	uint64_t reservedCount;
+	uint64_t codeOffset = object_code_offset(image->data, image->size, &reservedCount);
+
+	for(uint64_t i = 0; i < count; i++){
+		const Reference* reference = &references[i];
+		char marker[64];
+		snprintf(marker, sizeof(marker), "%s%lu", RELOCATION_LABEL, i);
+		uint64_t address = ((Label*) hashmap_get(lhm, marker))->address;
+
+		// The payload follows the ldw of an ld, or the save of r0 and the ldw of a long brr
+		uint32_t word;
+		memcpy(&word, image->data + codeOffset + address - INIT_CODE_ADDR, sizeof(uint32_t));
+		uint8_t opcode = word >> 27;
+		if(opcode == 0xa){
+			continue;
+		}
+		else if(opcode != 0x1e && opcode != 0x13){
+			fprintf(stderr, "Error: the address of %s is too small to relocate\n", reference->symbol);
+			return -1;
+		}
+
+		Label* label = (Label*) hashmap_get(lhm, (char*) reference->symbol);
+		uint64_t symbol = reference->external ? add_symbol(table, reference->symbol, SECTION_UNDEFINED, 0, true)
+			: add_symbol(table, reference->symbol, label->address >= INIT_DATA_ADDR ? SECTION_DATA : SECTION_CODE, label->address,
+				hashmap_get(globals, (char*) reference->symbol) != NULL);
+
+		Relocation* relocation = &table->relocations[table->relocationCount++];
+		relocation->offset = address - INIT_CODE_ADDR + (opcode == 0x1e ? 4 : 8);
+		relocation->symbol = symbol;
+		relocation->addend = reference->addend;
+	}
+
+	return 0;
+}
+
+int assemble_relocatable(Source* source, ObjectBuffer* out, HashMap* ihm, HashMap* globals, bool debug){
+	char line[256];
+	HashMap* defined = create_hashmap();
+
+	// Collect the labels the program defines itself
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+		if(line[0] == ':'){
+			trim(line);
+			if(hashmap_get(defined, line) == NULL){
+				char* name = strdup(line);
+				hashmap_insert(defined, name, create_label(name, 0));
+			}
+		}
+	}
+
+	// Every exported label must be defined here
+	for(uint32_t i = 0; i < globals->capacity; i++){
+		for(MapEntry* entry = globals->data[i]; entry != NULL; entry = entry->next){
+			if(hashmap_get(defined, entry->key) == NULL){
+				fprintf(stderr, "Error: .global label %s is not defined\n", entry->key);
+				destroy_hashmap(defined, destroy_label);
+				return -1;
+			}
+		}
+	}
+
+	Reference* references = NULL;
+	uint64_t count = 0;
+	Source* marked = mark_references(source, defined, &references, &count);
+	destroy_hashmap(defined, destroy_label);
+	if(marked == NULL){
+		return -1;
+	}
+
+	HashMap* lhm = create_hashmap();
+	TinkerFileHeader* tfh = create_tinker_file_header();
+	ReservedLayout* reserved = NULL;
+	SymbolTable table;
+	memset(&table, 0, sizeof(table));
+	table.symbols = (ObjectSymbol*) malloc(sizeof(ObjectSymbol) * (source->count + count + 1));
+	table.relocations = (Relocation*) malloc(sizeof(Relocation) * (count + 1));
+	table.indices = create_hashmap();
+	table.strings = create_object_buffer();
+
+	if (table.symbols == NULL || table.relocations == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for SymbolTable\n");
+		exit(1);
+	}
+
+	// Assemble the program as usual, then list what the linker rewrites
+	int status = 0;
+	if(layout_reserved(marked, &reserved) != 0 || populate_labels(marked, lhm, tfh, reserved, NULL) != 0){
+		fprintf(stderr, "Error: failed to populate LabelHashMap\n");
+		status = -1;
+	}
+	else if(resolve_program(marked, out, lhm, ihm, tfh, reserved, NULL) != 0){
+		fprintf(stderr, "Error: failed to create object file\n");
+		status = -1;
+	}
+	else if(build_symbols(&table, marked, lhm, globals, out, references, count) != 0 || (debug && append_debug_table(source, out) != 0)){
+		status = -1;
+	}
+	else{
+		TinkerFileHeader header;
+		memcpy(&header, out->data, sizeof(TinkerFileHeader));
+		header.fileType |= FILE_FLAG_RELOCATABLE;
+		buffer_write_at(out, 0, &header, sizeof(TinkerFileHeader));
+
+		// The link table follows the data segment and any debug table
+		LinkTable link = {table.count, table.relocationCount, table.strings->position};
+		out->position = out->size;
+		buffer_write(out, &link, sizeof(LinkTable));
+		buffer_write(out, table.symbols, sizeof(ObjectSymbol) * table.count);
+		buffer_write(out, table.relocations, sizeof(Relocation) * table.relocationCount);
+		buffer_write(out, table.strings->data, table.strings->position);
+	}
+
+	free(table.symbols);
+	free(table.relocations);
+	destroy_hashmap(table.indices, destroy_label);
+	destroy_object_buffer(table.strings);
+	destroy_hashmap(lhm, destroy_label);
+	destroy_reserved_layout(reserved);
+	free(tfh);
+	free(references);
+	destroy_source(marked);
+	return status;
+}
\ No newline at end of file
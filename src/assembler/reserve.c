@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/reserve.h"
+#include "assembler/instruction.h"
+#include "assembler/utils.h"
+
+int reservation_size(const char* line, uint64_t address, uint64_t* size){
+	char directive[10];
+	char operand[32];
+	char extra;
+
+	// Extract the directive and its operand, which only a comment may follow
+	int fields = sscanf(line, ".%9s %31s %c", directive, operand, &extra);
+	if(fields < 2 || (fields == 3 && extra != ';') || !is_uint64(operand)){
+		return -1;
+	}
+
+	uint64_t value = strtoull(operand, NULL, 10);
+	if(strcmp(directive, "space") == 0 || strcmp(directive, "zero") == 0){
+		*size = value;
+		return 0;
+	}
+	// Pad up to the next multiple of a power of two
+	else if(strcmp(directive, "align") == 0 && value != 0 && (value & (value - 1)) == 0){
+		*size = (value - address % value) % value;
+		return 0;
+	}
+
+	return -1;
+}
+
+/**
+ * @brief Adds a reserved range, merging it with the previous one when they touch.
+ *
+ * @param layout pointer to the layout
+ * @param address address of the first reserved byte
+ * @param size number of reserved bytes
+ */
+static void add_reserved_range(ReservedLayout* layout, uint64_t address, uint64_t size){
+	if(size == 0){
+		return;
+	}
+
+	layout->total += size;
+	if(layout->count > 0 && layout->ranges[layout->count - 1].address + layout->ranges[layout->count - 1].size == address){
+		layout->ranges[layout->count - 1].size += size;
+		return;
+	}
+
+	if(layout->count == layout->capacity){
+		layout->capacity = layout->capacity == 0 ? 16 : layout->capacity * 2;
+		layout->ranges = (ReservedRange*) realloc(layout->ranges, sizeof(ReservedRange) * layout->capacity);
+
+		if (layout->ranges == NULL) {
+			// Print error message and exit if memory allocation fails
+			fprintf(stderr, "Error: failed to allocate memory for ReservedRange\n");
+			exit(1);
+		}
+	}
+
+	layout->ranges[layout->count].address = address;
+	layout->ranges[layout->count].size = size;
+	layout->count++;
+}
+
+int layout_reserved(Source* source, ReservedLayout** layout){
+	ReservedLayout* reserved = (ReservedLayout*) calloc(1, sizeof(ReservedLayout));
+
+	if (reserved == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for ReservedLayout\n");
+		exit(1);
+	}
+
+	reserved->sizes = (uint64_t*) calloc(source->count + 1, sizeof(uint64_t));
+	if (reserved->sizes == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for reserved sizes\n");
+		exit(1);
+	}
+
+	char line[256];
+	char currentDirective = 'N';
+	uint64_t dataAddress = INIT_DATA_ADDR;
+	*layout = NULL;
+
+	for(uint64_t i = 0; i < source->count; i++){
+		source_get_line(source, i, line, sizeof(line));
+
+		// Every data line takes one word
+		if(line[0] == '\t' && !is_empty(line)){
+			dataAddress += currentDirective == 'D' ? sizeof(uint64_t) : 0;
+			continue;
+		}
+		else if(line[0] != '.'){
+			continue;
+		}
+
+		char directive = process_directive(line);
+		if(directive != 'R'){
+			currentDirective = directive;
+			continue;
+		}
+
+		if(currentDirective != 'D'){
+			fprintf(stderr, "Error: .space, .zero, and .align must be under a .data directive\n");
+			destroy_reserved_layout(reserved);
+			return -1;
+		}
+
+		uint64_t size;
+		reservation_size(line, dataAddress, &size);
+		if(size > UINT64_MAX - dataAddress){
+			fprintf(stderr, "Error: reserved data does not fit in the address space\n");
+			destroy_reserved_layout(reserved);
+			return -1;
+		}
+
+		reserved->sizes[i] = size;
+		add_reserved_range(reserved, dataAddress, size);
+		dataAddress += size;
+	}
+
+	*layout = reserved;
+	return 0;
+}
+
+uint64_t reserved_table_size(const ReservedLayout* layout){
+	return layout->count == 0 ? 0 : sizeof(uint64_t) + layout->count * sizeof(ReservedRange);
+}
+
+uint64_t reserved_below(const ReservedLayout* layout, uint64_t address){
+	uint64_t below = 0;
+
+	// A merged range may straddle the address, so only count the part under it
+	for(uint64_t i = 0; i < layout->count && layout->ranges[i].address < address; i++){
+		uint64_t end = layout->ranges[i].address + layout->ranges[i].size;
+		below += (end < address ? end : address) - layout->ranges[i].address;
+	}
+
+	return below;
+}
+
+void write_reserved_table(ObjectBuffer* out, const ReservedLayout* layout, TinkerFileHeader* tfh){
+	// Files without reservations keep the plain header
+	if(layout->count == 0){
+		return;
+	}
+
+	tfh->fileType |= FILE_FLAG_RESERVED;
+	buffer_write_at(out, sizeof(TinkerFileHeader), &layout->count, sizeof(uint64_t));
+	buffer_write_at(out, sizeof(TinkerFileHeader) + sizeof(uint64_t), layout->ranges, layout->count * sizeof(ReservedRange));
+}
+
+void destroy_reserved_layout(ReservedLayout* layout){
+	if(layout == NULL){
+		return;
+	}
+
+	free(layout->sizes);
+	free(layout->ranges);
+	free(layout);
+}
\ No newline at end of file
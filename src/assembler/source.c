@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "assembler/source.h"
+
+/**
+ * @brief Builds a source that takes ownership of a null-terminated text buffer.
+ * 
+ * @param copy the source text, with room for the terminator at copy[size]
+ * @param size the size of the source text in bytes
+ * @return Pointer to the newly created source.
+ */
+static Source* build_source(char* copy, uint64_t size){
+	Source* source = (Source*) malloc(sizeof(Source));
+
+	if (source == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Source\n");
+		exit(1);
+	}
+
+	copy[size] = '\0';
+
+	// Count the lines so the line table is allocated once
+	uint64_t count = 0;
+	for(uint64_t i = 0; i < size; i++){
+		if(copy[i] == '\n'){
+			count++;
+		}
+	}
+	if(size > 0 && copy[size - 1] != '\n'){
+		count++;
+	}
+
+	source->lineStarts = (uint64_t*) malloc(sizeof(uint64_t) * (count + 1));
+	if (source->lineStarts == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Source lines\n");
+		exit(1);
+	}
+
+	// Record where each line begins, with a sentinel at the end of the text
+	uint64_t line = 0;
+	for(uint64_t i = 0; i < size; i++){
+		if(i == 0 || copy[i - 1] == '\n'){
+			source->lineStarts[line++] = i;
+		}
+	}
+	source->lineStarts[count] = size;
+
+	source->text = copy;
+	source->size = size;
+	source->count = count;
+	return source;
+}
+
+Source* create_source(const char* text, uint64_t size){
+	char* copy = (char*) malloc(size + 1);
+
+	if (copy == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Source\n");
+		exit(1);
+	}
+
+	memcpy(copy, text, size);
+	return build_source(copy, size);
+}
+
+Source* read_source(FILE* in){
+	uint64_t capacity = 4096, size = 0;
+	char* text = (char*) malloc(capacity);
+
+	if (text == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Source\n");
+		exit(1);
+	}
+
+	// Read the whole stream, keeping one spare byte for the terminator
+	size_t read;
+	while((read = fread(text + size, 1, capacity - size - 1, in)) > 0){
+		size += read;
+
+		if(size == capacity - 1){
+			capacity *= 2;
+			char* grown = (char*) realloc(text, capacity);
+
+			if (grown == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for Source\n");
+				exit(1);
+			}
+
+			text = grown;
+		}
+	}
+
+	if(ferror(in)){
+		free(text);
+		return NULL;
+	}
+
+	return build_source(text, size);
+}
+
+void source_get_line(Source* source, uint64_t index, char* line, uint64_t size){
+	uint64_t start = source->lineStarts[index];
+	uint64_t length = source->lineStarts[index + 1] - start;
+
+	// Truncate overly long lines the same way a fixed fgets buffer would
+	if(length > size - 1){
+		length = size - 1;
+	}
+
+	memcpy(line, source->text + start, length);
+	line[length] = '\0';
+}
+
+void destroy_source(Source* source){
+	if(source == NULL){
+		return;
+	}
+
+	free(source->text);
+	free(source->lineStarts);
+	free(source);
+}
\ No newline at end of file
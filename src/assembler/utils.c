@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
@@ -63,29 +64,26 @@ void trim(char* str) {
 	}
 }
 
-bool is_uint64(const char* str) {
-	// Check if the string is NULL or empty
-	if (str == NULL || *str == '\0') {
-		return false;
+int split_instruction(const char* line, char mnemonic[10], char operands[][256], int maxOperands){
+	char rest[256] = "";
+	if(sscanf(line, "\t %9s %255[^\n]", mnemonic, rest) < 1){
+		return -1;
 	}
 
-	// Check if the string contains only digits
-	const char* ptr = str;
-	while (*ptr) {
-		if (!isdigit((unsigned char)*ptr)) {
-			return false;
+	// strtok_r keeps its position in save, so batch workers do not share it
+	int count = 0;
+	char* save = NULL;
+	for(char* token = strtok_r(rest, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)){
+		if(count == maxOperands){
+			return -1;
 		}
-		ptr++;
-	}
 
-	errno = 0;
-	// Convert the string to an unsigned long long and check if it fits in 64 bits
-	unsigned long long val = strtoull(str, NULL, 10);
-	if (errno == ERANGE || val > UINT64_MAX || errno == EINVAL) {
-		return false;
+		strcpy(operands[count], token);
+		trim(operands[count]);
+		count++;
 	}
 
-	return true;
+	return count;
 }
 
 bool is_valid_register(const char* reg){
@@ -97,21 +95,66 @@ bool is_valid_register(const char* reg){
 	return (val >= 0 && val <= 31);
 }
 
+bool resolve_label(HashMap* lhm, const char* operand, uint64_t* address){
+	Label* label = (Label*) hashmap_get(lhm, (char*) operand);
+	if (label != NULL) {
+		*address = label->address;
+		return true;
+	}
+
+	// Otherwise split a constant offset off the end of the label
+	const char* sign = operand + strlen(operand);
+	while (sign > operand && *sign != '+' && *sign != '-') {
+		sign--;
+	}
+	if (sign == operand || !is_uint64(sign + 1) || (uint64_t) (sign - operand) >= 256) {
+		return false;
+	}
+
+	char name[256];
+	memcpy(name, operand, sign - operand);
+	name[sign - operand] = '\0';
+
+	label = (Label*) hashmap_get(lhm, name);
+	if (label == NULL) {
+		return false;
+	}
+
+	uint64_t offset = strtoull(sign + 1, NULL, 10);
+	*address = *sign == '+' ? label->address + offset : label->address - offset;
+	return true;
+}
+
+uint64_t literal_value(HashMap* lhm, const char* L){
+	uint64_t address = 0;
+
+	// Labels resolve to their address, numbers to their (possibly negative) value
+	if (L[0] == ':') {
+		resolve_label(lhm, L, &address);
+		return address;
+	}
+
+	return L[0] == '-' ? (uint64_t) strtoll(L, NULL, 10) : strtoull(L, NULL, 10);
+}
+
 bool is_valid_literal(HashMap* lhm, char* instruction, char* L){
 	// Check if the literal is a label
 	if (L[0] == ':') {
-		if(hashmap_get(lhm, L) == NULL){
+		uint64_t address;
+		if(!resolve_label(lhm, L, &address)){
 			return false;
 		}
-
-		uint64_t address = ((Label*) hashmap_get(lhm, L))->address;
 		
 		// Check if the label address is invalid
 		if (address == -1) {
 			return false;
 		}
+		// Branches to labels are relative, with out of range targets taking the long form
+		else if (strcmp(instruction, "brr") == 0) {
+			return true;
+		}
 		// Check if the address is within range for specific instructions
-		else if (strcmp(instruction, "brr") == 0 || strcmp(instruction, "mov") == 0) {
+		else if (strcmp(instruction, "mov") == 0) {
 			if(address > 2047){
 				return false;
 			}
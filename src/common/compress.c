@@ -0,0 +1,148 @@
+#include <string.h>
+
+#include "common/compress.h"
+#include "common/object.h"
+
+#define MAX_VARINT_SIZE 10
+
+/**
+ * @brief Writes a value as a little-endian base-128 varint.
+ *
+ * @param value the value to write
+ * @param out receives at most MAX_VARINT_SIZE bytes
+ * @return the number of bytes written
+ */
+static uint64_t write_varint(uint64_t value, uint8_t* out){
+	uint64_t size = 0;
+	while(value >= 0x80){
+		out[size++] = (uint8_t) (value | 0x80);
+		value >>= 7;
+	}
+
+	out[size++] = (uint8_t) value;
+	return size;
+}
+
+/**
+ * @brief Reads a varint from the stored bytes of a data segment.
+ *
+ * @param decoder pointer to the decoder
+ * @param value set to the value read
+ * @return 0 if successful, -1 if the varint is truncated or too long
+ */
+static int read_varint(DataDecoder* decoder, uint64_t* value){
+	*value = 0;
+
+	for(uint64_t shift = 0; shift < 7 * MAX_VARINT_SIZE && decoder->position < decoder->size; shift += 7){
+		uint8_t byte = decoder->stream[decoder->position++];
+		*value |= (uint64_t) (byte & 0x7f) << shift;
+
+		if((byte & 0x80) == 0){
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+uint64_t encoded_data_bound(uint64_t size){
+	return size / 8 * MAX_VARINT_SIZE;
+}
+
+uint64_t encode_data(const uint8_t* data, uint64_t size, uint8_t* out){
+	uint64_t written = 0, previous = 0;
+
+	for(uint64_t offset = 0; offset + 8 <= size; ){
+		uint64_t word;
+		memcpy(&word, data + offset, sizeof(uint64_t));
+
+		// Words that repeat the previous one collapse into a single run
+		if(word == previous){
+			uint64_t count = 0;
+			while(offset + 8 <= size && memcmp(data + offset, &previous, sizeof(uint64_t)) == 0){
+				count++;
+				offset += 8;
+			}
+
+			written += write_varint(0, out + written);
+			written += write_varint(count, out + written);
+			continue;
+		}
+
+		// Zigzag encoding keeps small negative differences short too
+		int64_t difference = (int64_t) (word - previous);
+		written += write_varint(((uint64_t) difference << 1) ^ (uint64_t) (difference >> 63), out + written);
+		previous = word;
+		offset += 8;
+	}
+
+	return written;
+}
+
+int open_data_segment(DataDecoder* decoder, const uint8_t* image, uint64_t size){
+	memset(decoder, 0, sizeof(DataDecoder));
+
+	uint64_t offset = object_data_offset(image, size, &decoder->size);
+	if(offset == 0){
+		return -1;
+	}
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+	decoder->stream = image + offset;
+	decoder->compressed = (tfh.fileType & FILE_FLAG_COMPRESSED) != 0;
+
+	// Compressed segments only ever hold whole words
+	if(decoder->compressed && tfh.dataSize % 8 != 0){
+		return -1;
+	}
+
+	return 0;
+}
+
+int decode_data(DataDecoder* decoder, uint8_t* out, uint64_t size){
+	if(!decoder->compressed){
+		if(size > decoder->size - decoder->position){
+			return -1;
+		}
+
+		memcpy(out, decoder->stream + decoder->position, size);
+		decoder->position += size;
+		return 0;
+	}
+
+	if(size % 8 != 0){
+		return -1;
+	}
+
+	for(uint64_t offset = 0; offset < size; offset += 8){
+		if(decoder->repeat > 0){
+			decoder->repeat--;
+		}
+		else{
+			uint64_t value;
+			if(read_varint(decoder, &value) != 0){
+				return -1;
+			}
+
+			if(value == 0){
+				// A run repeats the previous word at least once
+				if(read_varint(decoder, &decoder->repeat) != 0 || decoder->repeat == 0){
+					return -1;
+				}
+				decoder->repeat--;
+			}
+			else{
+				decoder->previous += (value >> 1) ^ (0 - (value & 1));
+			}
+		}
+
+		memcpy(out + offset, &decoder->previous, sizeof(uint64_t));
+	}
+
+	return 0;
+}
+
+bool data_segment_finished(const DataDecoder* decoder){
+	return decoder->position == decoder->size && decoder->repeat == 0;
+}
\ No newline at end of file
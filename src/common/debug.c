@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/debug.h"
+
+DebugInfo* read_debug_info(const uint8_t* image, uint64_t size){
+	DebugTable table;
+	uint64_t offset = object_debug_offset(image, size, &table);
+	if(offset == 0){
+		return NULL;
+	}
+
+	const uint8_t* strings = image + offset + table.symbolCount * sizeof(DebugSymbol) + table.lineCount * sizeof(DebugLine);
+	DebugInfo* debug = (DebugInfo*) malloc(sizeof(DebugInfo));
+	if (debug == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for DebugInfo\n");
+		exit(1);
+	}
+
+	debug->symbols = (DebugSymbol*) malloc(sizeof(DebugSymbol) * (table.symbolCount + 1));
+	debug->lines = (DebugLine*) malloc(sizeof(DebugLine) * (table.lineCount + 1));
+	debug->strings = (char*) malloc(table.stringSize + 1);
+	if (debug->symbols == NULL || debug->lines == NULL || debug->strings == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for DebugInfo\n");
+		exit(1);
+	}
+
+	debug->symbolCount = table.symbolCount;
+	debug->lineCount = table.lineCount;
+	memcpy(debug->symbols, image + offset, table.symbolCount * sizeof(DebugSymbol));
+	memcpy(debug->lines, image + offset + table.symbolCount * sizeof(DebugSymbol), table.lineCount * sizeof(DebugLine));
+	memcpy(debug->strings, strings, table.stringSize);
+	debug->strings[table.stringSize] = '\0';
+
+	// Every name must start inside the string table, and both tables must be in address order
+	for(uint64_t i = 0; i < debug->symbolCount; i++){
+		if(debug->symbols[i].name >= table.stringSize || (i > 0 && debug->symbols[i].address < debug->symbols[i - 1].address)){
+			destroy_debug_info(debug);
+			return NULL;
+		}
+	}
+	for(uint64_t i = 1; i < debug->lineCount; i++){
+		if(debug->lines[i].address < debug->lines[i - 1].address){
+			destroy_debug_info(debug);
+			return NULL;
+		}
+	}
+
+	return debug;
+}
+
+/**
+ * @brief Finds the last entry of an address-ordered table at or before an address.
+ * 
+ * @param table the table, whose entries start with their address
+ * @param count number of entries
+ * @param stride size of each entry in bytes
+ * @param address the address to look up
+ * @return the index of the entry, or count if every entry is after the address
+ */
+static uint64_t find_entry(const void* table, uint64_t count, uint64_t stride, uint64_t address){
+	uint64_t low = 0, high = count;
+	while(low < high){
+		uint64_t middle = low + (high - low) / 2;
+		uint64_t entry;
+		memcpy(&entry, (const uint8_t*) table + middle * stride, sizeof(uint64_t));
+
+		if(entry <= address){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+
+	return low == 0 ? count : low - 1;
+}
+
+int describe_address(const DebugInfo* debug, uint64_t address, char* description, uint64_t size){
+	uint64_t symbol = find_entry(debug->symbols, debug->symbolCount, sizeof(DebugSymbol), address);
+	uint64_t line = find_entry(debug->lines, debug->lineCount, sizeof(DebugLine), address);
+	if(symbol == debug->symbolCount && line == debug->lineCount){
+		return -1;
+	}
+
+	char label[300] = "", number[64] = "";
+	if(symbol != debug->symbolCount){
+		uint64_t offset = address - debug->symbols[symbol].address;
+		const char* name = debug->strings + debug->symbols[symbol].name;
+		if(offset > 0){
+			snprintf(label, sizeof(label), "%.255s+%lu", name, offset);
+		}
+		else{
+			snprintf(label, sizeof(label), "%.255s", name);
+		}
+	}
+	if(line != debug->lineCount){
+		snprintf(number, sizeof(number), "%sline %lu%s", label[0] != '\0' ? " (" : "", debug->lines[line].line, label[0] != '\0' ? ")" : "");
+	}
+
+	snprintf(description, size, "%s%s", label, number);
+	return 0;
+}
+
+void destroy_debug_info(DebugInfo* debug){
+	if(debug == NULL){
+		return;
+	}
+
+	free(debug->symbols);
+	free(debug->lines);
+	free(debug->strings);
+	free(debug);
+}
\ No newline at end of file
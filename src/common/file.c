@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "common/file.h"
+
+/**
+ * @brief Reads the rest of a file into a newly allocated buffer.
+ * 
+ * @param fd the file descriptor
+ * @param file pointer to the mapped file receiving the contents
+ * @return 0 if successful, -1 otherwise
+ */
+static int read_file(int fd, MappedFile* file){
+	uint64_t capacity = 4096, size = 0;
+	uint8_t* data = (uint8_t*) malloc(capacity);
+
+	if (data == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for file contents\n");
+		exit(1);
+	}
+
+	ssize_t bytes;
+	while((bytes = read(fd, data + size, capacity - size)) > 0){
+		size += bytes;
+
+		if(size == capacity){
+			capacity *= 2;
+			uint8_t* grown = (uint8_t*) realloc(data, capacity);
+
+			if (grown == NULL) {
+				// Print error message and exit if memory allocation fails
+				fprintf(stderr, "Error: failed to allocate memory for file contents\n");
+				exit(1);
+			}
+
+			data = grown;
+		}
+	}
+
+	if(bytes < 0){
+		free(data);
+		return -1;
+	}
+
+	file->data = data;
+	file->size = size;
+	file->mapped = false;
+	return 0;
+}
+
+MappedFile* map_file(const char* path){
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		return NULL;
+	}
+
+	MappedFile* file = (MappedFile*) malloc(sizeof(MappedFile));
+	if (file == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for MappedFile\n");
+		exit(1);
+	}
+
+	// Map regular files whole; the contents are read once, front to back
+	struct stat info;
+	void* data = MAP_FAILED;
+	if(fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0){
+		data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+
+	int status = 0;
+	if(data != MAP_FAILED){
+		madvise(data, info.st_size, MADV_SEQUENTIAL);
+		file->data = (const uint8_t*) data;
+		file->size = info.st_size;
+		file->mapped = true;
+	}
+	else{
+		status = read_file(fd, file);
+	}
+
+	close(fd);
+	if(status != 0){
+		free(file);
+		return NULL;
+	}
+
+	return file;
+}
+
+void unmap_file(MappedFile* file){
+	if(file == NULL){
+		return;
+	}
+
+	if(file->mapped){
+		munmap((void*) file->data, file->size);
+	}
+	else{
+		free((void*) file->data);
+	}
+	free(file);
+}
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/object.h"
+
+TinkerFileHeader* create_tinker_file_header(){
+	TinkerFileHeader* tfh = (TinkerFileHeader*) malloc(sizeof(TinkerFileHeader));
+
+	if (tfh == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Failed to allocate memory for TinkerFileHeader\n");
+		exit(1);
+	}
+	
+	// Initialize file header
+	tfh->fileType = FILE_TYPE;
+	tfh->codeBegin = INIT_CODE_ADDR;
+	tfh->codeSize = 0;
+	tfh->dataBegin = INIT_DATA_ADDR;
+	tfh->dataSize = 0;
+
+	return tfh;
+}
+
+uint64_t object_code_offset(const uint8_t* image, uint64_t size, uint64_t* reservedCount){
+	*reservedCount = 0;
+
+	// Check that the image holds a complete file header of a known type
+	if(size < sizeof(TinkerFileHeader)){
+		return 0;
+	}
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+	if((tfh.fileType & ~(uint64_t) FILE_FLAGS) != FILE_TYPE){
+		return 0;
+	}
+
+	uint64_t offset = sizeof(TinkerFileHeader);
+	if(tfh.fileType & FILE_FLAG_RESERVED){
+		// Check that the whole range table is present
+		if(size - offset < sizeof(uint64_t)){
+			return 0;
+		}
+
+		memcpy(reservedCount, image + offset, sizeof(uint64_t));
+		offset += sizeof(uint64_t);
+
+		if(*reservedCount > (size - offset) / sizeof(ReservedRange)){
+			*reservedCount = 0;
+			return 0;
+		}
+		offset += *reservedCount * sizeof(ReservedRange);
+	}
+
+	return offset;
+}
+
+ReservedRange object_reserved_range(const uint8_t* image, uint64_t index){
+	ReservedRange range;
+	memcpy(&range, image + sizeof(TinkerFileHeader) + sizeof(uint64_t) + index * sizeof(ReservedRange), sizeof(ReservedRange));
+	return range;
+}
+
+uint64_t object_data_offset(const uint8_t* image, uint64_t size, uint64_t* storedSize){
+	*storedSize = 0;
+
+	uint64_t reservedCount;
+	uint64_t offset = object_code_offset(image, size, &reservedCount);
+	if(offset == 0){
+		return 0;
+	}
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+	if(tfh.codeSize > size - offset){
+		return 0;
+	}
+	offset += tfh.codeSize;
+
+	// A compressed data segment starts with the number of bytes it takes
+	uint64_t stored = tfh.dataSize;
+	if(tfh.fileType & FILE_FLAG_COMPRESSED){
+		if(size - offset < sizeof(uint64_t)){
+			return 0;
+		}
+
+		memcpy(&stored, image + offset, sizeof(uint64_t));
+		offset += sizeof(uint64_t);
+	}
+
+	if(stored > size - offset){
+		return 0;
+	}
+
+	*storedSize = stored;
+	return offset;
+}
+
+/**
+ * @brief Finds where the segments of an object image end.
+ * 
+ * @param image the object file image, starting with its header
+ * @param size size of the image in bytes
+ * @return the offset of the first byte after the data segment, or 0 if the image is malformed
+ */
+static uint64_t segments_end(const uint8_t* image, uint64_t size){
+	uint64_t storedSize;
+	uint64_t offset = object_data_offset(image, size, &storedSize);
+	return offset == 0 ? 0 : offset + storedSize;
+}
+
+uint64_t object_debug_offset(const uint8_t* image, uint64_t size, DebugTable* table){
+	memset(table, 0, sizeof(DebugTable));
+
+	uint64_t offset = segments_end(image, size);
+	TinkerFileHeader tfh;
+	if(offset == 0){
+		return 0;
+	}
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+	if((tfh.fileType & FILE_FLAG_DEBUG) == 0 || size - offset < sizeof(DebugTable)){
+		return 0;
+	}
+
+	// Check that the table and everything it counts is present
+	memcpy(table, image + offset, sizeof(DebugTable));
+	offset += sizeof(DebugTable);
+
+	uint64_t remaining = size - offset;
+	if(table->symbolCount > remaining / sizeof(DebugSymbol)){
+		return 0;
+	}
+	remaining -= table->symbolCount * sizeof(DebugSymbol);
+	if(table->lineCount > remaining / sizeof(DebugLine)){
+		return 0;
+	}
+	remaining -= table->lineCount * sizeof(DebugLine);
+	if(table->stringSize > remaining){
+		return 0;
+	}
+
+	return offset;
+}
+
+uint64_t object_link_offset(const uint8_t* image, uint64_t size, LinkTable* table){
+	memset(table, 0, sizeof(LinkTable));
+
+	uint64_t offset = segments_end(image, size);
+	TinkerFileHeader tfh;
+	if(offset == 0){
+		return 0;
+	}
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+	if((tfh.fileType & FILE_FLAG_RELOCATABLE) == 0){
+		return 0;
+	}
+
+	// Skip the debug table, which comes first
+	if(tfh.fileType & FILE_FLAG_DEBUG){
+		DebugTable debug;
+		offset = object_debug_offset(image, size, &debug);
+		if(offset == 0){
+			return 0;
+		}
+		offset += debug.symbolCount * sizeof(DebugSymbol) + debug.lineCount * sizeof(DebugLine) + debug.stringSize;
+	}
+
+	// Check that the table and everything it counts is present
+	if(size - offset < sizeof(LinkTable)){
+		return 0;
+	}
+	memcpy(table, image + offset, sizeof(LinkTable));
+	offset += sizeof(LinkTable);
+
+	uint64_t remaining = size - offset;
+	if(table->symbolCount > remaining / sizeof(ObjectSymbol)){
+		return 0;
+	}
+	remaining -= table->symbolCount * sizeof(ObjectSymbol);
+	if(table->relocationCount > remaining / sizeof(Relocation)){
+		return 0;
+	}
+	remaining -= table->relocationCount * sizeof(Relocation);
+	if(table->stringSize != remaining){
+		return 0;
+	}
+
+	return offset;
+}
\ No newline at end of file
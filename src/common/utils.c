@@ -4,7 +4,7 @@
 #include <stdint.h>
 #include <errno.h>
 
-#include "simulator/utils.h"
+#include "common/utils.h"
 
 bool is_uint64(const char* str) {
 	// Check if the string is NULL or empty
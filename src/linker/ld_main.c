@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "linker/linker.h"
+
+int main(int argc, char* argv[]){
+	// Check for the output file and at least one object file
+	if(argc < 4 || strcmp(argv[1], "-o") != 0){
+		fprintf(stderr, "Please include -o, an output object file, and the relocatable object files to link\n");
+		exit(1);
+	}
+
+	if(link_object_files((const char* const*) &argv[3], argc - 3, argv[2]) != 0){
+		fprintf(stderr, "Linking failed; %s was not written\n", argv[2]);
+		return 1;
+	}
+
+	return 0;
+}
\ No newline at end of file
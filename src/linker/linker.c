@@ -0,0 +1,361 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "linker/linker.h"
+#include "assembler/assembler.h"
+#include "assembler/hashmap.h"
+#include "assembler/label.h"
+#include "assembler/compress.h"
+#include "common/object.h"
+#include "common/file.h"
+#include "common/compress.h"
+
+/**
+ * @brief Structure representing a relocatable object being linked.
+ */
+typedef struct LinkObject {
+	const uint8_t* image; /**< the object image */
+	const char* name; /**< name of the object, for error messages */
+	TinkerFileHeader header; /**< the object's file header */
+	uint64_t reservedCount; /**< number of reserved ranges */
+	uint64_t codeOffset; /**< offset of the code segment in the image */
+	DataDecoder data; /**< read position in the data segment, which may be compressed */
+	LinkTable table; /**< the object's link table */
+	uint64_t linkOffset; /**< offset of the first symbol in the image */
+	uint64_t dataSpan; /**< bytes of data, reserved ranges included */
+	uint64_t codeBase; /**< address the code segment is placed at */
+	uint64_t dataBase; /**< address the data segment is placed at */
+} LinkObject;
+
+/**
+ * @brief Reads one symbol of an object.
+ *
+ * @param object pointer to the object
+ * @param index index of the symbol
+ * @return the symbol
+ */
+static ObjectSymbol read_symbol(const LinkObject* object, uint64_t index){
+	ObjectSymbol symbol;
+	memcpy(&symbol, object->image + object->linkOffset + index * sizeof(ObjectSymbol), sizeof(ObjectSymbol));
+	return symbol;
+}
+
+/**
+ * @brief Reads one relocation of an object.
+ *
+ * @param object pointer to the object
+ * @param index index of the relocation
+ * @return the relocation
+ */
+static Relocation read_relocation(const LinkObject* object, uint64_t index){
+	Relocation relocation;
+	memcpy(&relocation, object->image + object->linkOffset + object->table.symbolCount * sizeof(ObjectSymbol) + index * sizeof(Relocation), sizeof(Relocation));
+	return relocation;
+}
+
+/**
+ * @brief Finds the string table of an object.
+ *
+ * @param object pointer to the object
+ * @return the first byte of the string table
+ */
+static const char* string_table(const LinkObject* object){
+	return (const char*) object->image + object->linkOffset + object->table.symbolCount * sizeof(ObjectSymbol)
+		+ object->table.relocationCount * sizeof(Relocation);
+}
+
+/**
+ * @brief Reads and checks the header, reserved ranges, and link table of an object.
+ *
+ * @param object pointer to the object, with its image and name set
+ * @param size size of the image in bytes
+ * @return 0 if successful, -1 if the object is not relocatable or is malformed
+ */
+static int read_object(LinkObject* object, uint64_t size){
+	object->codeOffset = object_code_offset(object->image, size, &object->reservedCount);
+	object->linkOffset = object_link_offset(object->image, size, &object->table);
+	if(object->codeOffset == 0 || object->linkOffset == 0 || open_data_segment(&object->data, object->image, size) != 0){
+		fprintf(stderr, "Error: %s is not a relocatable object; assemble it with -c\n", object->name);
+		return -1;
+	}
+	memcpy(&object->header, object->image, sizeof(TinkerFileHeader));
+
+	// The reserved ranges must lie in order around the data
+	uint64_t address = INIT_DATA_ADDR, remaining = object->header.dataSize;
+	object->dataSpan = object->header.dataSize;
+	for(uint64_t i = 0; i < object->reservedCount; i++){
+		ReservedRange range = object_reserved_range(object->image, i);
+		if(range.address < address || range.address - address > remaining || range.size > UINT64_MAX - range.address){
+			fprintf(stderr, "Error: the reserved ranges of %s are out of bounds\n", object->name);
+			return -1;
+		}
+
+		remaining -= range.address - address;
+		address = range.address + range.size;
+		object->dataSpan += range.size;
+	}
+
+	// Every name must end inside the string table
+	const char* strings = string_table(object);
+	for(uint64_t i = 0; i < object->table.symbolCount; i++){
+		ObjectSymbol symbol = read_symbol(object, i);
+		if(symbol.name >= object->table.stringSize || memchr(strings + symbol.name, '\0', object->table.stringSize - symbol.name) == NULL
+			|| symbol.section > SECTION_DATA){
+			fprintf(stderr, "Error: the symbol table of %s is malformed\n", object->name);
+			return -1;
+		}
+	}
+
+	// Every relocation must rewrite a payload inside the code segment
+	for(uint64_t i = 0; i < object->table.relocationCount; i++){
+		Relocation relocation = read_relocation(object, i);
+		if(relocation.symbol >= object->table.symbolCount || relocation.offset > object->header.codeSize
+			|| object->header.codeSize - relocation.offset < sizeof(uint64_t)){
+			fprintf(stderr, "Error: the relocations of %s are malformed\n", object->name);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Finds the linked address of a symbol an object defines.
+ *
+ * @param object pointer to the object
+ * @param symbol the symbol
+ * @return the address of the symbol once its object is placed
+ */
+static uint64_t placed_address(const LinkObject* object, const ObjectSymbol* symbol){
+	return symbol->section == SECTION_DATA ? symbol->value - INIT_DATA_ADDR + object->dataBase
+		: symbol->value - INIT_CODE_ADDR + object->codeBase;
+}
+
+/**
+ * @brief Adds a reserved range, merging it with the previous range when they touch.
+ *
+ * @param ranges pointer to the object buffer of reserved ranges
+ * @param address address of the first reserved byte
+ * @param size number of reserved bytes
+ */
+static void add_reserved_range(ObjectBuffer* ranges, uint64_t address, uint64_t size){
+	if(ranges->position >= sizeof(ReservedRange)){
+		ReservedRange last;
+		memcpy(&last, ranges->data + ranges->position - sizeof(ReservedRange), sizeof(ReservedRange));
+
+		if(last.address + last.size == address){
+			last.size += size;
+			buffer_write_at(ranges, ranges->position - sizeof(ReservedRange), &last, sizeof(ReservedRange));
+			return;
+		}
+	}
+
+	ReservedRange range = {address, size};
+	buffer_write(ranges, &range, sizeof(ReservedRange));
+}
+
+/**
+ * @brief Exports the global symbols of every object under their linked addresses.
+ *
+ * @param objects the placed objects
+ * @param count number of objects
+ * @param globals pointer to the hash map receiving every global symbol
+ * @return 0 if successful, -1 if a symbol is defined by more than one object
+ */
+static int export_globals(const LinkObject* objects, uint64_t count, HashMap* globals){
+	for(uint64_t i = 0; i < count; i++){
+		for(uint64_t j = 0; j < objects[i].table.symbolCount; j++){
+			ObjectSymbol symbol = read_symbol(&objects[i], j);
+			if(!symbol.global || symbol.section == SECTION_UNDEFINED){
+				continue;
+			}
+
+			const char* name = string_table(&objects[i]) + symbol.name;
+			if(hashmap_get(globals, (char*) name) != NULL){
+				fprintf(stderr, "Error: symbol %s is defined by more than one object\n", name);
+				return -1;
+			}
+
+			char* key = strdup(name);
+			hashmap_insert(globals, key, create_label(key, placed_address(&objects[i], &symbol)));
+		}
+	}
+
+	return 0;
+}
+
+int link_images(const uint8_t* const* images, const uint64_t* sizes, const char* const* names, uint64_t count, ObjectBuffer* out){
+	LinkObject* objects = (LinkObject*) malloc(sizeof(LinkObject) * (count + 1));
+
+	if (objects == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for LinkObject\n");
+		exit(1);
+	}
+
+	// Place the code segments back to back and the data segments on 8-byte boundaries
+	uint64_t codeAddress = INIT_CODE_ADDR, dataAddress = INIT_DATA_ADDR;
+	for(uint64_t i = 0; i < count; i++){
+		objects[i].image = images[i];
+		objects[i].name = names[i];
+		if(read_object(&objects[i], sizes[i]) != 0){
+			free(objects);
+			return -1;
+		}
+
+		objects[i].codeBase = codeAddress;
+		objects[i].dataBase = (dataAddress + 7) & ~7ULL;
+		codeAddress += objects[i].header.codeSize;
+		dataAddress = objects[i].dataBase + objects[i].dataSpan;
+	}
+
+	if(codeAddress - INIT_CODE_ADDR > INIT_DATA_ADDR - INIT_CODE_ADDR){
+		fprintf(stderr, "Error: the linked code segment is too large\n");
+		free(objects);
+		return -1;
+	}
+
+	HashMap* globals = create_hashmap();
+	if(export_globals(objects, count, globals) != 0){
+		destroy_hashmap(globals, destroy_label);
+		free(objects);
+		return -1;
+	}
+
+	ObjectBuffer* code = create_object_buffer();
+	ObjectBuffer* data = create_object_buffer();
+	ObjectBuffer* ranges = create_object_buffer();
+	int status = 0;
+
+	for(uint64_t i = 0; i < count && status == 0; i++){
+		LinkObject* object = &objects[i];
+		uint64_t codeStart = code->position;
+		buffer_write(code, object->image + object->codeOffset, object->header.codeSize);
+
+		// Rewrite each payload with the placed address of its symbol
+		for(uint64_t j = 0; j < object->table.relocationCount; j++){
+			Relocation relocation = read_relocation(object, j);
+			ObjectSymbol symbol = read_symbol(object, relocation.symbol);
+			uint64_t address;
+
+			if(symbol.section == SECTION_UNDEFINED){
+				const char* name = string_table(object) + symbol.name;
+				Label* label = (Label*) hashmap_get(globals, (char*) name);
+				if(label == NULL){
+					fprintf(stderr, "Error: undefined symbol %s in %s\n", name, object->name);
+					status = -1;
+					break;
+				}
+				address = label->address;
+			}
+			else{
+				address = placed_address(object, &symbol);
+			}
+
+			address += relocation.addend;
+			buffer_write_at(code, codeStart + relocation.offset, &address, sizeof(uint64_t));
+		}
+	}
+
+	// Data bytes follow one another; the padding and each object's reserved ranges take no file bytes
+	uint64_t address = INIT_DATA_ADDR;
+	bool compressed = false;
+	for(uint64_t i = 0; i < count && status == 0; i++){
+		LinkObject* object = &objects[i];
+		if(object->dataBase > address){
+			add_reserved_range(ranges, address, object->dataBase - address);
+		}
+
+		for(uint64_t j = 0; j < object->reservedCount; j++){
+			ReservedRange range = object_reserved_range(object->image, j);
+			add_reserved_range(ranges, range.address - INIT_DATA_ADDR + object->dataBase, range.size);
+		}
+
+		// Compressed data is decoded straight into the linked data segment
+		buffer_reserve(data, data->position + object->header.dataSize);
+		if(decode_data(&object->data, data->data + data->position, object->header.dataSize) != 0 || !data_segment_finished(&object->data)){
+			fprintf(stderr, "Error: the data segment of %s is malformed\n", object->name);
+			status = -1;
+			break;
+		}
+		data->position += object->header.dataSize;
+		data->size = data->position;
+		compressed |= (object->header.fileType & FILE_FLAG_COMPRESSED) != 0;
+		address = object->dataBase + object->dataSpan;
+	}
+
+	if(status == 0){
+		TinkerFileHeader header = {FILE_TYPE, INIT_CODE_ADDR, code->position, INIT_DATA_ADDR, data->position};
+		uint64_t rangeCount = ranges->position / sizeof(ReservedRange);
+		header.fileType |= rangeCount > 0 ? FILE_FLAG_RESERVED : 0;
+
+		buffer_write(out, &header, sizeof(TinkerFileHeader));
+		if(rangeCount > 0){
+			buffer_write(out, &rangeCount, sizeof(uint64_t));
+			buffer_write(out, ranges->data, ranges->position);
+		}
+		buffer_write(out, code->data, code->position);
+		buffer_write(out, data->data, data->position);
+
+		// The linked object is compressed if any of its objects were
+		if(compressed){
+			status = compress_object(out);
+		}
+	}
+
+	destroy_object_buffer(code);
+	destroy_object_buffer(data);
+	destroy_object_buffer(ranges);
+	destroy_hashmap(globals, destroy_label);
+	free(objects);
+	return status;
+}
+
+int link_object_files(const char* const* inputFiles, uint64_t count, const char* outputFile){
+	MappedFile** files = (MappedFile**) calloc(count + 1, sizeof(MappedFile*));
+	const uint8_t** images = (const uint8_t**) malloc(sizeof(uint8_t*) * (count + 1));
+	uint64_t* sizes = (uint64_t*) malloc(sizeof(uint64_t) * (count + 1));
+
+	if (files == NULL || images == NULL || sizes == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for object images\n");
+		exit(1);
+	}
+
+	// Map every object file whole
+	int status = 0;
+	for(uint64_t i = 0; i < count && status == 0; i++){
+		files[i] = map_file(inputFiles[i]);
+
+		// Check if the input file was opened successfully
+		if(files[i] == NULL){
+			fprintf(stderr, "Error: could not open the file %s for reading\n", inputFiles[i]);
+			status = -1;
+			continue;
+		}
+
+		images[i] = files[i]->data;
+		sizes[i] = files[i]->size;
+	}
+
+	ObjectBuffer* out = create_object_buffer();
+	if(status == 0){
+		status = link_images(images, sizes, (const char* const*) inputFiles, count, out);
+	}
+
+	// Only touch the output file once every object linked
+	if(status == 0){
+		status = write_object_file(outputFile, out);
+	}
+
+	for(uint64_t i = 0; i < count; i++){
+		unmap_file(files[i]);
+	}
+	destroy_object_buffer(out);
+	free(files);
+	free(images);
+	free(sizes);
+	return status;
+}
\ No newline at end of file
@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "optimizer/cfg.h"
+#include "assembler/instruction.h"
+#include "common/compress.h"
+#include "common/vector.h"
+
+#define NUM_OPCODES 0x20
+
+/**
+ * @brief Sign-extends a 12-bit literal.
+ *
+ * @param imm the raw literal
+ * @return the sign-extended literal
+ */
+static int64_t sign_extend(uint16_t imm){
+	return (imm & 0x800) ? (int64_t) imm - 0x1000 : (int64_t) imm;
+}
+
+/**
+ * @brief Creates a register value that constant propagation cannot track.
+ *
+ * @return the register value
+ */
+static RegValue varies(){
+	RegValue value = {VALUE_VARIES, 0, UNIT_DERIVED};
+	return value;
+}
+
+/**
+ * @brief Creates a constant register value computed from other registers.
+ *
+ * @param value the constant
+ * @return the register value
+ */
+static RegValue derived(uint64_t value){
+	RegValue result = {VALUE_CONST, value, UNIT_DERIVED};
+	return result;
+}
+
+/**
+ * @brief Marks every register as unknown.
+ *
+ * @param regs the register values
+ */
+static void set_varies(RegValue regs[32]){
+	for(int i = 0; i < 32; i++){
+		regs[i] = varies();
+	}
+}
+
+/**
+ * @brief Merges the register values of another path into a block's entry values.
+ *
+ * @param into the entry values, updated in place
+ * @param from the values along the other path
+ * @return true if any entry value changed, false otherwise
+ */
+static bool join_values(RegValue into[32], const RegValue from[32]){
+	bool changed = false;
+
+	for(int i = 0; i < 32; i++){
+		RegValue merged = into[i];
+
+		if(from[i].kind == VALUE_UNDEF || into[i].kind == VALUE_VARIES){
+			continue;
+		}
+		else if(into[i].kind == VALUE_UNDEF){
+			merged = from[i];
+		}
+		else if(from[i].kind == VALUE_VARIES || from[i].value != into[i].value){
+			merged = varies();
+		}
+		else if(from[i].unit != into[i].unit){
+			merged.unit = UNIT_MIXED;
+		}
+
+		if(merged.kind != into[i].kind || merged.value != into[i].value || merged.unit != into[i].unit){
+			into[i] = merged;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/**
+ * @brief Checks whether an opcode transfers control.
+ *
+ * @param opcode the opcode
+ * @return true for branches, calls, returns, and privileged operations
+ */
+static bool is_control(uint8_t opcode){
+	return opcode >= 0x8 && opcode <= 0xf;
+}
+
+bool priv_keeps_registers(uint64_t imm){
+	return imm <= 2 || (imm >= 4 && imm <= 7) || imm == 10;
+}
+
+bool priv_writes_destination(uint64_t imm){
+	return imm == 3 || imm == 8 || imm == 9 || (imm >= 11 && imm <= 14);
+}
+
+/**
+ * @brief Checks whether an op spawns a hart, which starts at the address in rs.
+ *
+ * @param op pointer to the op
+ * @return true for priv 11, false otherwise
+ */
+static bool is_spawn(const Op* op){
+	return !op->constant && op->opcode == 0xf && op->imm == 11;
+}
+
+uint8_t branch_register(const Op* op){
+	return is_spawn(op) ? op->rs : op->rd;
+}
+
+bool vector_writes_register(uint64_t imm){
+	return imm == VECTOR_SUM || imm == VECTOR_SUMF;
+}
+
+int64_t find_op(Program* program, uint64_t address){
+	// Binary search for the op starting at the address
+	uint64_t low = 0;
+	uint64_t high = program->count;
+	while(low < high){
+		uint64_t mid = low + (high - low) / 2;
+		if(program->ops[mid].address < address){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+
+	return low < program->count && program->ops[low].address == address ? (int64_t) low : -1;
+}
+
+bool is_code_address(Program* program, uint64_t value){
+	return value >= program->header.codeBegin && value <= program->header.codeBegin + program->header.codeSize;
+}
+
+/**
+ * @brief Marks the ops that start blocks before any indirect target is known.
+ *
+ * @param program pointer to the program
+ */
+static void mark_leaders(Program* program){
+	if(program->count > 0){
+		program->ops[0].leader = true;
+	}
+
+	for(uint64_t i = 0; i < program->count; i++){
+		Op* op = &program->ops[i];
+
+		// Every control transfer ends a block
+		if((is_control(op->opcode) || op->opcode >= NUM_OPCODES || op->jump) && i + 1 < program->count){
+			program->ops[i + 1].leader = true;
+		}
+
+		// brrL and long brr targets are known from the encoding alone
+		if(op->opcode == 0xa || op->jump){
+			if(!op->jump){
+				op->target = op->address + sign_extend(op->imm);
+			}
+			int64_t target = find_op(program, op->target);
+			if(target >= 0){
+				program->ops[target].leader = true;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Merges each xor rd, rd, rd and the addi/shftli on rd after it into one constant op.
+ *
+ * @param program pointer to the program
+ */
+static void group_constants(Program* program){
+	uint64_t count = 0;
+
+	for(uint64_t i = 0; i < program->count; i++){
+		Op op = program->ops[i];
+
+		if(op.opcode == 0x2 && op.rd == op.rs && op.rd == op.rt){
+			op.constant = true;
+			op.value = 0;
+
+			// The chain stops at a block leader or any other instruction
+			while(i + 1 < program->count && !program->ops[i + 1].leader && program->ops[i + 1].rd == op.rd
+				&& (program->ops[i + 1].opcode == 0x19 || program->ops[i + 1].opcode == 0x7)){
+				Op* next = &program->ops[++i];
+				if(next->opcode == 0x19){
+					op.value += next->imm;
+				}
+				else{
+					op.value = next->imm < 64 ? op.value << next->imm : 0;
+				}
+
+				op.size += next->size;
+				op.instructions += next->instructions;
+			}
+		}
+
+		program->ops[count++] = op;
+	}
+
+	program->count = count;
+}
+
+/**
+ * @brief Checks whether the code at an offset is the sequence hw7-asm emits for a long brr.
+ *
+ * @param code the code segment
+ * @param offset offset of the first word
+ * @param codeSize size of the code segment in bytes
+ * @return true if the words save r0, load the target, store it for return, restore r0, and return
+ */
+static bool is_long_branch(const uint8_t* code, uint64_t offset, uint64_t codeSize){
+	if(offset + BRR_LONG_SIZE > codeSize){
+		return false;
+	}
+
+	// Every word but the ldw payload is fixed
+	const uint32_t before[2] = {encode_instruction(0x13, 31, 0, 0, -16), encode_instruction(0x1e, 0, 0, 0, 0)};
+	const uint32_t after[3] = {encode_instruction(0x13, 31, 0, 0, -8), encode_instruction(0x10, 0, 31, 0, -16), encode_instruction(0xd, 0, 0, 0, 0)};
+	return memcmp(code + offset, before, sizeof(before)) == 0 && memcmp(code + offset + 16, after, sizeof(after)) == 0;
+}
+
+Program* decode_program(const uint8_t* image, uint64_t size){
+	// Check that the image holds a complete file header and range table
+	uint64_t reservedCount;
+	uint64_t codeOffset = object_code_offset(image, size, &reservedCount);
+	if(codeOffset == 0){
+		fprintf(stderr, "Object file header is malformed\n");
+		return NULL;
+	}
+
+	TinkerFileHeader header;
+	memcpy(&header, image, sizeof(TinkerFileHeader));
+
+	// Relocatable objects hold unresolved addresses until they are linked
+	if(header.fileType & FILE_FLAG_RELOCATABLE){
+		fprintf(stderr, "Object file is relocatable; link it with hw7-ld first\n");
+		return NULL;
+	}
+
+	// The simulator always starts at INIT_CODE_ADDR, so the code must be loaded there
+	DataDecoder decoder;
+	if(header.codeBegin != INIT_CODE_ADDR || header.codeSize > INIT_DATA_ADDR - INIT_CODE_ADDR || header.codeSize % 4 != 0
+		|| open_data_segment(&decoder, image, size) != 0){
+		fprintf(stderr, "Object file segments are out of bounds\n");
+		return NULL;
+	}
+
+	Program* program = (Program*) calloc(1, sizeof(Program));
+	Op* ops = (Op*) calloc(header.codeSize / 4 + 1, sizeof(Op));
+	uint8_t* data = (uint8_t*) malloc(header.dataSize + 1);
+
+	if (program == NULL || ops == NULL || data == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Program\n");
+		exit(1);
+	}
+
+	program->header = header;
+	program->table = image + sizeof(TinkerFileHeader);
+	program->tableSize = codeOffset - sizeof(TinkerFileHeader);
+	program->code = image + codeOffset;
+	program->data = data;
+	program->ops = ops;
+
+	// Compressed data is decoded once, so later passes read plain words
+	if(decode_data(&decoder, data, header.dataSize) != 0 || !data_segment_finished(&decoder)){
+		fprintf(stderr, "Object file data segment is malformed\n");
+		destroy_program(program);
+		return NULL;
+	}
+
+	// Decode one instruction at a time, keeping each ldw payload with its instruction
+	for(uint64_t offset = 0; offset < header.codeSize; offset += ops[program->count++].size){
+		Op* op = &ops[program->count];
+		memcpy(&op->word, program->code + offset, sizeof(uint32_t));
+
+		op->address = header.codeBegin + offset;
+		op->offset = offset;
+		op->size = 4;
+		op->instructions = 1;
+		op->opcode = (op->word >> 27) & 0x1F;
+		op->rd = (op->word >> 22) & 0x1F;
+		op->rs = (op->word >> 17) & 0x1F;
+		op->rt = (op->word >> 12) & 0x1F;
+		op->imm = op->word & 0xFFF;
+
+		// A long brr leaves every register as it was, so it is a jump to its ldw payload
+		if(is_long_branch(program->code, offset, header.codeSize)){
+			op->jump = true;
+			op->size = BRR_LONG_SIZE;
+			op->instructions = 5;
+			memcpy(&op->target, program->code + offset + 8, sizeof(uint64_t));
+		}
+		else if(op->opcode == 0x1e){
+			if(offset + 12 > header.codeSize){
+				fprintf(stderr, "Error: ldw at 0x%lx is missing its payload\n", op->address);
+				destroy_program(program);
+				return NULL;
+			}
+
+			op->constant = true;
+			op->size = 12;
+			memcpy(&op->value, program->code + offset + 4, sizeof(uint64_t));
+		}
+	}
+
+	mark_leaders(program);
+	group_constants(program);
+	return program;
+}
+
+void apply_op(Program* program, uint64_t index, RegValue regs[32]){
+	Op* op = &program->ops[index];
+	RegValue* d = &regs[op->rd];
+	RegValue s = regs[op->rs];
+	RegValue t = regs[op->rt];
+	bool known = s.kind == VALUE_CONST && t.kind == VALUE_CONST;
+
+	if(op->constant){
+		d->kind = VALUE_CONST;
+		d->value = op->value;
+		d->unit = (int64_t) index;
+		return;
+	}
+
+	switch(op->opcode){
+		case 0x0:
+			*d = known ? derived(s.value & t.value) : varies();
+			break;
+		case 0x1:
+			*d = known ? derived(s.value | t.value) : varies();
+			break;
+		case 0x2:
+			*d = op->rs == op->rt ? derived(0) : known ? derived(s.value ^ t.value) : varies();
+			break;
+		case 0x3:
+			*d = s.kind == VALUE_CONST ? derived(~s.value) : varies();
+			break;
+		case 0x4:
+			*d = known && t.value < 64 ? derived(s.value >> t.value) : varies();
+			break;
+		case 0x5:
+			*d = d->kind == VALUE_CONST && op->imm < 64 ? derived(d->value >> op->imm) : varies();
+			break;
+		case 0x6:
+			*d = known && t.value < 64 ? derived(s.value << t.value) : varies();
+			break;
+		case 0x7:
+			*d = d->kind == VALUE_CONST && op->imm < 64 ? derived(d->value << op->imm) : varies();
+			break;
+		case 0xf:
+			// Input, memory compare, allocation, and the hart and atomic calls only write rd
+			if(priv_writes_destination(op->imm)){
+				*d = varies();
+			}
+			else if(!priv_keeps_registers(op->imm)){
+				set_varies(regs);
+			}
+			break;
+		case 0x10:
+			*d = varies();
+			break;
+		case 0x11:
+			*d = s;
+			break;
+		case 0x12:
+			*d = d->kind == VALUE_CONST ? derived((d->value & ~0xFFFULL) | op->imm) : varies();
+			break;
+		case 0x14:
+		case 0x15:
+		case 0x16:
+		case 0x17:
+			*d = varies();
+			break;
+		case 0x18:
+			*d = known ? derived(s.value + t.value) : varies();
+			break;
+		case 0x19:
+			*d = d->kind == VALUE_CONST ? derived(d->value + op->imm) : varies();
+			break;
+		case 0x1a:
+			*d = op->rs == op->rt ? derived(0) : known ? derived(s.value - t.value) : varies();
+			break;
+		case 0x1b:
+			*d = d->kind == VALUE_CONST ? derived(d->value - op->imm) : varies();
+			break;
+		case 0x1c:
+			*d = known ? derived(s.value * t.value) : varies();
+			break;
+		case 0x1d:
+			// Leave division by zero and overflow to run time
+			*d = known && t.value != 0 && !(s.value == 0x8000000000000000ULL && t.value == UINT64_MAX)
+				? derived((uint64_t) ((int64_t) s.value / (int64_t) t.value)) : varies();
+			break;
+		case VECTOR_OPCODE:
+			// Only the sums leave a result in a general purpose register
+			if(vector_writes_register(op->imm)){
+				*d = varies();
+			}
+			break;
+		default:
+			// Branches and stores write no register
+			break;
+	}
+}
+
+/**
+ * @brief Splits the ops into blocks at the current leaders.
+ *
+ * @param program pointer to the program
+ */
+static void build_blocks(Program* program){
+	free(program->blocks);
+	free(program->blockOf);
+	free(program->reached);
+	free(program->in);
+
+	program->blocks = (uint64_t*) malloc(sizeof(uint64_t) * (program->count + 1));
+	program->blockOf = (uint64_t*) malloc(sizeof(uint64_t) * (program->count + 1));
+	program->blockCount = 0;
+
+	if (program->blocks == NULL || program->blockOf == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for blocks\n");
+		exit(1);
+	}
+
+	for(uint64_t i = 0; i < program->count; i++){
+		if(program->ops[i].leader){
+			program->blocks[program->blockCount++] = i;
+		}
+		program->blockOf[i] = program->blockCount - 1;
+	}
+	program->blocks[program->blockCount] = program->count;
+
+	program->reached = (bool*) calloc(program->blockCount + 1, sizeof(bool));
+	program->in = (RegValue (*)[32]) calloc(program->blockCount + 1, sizeof(RegValue[32]));
+
+	if (program->reached == NULL || program->in == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for blocks\n");
+		exit(1);
+	}
+}
+
+/**
+ * @brief Returns a branch register's value if it is a constant address of an op.
+ *
+ * @param program pointer to the program
+ * @param value the register value
+ * @param target set to the address
+ * @return true if the register holds the address of an op, false otherwise
+ */
+static bool resolve_target(Program* program, RegValue value, uint64_t* target){
+	if(value.kind != VALUE_CONST || find_op(program, value.value) < 0){
+		return false;
+	}
+
+	*target = value.value;
+	return true;
+}
+
+/**
+ * @brief Merges register values into a block's entry values and queues it if they changed.
+ *
+ * @param program pointer to the program
+ * @param worklist the blocks waiting to be processed
+ * @param pending number of queued blocks, updated in place
+ * @param queued whether each block is queued
+ * @param index index of the op starting the block
+ * @param regs the register values flowing into the block
+ */
+static void flow_into(Program* program, uint64_t* worklist, uint64_t* pending, bool* queued, uint64_t index, const RegValue regs[32]){
+	uint64_t block = program->blockOf[index];
+	bool changed = join_values(program->in[block], regs);
+
+	if(!program->reached[block]){
+		program->reached[block] = true;
+		changed = true;
+	}
+
+	if(changed && !queued[block]){
+		queued[block] = true;
+		worklist[(*pending)++] = block;
+	}
+}
+
+/**
+ * @brief Propagates register values over the blocks until they stop changing.
+ *
+ * The last visit of each block sees its final entry values, so the edges it
+ * records on its last op are the ones that can actually be taken.
+ *
+ * @param program pointer to the program
+ */
+static void propagate_constants(Program* program){
+	uint64_t* worklist = (uint64_t*) malloc(sizeof(uint64_t) * (program->blockCount + 1));
+	bool* queued = (bool*) calloc(program->blockCount + 1, sizeof(bool));
+
+	if (worklist == NULL || queued == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for worklist\n");
+		exit(1);
+	}
+
+	uint64_t pending = 0;
+	RegValue regs[32];
+	RegValue unknown[32];
+	set_varies(unknown);
+
+	if(program->count > 0){
+		flow_into(program, worklist, &pending, queued, 0, unknown);
+	}
+
+	while(pending > 0){
+		uint64_t block = worklist[--pending];
+		queued[block] = false;
+		memcpy(regs, program->in[block], sizeof(regs));
+
+		uint64_t last = program->blocks[block + 1] - 1;
+		for(uint64_t i = program->blocks[block]; i < last; i++){
+			apply_op(program, i, regs);
+		}
+
+		// A spawned hart starts with the spawner's registers, its stack pointer in r31 and 0 in rd
+		Op* op = &program->ops[last];
+		RegValue hart[32];
+		bool spawns = false;
+		if(is_spawn(op)){
+			memcpy(hart, regs, sizeof(hart));
+			hart[op->rd] = derived(0);
+			hart[31] = regs[op->rt];
+			spawns = resolve_target(program, regs[op->rs], &op->target);
+		}
+		apply_op(program, last, regs);
+
+		RegValue s = regs[op->rs];
+		RegValue t = regs[op->rt];
+		op->takes = false;
+		op->falls = op->constant || (!is_control(op->opcode) && op->opcode < NUM_OPCODES && !op->jump);
+
+		if(op->jump){
+			op->takes = find_op(program, op->target) >= 0;
+		}
+		else if(!op->constant){
+			switch(op->opcode){
+				case 0x8:
+					op->takes = resolve_target(program, regs[op->rd], &op->target);
+					break;
+				case 0xa:
+					op->takes = find_op(program, op->target) >= 0;
+					break;
+				case 0xb:
+					// A constant condition keeps only the edge it takes
+					op->takes = !(s.kind == VALUE_CONST && s.value == 0) && resolve_target(program, regs[op->rd], &op->target);
+					op->falls = !(s.kind == VALUE_CONST && s.value != 0);
+					break;
+				case 0xc:
+					op->takes = resolve_target(program, regs[op->rd], &op->target);
+					op->falls = true;
+					break;
+				case 0xe:
+					op->takes = !(s.kind == VALUE_CONST && t.kind == VALUE_CONST && s.value <= t.value)
+						&& resolve_target(program, regs[op->rd], &op->target);
+					op->falls = !(s.kind == VALUE_CONST && t.kind == VALUE_CONST && s.value > t.value);
+					break;
+				case 0xf:
+					op->takes = spawns;
+					op->falls = op->imm != 0;
+					break;
+				default:
+					break;
+			}
+		}
+
+		if(op->takes){
+			flow_into(program, worklist, &pending, queued, (uint64_t) find_op(program, op->target), spawns ? hart : regs);
+		}
+
+		// A call returns with whatever the callee left in the registers
+		if(op->falls && last + 1 < program->count){
+			flow_into(program, worklist, &pending, queued, last + 1, !op->constant && op->opcode == 0xc ? unknown : regs);
+		}
+	}
+
+	free(worklist);
+	free(queued);
+}
+
+int analyze_program(Program* program){
+	RegValue regs[32];
+
+	while(true){
+		build_blocks(program);
+		propagate_constants(program);
+		bool added = false;
+
+		for(uint64_t block = 0; block < program->blockCount; block++){
+			if(!program->reached[block]){
+				continue;
+			}
+
+			// Replay the block up to its last op
+			uint64_t last = program->blocks[block + 1] - 1;
+			memcpy(regs, program->in[block], sizeof(regs));
+			for(uint64_t i = program->blocks[block]; i < last; i++){
+				apply_op(program, i, regs);
+			}
+
+			Op* op = &program->ops[last];
+			if(op->constant){
+				continue;
+			}
+
+			if(op->opcode >= NUM_OPCODES){
+				fprintf(stderr, "Error: invalid instruction at 0x%lx\n", op->address);
+				return -1;
+			}
+			if(op->opcode == 0x9 || ((op->opcode == 0xa || op->jump) && !op->takes)){
+				fprintf(stderr, "Error: cannot prove the target of the relative branch at 0x%lx\n", op->address);
+				return -1;
+			}
+
+			// Every register branch that can run needs a provable constant target
+			RegValue s = regs[op->rs];
+			RegValue t = regs[op->rt];
+			bool indirect = op->opcode == 0x8 || op->opcode == 0xc
+				|| (op->opcode == 0xb && !(s.kind == VALUE_CONST && s.value == 0))
+				|| (op->opcode == 0xe && !(s.kind == VALUE_CONST && t.kind == VALUE_CONST && s.value <= t.value))
+				|| is_spawn(op);
+			if(!indirect){
+				continue;
+			}
+
+			RegValue target = regs[branch_register(op)];
+			int64_t index = target.kind == VALUE_CONST ? find_op(program, target.value) : -1;
+			if(index < 0 || target.unit == UNIT_DERIVED){
+				fprintf(stderr, "Error: cannot prove the target of the branch at 0x%lx\n", op->address);
+				return -1;
+			}
+
+			if(!program->ops[index].leader){
+				program->ops[index].leader = true;
+				added = true;
+			}
+		}
+
+		// New leaders split blocks, so the values have to be propagated again
+		if(!added){
+			return 0;
+		}
+	}
+}
+
+void destroy_program(Program* program){
+	if(program == NULL){
+		return;
+	}
+
+	free(program->ops);
+	free(program->data);
+	free(program->blocks);
+	free(program->blockOf);
+	free(program->reached);
+	free(program->in);
+	free(program);
+}
\ No newline at end of file
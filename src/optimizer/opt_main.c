@@ -0,0 +1,22 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "optimizer/optimizer.h"
+
+int main(int argc, char* argv[]){
+	// Check that there is one input and one output file
+	if(argc != 3){
+		fprintf(stderr, "Please include an input object file and an output object file\n");
+		exit(1);
+	}
+
+	OptimizerStats stats;
+	if(optimize_object_file(argv[1], argv[2], &stats) != 0){
+		fprintf(stderr, "Optimization failed; %s was not written\n", argv[2]);
+		return 1;
+	}
+
+	// Report the reduction in instructions
+	printf("%s: %lu -> %lu instructions (%lu removed)\n", argv[1], stats.before, stats.after, stats.before - stats.after);
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,611 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "optimizer/optimizer.h"
+#include "optimizer/cfg.h"
+#include "assembler/assembler.h"
+#include "assembler/instruction.h"
+#include "assembler/compress.h"
+#include "common/vector.h"
+#include "common/file.h"
+
+#define ALL_REGISTERS 0xFFFFFFFFU
+
+/**
+ * @brief Returns the registers an op writes.
+ *
+ * @param op pointer to the op
+ * @return a mask with one bit per register
+ */
+static uint32_t op_defs(const Op* op){
+	uint8_t opcode = op->replaced ? (op->replacement >> 27) & 0x1F : op->opcode;
+
+	if(op->constant || opcode <= 0x7 || (opcode >= 0x10 && opcode <= 0x12) || (opcode >= 0x14 && opcode <= 0x1d)){
+		return 1U << op->rd;
+	}
+
+	// Input, memory compare, allocation, and the hart and atomic calls only write rd
+	if(opcode == 0xf && !priv_keeps_registers(op->imm)){
+		return priv_writes_destination(op->imm) ? 1U << op->rd : ALL_REGISTERS;
+	}
+	if(opcode == VECTOR_OPCODE && vector_writes_register(op->imm)){
+		return 1U << op->rd;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Returns the registers an op reads.
+ *
+ * Calls, returns, and unknown privileged operations may read any register.
+ *
+ * @param op pointer to the op
+ * @return a mask with one bit per register
+ */
+static uint32_t op_uses(const Op* op){
+	if(op->constant){
+		return 0;
+	}
+
+	uint32_t word = op->replaced ? op->replacement : op->word;
+	uint8_t opcode = (word >> 27) & 0x1F;
+	uint32_t rd = 1U << ((word >> 22) & 0x1F);
+	uint32_t rs = 1U << ((word >> 17) & 0x1F);
+	uint32_t rt = 1U << ((word >> 12) & 0x1F);
+
+	switch(opcode){
+		case 0x3:
+		case 0x10:
+		case 0x11:
+			return rs;
+		case 0x5:
+		case 0x7:
+		case 0x12:
+		case 0x19:
+		case 0x1b:
+		case 0x8:
+		case 0x9:
+			return rd;
+		case 0xa:
+			return 0;
+		case 0xb:
+		case 0x13:
+			return rd | rs;
+		case 0xe:
+			return rd | rs | rt;
+		case 0xf:
+			// Halt and the mode switches read nothing, input, allocation, and join read rs, free reads rd, the rest their operands
+			switch(op->imm){
+				case 0:
+				case 1:
+				case 2:
+					return 0;
+				case 3:
+				case 9:
+				case 12:
+					return rs;
+				case 4:
+					return rd | rs;
+				case 11:
+				case 13:
+					return rs | rt;
+				case 5:
+				case 6:
+				case 7:
+				case 8:
+				case 14:
+					return rd | rs | rt;
+				case 10:
+					return rd;
+				default:
+					return ALL_REGISTERS;
+			}
+		case 0xc:
+		case 0xd:
+			return ALL_REGISTERS;
+		case VECTOR_OPCODE:
+			// Loads and broadcasts read rs, stores read their address in rd, and the rest only vector registers
+			switch(op->imm){
+				case VECTOR_LOAD:
+				case VECTOR_BROADCAST:
+					return rs;
+				case VECTOR_STORE:
+					return rd;
+				default:
+					return op->imm < NUM_VECTOR_OPS ? 0 : ALL_REGISTERS;
+			}
+		default:
+			return opcode < 0x1e ? rs | rt : ALL_REGISTERS;
+	}
+}
+
+/**
+ * @brief Checks whether an op can be dropped when the register it writes is dead.
+ *
+ * Loads, divisions, and everything that can fault or has other effects are kept.
+ *
+ * @param op pointer to the op
+ * @return true if the op only writes its destination register
+ */
+static bool is_pure(const Op* op){
+	uint8_t opcode = op->replaced ? (op->replacement >> 27) & 0x1F : op->opcode;
+
+	return op->constant || opcode <= 0x7 || opcode == 0x11 || opcode == 0x12 || (opcode >= 0x14 && opcode <= 0x16)
+		|| (opcode >= 0x18 && opcode <= 0x1c);
+}
+
+/**
+ * @brief Replays a block up to, but not including, one of its ops.
+ *
+ * @param program pointer to the program
+ * @param block index of the block
+ * @param end index of the op to stop before
+ * @param regs set to the register values before the op
+ */
+static void replay_block(Program* program, uint64_t block, uint64_t end, RegValue regs[32]){
+	memcpy(regs, program->in[block], sizeof(RegValue[32]));
+	for(uint64_t i = program->blocks[block]; i < end; i++){
+		apply_op(program, i, regs);
+	}
+}
+
+/**
+ * @brief Removes unreachable blocks and rewrites branches whose condition is constant.
+ *
+ * @param program pointer to the program
+ */
+static void fold_branches(Program* program){
+	for(uint64_t block = 0; block < program->blockCount; block++){
+		uint64_t first = program->blocks[block];
+		uint64_t last = program->blocks[block + 1] - 1;
+
+		if(!program->reached[block]){
+			for(uint64_t i = first; i <= last; i++){
+				program->ops[i].removed = true;
+			}
+			continue;
+		}
+
+		Op* op = &program->ops[last];
+		if(op->constant || (op->opcode != 0xb && op->opcode != 0xe)){
+			continue;
+		}
+
+		// A branch that is always taken becomes br, one that never is disappears
+		if(op->takes && !op->falls){
+			op->replaced = true;
+			op->replacement = encode_instruction(0x8, op->rd, 0, 0, 0);
+		}
+		else if(!op->takes){
+			op->removed = true;
+		}
+	}
+}
+
+/**
+ * @brief Marks the constant ops whose values are used as branch targets.
+ *
+ * @param program pointer to the program
+ */
+static void mark_relocations(Program* program){
+	RegValue regs[32];
+
+	for(uint64_t block = 0; block < program->blockCount; block++){
+		uint64_t last = program->blocks[block + 1] - 1;
+		Op* op = &program->ops[last];
+
+		if(!program->reached[block] || op->removed || !op->takes || op->constant || op->opcode == 0xa || op->jump){
+			continue;
+		}
+
+		replay_block(program, block, last, regs);
+		uint8_t target = branch_register(op);
+		if(regs[target].unit >= 0){
+			program->ops[regs[target].unit].relocate = true;
+		}
+	}
+}
+
+/**
+ * @brief Removes constant ops that load a value the register already holds.
+ *
+ * A removed load of a code address is only dropped when the op that loaded the
+ * held value is known, since that op must then be relocated in its place.
+ *
+ * @param program pointer to the program
+ */
+static void remove_redundant_constants(Program* program){
+	int64_t* source = (int64_t*) malloc(sizeof(int64_t) * (program->count + 1));
+	bool* redundant = (bool*) calloc(program->count + 1, sizeof(bool));
+
+	if (source == NULL || redundant == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for redundant constants\n");
+		exit(1);
+	}
+
+	RegValue regs[32];
+	for(uint64_t block = 0; block < program->blockCount; block++){
+		if(!program->reached[block]){
+			continue;
+		}
+
+		memcpy(regs, program->in[block], sizeof(regs));
+		for(uint64_t i = program->blocks[block]; i < program->blocks[block + 1]; i++){
+			Op* op = &program->ops[i];
+			RegValue held = regs[op->rd];
+
+			if(op->constant && held.kind == VALUE_CONST && held.value == op->value
+				&& (held.unit >= 0 || !is_code_address(program, op->value))){
+				redundant[i] = true;
+				source[i] = held.unit;
+			}
+
+			apply_op(program, i, regs);
+		}
+	}
+
+	// Relocate the op that loaded the held value for every dropped relocated op
+	bool changed = true;
+	while(changed){
+		changed = false;
+		for(uint64_t i = 0; i < program->count; i++){
+			if(redundant[i] && program->ops[i].relocate && source[i] >= 0 && !program->ops[source[i]].relocate){
+				program->ops[source[i]].relocate = true;
+				changed = true;
+			}
+		}
+	}
+
+	for(uint64_t i = 0; i < program->count; i++){
+		if(redundant[i]){
+			program->ops[i].removed = true;
+		}
+	}
+
+	free(source);
+	free(redundant);
+}
+
+/**
+ * @brief Forgets the memory values held in or addressed through the given registers.
+ *
+ * @param held whether each register holds a loaded memory value
+ * @param bases base register of each held value's address
+ * @param mask the registers written
+ */
+static void forget_loads(bool held[32], uint8_t bases[32], uint32_t mask){
+	for(int i = 0; i < 32; i++){
+		if((mask >> i) & 1 || (mask >> bases[i]) & 1){
+			held[i] = false;
+		}
+	}
+}
+
+/**
+ * @brief Removes loads of memory a register already holds within a block.
+ *
+ * A load of the same address into another register becomes a mov from it.
+ * Stores, calls, and privileged operations forget every held value.
+ *
+ * @param program pointer to the program
+ */
+static void remove_redundant_loads(Program* program){
+	bool held[32];
+	uint8_t bases[32];
+	uint16_t offsets[32];
+
+	for(uint64_t block = 0; block < program->blockCount; block++){
+		if(!program->reached[block]){
+			continue;
+		}
+
+		memset(held, 0, sizeof(held));
+		memset(bases, 0, sizeof(bases));
+		for(uint64_t i = program->blocks[block]; i < program->blocks[block + 1]; i++){
+			Op* op = &program->ops[i];
+			if(op->removed){
+				continue;
+			}
+
+			if(op->constant || op->opcode != 0x10){
+				forget_loads(held, bases, op->opcode == 0x13 || (!op->constant && op->opcode >= 0x8 && op->opcode <= 0xf)
+					|| (!op->constant && op->opcode == VECTOR_OPCODE && op->imm == VECTOR_STORE)
+					? ALL_REGISTERS : op_defs(op));
+				continue;
+			}
+
+			// Look for a register holding the same address's value
+			int source = -1;
+			for(int r = 0; r < 32 && source < 0; r++){
+				if(held[r] && bases[r] == op->rs && offsets[r] == op->imm){
+					source = r;
+				}
+			}
+
+			if(source == op->rd){
+				op->removed = true;
+				continue;
+			}
+			if(source >= 0){
+				op->replaced = true;
+				op->replacement = encode_instruction(0x11, op->rd, (uint8_t) source, 0, 0);
+			}
+
+			forget_loads(held, bases, 1U << op->rd);
+			if(op->rd != op->rs){
+				held[op->rd] = true;
+				bases[op->rd] = op->rs;
+				offsets[op->rd] = op->imm;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Returns the registers live when a block is left.
+ *
+ * @param program pointer to the program
+ * @param live registers live on entry to each block
+ * @param block index of the block
+ * @return a mask with one bit per register
+ */
+static uint32_t live_out(Program* program, const uint32_t* live, uint64_t block){
+	uint64_t last = program->blocks[block + 1] - 1;
+	Op* op = &program->ops[last];
+
+	// Callees and callers may read any register
+	if(!op->constant && (op->opcode == 0xc || op->opcode == 0xd || op->opcode >= 0x1f)){
+		return ALL_REGISTERS;
+	}
+
+	uint32_t mask = 0;
+	if(op->takes && !op->removed){
+		mask |= live[program->blockOf[find_op(program, op->target)]];
+	}
+	if(op->falls || op->removed){
+		mask |= last + 1 < program->count ? live[program->blockOf[last + 1]] : ALL_REGISTERS;
+	}
+
+	return mask;
+}
+
+/**
+ * @brief Removes instructions whose results are never read, until none are left.
+ *
+ * @param program pointer to the program
+ */
+static void remove_dead_code(Program* program){
+	uint32_t* live = (uint32_t*) calloc(program->blockCount + 1, sizeof(uint32_t));
+
+	if (live == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for liveness\n");
+		exit(1);
+	}
+
+	bool removedAny = true;
+	while(removedAny){
+		removedAny = false;
+
+		// Compute the registers live on entry to each block
+		memset(live, 0, sizeof(uint32_t) * (program->blockCount + 1));
+		bool changed = true;
+		while(changed){
+			changed = false;
+			for(uint64_t block = program->blockCount; block-- > 0;){
+				if(!program->reached[block]){
+					continue;
+				}
+
+				uint32_t mask = live_out(program, live, block);
+				for(uint64_t i = program->blocks[block + 1]; i-- > program->blocks[block];){
+					if(!program->ops[i].removed){
+						mask = (mask & ~op_defs(&program->ops[i])) | op_uses(&program->ops[i]);
+					}
+				}
+
+				if(mask != live[block]){
+					live[block] = mask;
+					changed = true;
+				}
+			}
+		}
+
+		// Drop every pure op whose result is dead
+		for(uint64_t block = 0; block < program->blockCount; block++){
+			if(!program->reached[block]){
+				continue;
+			}
+
+			uint32_t mask = live_out(program, live, block);
+			for(uint64_t i = program->blocks[block + 1]; i-- > program->blocks[block];){
+				Op* op = &program->ops[i];
+				if(op->removed){
+					continue;
+				}
+
+				if(is_pure(op) && (op_defs(op) & mask) == 0){
+					op->removed = true;
+					removedAny = true;
+					continue;
+				}
+
+				mask = (mask & ~op_defs(op)) | op_uses(op);
+			}
+		}
+	}
+
+	free(live);
+}
+
+/**
+ * @brief Checks that every code address left in the program can be relocated.
+ *
+ * @param program pointer to the program
+ * @return 0 if every code address is a relocated branch target, -1 otherwise
+ */
+static int check_code_addresses(Program* program){
+	// Code addresses stored as data could be loaded and branched to
+	for(uint64_t offset = 0; offset + 8 <= program->header.dataSize; offset += 8){
+		uint64_t value;
+		memcpy(&value, program->data + offset, sizeof(uint64_t));
+
+		if(is_code_address(program, value)){
+			fprintf(stderr, "Error: cannot prove how the code address 0x%lx in the data segment is used\n", value);
+			return -1;
+		}
+	}
+
+	for(uint64_t i = 0; i < program->count; i++){
+		Op* op = &program->ops[i];
+
+		if(op->constant && !op->removed && !op->relocate && is_code_address(program, op->value)){
+			fprintf(stderr, "Error: cannot prove how the code address loaded at 0x%lx is used\n", op->address);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Returns the new address of an op's original address.
+ *
+ * A removed op maps to the op that now follows it.
+ *
+ * @param program pointer to the program
+ * @param address the original address
+ * @param end the new end of the code segment
+ * @return the new address
+ */
+static uint64_t new_address(Program* program, uint64_t address, uint64_t end){
+	int64_t index = find_op(program, address);
+	return index >= 0 ? program->ops[index].newAddress : end;
+}
+
+/**
+ * @brief Lays out the kept ops and writes the optimized image.
+ *
+ * @param program pointer to the program
+ * @param out pointer to the object buffer
+ * @param stats set to the instruction counts
+ * @return 0 if successful, -1 if a brrL offset no longer fits
+ */
+static int rewrite_program(Program* program, ObjectBuffer* out, OptimizerStats* stats){
+	// Relocated constants are always written as an ldw of the new address
+	uint64_t address = program->header.codeBegin;
+	stats->before = 0;
+	stats->after = 0;
+	for(uint64_t i = 0; i < program->count; i++){
+		Op* op = &program->ops[i];
+		op->newAddress = address;
+		stats->before += op->instructions;
+
+		if(!op->removed){
+			address += op->relocate ? 12 : op->size;
+			stats->after += op->relocate ? 1 : op->instructions;
+		}
+	}
+
+	// The debug table describes the old layout, so it is dropped; the data is written uncompressed
+	TinkerFileHeader header = program->header;
+	header.codeSize = address - header.codeBegin;
+	header.fileType &= ~(uint64_t) (FILE_FLAG_DEBUG | FILE_FLAG_COMPRESSED);
+	if(header.codeSize > INIT_DATA_ADDR - INIT_CODE_ADDR){
+		fprintf(stderr, "Code segment is too large\n");
+		return -1;
+	}
+	buffer_write(out, &header, sizeof(TinkerFileHeader));
+	buffer_write(out, program->table, program->tableSize);
+
+	for(uint64_t i = 0; i < program->count; i++){
+		Op* op = &program->ops[i];
+
+		if(op->removed){
+			continue;
+		}
+
+		if(op->relocate){
+			uint64_t value = new_address(program, op->value, address);
+			buffer_write_instruction(out, encode_instruction(0x1e, op->rd, 0, 0, 0));
+			buffer_write(out, &value, sizeof(uint64_t));
+		}
+		else if(op->replaced){
+			buffer_write_instruction(out, op->replacement);
+		}
+		else if(op->jump){
+			// A long brr reaches anywhere, so only its payload moves
+			uint64_t target = new_address(program, op->target, address);
+			buffer_write(out, program->code + op->offset, 8);
+			buffer_write(out, &target, sizeof(uint64_t));
+			buffer_write(out, program->code + op->offset + 16, op->size - 16);
+		}
+		else if(!op->constant && op->opcode == 0xa){
+			int64_t offset = (int64_t) (new_address(program, op->target, address) - op->newAddress);
+			if(offset < -2048 || offset > 2047){
+				fprintf(stderr, "Error: the relative branch at 0x%lx no longer reaches its target\n", op->address);
+				return -1;
+			}
+
+			buffer_write_instruction(out, (op->word & ~0xFFFU) | ((uint32_t) offset & 0xFFF));
+		}
+		else{
+			buffer_write(out, program->code + op->offset, op->size);
+		}
+	}
+
+	buffer_write(out, program->data, program->header.dataSize);
+	return 0;
+}
+
+int optimize_image(const uint8_t* image, uint64_t size, ObjectBuffer* out, OptimizerStats* stats){
+	Program* program = decode_program(image, size);
+	if(program == NULL){
+		return -1;
+	}
+
+	int status = analyze_program(program);
+	if(status == 0){
+		fold_branches(program);
+		mark_relocations(program);
+		remove_redundant_constants(program);
+		remove_redundant_loads(program);
+		remove_dead_code(program);
+		status = check_code_addresses(program);
+	}
+
+	if(status == 0){
+		status = rewrite_program(program, out, stats);
+	}
+	// Compressed input stays compressed
+	if(status == 0 && (program->header.fileType & FILE_FLAG_COMPRESSED)){
+		status = compress_object(out);
+	}
+
+	destroy_program(program);
+	return status;
+}
+
+int optimize_object_file(const char* inputFile, const char* outputFile, OptimizerStats* stats){
+	MappedFile* image = map_file(inputFile);
+
+	// Check if the input file was opened successfully
+	if(image == NULL){
+		fprintf(stderr, "Invalid tinker filepath\n");
+		return -1;
+	}
+
+	ObjectBuffer* out = create_object_buffer();
+	int status = optimize_image(image->data, image->size, out, stats);
+
+	if(status == 0){
+		status = write_object_file(outputFile, out);
+	}
+
+	unmap_file(image);
+	destroy_object_buffer(out);
+	return status;
+}
\ No newline at end of file
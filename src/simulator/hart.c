@@ -0,0 +1,171 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "simulator/hart.h"
+
+/**
+ * @brief Creates an empty hart group.
+ *
+ * @return Pointer to the newly created group
+ */
+static HartGroup* create_harts(){
+	HartGroup* harts = (HartGroup*) malloc(sizeof(HartGroup));
+
+	if (harts == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for HartGroup\n");
+		exit(1);
+	}
+
+	pthread_mutex_init(&harts->lock, NULL);
+	for(int id = 0; id < MAX_HARTS; id++){
+		harts->harts[id] = NULL;
+		harts->joining[id] = false;
+	}
+	return harts;
+}
+
+/**
+ * @brief Runs a hart until it halts or an error occurs.
+ *
+ * @param argument pointer to the hart's processor
+ * @return NULL if the hart halted, non-NULL otherwise
+ */
+static void* run_hart(void* argument){
+	Processor* hart = (Processor*) argument;
+	return run_processor(hart) == 0 ? NULL : hart;
+}
+
+/**
+ * @brief Waits for the hart in a slot claimed for joining, then frees the slot.
+ *
+ * @param harts pointer to the group
+ * @param id slot of the hart, already marked as joining
+ * @return 0 if the hart halted, 1 if it stopped on an error
+ */
+static uint64_t wait_for_hart(HartGroup* harts, uint64_t id){
+	void* stopped;
+	pthread_join(harts->threads[id], &stopped);
+
+	pthread_mutex_lock(&harts->lock);
+	Processor* hart = harts->harts[id];
+	harts->harts[id] = NULL;
+	harts->joining[id] = false;
+	pthread_mutex_unlock(&harts->lock);
+
+	destroy_processor(hart);
+	return stopped != NULL;
+}
+
+uint64_t spawn_hart(Processor* processor, uint8_t rd, uint64_t pc, uint64_t stack){
+	Processor* root = processor->root;
+	// Only the main hart runs before the first spawn, so the group is created without a race
+	if(root->harts == NULL){
+		root->harts = create_harts();
+	}
+
+	Processor* hart = (Processor*) malloc(sizeof(Processor));
+
+	if (hart == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Processor\n");
+		exit(1);
+	}
+
+	// Memory, devices, and loaded tables stay with the main hart, which frees them
+	*hart = *processor;
+	hart->pc = pc;
+	hart->registers[rd] = 0;
+	hart->registers[31] = stack;
+	hart->heap = NULL;
+	hart->harts = NULL;
+
+	HartGroup* harts = root->harts;
+	pthread_mutex_lock(&harts->lock);
+	uint64_t id = 1;
+	while(id < MAX_HARTS && harts->harts[id] != NULL){
+		id++;
+	}
+
+	if(id < MAX_HARTS && pthread_create(&harts->threads[id], NULL, run_hart, hart) == 0){
+		harts->harts[id] = hart;
+	}
+	else{
+		free(hart);
+		id = 0;
+	}
+	pthread_mutex_unlock(&harts->lock);
+
+	return id;
+}
+
+int join_hart(Processor* processor, uint64_t id, uint64_t* result){
+	HartGroup* harts = processor->root->harts;
+	if(harts == NULL || id == 0 || id >= MAX_HARTS){
+		return -1;
+	}
+
+	// Claim the slot so no other hart waits on the same thread
+	pthread_mutex_lock(&harts->lock);
+	bool valid = harts->harts[id] != NULL && harts->harts[id] != processor && !harts->joining[id];
+	if(valid){
+		harts->joining[id] = true;
+	}
+	pthread_mutex_unlock(&harts->lock);
+
+	if(!valid){
+		return -1;
+	}
+
+	*result = wait_for_hart(harts, id);
+	return 0;
+}
+
+int finish_harts(HartGroup* harts){
+	if(harts == NULL){
+		return 0;
+	}
+
+	int status = 0;
+	while(true){
+		// Harts being joined are waited for by a hart this loop still reaches
+		pthread_mutex_lock(&harts->lock);
+		uint64_t id = 1;
+		while(id < MAX_HARTS && (harts->harts[id] == NULL || harts->joining[id])){
+			id++;
+		}
+		if(id < MAX_HARTS){
+			harts->joining[id] = true;
+		}
+		pthread_mutex_unlock(&harts->lock);
+
+		if(id == MAX_HARTS){
+			return status;
+		}
+
+		if(wait_for_hart(harts, id) != 0){
+			status = -1;
+		}
+	}
+}
+
+void lock_harts(HartGroup* harts){
+	if(harts != NULL){
+		pthread_mutex_lock(&harts->lock);
+	}
+}
+
+void unlock_harts(HartGroup* harts){
+	if(harts != NULL){
+		pthread_mutex_unlock(&harts->lock);
+	}
+}
+
+void destroy_harts(HartGroup* harts){
+	if(harts != NULL){
+		finish_harts(harts);
+		pthread_mutex_destroy(&harts->lock);
+	}
+	free(harts);
+}
\ No newline at end of file
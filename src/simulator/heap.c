@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simulator/heap.h"
+
+Heap* create_heap(uint64_t begin, uint64_t end){
+	Heap* heap = (Heap*) calloc(1, sizeof(Heap));
+	uint64_t slots = end > begin ? (end - begin) / HEAP_ALIGNMENT : 0;
+	uint8_t* classes = (uint8_t*) calloc(slots + 1, sizeof(uint8_t));
+	uint32_t* links = (uint32_t*) calloc(slots + 1, sizeof(uint32_t));
+
+	if (heap == NULL || classes == NULL || links == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for Heap\n");
+		exit(1);
+	}
+
+	heap->begin = begin;
+	heap->end = begin + slots * HEAP_ALIGNMENT;
+	heap->top = begin;
+	heap->classes = classes;
+	heap->links = links;
+	return heap;
+}
+
+/**
+ * @brief Pushes a block onto the free list of its class.
+ *
+ * @param heap pointer to the heap
+ * @param address address of the block
+ * @param class the size class of the block
+ */
+static void push_free(Heap* heap, uint64_t address, int class){
+	uint64_t slot = (address - heap->begin) / HEAP_ALIGNMENT;
+	heap->links[slot] = heap->freeLists[class];
+	heap->freeLists[class] = (uint32_t) (slot + 1);
+}
+
+/**
+ * @brief Pops a block from the free list of a class.
+ *
+ * @param heap pointer to the heap
+ * @param class the size class
+ * @return the address of the block, or 0 if the list is empty
+ */
+static uint64_t pop_free(Heap* heap, int class){
+	if(heap->freeLists[class] == 0){
+		return 0;
+	}
+
+	uint64_t slot = heap->freeLists[class] - 1;
+	heap->freeLists[class] = heap->links[slot];
+	return heap->begin + slot * HEAP_ALIGNMENT;
+}
+
+uint64_t heap_allocate(Heap* heap, uint64_t size){
+	// Find the smallest class that holds the request
+	int class = 0;
+	while(class < HEAP_CLASSES && ((uint64_t) HEAP_ALIGNMENT << class) < size){
+		class++;
+	}
+	if(class == HEAP_CLASSES){
+		return 0;
+	}
+
+	uint64_t blockSize = (uint64_t) HEAP_ALIGNMENT << class;
+	uint64_t address = pop_free(heap, class);
+
+	// Cut a fresh block from the top of the heap
+	if(address == 0 && blockSize <= heap->end - heap->top){
+		address = heap->top;
+		heap->top += blockSize;
+	}
+
+	// Split the smallest larger free block, keeping the upper halves free
+	for(int larger = class + 1; address == 0 && larger < HEAP_CLASSES; larger++){
+		address = pop_free(heap, larger);
+		for(int split = larger - 1; address != 0 && split >= class; split--){
+			push_free(heap, address + ((uint64_t) HEAP_ALIGNMENT << split), split);
+		}
+	}
+
+	if(address != 0){
+		heap->classes[(address - heap->begin) / HEAP_ALIGNMENT] = (uint8_t) (class + 1);
+	}
+	return address;
+}
+
+int heap_free(Heap* heap, uint64_t address){
+	if(address < heap->begin || address >= heap->top || (address - heap->begin) % HEAP_ALIGNMENT != 0){
+		return -1;
+	}
+
+	// Only the start of an allocated block may be freed, and only once
+	uint64_t slot = (address - heap->begin) / HEAP_ALIGNMENT;
+	if(heap->classes[slot] == 0){
+		return -1;
+	}
+
+	push_free(heap, address, heap->classes[slot] - 1);
+	heap->classes[slot] = 0;
+	return 0;
+}
+
+void destroy_heap(Heap* heap){
+	if(heap == NULL){
+		return;
+	}
+
+	free(heap->classes);
+	free(heap->links);
+	free(heap);
+}
\ No newline at end of file
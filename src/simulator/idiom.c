@@ -0,0 +1,625 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "simulator/idiom.h"
+#include "simulator/vector.h"
+#include "simulator/simulator.h"
+
+/// @brief Fields of an instruction word
+typedef struct Word {
+	uint8_t opcode, rd, rs, rt;
+	uint16_t L;
+} Word;
+
+/**
+ * @brief Splits an instruction word into its fields.
+ *
+ * @param word the instruction word
+ * @return the fields
+ */
+static Word decode_word(uint32_t word){
+	Word fields = {(word >> 27) & 0x1F, (word >> 22) & 0x1F, (word >> 17) & 0x1F, (word >> 12) & 0x1F, word & 0xFFF};
+	return fields;
+}
+
+/**
+ * @brief Sign-extends the 12-bit literal of a mov load.
+ *
+ * @param L the literal
+ * @return the offset
+ */
+static int16_t load_offset(uint16_t L){
+	return (L & 0x800) ? (int16_t) (L | 0xF000) : (int16_t) L;
+}
+
+/**
+ * @brief Checks whether two operands are the pair of registers x and y, in either order.
+ *
+ * @param s first operand
+ * @param t second operand
+ * @param x one register
+ * @param y the other register
+ * @return true if the operands are x and y, false otherwise
+ */
+static bool same_pair(uint8_t s, uint8_t t, uint8_t x, uint8_t y){
+	return (s == x && t == y) || (s == y && t == x);
+}
+
+/**
+ * @brief Matches the dot-product loop shape at a run of code words.
+ *
+ * @param words the eight instruction words
+ * @param loop set to the loop if the words match
+ * @return true if the words form a dot-product loop, false otherwise
+ */
+static bool match_dot_loop(const uint32_t words[DOT_LOOP_WORDS], DotLoop* loop){
+	Word w[DOT_LOOP_WORDS];
+	for(int i = 0; i < DOT_LOOP_WORDS; i++){
+		w[i] = decode_word(words[i]);
+	}
+
+	// Two loads, a product of the loaded values, and an accumulation
+	if(w[0].opcode != 0x10 || w[1].opcode != 0x10 || (w[2].opcode != 0x1c && w[2].opcode != 0x16) || w[7].opcode != 0xe){
+		return false;
+	}
+
+	memset(loop, 0, sizeof(DotLoop));
+	memcpy(loop->words, words, DOT_LOOP_WORDS * sizeof(uint32_t));
+	loop->length = DOT_LOOP_WORDS;
+	loop->floating = w[2].opcode == 0x16;
+	loop->a = w[0].rd;
+	loop->b = w[1].rd;
+	loop->product = w[2].rd;
+	loop->pointers[0] = w[0].rs;
+	loop->pointers[1] = w[1].rs;
+	loop->offsets[0] = load_offset(w[0].L);
+	loop->offsets[1] = load_offset(w[1].L);
+	loop->target = w[7].rd;
+	loop->limit = w[7].rs;
+	loop->counter = w[7].rt;
+
+	if(!same_pair(w[2].rs, w[2].rt, loop->a, loop->b) || w[3].opcode != (loop->floating ? 0x14 : 0x18)
+		|| !same_pair(w[3].rs, w[3].rt, w[3].rd, loop->product)){
+		return false;
+	}
+	loop->sum = w[3].rd;
+
+	// Each of rP, rQ, and rK is stepped exactly once
+	uint8_t written[7] = {loop->a, loop->b, loop->product, loop->sum, loop->pointers[0], loop->pointers[1], loop->counter};
+	bool stepped[3] = {false, false, false};
+	for(int i = 4; i < 7; i++){
+		uint8_t reg = w[i].rd;
+		int which = reg == loop->pointers[0] ? 0 : reg == loop->pointers[1] ? 1 : reg == loop->counter ? 2 : -1;
+		if(which < 0 || stepped[which]){
+			return false;
+		}
+		stepped[which] = true;
+
+		if(w[i].opcode == 0x19){
+			if(which == 2){
+				loop->step = w[i].L;
+			}
+			else{
+				loop->strides[which] = w[i].L;
+				loop->strideRegisters[which] = -1;
+			}
+		}
+		else if(w[i].opcode == 0x18 && which < 2 && (w[i].rs == reg || w[i].rt == reg)){
+			loop->strideRegisters[which] = w[i].rs == reg ? w[i].rt : w[i].rs;
+		}
+		else{
+			return false;
+		}
+	}
+
+	// The loop writes seven distinct registers and reads its strides, limit, and target unchanged
+	for(int i = 0; i < 7; i++){
+		for(int j = i + 1; j < 7; j++){
+			if(written[i] == written[j]){
+				return false;
+			}
+		}
+		if(written[i] == loop->limit || written[i] == loop->target || written[i] == loop->strideRegisters[0] || written[i] == loop->strideRegisters[1]){
+			return false;
+		}
+	}
+
+	return loop->step > 0;
+}
+
+/**
+ * @brief Checks whether an instruction may appear in the index arithmetic of an indexed loop.
+ *
+ * @param w the instruction
+ * @return true if the instruction is clr, add, sub, mul, addi, subi, shftli, or mov between registers
+ */
+static bool is_index_op(Word w){
+	switch(w.opcode){
+		case 0x2:
+			return w.rs == w.rt;
+		case 0x7:
+			// Shifting a word by 64 or more is not defined on the host
+			return w.L < 64;
+		case 0x11:
+		case 0x18:
+		case 0x19:
+		case 0x1a:
+		case 0x1b:
+		case 0x1c:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ * @brief Matches the indexed dot-product loop shape at an address.
+ *
+ * @param memory memory of the processor
+ * @param address address of the first word
+ * @param end first address past the code segment
+ * @param loop set to the loop if the words match
+ * @return true if the words form an indexed dot-product loop, false otherwise
+ */
+static bool match_indexed_loop(const uint8_t* memory, uint64_t address, uint64_t end, DotLoop* loop){
+	uint64_t available = (end - address) / 4;
+	if(available > DOT_LOOP_MAX_WORDS){
+		available = DOT_LOOP_MAX_WORDS;
+	}
+	if(available < DOT_LOOP_WORDS){
+		return false;
+	}
+
+	uint32_t words[DOT_LOOP_MAX_WORDS];
+	Word w[DOT_LOOP_MAX_WORDS];
+	memcpy(words, &memory[address], available * sizeof(uint32_t));
+	for(uint64_t i = 0; i < available; i++){
+		w[i] = decode_word(words[i]);
+	}
+
+	// The test at the top and the word that leaves the loop, then index arithmetic up to the two loads
+	if(w[0].opcode != 0xe){
+		return false;
+	}
+	uint64_t body = 2;
+	while(body + 6 < available && is_index_op(w[body])){
+		body++;
+	}
+	if(body + 6 > available){
+		return false;
+	}
+
+	const Word* tail = &w[body];
+	if(tail[0].opcode != 0x10 || tail[1].opcode != 0x10 || (tail[2].opcode != 0x1c && tail[2].opcode != 0x16)
+		|| tail[4].opcode != 0x19 || tail[5].opcode != 0x8){
+		return false;
+	}
+
+	memset(loop, 0, sizeof(DotLoop));
+	memcpy(loop->words, words, (body + 6) * sizeof(uint32_t));
+	loop->length = (uint8_t) (body + 6);
+	loop->indexed = true;
+	loop->floating = tail[2].opcode == 0x16;
+	loop->a = tail[0].rd;
+	loop->b = tail[1].rd;
+	loop->product = tail[2].rd;
+	loop->pointers[0] = tail[0].rs;
+	loop->pointers[1] = tail[1].rs;
+	loop->offsets[0] = load_offset(tail[0].L);
+	loop->offsets[1] = load_offset(tail[1].L);
+	loop->target = w[0].rd;
+	loop->limit = w[0].rs;
+	loop->counter = w[0].rt;
+	loop->back = tail[5].rd;
+	loop->step = tail[4].L;
+
+	if(!same_pair(tail[2].rs, tail[2].rt, loop->a, loop->b) || tail[3].opcode != (loop->floating ? 0x14 : 0x18)
+		|| !same_pair(tail[3].rs, tail[3].rt, tail[3].rd, loop->product) || tail[4].rd != loop->counter){
+		return false;
+	}
+	loop->sum = tail[3].rd;
+
+	// Values carried from trip to trip may only pass through rS and rK
+	uint8_t written[5] = {loop->a, loop->b, loop->product, loop->sum, loop->counter};
+	uint32_t carried = 0;
+	for(int i = 0; i < 5; i++){
+		if(carried & (1U << written[i])){
+			return false;
+		}
+		carried |= 1U << written[i];
+	}
+	uint32_t fixed = 1U << loop->limit | 1U << loop->target | 1U << loop->back;
+	if(carried & fixed){
+		return false;
+	}
+
+	// Registers the index arithmetic writes must be written again before each trip reads them
+	uint32_t indices = 0;
+	for(uint64_t i = 2; i < body; i++){
+		indices |= 1U << w[i].rd;
+	}
+	if(indices & (carried | fixed)){
+		return false;
+	}
+
+	// Track whether each register is constant or affine in rK through the index arithmetic
+	uint8_t degree[32] = {0};
+	degree[loop->counter] = 1;
+	for(uint64_t i = 2; i < body; i++){
+		Word op = w[i];
+		uint8_t s = op.rs, t = op.rt;
+		if(op.opcode == 0x7 || op.opcode == 0x19 || op.opcode == 0x1b){
+			s = t = op.rd;
+		}
+		else if(op.opcode == 0x11){
+			t = op.rs;
+		}
+
+		// clr reads nothing; anything else reads constants, rK, or registers already written this trip
+		uint32_t reads = op.opcode == 0x2 ? 0 : 1U << s | 1U << t;
+		if(reads & ((carried & ~(1U << loop->counter)) | (indices & ~loop->indices))){
+			return false;
+		}
+
+		uint8_t d = op.opcode == 0x2 ? 0 : op.opcode == 0x1c ? degree[s] + degree[t] : degree[s] > degree[t] ? degree[s] : degree[t];
+		if(d > 1){
+			return false;
+		}
+		degree[op.rd] = d;
+		loop->indices |= 1U << op.rd;
+	}
+
+	// The bases may be constant or computed, but not loaded or accumulated
+	for(int i = 0; i < 2; i++){
+		if(carried & ~(1U << loop->counter) & (1U << loop->pointers[i])){
+			return false;
+		}
+	}
+
+	return loop->step > 0;
+}
+
+/**
+ * @brief Checks whether a register is written before it is read in the straight-line code at an address.
+ *
+ * Branches, calls, privileged operations, and the end of the code count as
+ * reads, since the register may be read wherever control goes next.
+ *
+ * @param memory memory of the processor
+ * @param address address of the first instruction to look at
+ * @param end first address past the code segment
+ * @param reg the register
+ * @return true if the register is dead at the address, false if it may be read
+ */
+static bool dead_after(const uint8_t* memory, uint64_t address, uint64_t end, uint8_t reg){
+	while(address + 4 <= end){
+		uint32_t word;
+		memcpy(&word, &memory[address], sizeof(uint32_t));
+		Word w = decode_word(word);
+
+		uint32_t reads;
+		switch(w.opcode){
+			case 0x3:
+			case 0x10:
+			case 0x11:
+				reads = 1U << w.rs;
+				break;
+			case 0x5:
+			case 0x7:
+			case 0x12:
+			case 0x19:
+			case 0x1b:
+				reads = 1U << w.rd;
+				break;
+			case 0x13:
+				reads = 1U << w.rd | 1U << w.rs;
+				break;
+			case 0x1e:
+				// ldw only writes rd and skips its payload
+				if(w.rd == reg){
+					return true;
+				}
+				address += 12;
+				continue;
+			default:
+				if((w.opcode >= 0x8 && w.opcode <= 0xf) || w.opcode == 0x1f){
+					return false;
+				}
+				reads = 1U << w.rs | 1U << w.rt;
+				break;
+		}
+
+		if(reads & (1U << reg)){
+			return false;
+		}
+		if(w.opcode != 0x13 && w.rd == reg){
+			return true;
+		}
+		address += 4;
+	}
+
+	return false;
+}
+
+/**
+ * @brief Matches a fused multiply-add pair at two code words.
+ *
+ * @param memory memory of the processor
+ * @param address address of the first word
+ * @param end first address past the code segment
+ * @param pair set to the pair if the words match
+ * @return true if the words form a fused pair, false otherwise
+ */
+static bool match_fused_pair(const uint8_t* memory, uint64_t address, uint64_t end, FusedPair* pair){
+	uint32_t words[2];
+	memcpy(words, &memory[address], sizeof(words));
+	Word multiply = decode_word(words[0]), add = decode_word(words[1]);
+
+	bool floating = multiply.opcode == 0x16;
+	if((multiply.opcode != 0x1c && !floating) || add.opcode != (floating ? 0x14 : 0x18)
+		|| add.rd == multiply.rd || !same_pair(add.rs, add.rt, add.rd, multiply.rd)){
+		return false;
+	}
+
+	pair->head = address;
+	memcpy(pair->words, words, sizeof(words));
+	pair->floating = floating;
+	pair->product = multiply.rd;
+	pair->a = multiply.rs;
+	pair->b = multiply.rt;
+	pair->sum = add.rd;
+	return dead_after(memory, address + 8, end, pair->product);
+}
+
+IdiomTable* find_idioms(const uint8_t* memory, uint64_t codeBegin, uint64_t codeSize){
+	IdiomTable* idioms = (IdiomTable*) calloc(1, sizeof(IdiomTable));
+	int16_t* heads = (int16_t*) calloc(codeSize / 4 + 1, sizeof(int16_t));
+	DotLoop* loops = (DotLoop*) malloc(sizeof(DotLoop) * (codeSize / (DOT_LOOP_WORDS * 4) + 1));
+	FusedPair* pairs = (FusedPair*) malloc(sizeof(FusedPair) * (codeSize / 8 + 1));
+
+	if (idioms == NULL || heads == NULL || loops == NULL || pairs == NULL) {
+		// Print error message and exit if memory allocation fails
+		fprintf(stderr, "Error: failed to allocate memory for IdiomTable\n");
+		exit(1);
+	}
+
+	idioms->codeBegin = codeBegin;
+	idioms->codeWords = codeSize / 4;
+	idioms->heads = heads;
+	idioms->loops = loops;
+	idioms->pairs = pairs;
+
+	// Matches cannot overlap, so the loops and pairs fit their arrays and every index fits an int16_t
+	for(uint64_t offset = 0; offset + DOT_LOOP_WORDS * 4 <= codeSize; offset += 4){
+		uint32_t words[DOT_LOOP_WORDS];
+		memcpy(words, &memory[codeBegin + offset], sizeof(words));
+
+		DotLoop* loop = &loops[idioms->count];
+		if(match_dot_loop(words, loop) || match_indexed_loop(memory, codeBegin + offset, codeBegin + codeSize, loop)){
+			loop->head = codeBegin + offset;
+			heads[offset / 4] = (int16_t) ++idioms->count;
+			offset += (loop->length - 1) * 4;
+		}
+	}
+	for(uint64_t offset = 0; offset + 8 <= codeSize; offset += 4){
+		if(heads[offset / 4] == 0 && heads[offset / 4 + 1] == 0 && match_fused_pair(memory, codeBegin + offset, codeBegin + codeSize, &pairs[idioms->pairCount])){
+			heads[offset / 4] = (int16_t) -++idioms->pairCount;
+			offset += 4;
+		}
+	}
+
+	if(idioms->count == 0 && idioms->pairCount == 0){
+		destroy_idioms(idioms);
+		return NULL;
+	}
+	return idioms;
+}
+
+/**
+ * @brief Checks whether every word of a strided sequence lies in memory.
+ *
+ * @param address address of the first word
+ * @param stride distance between words, wrapping like a guest address
+ * @param count number of words, at least one
+ * @return true if every word is in memory, false otherwise
+ */
+static bool sequence_in_memory(uint64_t address, uint64_t stride, uint64_t count){
+	if(address > MEM_SIZE - 8){
+		return false;
+	}
+
+	// Only the last word can be furthest from the first
+	bool backwards = (int64_t) stride < 0;
+	uint64_t distance = backwards ? 0 - stride : stride;
+	uint64_t room = backwards ? address : MEM_SIZE - 8 - address;
+	return distance == 0 || count - 1 <= room / distance;
+}
+
+/**
+ * @brief Runs the index arithmetic of an indexed loop for one value of its counter.
+ *
+ * @param loop pointer to the loop
+ * @param registers general purpose registers of the processor, left unchanged
+ * @param counter value of rK
+ * @param indices set to the registers as the index arithmetic leaves them
+ */
+static void run_indices(const DotLoop* loop, const uint64_t* registers, uint64_t counter, uint64_t indices[32]){
+	memcpy(indices, registers, 32 * sizeof(uint64_t));
+	indices[loop->counter] = counter;
+
+	// Wrapping unsigned arithmetic matches the interpreter's signed add, sub, and mul
+	for(int i = 2; i < loop->length - 6; i++){
+		Word w = decode_word(loop->words[i]);
+		uint64_t s = indices[w.rs], t = indices[w.rt];
+		switch(w.opcode){
+			case 0x2:
+				indices[w.rd] = 0;
+				break;
+			case 0x7:
+				indices[w.rd] <<= w.L;
+				break;
+			case 0x11:
+				indices[w.rd] = s;
+				break;
+			case 0x18:
+				indices[w.rd] = s + t;
+				break;
+			case 0x19:
+				indices[w.rd] += w.L;
+				break;
+			case 0x1a:
+				indices[w.rd] = s - t;
+				break;
+			case 0x1b:
+				indices[w.rd] -= w.L;
+				break;
+			default:
+				indices[w.rd] = s * t;
+				break;
+		}
+	}
+}
+
+/**
+ * @brief Runs a fused multiply-add pair as one operation.
+ *
+ * @param pair pointer to the pair
+ * @param registers general purpose registers of the processor
+ * @param memory memory of the processor
+ * @param pc the program counter, moved to the add if the pair ran
+ * @param strict whether a double pair must round the product before adding it
+ * @return true if the pair ran, false if it must be interpreted
+ */
+static bool run_fused_pair(const FusedPair* pair, uint64_t* registers, const uint8_t* memory, uint64_t* pc, bool strict){
+	if(memcmp(&memory[pair->head], pair->words, sizeof(pair->words)) != 0){
+		return false;
+	}
+
+	if(pair->floating){
+		double a, b, sum, product;
+		memcpy(&a, &registers[pair->a], sizeof(double));
+		memcpy(&b, &registers[pair->b], sizeof(double));
+		memcpy(&sum, &registers[pair->sum], sizeof(double));
+
+		product = a * b;
+		sum = strict ? sum + product : fma(a, b, sum);
+		memcpy(&registers[pair->product], &product, sizeof(uint64_t));
+		memcpy(&registers[pair->sum], &sum, sizeof(uint64_t));
+	}
+	else{
+		// The product is read before rX is written, in case rX is also a factor
+		uint64_t product = registers[pair->a] * registers[pair->b];
+		registers[pair->product] = product;
+		registers[pair->sum] += product;
+	}
+
+	*pc = pair->head + 4;
+	return true;
+}
+
+bool run_idiom(const IdiomTable* idioms, uint64_t* registers, const uint8_t* memory, uint64_t* pc, bool strict){
+	if(*pc < idioms->codeBegin || (*pc - idioms->codeBegin) / 4 >= idioms->codeWords || idioms->heads[(*pc - idioms->codeBegin) / 4] == 0){
+		return false;
+	}
+
+	int16_t head = idioms->heads[(*pc - idioms->codeBegin) / 4];
+	if(head < 0){
+		return run_fused_pair(&idioms->pairs[-head - 1], registers, memory, pc, strict);
+	}
+
+	// Stores may have changed the code, and the branches must still close the loop
+	const DotLoop* loop = &idioms->loops[head - 1];
+	uint64_t resume = loop->indexed ? loop->head + 8 : loop->head;
+	if(memcmp(&memory[loop->head], loop->words, loop->length * sizeof(uint32_t)) != 0 || registers[loop->target] != resume
+		|| (loop->indexed && registers[loop->back] != loop->head)){
+		return false;
+	}
+
+	// The body runs once, then again while the limit is above the counter
+	uint64_t counter = registers[loop->counter], limit = registers[loop->limit], trips;
+	if(loop->step > UINT64_MAX - counter){
+		return false;
+	}
+	if(loop->indexed && limit <= counter){
+		// An indexed loop tests first, so the interpreter just leaves it
+		return false;
+	}
+	if(limit <= counter + loop->step){
+		trips = 1;
+	}
+	else{
+		trips = (limit - counter - 1) / loop->step + 1;
+		if(trips > (UINT64_MAX - counter) / loop->step){
+			return false;
+		}
+	}
+
+	uint64_t addresses[2], strides[2], first[32], second[32];
+	if(loop->indexed){
+		// The addresses are affine in rK, so two trips give the first address and the stride
+		run_indices(loop, registers, counter, first);
+		run_indices(loop, registers, counter + loop->step, second);
+	}
+	for(int i = 0; i < 2; i++){
+		if(loop->indexed){
+			strides[i] = second[loop->pointers[i]] - first[loop->pointers[i]];
+			addresses[i] = first[loop->pointers[i]] + (uint64_t) (int64_t) loop->offsets[i];
+		}
+		else{
+			strides[i] = loop->strideRegisters[i] < 0 ? loop->strides[i] : registers[loop->strideRegisters[i]];
+			addresses[i] = registers[loop->pointers[i]] + (uint64_t) (int64_t) loop->offsets[i];
+		}
+
+		// Loads outside memory, such as from the input region, are left to the interpreter
+		if(!sequence_in_memory(addresses[i], strides[i], trips)){
+			return false;
+		}
+	}
+
+	registers[loop->sum] = dot_product(memory, addresses[0], strides[0], addresses[1], strides[1], trips, registers[loop->sum], loop->floating);
+
+	// The other registers hold what the last trip left in them
+	memcpy(&registers[loop->a], &memory[addresses[0] + (trips - 1) * strides[0]], sizeof(uint64_t));
+	memcpy(&registers[loop->b], &memory[addresses[1] + (trips - 1) * strides[1]], sizeof(uint64_t));
+	if(loop->floating){
+		double a, b, product;
+		memcpy(&a, &registers[loop->a], sizeof(double));
+		memcpy(&b, &registers[loop->b], sizeof(double));
+		product = a * b;
+		memcpy(&registers[loop->product], &product, sizeof(uint64_t));
+	}
+	else{
+		registers[loop->product] = registers[loop->a] * registers[loop->b];
+	}
+
+	if(loop->indexed){
+		uint64_t last[32];
+		run_indices(loop, registers, counter + (trips - 1) * loop->step, last);
+		for(int reg = 0; reg < 32; reg++){
+			if(loop->indices & (1U << reg)){
+				registers[reg] = last[reg];
+			}
+		}
+	}
+	else{
+		for(int i = 0; i < 2; i++){
+			registers[loop->pointers[i]] += trips * strides[i];
+		}
+	}
+	registers[loop->counter] = counter + trips * loop->step;
+
+	// An indexed loop ends on its failing test at the head, a pointer loop on its final brgt
+	*pc = loop->indexed ? loop->head : loop->head + (DOT_LOOP_WORDS - 1) * 4;
+	return true;
+}
+
+void destroy_idioms(IdiomTable* idioms){
+	if(idioms != NULL){
+		free(idioms->heads);
+		free(idioms->loops);
+		free(idioms->pairs);
+	}
+	free(idioms);
+}
\ No newline at end of file
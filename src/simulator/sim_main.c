@@ -1,16 +1,54 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
 
 #include "simulator/simulator.h"
 
 int main(int argc, char* argv[]){
+	SimulatorOptions options = {NULL, NULL, false};
+	bool source = false;
+	int arg = 1;
+
+	// Parse the optional flags that precede the program file
+	while(arg < argc && argv[arg][0] == '-' && argv[arg][1] == '-'){
+		if(strcmp(argv[arg], "--source") == 0){
+			// Assemble and run a source file without an intermediate object file
+			source = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "--strict-ieee") == 0){
+			// Round fused mulf/addf pairs like the separate instructions
+			options.strictIEEE = true;
+			arg++;
+		}
+		else if(strcmp(argv[arg], "--input") == 0 && arg + 1 < argc){
+			// Map a binary input file at INPUT_ADDR
+			options.inputFile = argv[arg + 1];
+			arg += 2;
+		}
+		else if(strcmp(argv[arg], "--output") == 0 && arg + 1 < argc){
+			// Send the binary output port to a file instead of stdout
+			options.outputFile = argv[arg + 1];
+			arg += 2;
+		}
+		else{
+			break;
+		}
+	}
+
 	// Check that there is one input file
-	if(argc != 2){
+	if(argc - arg != 1){
 		fprintf(stderr, "Invalid tinker filepath\n");
 		exit(1);
 	}
 
-	simulate_program(argv[1]);
+	if(source){
+		simulate_source(argv[arg], &options);
+	}
+	else{
+		simulate_program(argv[arg], &options);
+	}
 
 	return 0;
 }
\ No newline at end of file
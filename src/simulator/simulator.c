@@ -1,30 +1,15 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include "simulator/simulator.h"
 #include "simulator/utils.h"
-
-#define FILE_TYPE 0
-#define INIT_CODE_ADDR 0x2000
-#define INIT_DATA_ADDR 0x10000
-
-TinkerFileHeader* create_tinker_file_header(){
-	TinkerFileHeader* tfh = (TinkerFileHeader*) malloc(sizeof(TinkerFileHeader));
-
-	if (tfh == NULL) {
-		// Print error message and exit if memory allocation fails
-		fprintf(stderr, "Failed to allocate memory for TinkerFileHeader\n");
-		exit(1);
-	}
-	
-	// Initialize file header
-	tfh->fileType = FILE_TYPE;
-	tfh->codeBegin = INIT_CODE_ADDR;
-	tfh->dataBegin = INIT_DATA_ADDR;
-
-	return tfh;
-}
+#include "simulator/vector.h"
+#include "simulator/hart.h"
+#include "assembler/assembler.h"
+#include "common/file.h"
+#include "common/compress.h"
 
 Processor* create_processor(){
 	Processor* processor = (Processor*) malloc(sizeof(Processor));
@@ -34,20 +19,56 @@ Processor* create_processor(){
 		exit(1);
 	}
 
+	processor->memory = (uint8_t*) malloc(MEM_SIZE);
+
+	if(processor->memory == NULL){
+		fprintf(stderr, "Error: failed to allocate memory for Processor memory\n");
+		exit(1);
+	}
+
 	// Initialize the program counter to the starting address
 	processor->pc = INIT_CODE_ADDR;
 	// Initialize the registers and memory
 	memset(processor->registers, 0, sizeof(processor->registers));
-	memset(processor->memory, 255, sizeof(processor->memory));
+	memset(processor->vectors, 0, sizeof(processor->vectors));
+	memset(processor->memory, 255, MEM_SIZE);
 	// Set the stack pointer register to the memory size
 	processor->registers[31] = MEM_SIZE;
 	processor->mode = USER_MODE;
+	processor->debug = NULL;
+	processor->input = NULL;
+	processor->output = stdout;
+	processor->heapBegin = INIT_DATA_ADDR;
+	processor->heap = NULL;
+	processor->idioms = NULL;
+	processor->strictIEEE = false;
+	processor->root = processor;
+	processor->harts = NULL;
 
 	populate_instructions(processor);
 	return processor;
 }
 
-void simulate_program(const char* filename){
+/**
+ * @brief Attaches the input and output files named by the options and sets the floating-point mode.
+ * 
+ * @param processor pointer to the processor
+ * @param options pointer to the devices to attach
+ * @return 0 if successful, -1 otherwise
+ */
+static int attach_devices(Processor* processor, const SimulatorOptions* options){
+	processor->strictIEEE = options->strictIEEE;
+	if(options->inputFile != NULL && attach_input(processor, options->inputFile) != 0){
+		return -1;
+	}
+	if(options->outputFile != NULL && attach_output(processor, options->outputFile) != 0){
+		return -1;
+	}
+
+	return 0;
+}
+
+void simulate_program(const char* filename, const SimulatorOptions* options){
 	Processor* processor = create_processor();
 	if(load_memory(filename, processor) == -1){
 		fprintf(stderr, "Simulation error: failed to load memory\n");
@@ -55,60 +76,284 @@ void simulate_program(const char* filename){
 		exit(1);
 	}
 
+	if(attach_devices(processor, options) != 0){
+		destroy_processor(processor);
+		exit(1);
+	}
+
+	int status = run_processor(processor);
+	// Harts still running finish before the program ends, and their errors fail it too
+	if(finish_harts(processor->harts) != 0){
+		status = -1;
+	}
+	destroy_processor(processor);
+
+	if(status != 0){
+		exit(1);
+	}
+}
+
+void simulate_source(const char* filename, const SimulatorOptions* options){
+	FILE* fp = fopen(filename, "r");
+
+	// Check if the source file was opened successfully
+	if(fp == NULL){
+		fprintf(stderr, "Invalid tinker filepath\n");
+		exit(1);
+	}
+
+	Source* source = read_source(fp);
+	fclose(fp);
+	if(source == NULL){
+		fprintf(stderr, "Invalid tinker filepath\n");
+		exit(1);
+	}
+
+	// Assemble straight into memory with a debug table; no object file is written or read back
+	AssemblerOptions assemblerOptions = {1, false, false, false, true, false};
+	ObjectBuffer* image = create_object_buffer();
+	int status = assemble_source_with_options(source->text, source->size, image, &assemblerOptions);
+	destroy_source(source);
+
+	if(status != 0){
+		fprintf(stderr, "Simulation error: failed to assemble program\n");
+		destroy_object_buffer(image);
+		exit(1);
+	}
+
+	Processor* processor = create_processor();
+	status = load_image(image->data, image->size, processor);
+	destroy_object_buffer(image);
+
+	if(status != 0){
+		fprintf(stderr, "Simulation error: failed to load memory\n");
+		destroy_processor(processor);
+		exit(1);
+	}
+
+	if(attach_devices(processor, options) != 0){
+		destroy_processor(processor);
+		exit(1);
+	}
+
+	status = run_processor(processor);
+	// Harts still running finish before the program ends, and their errors fail it too
+	if(finish_harts(processor->harts) != 0){
+		status = -1;
+	}
+	destroy_processor(processor);
+
+	if(status != 0){
+		exit(1);
+	}
+}
+
+int attach_input(Processor* processor, const char* filename){
+	MappedFile* file = map_file(filename);
+	if(file == NULL){
+		fprintf(stderr, "Simulation error: could not read the input file %s\n", filename);
+		return -1;
+	}
+
+	unmap_file(processor->input);
+	processor->input = file;
+	return 0;
+}
+
+int attach_output(Processor* processor, const char* filename){
+	FILE* output = fopen(filename, "wb");
+	if(output == NULL){
+		fprintf(stderr, "Simulation error: could not open the output file %s for writing\n", filename);
+		return -1;
+	}
+
+	// Values are written 8 bytes at a time, so a large buffer keeps the writes few
+	setvbuf(output, NULL, _IOFBF, 1 << 16);
+	if(processor->output != stdout){
+		fclose(processor->output);
+	}
+	processor->output = output;
+	return 0;
+}
+
+/**
+ * @brief Reads a word from the input region mapped at INPUT_ADDR.
+ * 
+ * @param processor pointer to the processor
+ * @param address address of the word
+ * @param value set to the word read
+ * @return 0 if successful, -1 if the word is not in the input region
+ */
+static int read_input(const Processor* processor, uint64_t address, uint64_t* value){
+	const MappedFile* input = processor->input;
+	if(input == NULL || address < INPUT_SIZE_ADDR){
+		return -1;
+	}
+
+	if(address == INPUT_SIZE_ADDR){
+		*value = input->size;
+		return 0;
+	}
+
+	// The last word of a file that is not a whole number of words is zero-padded
+	uint64_t offset = address - INPUT_ADDR;
+	if(address < INPUT_ADDR || offset >= input->size){
+		return -1;
+	}
+
+	uint64_t available = input->size - offset < sizeof(uint64_t) ? input->size - offset : sizeof(uint64_t);
+	*value = 0;
+	memcpy(value, input->data + offset, available);
+	return 0;
+}
+
+/**
+ * @brief Names the code at an address on stderr when the loaded object has a debug table.
+ * 
+ * @param processor pointer to the processor
+ * @param address address of the instruction
+ */
+static void report_location(Processor* processor, uint64_t address){
+	char description[512];
+	if(processor->debug != NULL && describe_address(processor->debug, address, description, sizeof(description)) == 0){
+		fprintf(stderr, "    at 0x%lx %s\n", address, description);
+	}
+}
+
+int run_processor(Processor* processor){
 	int status = 0;
+	uint64_t address = processor->pc;
 	// Process instructions until an error or halt
 	while((status = process_instruction(processor)) == 0){
 		processor->pc += 4;
 
-		// Check for program counter out of bounds
+		// Check for program counter out of bounds, naming the instruction that left the code
 		if(processor->pc < INIT_CODE_ADDR || processor->pc >= INIT_DATA_ADDR){
 			fprintf(stderr, "Simulation error: program counter out of bounds\n");
-			destroy_processor(processor);
-			exit(1);
+			report_location(processor, address);
+			return -1;
 		}
+		address = processor->pc;
 	}
 
 	if(status == -1){
 		fprintf(stderr, "Simulation error: invalid instruction\n");
-		destroy_processor(processor);
-		exit(1);
+		report_location(processor, processor->pc);
+		return -1;
 	}
 
-	destroy_processor(processor);
-	return;
+	return 0;
 }
 
 int load_memory(const char* filename, Processor* processor){
-	FILE *fp = fopen(filename, "rb");
+	// Map the object file so its segments are copied into memory straight from the page cache
+	MappedFile* file = map_file(filename);
 
 	// Check if the input file was opened successfully
-	if(fp == NULL){
+	if(file == NULL){
 		fprintf(stderr, "Invalid tinker filepath\n");
 		return -1;
 	}
 
-	// Get file header data from object file
-	TinkerFileHeader* tfh = create_tinker_file_header();
-	fread(tfh, sizeof(TinkerFileHeader), 1, fp);
+	int status = load_image(file->data, file->size, processor);
+	unmap_file(file);
+	return status;
+}
+
+int load_image(const uint8_t* image, uint64_t size, Processor* processor){
+	// Check that the image holds a complete file header
+	if(size < sizeof(TinkerFileHeader)){
+		fprintf(stderr, "Object file is too small\n");
+		return -1;
+	}
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image, sizeof(TinkerFileHeader));
+
+	// Find the code segment behind the header and any reserved range table
+	uint64_t reservedCount;
+	uint64_t offset = object_code_offset(image, size, &reservedCount);
+	if(offset == 0){
+		fprintf(stderr, "Object file header is malformed\n");
+		return -1;
+	}
+
+	// Relocatable objects hold unresolved addresses until they are linked
+	if(tfh.fileType & FILE_FLAG_RELOCATABLE){
+		fprintf(stderr, "Object file is relocatable; link it with hw7-ld first\n");
+		return -1;
+	}
 
 	// Check that the code segment is not too large (will overlap with data)
-	if(tfh->codeSize > INIT_DATA_ADDR - INIT_CODE_ADDR){
+	if(tfh.codeSize > INIT_DATA_ADDR - INIT_CODE_ADDR){
 		fprintf(stderr, "Code segment is too large\n");
-		free(tfh);
-		fclose(fp);
 		return -1;
 	}
 
-	// Load code and data from object file into memory
-	fread(&processor->memory[tfh->codeBegin], tfh->codeSize, 1, fp);
-	fread(&processor->memory[tfh->dataBegin], tfh->dataSize, 1, fp);
+	// Check that both segments fit in memory and are present in the image
+	DataDecoder decoder;
+	if(tfh.codeBegin > MEM_SIZE || tfh.codeSize > MEM_SIZE - tfh.codeBegin ||
+		tfh.dataBegin > MEM_SIZE || tfh.dataSize > MEM_SIZE - tfh.dataBegin ||
+		open_data_segment(&decoder, image, size) != 0){
+		fprintf(stderr, "Object file segments are out of bounds\n");
+		return -1;
+	}
 
-	free(tfh);
-	fclose(fp);
+	// Load code and data from the image into memory; compressed data is decoded in place
+	memcpy(&processor->memory[tfh.codeBegin], image + offset, tfh.codeSize);
+	uint64_t address = tfh.dataBegin;
+	uint64_t remaining = tfh.dataSize;
+
+	// Reserved ranges take no file bytes, so the data around them is loaded piece by piece
+	for(uint64_t i = 0; i < reservedCount; i++){
+		ReservedRange range = object_reserved_range(image, i);
+
+		if(range.address < address || range.address - address > remaining || range.address > MEM_SIZE || range.size > MEM_SIZE - range.address){
+			fprintf(stderr, "Object file reserved ranges are out of bounds\n");
+			return -1;
+		}
+
+		if(decode_data(&decoder, &processor->memory[address], range.address - address) != 0){
+			fprintf(stderr, "Object file data segment is malformed\n");
+			return -1;
+		}
+		remaining -= range.address - address;
+
+		memset(&processor->memory[range.address], 0, range.size);
+		address = range.address + range.size;
+	}
+
+	if(remaining > MEM_SIZE - address){
+		fprintf(stderr, "Object file segments are out of bounds\n");
+		return -1;
+	}
+
+	if(decode_data(&decoder, &processor->memory[address], remaining) != 0 || !data_segment_finished(&decoder)){
+		fprintf(stderr, "Object file data segment is malformed\n");
+		return -1;
+	}
+
+	// The heap starts empty after the data the program was loaded with
+	destroy_heap(processor->heap);
+	processor->heap = NULL;
+	processor->heapBegin = (address + remaining + HEAP_ALIGNMENT - 1) & ~(uint64_t) (HEAP_ALIGNMENT - 1);
+
+	// Keep the debug table, which only error reports read
+	destroy_debug_info(processor->debug);
+	processor->debug = (tfh.fileType & FILE_FLAG_DEBUG) ? read_debug_info(image, size) : NULL;
+
+	// Recognize the loops that can run natively while the code is known to be unchanged
+	destroy_idioms(processor->idioms);
+	processor->idioms = find_idioms(processor->memory, tfh.codeBegin, tfh.codeSize);
 	return 0;
 }
 
 int process_instruction(Processor* processor){
+	// A recognized loop or pair runs to its last instruction in one step
+	if(processor->idioms != NULL && run_idiom(processor->idioms, processor->registers, processor->memory, &processor->pc, processor->strictIEEE)){
+		return 0;
+	}
+
 	uint32_t instr;
 	// Fetch the instruction from memory
 	memcpy(&instr, &processor->memory[processor->pc], sizeof(instr));
@@ -121,7 +366,7 @@ int process_instruction(Processor* processor){
 	int16_t L = instr & 0xFFFF;
 
 	// Check for invalid opcode
-	if(opcode < 0 || opcode > 29){
+	if(opcode >= NUM_INSTR){
 		fprintf(stderr, "Simulation error: invalid opcode\n");
 		return -1;
 	}
@@ -132,7 +377,8 @@ int process_instruction(Processor* processor){
 void populate_instructions(Processor* processor){
 	Instruction instructions[] = {
 		and, or, xor, not, shftr, shftri, shftl, shftli, br, brr, brrL, brnz, call, ret, brgt, priv, 
-		movRRL, movRR, movRL, movRLR, addf, subf, mulf, divf, add, addi, sub, subi, mul, divi
+		movRRL, movRR, movRL, movRLR, addf, subf, mulf, divf, add, addi, sub, subi, mul, divi,
+		ldw, vector
 	};
 
 	memcpy(processor->instructions, instructions, sizeof(processor->instructions));
@@ -193,6 +439,18 @@ int divi(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 	return 0;
 }
 
+int ldw(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
+	// Check that the payload lies within the code segment
+	if(processor->pc + 12 > INIT_DATA_ADDR){
+		return -1;
+	}
+
+	memcpy(&processor->registers[rd], &processor->memory[processor->pc + 4], sizeof(uint64_t));
+	// Skip the payload words
+	processor->pc += 8;
+	return 0;
+}
+
 int and(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 	processor->registers[rd] = processor->registers[rs] & processor->registers[rt];
 	return 0;
@@ -282,8 +540,158 @@ int brgt(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 	return 0;
 }
 
+/**
+ * @brief Checks whether a range of bytes lies in memory.
+ * 
+ * @param address address of the first byte
+ * @param size number of bytes
+ * @return true if the whole range is in memory, false otherwise
+ */
+static bool in_memory(uint64_t address, uint64_t size){
+	return address <= MEM_SIZE && size <= MEM_SIZE - address;
+}
+
+/**
+ * @brief Writes a range of memory to an output port.
+ * 
+ * @param processor pointer to the processor
+ * @param port the output port
+ * @param address address of the first byte
+ * @param size number of bytes, a multiple of 8 for port 1
+ * @return 0 if successful, -1 if the range is out of bounds or cannot be written
+ */
+static int write_memory(Processor* processor, uint64_t port, uint64_t address, uint64_t size){
+	if(!in_memory(address, size)){
+		return -1;
+	}
+
+	const uint8_t* bytes = &processor->memory[address];
+	if(port == 1){
+		if(size % 8 != 0){
+			return -1;
+		}
+
+		for(uint64_t offset = 0; offset < size; offset += 8){
+			uint64_t value;
+			memcpy(&value, bytes + offset, sizeof(uint64_t));
+			printf("%lu\n", value);
+		}
+	}
+	else if(port == 2 || port == 3){
+		FILE* stream = port == 2 ? processor->output : stdout;
+		if(fwrite(bytes, 1, size, stream) != size){
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Runs a memory host call over rt bytes with the host's routines.
+ * 
+ * Copy (6) moves the bytes at rs to rd, even if the ranges overlap; fill (7)
+ * sets the bytes at rd to the low byte of rs; compare (8) leaves -1, 0, or 1
+ * in rd as the bytes at rd sort before, equal, or after the bytes at rs.
+ * 
+ * @param processor pointer to the processor
+ * @param rd destination register
+ * @param rs source register
+ * @param rt register holding the number of bytes
+ * @param operation the priv literal
+ * @return 0 if successful, -1 if a range is out of bounds
+ */
+static int memory_host_call(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int operation){
+	uint64_t destination = processor->registers[rd];
+	uint64_t source = processor->registers[rs];
+	uint64_t size = processor->registers[rt];
+
+	// Each range is checked once, however many bytes it holds
+	if(!in_memory(destination, size) || (operation != 7 && !in_memory(source, size))){
+		return -1;
+	}
+
+	if(operation == 6){
+		memmove(&processor->memory[destination], &processor->memory[source], size);
+	}
+	else if(operation == 7){
+		memset(&processor->memory[destination], (int) (source & 0xFF), size);
+	}
+	else{
+		int order = memcmp(&processor->memory[destination], &processor->memory[source], size);
+		processor->registers[rd] = order < 0 ? (uint64_t) -1 : order > 0 ? 1 : 0;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Runs an allocation host call on the heap of the main hart.
+ * 
+ * @param processor pointer to the processor
+ * @param rd destination register
+ * @param rs source register
+ * @param operation the priv literal, 9 to allocate or 10 to free
+ * @return 0 if successful, -1 if the block to free was never allocated
+ */
+static int heap_host_call(Processor* processor, uint8_t rd, uint8_t rs, int operation){
+	// Every hart allocates from one heap, so calls are serialized once harts exist
+	Processor* root = processor->root;
+	lock_harts(root->harts);
+
+	// The heap runs from the end of the data to the space kept for the stack
+	if(root->heap == NULL){
+		root->heap = create_heap(root->heapBegin, MEM_SIZE - STACK_RESERVE);
+	}
+
+	int status = 0;
+	if(operation == 9){
+		processor->registers[rd] = heap_allocate(root->heap, processor->registers[rs]);
+	}
+	else if(processor->registers[rd] != 0 && heap_free(root->heap, processor->registers[rd]) != 0){
+		status = -1;
+	}
+
+	unlock_harts(root->harts);
+	return status;
+}
+
+/**
+ * @brief Runs an atomic host call on the word at the address in rs.
+ * 
+ * Fetch-add (13) adds rt to the word; compare-and-swap (14) stores rt there
+ * only if the word equals rd. Both leave the old word in rd.
+ * 
+ * @param processor pointer to the processor
+ * @param rd destination register
+ * @param rs register holding the address, a multiple of 8
+ * @param rt source register
+ * @param operation the priv literal
+ * @return 0 if successful, -1 if the word is out of bounds or misaligned
+ */
+static int atomic_host_call(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int operation){
+	uint64_t address = processor->registers[rs];
+	if(address % 8 != 0 || !in_memory(address, 8)){
+		return -1;
+	}
+
+	uint64_t* word = (uint64_t*) &processor->memory[address];
+	if(operation == 13){
+		processor->registers[rd] = __atomic_fetch_add(word, processor->registers[rt], __ATOMIC_SEQ_CST);
+	}
+	else{
+		// A failed exchange leaves the word it found in expected, a successful one the old word
+		uint64_t expected = processor->registers[rd];
+		__atomic_compare_exchange_n(word, &expected, processor->registers[rt], false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+		processor->registers[rd] = expected;
+	}
+
+	return 0;
+}
+
 int priv(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
-	switch(L){
+	// The literal shares its upper bits with rt, which bulk output uses
+	switch(L & 0xFFF){
 		case 0:
 			// Halt the processor
 			return 1;
@@ -315,11 +723,38 @@ int priv(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 			if(processor->registers[rd] == 1){
 				printf("%lu\n", processor->registers[rs]);
 			}
+			else if(processor->registers[rd] == 2){
+				if(fwrite(&processor->registers[rs], sizeof(uint64_t), 1, processor->output) != 1){
+					return -1;
+				}
+			}
 			else if(processor->registers[rd] == 3){
 				char character = processor->registers[rs] & 0xFF;
 				printf("%c", character);
 			}
 			break;
+		case 5:
+			return write_memory(processor, processor->registers[rd], processor->registers[rs], processor->registers[rt]);
+		case 6:
+		case 7:
+		case 8:
+			return memory_host_call(processor, rd, rs, rt, L & 0xFFF);
+		case 9:
+		case 10:
+			return heap_host_call(processor, rd, rs, L & 0xFFF);
+		case 11:
+			// A hart must start in the code segment, like any branch target
+			if(processor->registers[rs] < INIT_CODE_ADDR || processor->registers[rs] >= INIT_DATA_ADDR){
+				return -1;
+			}
+
+			processor->registers[rd] = spawn_hart(processor, rd, processor->registers[rs], processor->registers[rt]);
+			break;
+		case 12:
+			return join_hart(processor, processor->registers[rs], &processor->registers[rd]);
+		case 13:
+		case 14:
+			return atomic_host_call(processor, rd, rs, rt, L & 0xFFF);
 		default:
 			return -1;
 	}
@@ -332,9 +767,9 @@ int movRRL(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 	L = (L & 0x800) ? (L | 0xF000) : (L & 0xFFF);
 	uint64_t index = processor->registers[rs] + L;
 
-	// Check for memory index out of bounds
+	// Addresses past the end of memory may be in the input region
 	if(index < 0 || index > MEM_SIZE - 8){
-		return -1;
+		return read_input(processor, index, &processor->registers[rd]);
 	}
 
 	// Load value from memory into register
@@ -414,5 +849,17 @@ int divf(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
 }
 
 void destroy_processor(Processor* processor){
+	// Spawned harts borrow everything but their registers from the main hart
+	if(processor != NULL && processor->root == processor){
+		destroy_harts(processor->harts);
+		free(processor->memory);
+		destroy_debug_info(processor->debug);
+		unmap_file(processor->input);
+		destroy_heap(processor->heap);
+		destroy_idioms(processor->idioms);
+		if(processor->output != stdout){
+			fclose(processor->output);
+		}
+	}
 	free(processor);
 }
\ No newline at end of file
@@ -0,0 +1,332 @@
+#include <string.h>
+#include <pthread.h>
+
+#include "simulator/vector.h"
+#include "common/vector.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define HAS_AVX2_PATH 1
+#else
+#define HAS_AVX2_PATH 0
+#endif
+
+/// @brief Whether vector instructions use AVX2: -1 until the host is checked
+static int accelerated = -1;
+
+bool use_vector_acceleration(bool enabled){
+#if HAS_AVX2_PATH
+	__builtin_cpu_init();
+	accelerated = enabled && __builtin_cpu_supports("avx2");
+#else
+	accelerated = 0;
+#endif
+	return accelerated;
+}
+
+/// @brief Makes sure the host is checked once, even when several harts reach a vector instruction together
+static pthread_once_t detected = PTHREAD_ONCE_INIT;
+
+/**
+ * @brief Turns acceleration on where the host supports it, unless it was already chosen.
+ */
+static void detect_acceleration(){
+	if(accelerated < 0){
+		use_vector_acceleration(true);
+	}
+}
+
+/**
+ * @brief Runs a lane-wise operation with portable host code.
+ *
+ * @param op the vector operation
+ * @param d destination lanes
+ * @param s first source lanes
+ * @param t second source lanes
+ */
+static void lanes_portable(VectorOp op, uint64_t d[VECTOR_LANES], const uint64_t s[VECTOR_LANES], const uint64_t t[VECTOR_LANES]){
+	for(int i = 0; i < VECTOR_LANES; i++){
+		double a, b, result;
+		memcpy(&a, &s[i], sizeof(double));
+		memcpy(&b, &t[i], sizeof(double));
+
+		switch(op){
+			case VECTOR_ADD:
+				d[i] = s[i] + t[i];
+				break;
+			case VECTOR_MUL:
+				d[i] = s[i] * t[i];
+				break;
+			case VECTOR_ADDF:
+				result = a + b;
+				memcpy(&d[i], &result, sizeof(double));
+				break;
+			default:
+				result = a * b;
+				memcpy(&d[i], &result, sizeof(double));
+				break;
+		}
+	}
+}
+
+/**
+ * @brief Sums the lanes of a vector with portable host code.
+ *
+ * @param op VECTOR_SUM or VECTOR_SUMF
+ * @param s source lanes
+ * @return the sum, as an integer or the bits of a double
+ */
+static uint64_t sum_portable(VectorOp op, const uint64_t s[VECTOR_LANES]){
+	if(op == VECTOR_SUM){
+		return s[0] + s[1] + s[2] + s[3];
+	}
+
+	double lanes[VECTOR_LANES];
+	memcpy(lanes, s, sizeof(lanes));
+
+	double sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	uint64_t bits;
+	memcpy(&bits, &sum, sizeof(uint64_t));
+	return bits;
+}
+
+/**
+ * @brief Accumulates products of strided words with portable host code.
+ *
+ * @param memory memory of the processor
+ * @param a address of the first word of the first sequence
+ * @param strideA distance between words of the first sequence
+ * @param b address of the first word of the second sequence
+ * @param strideB distance between words of the second sequence
+ * @param begin index of the first pair to multiply
+ * @param count number of pairs in the sequences
+ * @param sum the accumulator, as an integer or the bits of a double
+ * @param floating whether the words are doubles
+ * @return the accumulator after adding every product
+ */
+static uint64_t dot_portable(const uint8_t* memory, uint64_t a, uint64_t strideA, uint64_t b, uint64_t strideB, uint64_t begin, uint64_t count, uint64_t sum, bool floating){
+	double total;
+	memcpy(&total, &sum, sizeof(double));
+
+	for(uint64_t i = begin; i < count; i++){
+		uint64_t x, y;
+		memcpy(&x, &memory[a + i * strideA], sizeof(uint64_t));
+		memcpy(&y, &memory[b + i * strideB], sizeof(uint64_t));
+
+		if(floating){
+			double u, v;
+			memcpy(&u, &x, sizeof(double));
+			memcpy(&v, &y, sizeof(double));
+			total = total + u * v;
+		}
+		else{
+			sum += x * y;
+		}
+	}
+
+	if(floating){
+		memcpy(&sum, &total, sizeof(uint64_t));
+	}
+	return sum;
+}
+
+#if HAS_AVX2_PATH
+/**
+ * @brief Multiplies 64-bit lanes, keeping the low 64 bits of each product.
+ *
+ * AVX2 has no 64-bit multiply, so products are put together from 32-bit
+ * halves: the low product plus both cross products shifted up.
+ *
+ * @param a first factors
+ * @param b second factors
+ * @return the products
+ */
+__attribute__((target("avx2")))
+static __m256i multiply_avx2(__m256i a, __m256i b){
+	__m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b), _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+	return _mm256_add_epi64(_mm256_mul_epu32(a, b), _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * @brief Runs a lane-wise operation on the host's AVX2 units.
+ *
+ * @param op the vector operation
+ * @param d destination lanes
+ * @param s first source lanes
+ * @param t second source lanes
+ */
+__attribute__((target("avx2")))
+static void lanes_avx2(VectorOp op, uint64_t d[VECTOR_LANES], const uint64_t s[VECTOR_LANES], const uint64_t t[VECTOR_LANES]){
+	__m256i a = _mm256_loadu_si256((const __m256i*) s);
+	__m256i b = _mm256_loadu_si256((const __m256i*) t);
+	__m256i result;
+
+	switch(op){
+		case VECTOR_ADD:
+			result = _mm256_add_epi64(a, b);
+			break;
+		case VECTOR_MUL:
+			result = multiply_avx2(a, b);
+			break;
+		case VECTOR_ADDF:
+			result = _mm256_castpd_si256(_mm256_add_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)));
+			break;
+		default:
+			result = _mm256_castpd_si256(_mm256_mul_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(b)));
+			break;
+	}
+
+	_mm256_storeu_si256((__m256i*) d, result);
+}
+
+/**
+ * @brief Sums the lanes of a vector on the host's AVX2 units.
+ *
+ * @param op VECTOR_SUM or VECTOR_SUMF
+ * @param s source lanes
+ * @return the sum, as an integer or the bits of a double
+ */
+__attribute__((target("avx2")))
+static uint64_t sum_avx2(VectorOp op, const uint64_t s[VECTOR_LANES]){
+	__m256i a = _mm256_loadu_si256((const __m256i*) s);
+
+	if(op == VECTOR_SUM){
+		__m128i pair = _mm_add_epi64(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+		return (uint64_t) _mm_cvtsi128_si64(_mm_add_epi64(pair, _mm_unpackhi_epi64(pair, pair)));
+	}
+
+	// hadd pairs lanes 0 and 1 in the low half and lanes 2 and 3 in the high half
+	__m256d pairs = _mm256_hadd_pd(_mm256_castsi256_pd(a), _mm256_castsi256_pd(a));
+	__m128d sum = _mm_add_sd(_mm256_castpd256_pd128(pairs), _mm256_extractf128_pd(pairs, 1));
+	return (uint64_t) _mm_cvtsi128_si64(_mm_castpd_si128(sum));
+}
+
+/**
+ * @brief Accumulates products of strided words on the host's AVX2 units.
+ *
+ * Four pairs are gathered and multiplied at once. Integer products are
+ * summed in four lanes, since wrapping addition does not depend on order;
+ * double products are added one by one, in the order the loop would.
+ *
+ * @param memory memory of the processor
+ * @param a address of the first word of the first sequence
+ * @param strideA distance between words of the first sequence
+ * @param b address of the first word of the second sequence
+ * @param strideB distance between words of the second sequence
+ * @param count number of pairs in the sequences
+ * @param sum the accumulator, as an integer or the bits of a double
+ * @param floating whether the words are doubles
+ * @return the accumulator after adding every product
+ */
+__attribute__((target("avx2")))
+static uint64_t dot_avx2(const uint8_t* memory, uint64_t a, uint64_t strideA, uint64_t b, uint64_t strideB, uint64_t count, uint64_t sum, bool floating){
+	// Gather offsets are signed, so wrapped strides step backwards
+	__m256i offsetsA = _mm256_set_epi64x(3 * strideA, 2 * strideA, strideA, 0);
+	__m256i offsetsB = _mm256_set_epi64x(3 * strideB, 2 * strideB, strideB, 0);
+	__m256i totals = _mm256_setzero_si256();
+	double total;
+	memcpy(&total, &sum, sizeof(double));
+
+	uint64_t i = 0;
+	for(; i + VECTOR_LANES <= count; i += VECTOR_LANES){
+		const long long* baseA = (const long long*) &memory[a + i * strideA];
+		const long long* baseB = (const long long*) &memory[b + i * strideB];
+
+		if(floating){
+			double products[VECTOR_LANES];
+			_mm256_storeu_pd(products, _mm256_mul_pd(_mm256_i64gather_pd((const double*) baseA, offsetsA, 1), _mm256_i64gather_pd((const double*) baseB, offsetsB, 1)));
+			for(int lane = 0; lane < VECTOR_LANES; lane++){
+				total = total + products[lane];
+			}
+		}
+		else{
+			totals = _mm256_add_epi64(totals, multiply_avx2(_mm256_i64gather_epi64(baseA, offsetsA, 1), _mm256_i64gather_epi64(baseB, offsetsB, 1)));
+		}
+	}
+
+	if(floating){
+		memcpy(&sum, &total, sizeof(uint64_t));
+	}
+	else{
+		uint64_t lanes[VECTOR_LANES];
+		_mm256_storeu_si256((__m256i*) lanes, totals);
+		sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+
+	// The last few pairs do not fill a vector
+	return dot_portable(memory, a, strideA, b, strideB, i, count, sum, floating);
+}
+#endif
+
+uint64_t dot_product(const uint8_t* memory, uint64_t a, uint64_t strideA, uint64_t b, uint64_t strideB, uint64_t count, uint64_t sum, bool floating){
+	pthread_once(&detected, detect_acceleration);
+
+#if HAS_AVX2_PATH
+	if(accelerated){
+		return dot_avx2(memory, a, strideA, b, strideB, count, sum, floating);
+	}
+#endif
+	return dot_portable(memory, a, strideA, b, strideB, 0, count, sum, floating);
+}
+
+/**
+ * @brief Checks whether the 32 bytes of a vector at an address lie in memory.
+ *
+ * @param address address of the first byte
+ * @return true if every lane is in memory, false otherwise
+ */
+static bool vector_in_memory(uint64_t address){
+	return address <= MEM_SIZE - VECTOR_LANES * sizeof(uint64_t);
+}
+
+int vector(Processor* processor, uint8_t rd, uint8_t rs, uint8_t rt, int16_t L){
+	VectorOp op = (VectorOp) (L & 0xFFF);
+
+	pthread_once(&detected, detect_acceleration);
+
+	// Vector registers only go up to NUM_VREGS; sums and broadcasts name one general purpose register
+	bool vd = op != VECTOR_STORE && op != VECTOR_SUM && op != VECTOR_SUMF;
+	bool vs = op != VECTOR_LOAD && op != VECTOR_BROADCAST;
+	if(op >= NUM_VECTOR_OPS || (vd && rd >= NUM_VREGS) || (vs && rs >= NUM_VREGS) || rt >= NUM_VREGS){
+		return -1;
+	}
+
+	switch(op){
+		case VECTOR_LOAD:
+			if(!vector_in_memory(processor->registers[rs])){
+				return -1;
+			}
+			memcpy(processor->vectors[rd], &processor->memory[processor->registers[rs]], sizeof(processor->vectors[rd]));
+			return 0;
+		case VECTOR_STORE:
+			if(!vector_in_memory(processor->registers[rd])){
+				return -1;
+			}
+			memcpy(&processor->memory[processor->registers[rd]], processor->vectors[rs], sizeof(processor->vectors[rs]));
+			return 0;
+		case VECTOR_SUM:
+		case VECTOR_SUMF:
+#if HAS_AVX2_PATH
+			if(accelerated){
+				processor->registers[rd] = sum_avx2(op, processor->vectors[rs]);
+				return 0;
+			}
+#endif
+			processor->registers[rd] = sum_portable(op, processor->vectors[rs]);
+			return 0;
+		case VECTOR_BROADCAST:
+			for(int i = 0; i < VECTOR_LANES; i++){
+				processor->vectors[rd][i] = processor->registers[rs];
+			}
+			return 0;
+		default:
+#if HAS_AVX2_PATH
+			if(accelerated){
+				lanes_avx2(op, processor->vectors[rd], processor->vectors[rs], processor->vectors[rt]);
+				return 0;
+			}
+#endif
+			lanes_portable(op, processor->vectors[rd], processor->vectors[rs], processor->vectors[rt]);
+			return 0;
+	}
+}
\ No newline at end of file
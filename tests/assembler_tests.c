@@ -5,6 +5,15 @@
 #include "test_framework.h"
 #include "assembler/instruction.h"
 #include "assembler/stack.h"
+#include "assembler/buffer.h"
+#include "assembler/assembler.h"
+#include "assembler/parallel.h"
+#include "assembler/batch.h"
+#include "assembler/cache.h"
+#include "assembler/peephole.h"
+#include "assembler/expression.h"
+#include "assembler/regalloc.h"
+#include "assembler/relocate.h"
 #include "assembler/label.h"
 #include "assembler/hashmap.h"
 #include "assembler/utils.h"
@@ -89,6 +98,304 @@ TEST_CASE(test_stack_push_pop_peek){
 	return 0;
 }
 
+// Test that object buffer sequential and positional writes work as intended
+TEST_CASE(test_object_buffer){
+	ObjectBuffer* buffer = create_object_buffer();
+
+	uint64_t header = 0x1122334455667788;
+	buffer->position = sizeof(header);
+	buffer_write_instruction(buffer, 0xc14e9000);
+	buffer_write_instruction(buffer, 0x68000000);
+	ASSERT_EQUALS(buffer->position, 16);
+	ASSERT_EQUALS(buffer->size, 16);
+
+	// Positional writes past the end grow the buffer without moving the position
+	uint64_t data = 42;
+	buffer_write_at(buffer, 10000, &data, sizeof(data));
+	ASSERT_EQUALS(buffer->size, 10008);
+	ASSERT_EQUALS(buffer->position, 16);
+	ASSERT_TRUE(buffer->capacity >= 10008);
+
+	buffer_write_at(buffer, 0, &header, sizeof(header));
+
+	uint32_t instr;
+	memcpy(&instr, buffer->data + 12, sizeof(instr));
+	ASSERT_EQUALS(instr, 0x68000000);
+	memcpy(&data, buffer->data, sizeof(data));
+	ASSERT_EQUALS(data, 0x1122334455667788);
+	ASSERT_EQUALS(buffer->data[9999], 0);
+
+	destroy_object_buffer(buffer);
+	return 0;
+}
+
+// Test that parallel assembly produces the same image as sequential assembly
+TEST_CASE(test_assemble_program_parallel){
+	char text[] = ".code\n\tld r1, :data\n:loop\n\tadd r2, r2, r3\n.data\n:data\n\t5\n"
+		".code\n\tpush r2\n\tld r4, :loop\n; comment\n\tbr r4\n.data\n\t7\n:end\n";
+	// Reservations that merge across chunks and labels that bind to them
+	char reserved[] = ".code\n\tld r1, :buffer\n\tld r2, :end\n.data\n\t1\n:buffer\n.space 24\n.zero 8\n"
+		".align 64\n:aligned\n\t2\n.code\n\tld r3, :aligned\n.data\n.space 40\n\t3\n.align 16\n:end\n";
+	char* texts[] = {text, reserved};
+	HashMap* ihm = create_instr_hashmap();
+
+	for(int t = 0; t < 2; t++){
+		Source* source = create_source(texts[t], strlen(texts[t]));
+		ObjectBuffer* expected = create_object_buffer();
+		ASSERT_EQUALS(assemble_program(source, expected, ihm), 0);
+
+		// Every chunk count must agree byte for byte, including chunks with no instructions
+		for(int threads = 2; threads <= 16; threads++){
+			ObjectBuffer* actual = create_object_buffer();
+			ASSERT_EQUALS(assemble_program_parallel(source, actual, ihm, threads), 0);
+			ASSERT_EQUALS(actual->size, expected->size);
+			ASSERT_TRUE(memcmp(actual->data, expected->data, expected->size) == 0);
+			destroy_object_buffer(actual);
+		}
+
+		destroy_object_buffer(expected);
+		destroy_source(source);
+	}
+
+	destroy_hashmap(ihm, destroy_instruction);
+	return 0;
+}
+
+// Test that incremental assembly matches a full assembly after an edit shifts the layout
+TEST_CASE(test_line_cache){
+	char before[] = ".code\n\tld r1, :loop\n:loop\n\tadd r2, r2, r3\n\tbr r4\n.data\n:data\n\t5\n\t6\n";
+	char after[] = ".code\n\tpush r5\n\tld r1, :loop\n:loop\n\tadd r2, r2, r3\n\tbr r4\n.data\n:data\n\t5\n\t7\n";
+	const char* path = "test_line_cache.cache";
+	HashMap* ihm = create_instr_hashmap();
+
+	// Fill the sidecar file from the original program
+	Source* source = create_source(before, strlen(before));
+	ObjectBuffer* out = create_object_buffer();
+	LineCache* cache = create_line_cache();
+	ASSERT_EQUALS(assemble_program_cached(source, out, ihm, cache), 0);
+	ASSERT_EQUALS(cache->hits, 0);
+	ASSERT_EQUALS(write_line_cache(path, cache), 0);
+	destroy_line_cache(cache);
+	destroy_object_buffer(out);
+	destroy_source(source);
+
+	// Reassemble the edited program from the sidecar file
+	source = create_source(after, strlen(after));
+	ObjectBuffer* expected = create_object_buffer();
+	ASSERT_EQUALS(assemble_program(source, expected, ihm), 0);
+
+	out = create_object_buffer();
+	cache = read_line_cache(path);
+	ASSERT_EQUALS(cache->count, 5);
+	ASSERT_EQUALS(assemble_program_cached(source, out, ihm, cache), 0);
+	ASSERT_EQUALS(out->size, expected->size);
+	ASSERT_TRUE(memcmp(out->data, expected->data, expected->size) == 0);
+
+	// Only the new line, the changed data, and the ld whose label moved are encoded again
+	ASSERT_EQUALS(cache->hits, 3);
+	ASSERT_EQUALS(cache->misses, 3);
+
+	remove(path);
+	destroy_line_cache(cache);
+	destroy_object_buffer(out);
+	destroy_object_buffer(expected);
+	destroy_source(source);
+	destroy_hashmap(ihm, destroy_instruction);
+	return 0;
+}
+
+// Test that the peephole pass removes redundant instructions without crossing labels or calls
+TEST_CASE(test_optimize_source){
+	char text[] = ".code\n\tld r1, 100\n\tmov r2, r2\n\taddi r3, 5\n\tsubi r3, 2\n\taddi r3, 1\n\tld r1, 100\n"
+		"\tpush r4\n\tpop r5\n\tpush r6\n\tpop r6\n\taddi r7, 1\n\tsubi r7, 1\n"
+		":label\n\tld r1, 100\n\tcall r9\n\tld r1, 100\n\taddi r1, 1\n\tbrr r2\n\taddi r1, 1\n.data\n\t5\n";
+	char expected[] = ".code\n\tld r1, 100\n\taddi r3, 4\n\tmov r5, r4\n"
+		":label\n\tld r1, 100\n\tcall r9\n\tld r1, 100\n\taddi r1, 1\n\tbrr r2\n\taddi r1, 1\n.data\n\t5\n";
+
+	Source* source = create_source(text, strlen(text));
+	uint64_t removed;
+	Source* optimized = optimize_source(source, &removed);
+
+	ASSERT_EQUALS(removed, 9);
+	ASSERT_EQUALS(optimized->size, strlen(expected));
+	ASSERT_TRUE(memcmp(optimized->text, expected, optimized->size) == 0);
+
+	destroy_source(optimized);
+	destroy_source(source);
+
+	// Branches end a run, and nothing a literal brr jumps over or lands on moves
+	char branches[] = ".code\n\taddi r2, 1\n\tld r1, 9\n\tbrr 12\n\tld r1, 5\n\tld r1, 5\n\tout r2, r1\n"
+		"\tld r3, 7\n\tbrnz r4, r2\n\tld r3, 7\n\thalt\n";
+	source = create_source(branches, strlen(branches));
+	optimized = optimize_source(source, &removed);
+
+	ASSERT_EQUALS(removed, 0);
+	ASSERT_EQUALS(optimized->size, strlen(branches));
+	ASSERT_TRUE(memcmp(optimized->text, branches, optimized->size) == 0);
+
+	destroy_source(optimized);
+	destroy_source(source);
+	return 0;
+}
+
+// Test that virtual registers get the physical registers the program leaves free
+TEST_CASE(test_allocate_registers){
+	char text[] = ".code\n\tin v0, r0\n\tld v1, 0\n\tld v3, :loop\n:loop\n\tadd v1, v1, v0\n\tsubi v0, 1\n"
+		"\tbrnz v3, v0\n\tmov (r1)(8), v1\n\thalt\n";
+	char expected[] = ".code\n\tin r2, r0\n\tld r3, 0\n\tld r4, :loop\n:loop\n\tadd r3, r3, r2\n\tsubi r2, 1\n"
+		"\tbrnz r4, r2\n\tmov (r1)(8), r3\n\thalt\n";
+
+	Source* source = create_source(text, strlen(text));
+	uint64_t spilled;
+	Source* allocated = allocate_registers(source, &spilled);
+
+	ASSERT_NOT_NULL(allocated);
+	ASSERT_EQUALS(spilled, 0);
+	ASSERT_EQUALS(allocated->size, strlen(expected));
+	ASSERT_TRUE(memcmp(allocated->text, expected, allocated->size) == 0);
+	destroy_source(allocated);
+	destroy_source(source);
+
+	// A register read for the last time may be reused by the register written
+	char shared[] = ".code\n\tld v0, 1\n\tadd v1, v0, v0\n\tout r0, v1\n";
+	source = create_source(shared, strlen(shared));
+	allocated = allocate_registers(source, &spilled);
+	ASSERT_NOT_NULL(allocated);
+	ASSERT_TRUE(strstr(allocated->text, "\tadd r1, r1, r1\n") != NULL);
+	destroy_source(allocated);
+	destroy_source(source);
+
+	// Spill code needs free scratch registers, and register numbers are bounded
+	char named[512] = ".code\n";
+	for(int r = 0; r < 31; r++){
+		sprintf(named + strlen(named), "\tclr r%d\n", r);
+	}
+	strcat(named, "\tld v0, 1\n\tout r0, v0\n");
+	const char* invalid[] = {named, ".code\n\tld v65536, 1\n"};
+	for(int i = 0; i < 2; i++){
+		source = create_source(invalid[i], strlen(invalid[i]));
+		ASSERT_NULL(allocate_registers(source, &spilled));
+		destroy_source(source);
+	}
+	return 0;
+}
+
+// Test that .global lines are collected and removed, and relocatable objects list their references
+TEST_CASE(test_relocatable_object){
+	char text[] = ".global :entry ; exported\n.code\n:entry\n\tld r1, :table+8\n\tld r2, :external\n\tbrr :entry\n"
+		".data\n:table\n\t1\n\t2\n";
+	Source* source = create_source(text, strlen(text));
+	HashMap* globals = create_hashmap();
+	Source* extracted = extract_globals(source, globals);
+
+	ASSERT_NOT_NULL(extracted);
+	ASSERT_NOT_NULL(hashmap_get(globals, ":entry"));
+	ASSERT_TRUE(strstr(extracted->text, ".global") == NULL);
+	destroy_source(extracted);
+	destroy_source(source);
+	destroy_hashmap(globals, destroy_label);
+
+	ObjectBuffer* out = create_object_buffer();
+	ASSERT_EQUALS(assemble_relocatable_source(text, strlen(text), out), 0);
+
+	// Both loads take the wide form and are relocated; the short brr stays relative
+	LinkTable table;
+	uint64_t offset = object_link_offset(out->data, out->size, &table);
+	ASSERT_NOT_EQUALS(offset, 0);
+	ASSERT_EQUALS(table.symbolCount, 3);
+	ASSERT_EQUALS(table.relocationCount, 2);
+
+	ObjectSymbol entry;
+	Relocation relocation;
+	memcpy(&entry, out->data + offset, sizeof(ObjectSymbol));
+	memcpy(&relocation, out->data + offset + 3 * sizeof(ObjectSymbol), sizeof(Relocation));
+	ASSERT_EQUALS(entry.section, SECTION_CODE);
+	ASSERT_EQUALS(entry.global, 1);
+	ASSERT_EQUALS(relocation.offset, 4);
+	ASSERT_EQUALS(relocation.addend, 8);
+	destroy_object_buffer(out);
+
+	// Without -c, .global has no effect on the image
+	ObjectBuffer* plain = create_object_buffer();
+	ObjectBuffer* bare = create_object_buffer();
+	char local[] = ".global :main\n.code\n:main\n\tld r1, :main\n\thalt\n";
+	ASSERT_EQUALS(assemble_source(local, strlen(local), plain), 0);
+	ASSERT_EQUALS(assemble_source(local + strlen(".global :main\n"), strlen(local) - strlen(".global :main\n"), bare), 0);
+	ASSERT_EQUALS(plain->size, bare->size);
+	ASSERT_TRUE(memcmp(plain->data, bare->data, plain->size) == 0);
+	destroy_object_buffer(plain);
+	destroy_object_buffer(bare);
+	return 0;
+}
+
+// Test that batch lists are parsed into input/output pairs
+TEST_CASE(test_read_batch){
+	FILE* list = tmpfile();
+	fputs("a.tk a.tko\n; comment\n\n  b.tk   b.tko  \n", list);
+	rewind(list);
+
+	Batch* batch = read_batch(list);
+	ASSERT_NOT_NULL(batch);
+	ASSERT_EQUALS(batch->count, 2);
+	ASSERT_TRUE(strcmp(batch->jobs[0].inputFile, "a.tk") == 0);
+	ASSERT_TRUE(strcmp(batch->jobs[1].outputFile, "b.tko") == 0);
+	destroy_batch(batch);
+
+	// Malformed entries fail on their own without dropping the rest
+	rewind(list);
+	fputs("a.tk\n", list);
+	rewind(list);
+	batch = read_batch(list);
+	ASSERT_NOT_NULL(batch);
+	// The first pair is now split across two lines, each missing half of it
+	ASSERT_EQUALS(batch->count, 3);
+	ASSERT_NULL(batch->jobs[0].inputFile);
+	ASSERT_EQUALS(batch->jobs[1].status, -1);
+	ASSERT_TRUE(strcmp(batch->jobs[2].inputFile, "b.tk") == 0);
+	destroy_batch(batch);
+
+	fclose(list);
+	return 0;
+}
+
+// Test that constant expressions evaluate with symbols and at most one label
+TEST_CASE(test_evaluate_expression){
+	HashMap* symbols = create_hashmap();
+	hashmap_insert(symbols, "N", create_label(strdup("N"), 8));
+	Expression expression;
+
+	ASSERT_EQUALS(evaluate_expression(symbols, "(N + 2) * 3 - 10 / 4", &expression), 0);
+	ASSERT_EQUALS(expression.value, 28);
+	ASSERT_EQUALS(expression.label[0], '\0');
+
+	ASSERT_EQUALS(evaluate_expression(symbols, "-N * 2 + :matrix", &expression), 0);
+	ASSERT_EQUALS(expression.value, -16);
+	ASSERT_TRUE(strcmp(expression.label, ":matrix") == 0);
+
+	// Labels may cancel, but not be scaled or combined with another label
+	ASSERT_EQUALS(evaluate_expression(symbols, ":a - :a + 1", &expression), 0);
+	ASSERT_EQUALS(expression.value, 1);
+	ASSERT_NOT_EQUALS(evaluate_expression(symbols, ":a * 2", &expression), 0);
+	ASSERT_NOT_EQUALS(evaluate_expression(symbols, ":a - :b", &expression), 0);
+	ASSERT_NOT_EQUALS(evaluate_expression(symbols, "N / 0", &expression), 0);
+	ASSERT_NOT_EQUALS(evaluate_expression(symbols, "M + 1", &expression), 0);
+	ASSERT_NOT_EQUALS(evaluate_expression(symbols, "(N + 1", &expression), 0);
+
+	// Offsets from labels resolve once the label is placed
+	HashMap* lhm = create_hashmap();
+	hashmap_insert(lhm, ":matrix", create_label(strdup(":matrix"), 0x10000));
+	uint64_t address;
+	ASSERT_TRUE(resolve_label(lhm, ":matrix+800", &address));
+	ASSERT_EQUALS(address, 0x10320);
+	ASSERT_TRUE(resolve_label(lhm, ":matrix-8", &address));
+	ASSERT_EQUALS(address, 0xFFF8);
+	ASSERT_FALSE(resolve_label(lhm, ":other+8", &address));
+
+	destroy_hashmap(lhm, destroy_label);
+	destroy_hashmap(symbols, destroy_label);
+	return 0;
+}
+
 // Test that process directive returns the correct character based on the directive
 TEST_CASE(test_process_directive){
 	char str1[] = ".code";
@@ -102,6 +409,18 @@ TEST_CASE(test_process_directive){
 
 	char str4[] = ".invalid";
 	ASSERT_EQUALS(process_directive(str4), 'N');
+
+	char str5[] = ".space 64 ; buffer";
+	ASSERT_EQUALS(process_directive(str5), 'R');
+
+	char str6[] = ".align 16";
+	ASSERT_EQUALS(process_directive(str6), 'R');
+
+	char str7[] = ".align 12";
+	ASSERT_EQUALS(process_directive(str7), 'N');
+
+	char str8[] = ".zero -8";
+	ASSERT_EQUALS(process_directive(str8), 'N');
 	return 0;
 }
 
@@ -136,23 +455,63 @@ TEST_CASE(test_encode_instruction){
 // Test that change_in_address returns the correct value for instructions/macros/data
 TEST_CASE(test_change_in_address){
 	char str1[] = "\t56562326\n";
-	ASSERT_EQUALS(change_in_address(str1), 8);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str1), 8);
 
 	char str2[] = "\tadd r0, r1, r2\n";
-	ASSERT_EQUALS(change_in_address(str2), 4);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str2), 4);
 
 	char str3[] = "\tld r0, 100\n";
-	ASSERT_EQUALS(change_in_address(str3), 48);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str3), 8);
+
+	char str8[] = "\tld r0, 65536\n";
+	ASSERT_EQUALS(change_in_address(NULL, 0, str8), 12);
 
 	char str4[] = "\tpush r0\n";
-	ASSERT_EQUALS(change_in_address(str4), 8);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str4), 8);
 	
 	char str5[] = "\tpop r0\n";
-	ASSERT_EQUALS(change_in_address(str5), 8);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str5), 8);
 
 	char str6[] = "";
-	ASSERT_EQUALS(change_in_address(str6), -1);
+	ASSERT_EQUALS(change_in_address(NULL, 0, str6), -1);
+
+	// ld of a label is sized from the label's address once it has been placed
+	char str7[] = "\tld r0, :label\n";
+	ASSERT_EQUALS(change_in_address(NULL, 0, str7), LD_MAX_SIZE);
+
+	HashMap* lhm = create_hashmap();
+	hashmap_insert(lhm, ":label", create_label(strdup(":label"), 0x2000));
+	ASSERT_EQUALS(change_in_address(lhm, 0, str7), 12);
+
+	// brr of a label is short only when the label is in brrL's range
+	char str9[] = "\tbrr :label\n";
+	ASSERT_EQUALS(change_in_address(NULL, 0x2000, str9), BRR_LONG_SIZE);
+	ASSERT_EQUALS(change_in_address(lhm, 0x2000 + 2048, str9), 4);
+	ASSERT_EQUALS(change_in_address(lhm, 0x2000 - 2047, str9), 4);
+	ASSERT_EQUALS(change_in_address(lhm, 0x2000 - 2048, str9), BRR_LONG_SIZE);
+	destroy_hashmap(lhm, destroy_label);
+
+	return 0;
+}
 
+// Test that constants are loaded with the shortest sequence
+TEST_CASE(test_materialize_constant){
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 0, false), 1);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 8, false), 2);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 4095, false), 2);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 65536, false), 3);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 0x8000000000000000ULL, false), 3);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 0x1001, false), 4);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, UINT64_MAX, false), 12);
+
+	// Sizing by width never shrinks as the value grows
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 0x10000, true), 4);
+	ASSERT_EQUALS(materialize_constant(NULL, 0, 0x1FFFF, true), 4);
+
+	// The sequence written matches the counted length
+	ObjectBuffer* out = create_object_buffer();
+	ASSERT_EQUALS(materialize_constant(out, 3, 0x123456789ULL, false), out->position / 4);
+	destroy_object_buffer(out);
 	return 0;
 }
 
@@ -212,6 +571,25 @@ TEST_CASE(test_trim){
 	return 0;
 }
 
+// Test split_instruction splits operands without disturbing a tokenizer in use elsewhere
+TEST_CASE(test_split_instruction){
+	char mnemonic[10], operands[4][256];
+	ASSERT_EQUALS(split_instruction("\tadd v1,  v2 , r3\n", mnemonic, operands, 4), 3);
+	ASSERT_TRUE(strcmp(mnemonic, "add") == 0);
+	ASSERT_TRUE(strcmp(operands[1], "v2") == 0);
+	ASSERT_EQUALS(split_instruction("\thalt\n", mnemonic, operands, 4), 0);
+	ASSERT_EQUALS(split_instruction("\tadd r1, r2, r3\n", mnemonic, operands, 2), -1);
+
+	// Another strtok caller, such as a different batch worker, keeps its place
+	char other[] = "a,b";
+	ASSERT_TRUE(strcmp(strtok(other, ","), "a") == 0);
+	ASSERT_EQUALS(split_instruction("\tmov r1, r2\n", mnemonic, operands, 4), 2);
+	char* next = strtok(NULL, ",");
+	ASSERT_NOT_NULL(next);
+	ASSERT_TRUE(strcmp(next, "b") == 0);
+	return 0;
+}
+
 // Test is_uint64 checks that a string is an unsigned 64-bit integer
 TEST_CASE(test_is_uint64){
     char str1[] = "0";
@@ -310,16 +688,32 @@ int main() {
 	RUN_TEST(test_stack_push_pop_peek);
 	printf("\n");
 
+	printf("Buffer tests:\n");
+	RUN_TEST(test_object_buffer);
+	printf("\n");
+
+	printf("Assembler tests:\n");
+	RUN_TEST(test_assemble_program_parallel);
+	RUN_TEST(test_line_cache);
+	RUN_TEST(test_optimize_source);
+	RUN_TEST(test_allocate_registers);
+	RUN_TEST(test_relocatable_object);
+	RUN_TEST(test_read_batch);
+	printf("\n");
+
 	printf("Instruction tests:\n");
 	RUN_TEST(test_process_directive);
+	RUN_TEST(test_evaluate_expression);
 	RUN_TEST(test_encode_instruction);
 	RUN_TEST(test_change_in_address);
+	RUN_TEST(test_materialize_constant);
 	printf("\n");
 
 	printf("Utils tests:\n");
 	RUN_TEST(test_is_data);
 	RUN_TEST(test_is_empty);
 	RUN_TEST(test_trim);
+	RUN_TEST(test_split_instruction);
 	RUN_TEST(test_is_uint64);
 	RUN_TEST(test_is_valid_register);
 	RUN_TEST(test_is_valid_literal);
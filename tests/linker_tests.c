@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "linker/linker.h"
+#include "simulator/simulator.h"
+#include "assembler/assembler.h"
+
+int tests_run = 0;
+int tests_failed = 0;
+
+/**
+ * @brief Links two object images.
+ *
+ * @param first the first object image, whose code runs first
+ * @param second the second object image
+ * @param out pointer to the object buffer receiving the linked image
+ * @return 0 if successful, -1 otherwise
+ */
+static int link_pair(ObjectBuffer* first, ObjectBuffer* second, ObjectBuffer* out){
+	const uint8_t* images[] = {first->data, second->data};
+	uint64_t sizes[] = {first->size, second->size};
+	const char* names[] = {"first", "second"};
+	return link_images(images, sizes, names, 2, out);
+}
+
+/**
+ * @brief Runs an object file image and reads back a data word.
+ *
+ * @param image the object file image
+ * @param size size of the image in bytes
+ * @param address address of the data word
+ * @return the data word after the program halts, or UINT64_MAX if it fails
+ */
+static uint64_t run_image(const uint8_t* image, uint64_t size, uint64_t address){
+	Processor* processor = create_processor();
+	uint64_t value = UINT64_MAX;
+
+	if(load_image(image, size, processor) == 0 && run_processor(processor) == 0){
+		memcpy(&value, &processor->memory[address], sizeof(uint64_t));
+	}
+
+	destroy_processor(processor);
+	return value;
+}
+
+TEST_CASE(test_link_objects){
+	const char* main = ".code\n\tld r1, :value\n\tmov r1, (r1)(0)\n\tld r2, :twice\n\tcall r2\n\tld r4, :table+8\n"
+		"\tmov r4, (r4)(0)\n\tadd r1, r1, r4\n\tld r5, :value\n\tmov (r5)(0), r1\n\thalt\n.data\n:value\n\t21\n";
+	const char* library = ".global :twice\n.global :table ; shared data\n.code\n:twice\n\tadd r1, r1, r1\n\treturn\n"
+		".data\n.zero 12\n:table\n\t100\n\t5\n";
+	ObjectBuffer* first = create_object_buffer();
+	ObjectBuffer* second = create_object_buffer();
+	ASSERT_EQUALS(assemble_relocatable_source(main, strlen(main), first), 0);
+	ASSERT_EQUALS(assemble_relocatable_source(library, strlen(library), second), 0);
+
+	// Unlinked objects are refused by the simulator
+	ASSERT_EQUALS(run_image(first->data, first->size, INIT_DATA_ADDR), UINT64_MAX);
+
+	ObjectBuffer* linked = create_object_buffer();
+	ASSERT_EQUALS(link_pair(first, second, linked), 0);
+	ASSERT_EQUALS(run_image(linked->data, linked->size, INIT_DATA_ADDR), 47);
+
+	destroy_object_buffer(first);
+	destroy_object_buffer(second);
+	destroy_object_buffer(linked);
+	return 0;
+}
+
+TEST_CASE(test_link_errors){
+	const char* caller = ".code\n\tld r1, :missing\n\tcall r1\n\thalt\n";
+	const char* callee = ".global :missing\n.code\n:missing\n\treturn\n";
+	ObjectBuffer* first = create_object_buffer();
+	ObjectBuffer* second = create_object_buffer();
+	ObjectBuffer* linked = create_object_buffer();
+	ASSERT_EQUALS(assemble_relocatable_source(caller, strlen(caller), first), 0);
+	ASSERT_EQUALS(assemble_relocatable_source(callee, strlen(callee), second), 0);
+
+	// A symbol no object exports, and one that two objects export
+	ASSERT_EQUALS(link_pair(first, first, linked), -1);
+	ASSERT_EQUALS(link_pair(second, second, linked), -1);
+	ASSERT_EQUALS(link_pair(first, second, linked), 0);
+
+	// Exports must be defined, and brr cannot leave its object
+	const char* undefined = ".global :absent\n.code\n\thalt\n";
+	const char* branch = ".code\n\tbrr :missing\n";
+	ObjectBuffer* rejected = create_object_buffer();
+	ASSERT_EQUALS(assemble_relocatable_source(undefined, strlen(undefined), rejected), -1);
+	ASSERT_EQUALS(assemble_relocatable_source(branch, strlen(branch), rejected), -1);
+
+	destroy_object_buffer(first);
+	destroy_object_buffer(second);
+	destroy_object_buffer(linked);
+	destroy_object_buffer(rejected);
+	return 0;
+}
+
+int main() {
+	printf("Linker tests:\n");
+	RUN_TEST(test_link_objects);
+	RUN_TEST(test_link_errors);
+	printf("\n");
+
+    printf("Tests run: %d, Passed: %d, Failed: %d\n", tests_run, (tests_run - tests_failed), tests_failed);
+    return tests_failed;
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "test_framework.h"
+#include "optimizer/optimizer.h"
+#include "simulator/simulator.h"
+#include "assembler/assembler.h"
+
+int tests_run = 0;
+int tests_failed = 0;
+
+/**
+ * @brief Runs an object file image and reads back a data word.
+ *
+ * @param image the object file image
+ * @param size size of the image in bytes
+ * @param offset offset of the data word from INIT_DATA_ADDR
+ * @return the data word after the program halts, or UINT64_MAX if it fails
+ */
+static uint64_t run_image(const uint8_t* image, uint64_t size, uint64_t offset){
+	Processor* processor = create_processor();
+	uint64_t value = UINT64_MAX;
+
+	if(load_image(image, size, processor) == 0 && run_processor(processor) == 0){
+		memcpy(&value, &processor->memory[INIT_DATA_ADDR + offset], sizeof(uint64_t));
+	}
+
+	destroy_processor(processor);
+	return value;
+}
+
+TEST_CASE(test_optimize_dead_code){
+	const char* text = ".code\n\tld r2, 100\n\tld r1, 5\n\tld r2, 9\n\tadd r3, r1, r2\n\tmov r4, r3\n\tld r1, 5\n"
+		"\tadd r5, r1, r3\n\tld r6, 65536\n\tmov (r6)(0), r3\n\tmov (r6)(8), r5\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// The overwritten ld, the unused mov, and the reload of r1 are gone
+	ASSERT_EQUALS(stats.before - stats.after, 5);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 0), 14);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 8), 19);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_constant_branches){
+	const char* text = ".code\n\tld r1, :skip\n\tld r2, 0\n\tbrnz r1, r2\n\taddi r3, 1\n:skip\n\tld r4, 1\n\tld r5, :end\n"
+		"\tbrnz r5, r4\n\taddi r3, 100\n:end\n\tld r6, 65536\n\tmov (r6)(0), r3\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// The never-taken branch and its target load, the condition loads, and the skipped addi are gone
+	ASSERT_EQUALS(stats.before, 12);
+	ASSERT_EQUALS(stats.after, 6);
+	ASSERT_EQUALS(run_image(image->data, image->size, 0), 1);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 0), 1);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_relocates_targets){
+	const char* text = ".code\n\tld r1, :double\n\tld r2, 21\n\tld r3, 7\n\tld r3, 8\n\tcall r1\n\tbrr :store\n\tld r9, 4\n"
+		"\tld r9, 5\n:store\n\tld r6, 65536\n\tmov (r6)(0), r2\n\tmov (r6)(8), r3\n\thalt\n:double\n\tadd r2, r2, r2\n\treturn\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// Both the call target and the brrL offset follow the removed code
+	ASSERT_EQUALS(stats.before - stats.after, 6);
+	ASSERT_TRUE(optimized->size < image->size);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 0), 42);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 8), 8);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_long_branches){
+	// A long brr forward over dead code, and one back over a loop body, both longer than brrL reaches
+	char text[16384] = ".code\n\tbrr :start\n";
+	for(int i = 0; i < 600; i++){
+		strcat(text, "\taddi r3, 1\n");
+	}
+	strcat(text, ":start\n\tld r1, 3\n\tclr r2\n\tld r9, 4\n\tld r9, 5\n:top\n");
+	for(int i = 0; i < 600; i++){
+		strcat(text, "\taddi r2, 1\n");
+	}
+	strcat(text, "\tsubi r1, 1\n\tld r4, :again\n\tbrnz r4, r1\n\tbrr :done\n:again\n\tbrr :top\n:done\n"
+		"\tld r6, 65536\n\tmov (r6)(0), r2\n\thalt\n");
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// The skipped addi run and the two-instruction loads of r9 go; both payloads follow the code that moved
+	ASSERT_EQUALS(stats.before - stats.after, 604);
+	ASSERT_EQUALS(run_image(image->data, image->size, 0), 1800);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 0), 1800);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_redundant_loads){
+	const char* text = ".code\n\tld r6, 65536\n\tmov r1, (r6)(0)\n\tmov r2, (r6)(0)\n\tmov r1, (r6)(0)\n"
+		"\tadd r3, r1, r2\n\tmov (r6)(8), r3\n\thalt\n.data\n\t21\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// The second load becomes a mov and the third disappears
+	ASSERT_EQUALS(stats.before - stats.after, 1);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 8), 42);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_spawned_harts){
+	const char* text = ".code\n\tld r1, :worker\n\tld r2, 65536\n\tld r3, 20\n\tld r3, 21\n\tld r20, 262144\n"
+		"\tpriv r4, r1, r20, 11\n\tpriv r5, r4, r0, 12\n\thalt\n:worker\n\tadd r3, r3, r3\n\tmov (r2)(0), r3\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text, strlen(text), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	// Only the overwritten ld goes; the spawn target follows it and the hart still sees r3
+	ASSERT_TRUE(stats.after < stats.before);
+	ASSERT_EQUALS(run_image(image->data, image->size, 0), 42);
+	ASSERT_EQUALS(run_image(optimized->data, optimized->size, 0), 42);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+TEST_CASE(test_optimize_refuses_unproven_targets){
+	// A branch through a register loaded from memory
+	const char* loaded = ".code\n\tld r6, 65536\n\tmov r1, (r6)(0)\n\tbr r1\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) loaded, strlen(loaded), image), 0);
+
+	ObjectBuffer* optimized = create_object_buffer();
+	OptimizerStats stats;
+	ASSERT_NOT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+	destroy_object_buffer(image);
+
+	// A code address stored to memory, where its use cannot be followed
+	const char* stored = ".code\n\tld r6, 65536\n:here\n\tld r1, :here\n\tmov (r6)(0), r1\n\thalt\n";
+	image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) stored, strlen(stored), image), 0);
+	ASSERT_NOT_EQUALS(optimize_image(image->data, image->size, optimized, &stats), 0);
+
+	destroy_object_buffer(image);
+	destroy_object_buffer(optimized);
+	return 0;
+}
+
+int main() {
+	printf("Optimizer tests:\n");
+	RUN_TEST(test_optimize_dead_code);
+	RUN_TEST(test_optimize_constant_branches);
+	RUN_TEST(test_optimize_relocates_targets);
+	RUN_TEST(test_optimize_long_branches);
+	RUN_TEST(test_optimize_redundant_loads);
+	RUN_TEST(test_optimize_spawned_harts);
+	RUN_TEST(test_optimize_refuses_unproven_targets);
+	printf("\n");
+
+    printf("Tests run: %d, Passed: %d, Failed: %d\n", tests_run, (tests_run - tests_failed), tests_failed);
+    return tests_failed;
+}
\ No newline at end of file
@@ -1,10 +1,14 @@
 #include <stdlib.h>
 #include <time.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "test_framework.h"
 #include "simulator/simulator.h"
 #include "simulator/utils.h"
+#include "simulator/vector.h"
+#include "simulator/hart.h"
+#include "assembler/assembler.h"
 
 int tests_run = 0;
 int tests_failed = 0;
@@ -70,6 +74,22 @@ TEST_CASE(test_div){
 	return 0;
 }
 
+TEST_CASE(test_ldw){
+	Processor* processor = create_processor();
+	uint64_t value = 0x123456789ABCDEF0ULL;
+	memcpy(&processor->memory[processor->pc + 4], &value, sizeof(uint64_t));
+
+	ldw(processor, 3, 0, 0, 0);
+	ASSERT_EQUALS(processor->registers[3], value);
+	// The payload is skipped once the loop adds 4
+	ASSERT_EQUALS(processor->pc, INIT_CODE_ADDR + 8);
+
+	// A payload past the end of the code segment is rejected
+	processor->pc = INIT_DATA_ADDR - 8;
+	ASSERT_NOT_EQUALS(ldw(processor, 3, 0, 0, 0), 0);
+	return 0;
+}
+
 TEST_CASE(test_and){
 	Processor* processor = create_processor();
 	processor->registers[0] = 2;
@@ -260,6 +280,199 @@ TEST_CASE(test_priv){
 	return 0;
 }
 
+TEST_CASE(test_priv_output){
+	Processor* processor = create_processor();
+	processor->output = tmpfile();
+	ASSERT_NOT_NULL(processor->output);
+
+	// Port 2 appends raw words; bulk output writes a memory range in one call
+	uint64_t words[3] = {0x0102030405060708, 7, 0xffffffffffffffff};
+	memcpy(&processor->memory[0x3000], words, sizeof(words));
+	processor->registers[1] = 2;
+	processor->registers[2] = 42;
+	processor->registers[3] = 0x3000;
+	processor->registers[4] = sizeof(words);
+	ASSERT_EQUALS(priv(processor, 1, 2, 0, 4), 0);
+	ASSERT_EQUALS(priv(processor, 1, 3, 4, 5), 0);
+
+	uint64_t written[4];
+	rewind(processor->output);
+	ASSERT_EQUALS(fread(written, sizeof(uint64_t), 4, processor->output), 4);
+	ASSERT_EQUALS(written[0], 42);
+	ASSERT_TRUE(memcmp(&written[1], words, sizeof(words)) == 0);
+
+	// Ranges must lie in memory
+	processor->registers[3] = MEM_SIZE - 8;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 3, 4, 5), 0);
+
+	destroy_processor(processor);
+	return 0;
+}
+
+TEST_CASE(test_priv_memory){
+	Processor* processor = create_processor();
+	for(int i = 0; i < 64; i++){
+		processor->memory[0x3000 + i] = (uint8_t) i;
+	}
+
+	// Copy, including an overlapping copy, then fill
+	processor->registers[1] = 0x4000;
+	processor->registers[2] = 0x3000;
+	processor->registers[3] = 64;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 6), 0);
+	ASSERT_TRUE(memcmp(&processor->memory[0x4000], &processor->memory[0x3000], 64) == 0);
+	processor->registers[1] = 0x3008;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 6), 0);
+	ASSERT_TRUE(memcmp(&processor->memory[0x3008], &processor->memory[0x4000], 64) == 0);
+
+	processor->registers[1] = 0x5000;
+	processor->registers[2] = 0x1AB;
+	processor->registers[3] = 16;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 7), 0);
+	ASSERT_EQUALS(processor->memory[0x5000], 0xAB);
+	ASSERT_EQUALS(processor->memory[0x500F], 0xAB);
+	ASSERT_EQUALS(processor->memory[0x5010], 0xFF);
+
+	// Compare leaves its order in rd
+	processor->registers[1] = 0x3008;
+	processor->registers[2] = 0x4000;
+	processor->registers[3] = 64;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 8), 0);
+	ASSERT_EQUALS(processor->registers[1], 0);
+	processor->registers[1] = 0x4000;
+	processor->registers[2] = 0x5000;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 8), 0);
+	ASSERT_EQUALS(processor->registers[1], (uint64_t) -1);
+
+	// Ranges must lie in memory
+	processor->registers[1] = MEM_SIZE - 8;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 2, 3, 6), 0);
+	ASSERT_NOT_EQUALS(priv(processor, 1, 2, 3, 7), 0);
+	processor->registers[1] = 0x4000;
+	processor->registers[2] = MEM_SIZE;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 2, 3, 8), 0);
+
+	destroy_processor(processor);
+	return 0;
+}
+
+TEST_CASE(test_priv_heap){
+	const char* text = ".code\n\thalt\n.data\n\t1\n\t2\n\t3\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+
+	// Blocks start after the data, aligned and apart
+	processor->registers[2] = 24;
+	ASSERT_EQUALS(priv(processor, 1, 2, 0, 9), 0);
+	uint64_t first = processor->registers[1];
+	ASSERT_EQUALS(first, INIT_DATA_ADDR + 32);
+	ASSERT_EQUALS(priv(processor, 3, 2, 0, 9), 0);
+	ASSERT_EQUALS(processor->registers[3], first + 32);
+
+	// A freed block is reused by the next request of its size class
+	ASSERT_EQUALS(priv(processor, 1, 0, 0, 10), 0);
+	processor->registers[2] = 17;
+	ASSERT_EQUALS(priv(processor, 4, 2, 0, 9), 0);
+	ASSERT_EQUALS(processor->registers[4], first);
+
+	// Double frees and addresses inside a block are refused; freeing 0 does nothing
+	processor->registers[1] = first;
+	ASSERT_EQUALS(priv(processor, 1, 0, 0, 10), 0);
+	ASSERT_NOT_EQUALS(priv(processor, 1, 0, 0, 10), 0);
+	processor->registers[1] = first + 16;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 0, 0, 10), 0);
+	processor->registers[1] = 0;
+	ASSERT_EQUALS(priv(processor, 1, 0, 0, 10), 0);
+
+	// Requests larger than the heap get 0
+	processor->registers[2] = MEM_SIZE;
+	ASSERT_EQUALS(priv(processor, 1, 2, 0, 9), 0);
+	ASSERT_EQUALS(processor->registers[1], 0);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+
+	// Free blocks of a larger class are split when the top is used up
+	Heap* heap = create_heap(0x10000, 0x10000 + 256);
+	uint64_t whole = heap_allocate(heap, 256);
+	ASSERT_EQUALS(whole, 0x10000);
+	ASSERT_EQUALS(heap_allocate(heap, 16), 0);
+	ASSERT_EQUALS(heap_free(heap, whole), 0);
+	ASSERT_EQUALS(heap_allocate(heap, 64), 0x10000);
+	ASSERT_EQUALS(heap_allocate(heap, 64), 0x10040);
+	ASSERT_EQUALS(heap_allocate(heap, 128), 0x10080);
+	ASSERT_EQUALS(heap_allocate(heap, 16), 0);
+	destroy_heap(heap);
+	return 0;
+}
+
+TEST_CASE(test_priv_harts){
+	// Four harts each add 1 to the counter 1000 times, on stacks 4 KiB apart
+	const char* text = ".code\n\tld r1, :worker\n\tld r2, :counter\n\tmov r20, r31\n\tld r21, 4096\n"
+		"\tsub r20, r20, r21\n\tpriv r4, r1, r20, 11\n\tsub r20, r20, r21\n\tpriv r5, r1, r20, 11\n"
+		"\tsub r20, r20, r21\n\tpriv r6, r1, r20, 11\n\tsub r20, r20, r21\n\tpriv r7, r1, r20, 11\n"
+		"\tpriv r8, r4, r0, 12\n\tpriv r9, r5, r0, 12\n\tpriv r10, r6, r0, 12\n\tpriv r11, r7, r0, 12\n"
+		"\tmov r12, (r2)(0)\n\thalt\n"
+		":worker\n\tld r3, 1\n\tld r13, 1000\n\tld r14, :loop\n"
+		":loop\n\tpriv r15, r2, r3, 13\n\tsubi r13, 1\n\tbrnz r14, r13\n\tmov (r31)(-8), r4\n\thalt\n"
+		".data\n:counter\n\t0\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[12], 4000);
+	for(int i = 0; i < 4; i++){
+		// Ids count up from 1, every hart halted, and each saw 0 in the register its id went to
+		uint64_t stack = MEM_SIZE - 4096 * (i + 1);
+		uint64_t seen;
+		memcpy(&seen, &processor->memory[stack - 8], sizeof(uint64_t));
+		ASSERT_EQUALS(processor->registers[4 + i], i + 1);
+		ASSERT_EQUALS(processor->registers[8 + i], 0);
+		ASSERT_EQUALS(seen, i == 0 ? 0 : 1);
+	}
+
+	// Joined ids are free again, and a hart that stops on an error reports 1
+	processor->registers[2] = INIT_DATA_ADDR + 4;
+	ASSERT_EQUALS(priv(processor, 4, 1, 20, 11), 0);
+	ASSERT_EQUALS(processor->registers[4], 1);
+	ASSERT_EQUALS(priv(processor, 8, 4, 0, 12), 0);
+	ASSERT_EQUALS(processor->registers[8], 1);
+
+	// Unknown ids, a hart already joined, and starts outside the code are refused
+	ASSERT_NOT_EQUALS(priv(processor, 8, 4, 0, 12), 0);
+	processor->registers[4] = MAX_HARTS;
+	ASSERT_NOT_EQUALS(priv(processor, 8, 4, 0, 12), 0);
+	processor->registers[1] = INIT_DATA_ADDR;
+	ASSERT_NOT_EQUALS(priv(processor, 4, 1, 20, 11), 0);
+
+	// Compare-and-swap stores only over the expected word; both calls leave the old word
+	processor->registers[2] = INIT_DATA_ADDR;
+	processor->registers[3] = 7;
+	processor->registers[1] = 4000;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 14), 0);
+	ASSERT_EQUALS(processor->registers[1], 4000);
+	processor->registers[1] = 4000;
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 14), 0);
+	ASSERT_EQUALS(processor->registers[1], 7);
+	ASSERT_EQUALS(priv(processor, 1, 2, 3, 13), 0);
+	ASSERT_EQUALS(processor->registers[1], 7);
+	ASSERT_EQUALS(processor->memory[INIT_DATA_ADDR], 14);
+
+	// Atomic words must be aligned and in memory
+	processor->registers[2] = INIT_DATA_ADDR + 4;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 2, 3, 13), 0);
+	processor->registers[2] = MEM_SIZE;
+	ASSERT_NOT_EQUALS(priv(processor, 1, 2, 3, 14), 0);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	return 0;
+}
+
 TEST_CASE(test_movRRL){
 	Processor* processor = create_processor();
 	processor->registers[1] = 0x1562;
@@ -367,6 +580,372 @@ TEST_CASE(test_divf){
 	return 0;
 }
 
+// Test every vector operation on both the AVX2 and the portable path
+TEST_CASE(test_vector){
+	uint64_t ints[4] = {3, 0x100000001ULL, (uint64_t) -2, 0xFFFFFFFF};
+	double doubles[4] = {1.5, -2.0, 0.1, 1e300};
+
+	for(int accelerate = 0; accelerate < 2; accelerate++){
+		use_vector_acceleration(accelerate);
+		Processor* processor = create_processor();
+		memcpy(&processor->memory[0x3000], ints, sizeof(ints));
+		memcpy(&processor->memory[0x3020], doubles, sizeof(doubles));
+
+		processor->registers[1] = 0x3000;
+		processor->registers[2] = 0x3020;
+		ASSERT_EQUALS(vector(processor, 0, 1, 0, VECTOR_LOAD), 0);
+		ASSERT_EQUALS(vector(processor, 1, 2, 0, VECTOR_LOAD), 0);
+
+		// Integer lanes wrap like add and mul, including the high halves of products
+		ASSERT_EQUALS(vector(processor, 2, 0, 0, VECTOR_ADD), 0);
+		ASSERT_EQUALS(vector(processor, 3, 0, 0, VECTOR_MUL), 0);
+		for(int i = 0; i < 4; i++){
+			ASSERT_EQUALS(processor->vectors[2][i], ints[i] + ints[i]);
+			ASSERT_EQUALS(processor->vectors[3][i], ints[i] * ints[i]);
+		}
+		ASSERT_EQUALS(vector(processor, 4, 3, 0, VECTOR_SUM), 0);
+		ASSERT_EQUALS(processor->registers[4], ints[0] * ints[0] + ints[1] * ints[1] + ints[2] * ints[2] + ints[3] * ints[3]);
+
+		// Double lanes round like addf and mulf, and the sum adds pairs
+		ASSERT_EQUALS(vector(processor, 5, 1, 1, VECTOR_MULF), 0);
+		ASSERT_EQUALS(vector(processor, 5, 5, 1, VECTOR_ADDF), 0);
+		double lanes[4];
+		memcpy(lanes, processor->vectors[5], sizeof(lanes));
+		for(int i = 0; i < 4; i++){
+			ASSERT_EQUALS(lanes[i], doubles[i] * doubles[i] + doubles[i]);
+		}
+		ASSERT_EQUALS(vector(processor, 6, 5, 0, VECTOR_SUMF), 0);
+		double sum;
+		memcpy(&sum, &processor->registers[6], sizeof(double));
+		ASSERT_EQUALS(sum, (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]));
+
+		// Broadcast, then store over the integers
+		processor->registers[7] = 42;
+		ASSERT_EQUALS(vector(processor, 6, 7, 0, VECTOR_BROADCAST), 0);
+		ASSERT_EQUALS(vector(processor, 1, 6, 0, VECTOR_STORE), 0);
+		for(int i = 0; i < 4; i++){
+			uint64_t word;
+			memcpy(&word, &processor->memory[0x3000 + 8 * i], sizeof(uint64_t));
+			ASSERT_EQUALS(word, 42);
+		}
+
+		// Lanes must lie in memory, and vector registers stop at x15
+		processor->registers[1] = MEM_SIZE - 24;
+		ASSERT_NOT_EQUALS(vector(processor, 0, 1, 0, VECTOR_LOAD), 0);
+		ASSERT_NOT_EQUALS(vector(processor, 1, 0, 0, VECTOR_STORE), 0);
+		ASSERT_NOT_EQUALS(vector(processor, 16, 0, 0, VECTOR_ADD), 0);
+		ASSERT_NOT_EQUALS(vector(processor, 0, 0, 0, NUM_VECTOR_OPS), 0);
+		destroy_processor(processor);
+	}
+	use_vector_acceleration(true);
+
+	// The assembler encodes vector mnemonics with opcode 0x1f
+	char text[] = ".code\n\tld r1, :a\n\tvld x0, (r1)\n\tvbcast x1, r1\n\tvadd x2, x0, x1\n\tvst (r1), x2\n\tvsum r3, x0\n\thalt\n"
+		".data\n:a\n\t1\n\t2\n\t3\n\t4\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[3], 10);
+	uint64_t word;
+	memcpy(&word, &processor->memory[INIT_DATA_ADDR + 24], sizeof(uint64_t));
+	ASSERT_EQUALS(word, INIT_DATA_ADDR + 4);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+// Test that dot-product loops run natively leave the same state as interpreting them
+TEST_CASE(test_dot_loops){
+	for(int floating = 0; floating < 2; floating++){
+		// Eleven words of a row against every other word of a column
+		char text[4096];
+		sprintf(text, ".code\n\tld r1, :a\n\tld r2, :b\n\tld r3, 16\n\tld r4, 11\n\tclr r5\n\tclr r6\n\tld r7, :loop\n"
+			":loop\n\tmov r10, (r1)(0)\n\tmov r11, (r2)(8)\n\t%s r12, r11, r10\n\t%s r6, r12, r6\n"
+			"\taddi r5, 1\n\taddi r1, 8\n\tadd r2, r3, r2\n\tbrgt r7, r4, r5\n\thalt\n.data\n:a\n",
+			floating ? "mulf" : "mul", floating ? "addf" : "add");
+		for(int i = 0; i < 34; i++){
+			double value = (i - 9) * 0.37;
+			uint64_t word = floating ? 0 : 0x9E3779B97F4A7C15ULL * (i + 1);
+			if(floating){
+				memcpy(&word, &value, sizeof(uint64_t));
+			}
+			sprintf(text + strlen(text), "%s\t%lu\n", i == 11 ? ":b\n" : "", word);
+		}
+
+		ObjectBuffer* image = create_object_buffer();
+		ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+		for(int accelerate = 0; accelerate < 2; accelerate++){
+			use_vector_acceleration(accelerate);
+			Processor* native = create_processor();
+			Processor* interpreted = create_processor();
+			ASSERT_EQUALS(load_image(image->data, image->size, native), 0);
+			ASSERT_EQUALS(load_image(image->data, image->size, interpreted), 0);
+			ASSERT_TRUE(native->idioms != NULL && native->idioms->count == 1);
+			destroy_idioms(interpreted->idioms);
+			interpreted->idioms = NULL;
+
+			ASSERT_EQUALS(run_processor(native), 0);
+			ASSERT_EQUALS(run_processor(interpreted), 0);
+			ASSERT_TRUE(memcmp(native->registers, interpreted->registers, sizeof(native->registers)) == 0);
+			ASSERT_EQUALS(native->pc, interpreted->pc);
+			ASSERT_EQUALS(native->registers[5], 11);
+
+			// Deviations are left to the interpreter
+			const DotLoop* loop = &native->idioms->loops[0];
+			native->pc = loop->head;
+			native->registers[7] = loop->head;
+			native->registers[5] = 0;
+			native->registers[1] = MEM_SIZE - 16;
+			ASSERT_FALSE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+			native->registers[1] = INIT_DATA_ADDR;
+			ASSERT_TRUE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+			native->pc = loop->head;
+			native->registers[7] = loop->head + 4;
+			ASSERT_FALSE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+			native->registers[7] = loop->head;
+			native->memory[loop->head] ^= 1;
+			ASSERT_FALSE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+
+			destroy_processor(native);
+			destroy_processor(interpreted);
+		}
+		destroy_object_buffer(image);
+	}
+	use_vector_acceleration(true);
+
+	// Loops that write a register twice do not match
+	char text[] = ".code\n:loop\n\tmov r10, (r1)(0)\n\tmov r11, (r2)(0)\n\tmul r12, r10, r11\n\tadd r6, r6, r12\n"
+		"\taddi r1, 8\n\taddi r1, 8\n\taddi r5, 1\n\tbrgt r7, r4, r5\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_TRUE(processor->idioms == NULL);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+// Test that the inner loop of matrix_multiplication.tk runs natively and leaves the same state as interpreting it
+TEST_CASE(test_indexed_dot_loops){
+	MappedFile* source = map_file("matrix_multiplication.tk");
+	ASSERT_NOT_NULL(source);
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((const char*) source->data, source->size, image), 0);
+	unmap_file(source);
+
+	for(int accelerate = 0; accelerate < 2; accelerate++){
+		use_vector_acceleration(accelerate);
+		Processor* native = create_processor();
+		Processor* interpreted = create_processor();
+		ASSERT_EQUALS(load_image(image->data, image->size, native), 0);
+		ASSERT_EQUALS(load_image(image->data, image->size, interpreted), 0);
+		ASSERT_TRUE(native->idioms != NULL && native->idioms->count == 1 && native->idioms->loops[0].indexed);
+		destroy_idioms(interpreted->idioms);
+		interpreted->idioms = NULL;
+
+		// Enter the k loop for c[2][3] of two 5 by 5 matrices, as the j loop does
+		const DotLoop* loop = &native->idioms->loops[0];
+		uint64_t n = 5;
+		for(uint64_t i = 0; i < 2 * n * n; i++){
+			double value = (i * 7 % 11) * 0.37 - 1.5;
+			memcpy(&native->memory[65536 + i * 8], &value, sizeof(double));
+		}
+		native->registers[2] = n;
+		native->registers[6] = 2;
+		native->registers[7] = 3;
+		native->registers[8] = 0;
+		native->registers[10] = 65536;
+		native->registers[11] = 65536 + n * n * 8;
+		native->registers[22] = 8;
+		native->registers[5] = loop->head;
+		native->registers[19] = loop->head + 8;
+		native->pc = loop->head;
+		memcpy(interpreted->registers, native->registers, sizeof(native->registers));
+		memcpy(interpreted->memory, native->memory, MEM_SIZE);
+		interpreted->pc = native->pc;
+
+		// Interpret until the failing test at the head falls through to its br
+		while(interpreted->pc != loop->head + 4){
+			ASSERT_EQUALS(process_instruction(interpreted), 0);
+			interpreted->pc += 4;
+		}
+		ASSERT_TRUE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+		native->pc += 4;
+		ASSERT_TRUE(memcmp(native->registers, interpreted->registers, sizeof(native->registers)) == 0);
+		ASSERT_EQUALS(native->pc, interpreted->pc);
+		ASSERT_EQUALS(native->registers[8], n);
+
+		// A loop whose test fails at once, or whose body register moved, is interpreted
+		native->pc = loop->head;
+		ASSERT_FALSE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+		native->registers[8] = 0;
+		native->registers[19] = loop->head;
+		ASSERT_FALSE(run_idiom(native->idioms, native->registers, native->memory, &native->pc, false));
+
+		destroy_processor(native);
+		destroy_processor(interpreted);
+	}
+	use_vector_acceleration(true);
+
+	destroy_object_buffer(image);
+
+	// Index registers carried from the previous trip, or addresses not affine in rK, do not match
+	const char* indices[] = {"\tadd r20, r20, r8\n", "\tclr r20\n\tadd r20, r20, r8\n\tmul r20, r20, r8\n"};
+	for(int i = 0; i < 2; i++){
+		char text[512];
+		sprintf(text, ".code\n\tbrgt r19, r2, r8\n\thalt\n%s\tmov r23, (r20)(0)\n\tmov r24, (r21)(0)\n"
+			"\tmul r26, r23, r24\n\tadd r16, r16, r26\n\taddi r8, 1\n\tbr r5\n", indices[i]);
+		image = create_object_buffer();
+		ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+		Processor* processor = create_processor();
+		ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+		ASSERT_TRUE(processor->idioms == NULL);
+
+		destroy_processor(processor);
+		destroy_object_buffer(image);
+	}
+	return 0;
+}
+
+// Test that mulf/addf pairs with a dead product fuse, rounding once unless strict
+TEST_CASE(test_fused_pairs){
+	double values[3] = {1.0 + 0x1p-30, 1.0 - 0x1p-30, -1.0};
+	char text[1024];
+	sprintf(text, ".code\n\tld r1, :a\n\tmov r2, (r1)(0)\n\tmov r3, (r1)(8)\n\tmov r4, (r1)(16)\n"
+		"\tmulf r5, r2, r3\n\taddf r4, r5, r4\n\tmul r7, r7, r3\n\tadd r6, r6, r7\n\tmov r5, r2\n\tmov r7, r2\n\thalt\n.data\n:a\n");
+	for(int i = 0; i < 3; i++){
+		uint64_t word;
+		memcpy(&word, &values[i], sizeof(uint64_t));
+		sprintf(text + strlen(text), "\t%lu\n", word);
+	}
+
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	// The product of a and b rounds to 1, so only a fused pair keeps the last bits
+	double results[3];
+	for(int mode = 0; mode < 3; mode++){
+		Processor* processor = create_processor();
+		ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+		ASSERT_TRUE(processor->idioms != NULL && processor->idioms->pairCount == 2);
+		if(mode == 0){
+			destroy_idioms(processor->idioms);
+			processor->idioms = NULL;
+		}
+		processor->strictIEEE = mode == 1;
+		processor->registers[6] = 5;
+		processor->registers[7] = 3;
+
+		ASSERT_EQUALS(run_processor(processor), 0);
+		memcpy(&results[mode], &processor->registers[4], sizeof(double));
+		ASSERT_EQUALS(processor->registers[6], 5 + 3 * processor->registers[3]);
+		destroy_processor(processor);
+	}
+	ASSERT_TRUE(results[0] == 0.0 && results[1] == 0.0);
+	ASSERT_TRUE(results[2] == -0x1p-60);
+	destroy_object_buffer(image);
+
+	// A product read after the pair keeps both instructions
+	char live[] = ".code\n\tmulf r5, r2, r3\n\taddf r4, r4, r5\n\tmov r6, r5\n\thalt\n";
+	image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(live, strlen(live), image), 0);
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_TRUE(processor->idioms == NULL);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+// Test that a source assembled in memory loads and runs without an object file
+TEST_CASE(test_assemble_source){
+	char text[] = ".code\n\tld r1, :value\n\tmov r2, (r1)(0)\n\taddi r2, 5\n\thalt\n.data\n:value\n\t37\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[1], INIT_DATA_ADDR);
+	ASSERT_EQUALS(processor->registers[2], 42);
+
+	// Truncated images are rejected instead of read past their end
+	ASSERT_NOT_EQUALS(load_image(image->data, image->size - 8, processor), 0);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+
+	char invalid[] = ".code\n\tbogus r1\n";
+	image = create_object_buffer();
+	ASSERT_NOT_EQUALS(assemble_source(invalid, strlen(invalid), image), 0);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+// Test that ld loads constants correctly with the shortened sequences
+TEST_CASE(test_ld_constants){
+	uint64_t values[] = {0, 8, 4095, 4096, 65536, 0x1001, 0x4000000000000000ULL, 0x123456789ABCDEF0ULL, INT64_MAX};
+	uint64_t count = sizeof(values) / sizeof(values[0]);
+
+	for(uint64_t i = 0; i < count; i++){
+		char text[128];
+		// Fill r1 first so leftover bits would show up
+		sprintf(text, ".code\n\tld r1, 9223372036854775807\n\tld r1, %lu\n\thalt\n", values[i]);
+
+		ObjectBuffer* image = create_object_buffer();
+		ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+		Processor* processor = create_processor();
+		ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+		ASSERT_EQUALS(run_processor(processor), 0);
+		ASSERT_EQUALS(processor->registers[1], values[i]);
+
+		destroy_processor(processor);
+		destroy_object_buffer(image);
+	}
+
+	return 0;
+}
+
+// Test that brr reaches labels with both the short and the long form
+TEST_CASE(test_brr_labels){
+	// Fill the gap past brrL's range so the first branch takes the long form
+	ObjectBuffer* text = create_object_buffer();
+	const char* head = ".code\n\tld r0, 7\n\tbrr :far\n";
+	buffer_write(text, head, strlen(head));
+	for(int i = 0; i < 600; i++){
+		buffer_write(text, "\taddi r2, 1\n", strlen("\taddi r2, 1\n"));
+	}
+	const char* tail = ":far\n\taddi r0, 1\n\tbrr :forward\n:back\n\taddi r3, 1\n\thalt\n:forward\n\tbrr :back\n";
+	buffer_write(text, tail, strlen(tail));
+
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source((char*) text->data, text->position, image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+
+	// The long form leaves r0 intact and skips the gap
+	ASSERT_EQUALS(processor->registers[0], 8);
+	ASSERT_EQUALS(processor->registers[2], 0);
+	ASSERT_EQUALS(processor->registers[3], 1);
+	ASSERT_EQUALS(processor->registers[31], MEM_SIZE);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	destroy_object_buffer(text);
+	return 0;
+}
+
 // Test is_uint64 checks that a string is an unsigned 64-bit integer
 TEST_CASE(test_is_uint64){
     char str1[] = "0";
@@ -389,6 +968,257 @@ TEST_CASE(test_is_uint64){
 	return 0;
 }
 
+// Test that reserved data is zero-filled in memory without taking room in the object file
+TEST_CASE(test_reserved_data){
+	char text[] = ".code\n\tld r1, :buffer\n\tld r2, :aligned\n\tld r3, :end\n\tmov r4, (r2)(0)\n\thalt\n"
+		".data\n\t5\n:buffer\n.space 4000\n.align 64\n:aligned\n\t37\n.zero 16\n:end\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	// Only the two data words and the range table are stored
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image->data, sizeof(TinkerFileHeader));
+	ASSERT_EQUALS(tfh.fileType, FILE_FLAG_RESERVED);
+	ASSERT_EQUALS(tfh.dataSize, 16);
+	ASSERT_TRUE(image->size < 256);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[1], INIT_DATA_ADDR + 8);
+	ASSERT_EQUALS(processor->registers[2], INIT_DATA_ADDR + 4032);
+	ASSERT_EQUALS(processor->registers[3], INIT_DATA_ADDR + 4056);
+	ASSERT_EQUALS(processor->registers[4], 37);
+
+	// Memory starts out filled, so reserved bytes must have been cleared
+	for(uint64_t address = INIT_DATA_ADDR + 8; address < INIT_DATA_ADDR + 4032; address++){
+		ASSERT_EQUALS(processor->memory[address], 0);
+	}
+	ASSERT_EQUALS(processor->memory[INIT_DATA_ADDR + 4048], 0);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+
+	char misplaced[] = ".code\n.space 8\n\thalt\n";
+	image = create_object_buffer();
+	ASSERT_NOT_EQUALS(assemble_source(misplaced, strlen(misplaced), image), 0);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+// Test that constant expressions and .equ symbols are folded at assembly time
+TEST_CASE(test_constant_expressions){
+	char text[] = ".equ N, 4\n.equ STRIDE, N * 8\n.code\n\tld r1, :table + 8\n\tmov r2, (r1)(0)\n\tld r3, :table\n"
+		"\tmov r4, (r3)(STRIDE / 2 + 8)\n\tadd r2, r2, r4\n\taddi r2, (N - 1) * 3\n\tld r5, :table + N * 8\n"
+		"\tmov (r5)(STRIDE - 32), r2\n\tld r6, (N - 1) * STRIDE\n\tbrr :done - 4\n\thalt\n:done\n\tld r6, 0\n"
+		".data\n:table\n\tN\n\tSTRIDE + 10\n\t0 - 1\n\t7\n.space N * 2\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[1], INIT_DATA_ADDR + 8);
+	ASSERT_EQUALS(processor->registers[2], 42 + 7 + 9);
+	ASSERT_EQUALS(processor->registers[5], INIT_DATA_ADDR + 32);
+	ASSERT_EQUALS(processor->registers[6], 96);
+
+	uint64_t word;
+	memcpy(&word, &processor->memory[INIT_DATA_ADDR + 16], sizeof(uint64_t));
+	ASSERT_EQUALS(word, UINT64_MAX);
+	memcpy(&word, &processor->memory[INIT_DATA_ADDR + 32], sizeof(uint64_t));
+	ASSERT_EQUALS(word, 58);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+
+	// Symbols must be constant, defined once, and not look like registers
+	const char* invalid[] = {".equ N, :table\n.code\n\thalt\n", ".equ N, 1\n.equ N, 2\n.code\n\thalt\n",
+		".equ r3, 1\n.code\n\thalt\n", ".code\n\taddi r1, M\n\thalt\n",
+		// Operands that do not evaluate are errors, not their leading number
+		".code\n\tld r3, 7 + FOO\n\thalt\n", ".code\n\tld r3, 7 / 0\n\thalt\n", ".code\n\taddi r3, 7 / 0\n\thalt\n",
+		".code\n:lbl\n\tld r3, 7 * :lbl\n\thalt\n", ".code\n\tld r3, 7 )\n\thalt\n", ".code\n\tmov r1, (r2)(8 / 0)\n\thalt\n",
+		".code\n\thalt\n.data\n\t1 + FOO\n", ".code\n\thalt\n.data\n:lbl\n.space :lbl + 8\n"};
+	for(int i = 0; i < 12; i++){
+		image = create_object_buffer();
+		ASSERT_NOT_EQUALS(assemble_source(invalid[i], strlen(invalid[i]), image), 0);
+		destroy_object_buffer(image);
+	}
+	return 0;
+}
+
+// Test that programs over virtual registers run the same once allocated, spilled or not
+TEST_CASE(test_virtual_registers){
+	// 40 values stay live across a loop, more than the free registers hold
+	char text[4096] = ".code\n";
+	for(int i = 0; i < 40; i++){
+		sprintf(text + strlen(text), "\tld v%d, %d\n", i, i + 1);
+	}
+	strcat(text, "\tld v100, 3\n\tld v101, :again\n\tld v50, 0\n:again\n");
+	for(int i = 0; i < 40; i++){
+		sprintf(text + strlen(text), "\tadd v50, v50, v%d\n", i);
+	}
+	strcat(text, "\tsubi v100, 1\n\tbrnz v101, v100\n\tld v60, :buffer\n\tmov (v60)(8), v50\n\tmov r1, (v60)(8)\n"
+		"\thalt\n.data\n:buffer\n\t0\n\t0\n");
+
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[1], 3 * 820);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+TEST_CASE(test_load_memory){
+	const char* text = ".code\n\tld r1, :table\n\tmov r2, (r1)(8)\n\thalt\n.data\n:table\n\t7\n\t42\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	// The mapped file loads like the image it holds
+	char path[] = "/tmp/tinker_load_XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_TRUE(fd >= 0);
+	close(fd);
+	ASSERT_EQUALS(write_object_file(path, image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_memory(path, processor), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[2], 42);
+	destroy_processor(processor);
+
+	// A truncated file is refused
+	FILE* fp = fopen(path, "wb");
+	fwrite(image->data, 1, image->size - 12, fp);
+	fclose(fp);
+	processor = create_processor();
+	ASSERT_NOT_EQUALS(load_memory(path, processor), 0);
+	ASSERT_NOT_EQUALS(load_memory("/tmp/tinker_missing_object.tko", processor), 0);
+	destroy_processor(processor);
+
+	remove(path);
+	destroy_object_buffer(image);
+	return 0;
+}
+
+TEST_CASE(test_debug_table){
+	const char* text = ".equ N, 2\n.code\n\tld r1, N\n:loop\n\tsubi r1, 1\n\tld r2, :loop\n\tbrnz r2, r1\n"
+		"\tld r3, :value\n\tbr r3\n.data\n:value\n\t5\n";
+	AssemblerOptions options = {1, false, false, false, true, false};
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source_with_options(text, strlen(text), image, &options), 0);
+
+	// Without -g the image ends with its data segment
+	ObjectBuffer* plain = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), plain), 0);
+	ASSERT_TRUE(image->size > plain->size);
+	ASSERT_TRUE(memcmp(image->data + sizeof(uint64_t), plain->data + sizeof(uint64_t), plain->size - sizeof(uint64_t)) == 0);
+
+	// The loaded table names labels and the source lines of instructions
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_NOT_NULL(processor->debug);
+
+	char description[512];
+	ASSERT_EQUALS(describe_address(processor->debug, 0x2008, description, sizeof(description)), 0);
+	ASSERT_TRUE(strcmp(description, ":loop (line 5)") == 0);
+	ASSERT_EQUALS(describe_address(processor->debug, 0x200c, description, sizeof(description)), 0);
+	ASSERT_TRUE(strcmp(description, ":loop+4 (line 6)") == 0);
+	ASSERT_EQUALS(describe_address(processor->debug, INIT_DATA_ADDR, description, sizeof(description)), 0);
+	ASSERT_TRUE(strncmp(description, ":value", 6) == 0);
+
+	// The branch into the data segment fails either way
+	ASSERT_EQUALS(run_processor(processor), -1);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	destroy_object_buffer(plain);
+	return 0;
+}
+
+TEST_CASE(test_compressed_data){
+	// A counting table, a reserved range, and a run of zeros
+	char text[4096] = ".code\n\thalt\n.data\n";
+	for(int i = 1; i <= 64; i++){
+		sprintf(text + strlen(text), "\t%d\n", i * 3);
+	}
+	strcat(text, ".space 20\n\t0 - 7\n");
+	for(int i = 0; i < 64; i++){
+		strcat(text, "\t0\n");
+	}
+
+	AssemblerOptions options = {1, false, false, false, false, true};
+	ObjectBuffer* image = create_object_buffer();
+	ObjectBuffer* plain = create_object_buffer();
+	ASSERT_EQUALS(assemble_source_with_options(text, strlen(text), image, &options), 0);
+	ASSERT_EQUALS(assemble_source(text, strlen(text), plain), 0);
+
+	TinkerFileHeader tfh;
+	memcpy(&tfh, image->data, sizeof(TinkerFileHeader));
+	ASSERT_TRUE(tfh.fileType & FILE_FLAG_COMPRESSED);
+	ASSERT_EQUALS(tfh.dataSize, (uint64_t) 129 * 8);
+	ASSERT_TRUE(image->size < plain->size / 4);
+
+	// The compressed image loads the same memory as the plain one
+	Processor* processor = create_processor();
+	Processor* expected = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(load_image(plain->data, plain->size, expected), 0);
+	ASSERT_TRUE(memcmp(processor->memory, expected->memory, MEM_SIZE) == 0);
+
+	// A stream that ends early is refused
+	ASSERT_NOT_EQUALS(load_image(image->data, image->size - 1, processor), 0);
+
+	destroy_processor(processor);
+	destroy_processor(expected);
+	destroy_object_buffer(image);
+	destroy_object_buffer(plain);
+	return 0;
+}
+
+TEST_CASE(test_input_region){
+	// Three words and a partial word
+	uint64_t words[4] = {5, 10, 20, 0x0102};
+	char path[] = "/tmp/tinker_input_XXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_TRUE(fd >= 0);
+	ASSERT_EQUALS(write(fd, words, 26), 26);
+	close(fd);
+
+	// The size sits just below the mapped bytes
+	const char* text = ".code\n\tld r1, 16777208\n\tmov r2, (r1)(0)\n\tmov r3, (r1)(8)\n\tmov r4, (r1)(24)\n"
+		"\tmov r5, (r1)(32)\n\thalt\n";
+	ObjectBuffer* image = create_object_buffer();
+	ASSERT_EQUALS(assemble_source(text, strlen(text), image), 0);
+
+	Processor* processor = create_processor();
+	ASSERT_EQUALS(load_image(image->data, image->size, processor), 0);
+	ASSERT_EQUALS(attach_input(processor, path), 0);
+	ASSERT_EQUALS(run_processor(processor), 0);
+	ASSERT_EQUALS(processor->registers[1], INPUT_SIZE_ADDR);
+	ASSERT_EQUALS(processor->registers[2], 26);
+	ASSERT_EQUALS(processor->registers[3], 5);
+	ASSERT_EQUALS(processor->registers[4], 20);
+	ASSERT_EQUALS(processor->registers[5], 0x0102);
+
+	// Past the end of the file, and stores, are out of bounds
+	processor->registers[6] = INPUT_ADDR + 32;
+	ASSERT_NOT_EQUALS(movRRL(processor, 7, 6, 0, 0), 0);
+	processor->registers[6] = INPUT_ADDR;
+	ASSERT_NOT_EQUALS(movRLR(processor, 6, 7, 0, 0), 0);
+	ASSERT_NOT_EQUALS(attach_input(processor, "/tmp/tinker_missing_input"), 0);
+
+	destroy_processor(processor);
+	destroy_object_buffer(image);
+	remove(path);
+	return 0;
+}
+
 int main() {
 	printf("Simulator tests:\n");
 	RUN_TEST(test_add);
@@ -397,6 +1227,7 @@ int main() {
 	RUN_TEST(test_subi);
 	RUN_TEST(test_mul);
 	RUN_TEST(test_div);
+	RUN_TEST(test_ldw);
 	RUN_TEST(test_and);
 	RUN_TEST(test_or);
 	RUN_TEST(test_xor);
@@ -413,6 +1244,10 @@ int main() {
 	RUN_TEST(test_return);
 	RUN_TEST(test_brgt);
 	RUN_TEST(test_priv);
+	RUN_TEST(test_priv_output);
+	RUN_TEST(test_priv_memory);
+	RUN_TEST(test_priv_heap);
+	RUN_TEST(test_priv_harts);
 	RUN_TEST(test_movRRL);
 	RUN_TEST(test_movRR);
 	RUN_TEST(test_movRL);
@@ -421,6 +1256,23 @@ int main() {
 	RUN_TEST(test_subf);
 	RUN_TEST(test_mulf);
 	RUN_TEST(test_divf);
+	RUN_TEST(test_vector);
+	RUN_TEST(test_dot_loops);
+	RUN_TEST(test_indexed_dot_loops);
+	RUN_TEST(test_fused_pairs);
+	printf("\n");
+
+	printf("Loader tests:\n");
+	RUN_TEST(test_assemble_source);
+	RUN_TEST(test_ld_constants);
+	RUN_TEST(test_brr_labels);
+	RUN_TEST(test_reserved_data);
+	RUN_TEST(test_constant_expressions);
+	RUN_TEST(test_virtual_registers);
+	RUN_TEST(test_debug_table);
+	RUN_TEST(test_compressed_data);
+	RUN_TEST(test_load_memory);
+	RUN_TEST(test_input_region);
 	printf("\n");
 	
 	printf("Utils tests:\n");